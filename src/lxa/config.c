@@ -5,10 +5,13 @@
 #include "config.h"
 #include "vfs.h"
 #include "util.h"
+#include "lxa_instance.h"
 
-static char *g_rom_path = NULL;
-static int g_ram_size = 10 * 1024 * 1024;
-static bool g_rootless_mode = true;  /* Phase 15: Rootless windowing mode */
+static LXA_INSTANCE_LOCAL char *g_rom_path = NULL;
+static LXA_INSTANCE_LOCAL int g_ram_size = 10 * 1024 * 1024;
+static LXA_INSTANCE_LOCAL bool g_rootless_mode = true;  /* Phase 15: Rootless windowing mode */
+static LXA_INSTANCE_LOCAL bool g_render_thread = false; /* Present screens off the CPU thread */
+static LXA_INSTANCE_LOCAL bool g_fpu_host = false;      /* Host FPU arithmetic */
 
 static char *trim(char *str) {
     char *end;
@@ -58,6 +61,12 @@ bool config_load(const char *path) {
             } else if (strcmp(section, "display") == 0) {
                 if (strcmp(key, "rootless_mode") == 0) {
                     g_rootless_mode = (strcmp(val, "true") == 0 || strcmp(val, "1") == 0);
+                } else if (strcmp(key, "render_thread") == 0) {
+                    g_render_thread = (strcmp(val, "true") == 0 || strcmp(val, "1") == 0);
+                }
+            } else if (strcmp(section, "cpu") == 0) {
+                if (strcmp(key, "fpu") == 0) {
+                    g_fpu_host = (strcmp(val, "host") == 0);
                 }
             }
         }
@@ -75,6 +84,8 @@ void config_reset(void) {
 
     g_ram_size = 10 * 1024 * 1024;
     g_rootless_mode = true;
+    g_render_thread = false;
+    g_fpu_host = false;
 }
 
 const char *config_get_rom_path(void) {
@@ -92,3 +103,11 @@ bool config_get_rootless_mode(void) {
 void config_set_rootless_mode(bool enable) {
     g_rootless_mode = enable;
 }
+
+bool config_get_render_thread(void) {
+    return g_render_thread;
+}
+
+bool config_get_fpu_host(void) {
+    return g_fpu_host;
+}
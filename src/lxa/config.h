@@ -16,4 +16,18 @@ int config_get_ram_size(void);
 bool config_get_rootless_mode(void);
 void config_set_rootless_mode(bool enable);
 
+/*
+ * Render thread ([display] render_thread = true).
+ * A screen's host window is converted, uploaded and presented by a thread
+ * of its own instead of the CPU thread.
+ */
+bool config_get_render_thread(void);
+
+/*
+ * FPU arithmetic mode ([cpu] fpu = exact | host).
+ * "host" runs common 68881 arithmetic on the host FPU instead of the
+ * softfloat extended-precision emulation.
+ */
+bool config_get_fpu_host(void);
+
 #endif
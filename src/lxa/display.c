@@ -15,42 +15,56 @@
  * Phase 128 optimizations:
  *  - Dirty-region scanline tracking: display_update_planar() records the
  *    min/max dirty row; display_refresh() uploads only the changed rectangle
- *    via SDL_UpdateTexture instead of re-uploading the full texture every frame.
- *  - SSE2-accelerated planar-to-chunky: the inner bit-interleave loop uses
- *    SSE2 byte-shuffles on x86-64 hosts, giving ~4× throughput on 320-wide
- *    or 640-wide screens.
+ *    instead of re-uploading the full texture every frame.  The
+ *    rows are converted to ARGB (gathers on AVX2/AVX-512) directly into the
+ *    locked streaming texture, without a temporary buffer per frame.
+ *  - Vectorized planar-to-chunky: rows are converted by planar.c, which
+ *    picks an SSE2, AVX2 or AVX-512 (GFNI) kernel from cpuid.
  *  - Coalesced VBlank uploads: consecutive display_refresh_all() calls within
  *    the same VBlank share the dirty-rect information so only one SDL texture
  *    upload is emitted per frame.
+ *
+ * Rootless windows copy and upload only the screen rows that
+ * changed since the last VBlank (display_window_sync_from_screen()).  Screens
+ * and windows with nothing new are not presented at all, and presents are
+ * paced by the host monitor's refresh rate (display_present_due()).  With
+ * [display] render_thread = true a screen's window is converted, uploaded
+ * and presented by a thread of its own (display_render_start()).
  */
 
 #include "display.h"
 #include "config.h"
 #include "rootless_layout.h"
+#include "planar.h"
 #include "util.h"
 #include "m68k.h"
+#include "lxa_snapshot.h"
+#include "lxa_instance.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <png.h>
 
-/* Phase 128: SSE2 planar-to-chunky acceleration */
-#if defined(__SSE2__)
-#include <emmintrin.h>
-#define HAS_SSE2 1
-#else
-#define HAS_SSE2 0
-#endif
-
 /* SDL2 support is optional - check if available */
 #ifdef SDL2_FOUND
 #include <SDL.h>
+#include <pthread.h>
 #define HAS_SDL2 1
 #else
 #define HAS_SDL2 0
 #endif
 
+typedef struct display_rect_t
+{
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+} display_rect_t;
+
+#define DISPLAY_MAX_VISIBLE_RECTS 64
+
 /* Display state structure */
 struct display_t
 {
@@ -58,20 +72,31 @@ struct display_t
     SDL_Window   *window;
     SDL_Renderer *renderer;
     SDL_Texture  *texture;
+    uint32_t      last_present_ms;  /* SDL_GetTicks() of the last present */
+    struct display_render_t *render;  /* Render thread, or NULL: inline */
 #endif
     int           width;
     int           height;
     int           depth;
     uint8_t      *pixels;       /* Chunky pixel buffer (8-bit indexed) */
     uint32_t      palette[DISPLAY_MAX_COLORS];  /* ARGB format for SDL */
+    uint32_t     *staging;      /* ARGB rows if the texture won't lock */
+    size_t        staging_size; /*   (in pixels) */
     bool          dirty;        /* Needs refresh */
     int           dirty_row_min; /* Phase 128: first dirty row (-1 = none) */
     int           dirty_row_max; /* Phase 128: last dirty row (inclusive) */
+    int           sync_row_min;  /* Rows changed since the rootless */
+    int           sync_row_max;  /*   windows were last synced (min > max: none) */
+    bool          sync_palette;  /* Palette changed since then */
     
     /* Amiga screen bitmap info - for auto-sync from planar RAM */
     uint32_t      amiga_planes_ptr;  /* Pointer to BitMap.Planes[] array in emulated RAM */
     uint32_t      amiga_bpr;         /* Bytes per row in bitmap */
     uint32_t      amiga_depth;       /* Number of bitplanes */
+
+    int           slot;              /* Index into g_displays[] */
+    bool          wants_host_window;
+    char          title[256];
 };
 
 /*
@@ -87,6 +112,7 @@ struct display_window_t
     SDL_Renderer *renderer;
     SDL_Texture  *texture;
     uint32_t      sdl_window_id;  /* For event routing */
+    uint32_t      last_present_ms;  /* SDL_GetTicks() of the last present */
 #endif
     display_t    *screen;         /* Parent screen (for palette) */
     int           x, y;           /* Position on host desktop */
@@ -101,43 +127,51 @@ struct display_window_t
     char          title[256];
     uint8_t      *pixels;         /* Chunky pixel buffer */
     uint32_t      palette[DISPLAY_MAX_COLORS];  /* Local palette if no screen */
+    uint32_t     *staging;        /* ARGB rows if the texture won't lock */
+    size_t        staging_size;
     bool          dirty;
+    int           dirty_row_min;  /* Rows to upload (min > max: all) */
+    int           dirty_row_max;
+    bool          synced;         /* Pixels match the screen in sync_rects */
+    int           sync_rect_count;
+    display_rect_t sync_rects[DISPLAY_MAX_VISIBLE_RECTS];
     bool          in_use;         /* Slot is active */
+    bool          native_host;    /* Opened with uses_native_host */
 };
 
+/*
+ * Open displays, indexed by handle - 1.  The guest keeps
+ * display handles in its screen structures, so they must not depend on
+ * host heap addresses: a snapshot restore reopens each display under its
+ * old handle.
+ */
+#define MAX_DISPLAYS 32
+
+static LXA_INSTANCE_LOCAL display_t *g_displays[MAX_DISPLAYS];
+
 /* Rootless window tracking */
-static display_window_t g_windows[MAX_ROOTLESS_WINDOWS];
-static bool g_rootless_mode = false;
+static LXA_INSTANCE_LOCAL display_window_t g_windows[MAX_ROOTLESS_WINDOWS];
+static LXA_INSTANCE_LOCAL bool g_rootless_mode = false;
 /* -1 = use first in-use window; >= 0 = index into g_windows (set by
  * display_set_active_by_index for explicit per-test window selection). */
-static int g_active_rootless_window = -1;
-
-extern uint8_t g_ram[];
+static LXA_INSTANCE_LOCAL int g_active_rootless_window = -1;
 
-#define LXA_RAM_SIZE (10 * 1024 * 1024)
+extern LXA_INSTANCE_LOCAL uint8_t *g_ram;
+extern LXA_INSTANCE_LOCAL uint32_t g_ram_size;     /* chip RAM: bitplanes must live here */
 
 /* Global state */
-static bool g_display_initialized = false;
-static bool g_sdl_available = false;
-static bool g_headless_mode = false;  /* Skip SDL window creation for automated testing */
-static display_t *g_active_display = NULL;  /* Forward declaration for event routing */
+static LXA_INSTANCE_LOCAL bool g_display_initialized = false;
+static LXA_INSTANCE_LOCAL bool g_sdl_available = false;
+static LXA_INSTANCE_LOCAL bool g_headless_mode = false;  /* Skip SDL window creation for automated testing */
+static LXA_INSTANCE_LOCAL bool g_render_thread = false;  /* [display] render_thread */
+static LXA_INSTANCE_LOCAL display_t *g_active_display = NULL;  /* Forward declaration for event routing */
 #define EVENT_QUEUE_SIZE 256
-static display_event_t g_event_queue[EVENT_QUEUE_SIZE];
-static int g_event_queue_head = 0;
-static int g_event_queue_tail = 0;
-static int g_mouse_x = 0;
-static int g_mouse_y = 0;
-static int g_last_buttons = 0;  /* Track button state for inject release detection */
-
-typedef struct display_rect_t
-{
-    int x0;
-    int y0;
-    int x1;
-    int y1;
-} display_rect_t;
-
-#define DISPLAY_MAX_VISIBLE_RECTS 64
+static LXA_INSTANCE_LOCAL display_event_t g_event_queue[EVENT_QUEUE_SIZE];
+static LXA_INSTANCE_LOCAL int g_event_queue_head = 0;
+static LXA_INSTANCE_LOCAL int g_event_queue_tail = 0;
+static LXA_INSTANCE_LOCAL int g_mouse_x = 0;
+static LXA_INSTANCE_LOCAL int g_mouse_y = 0;
+static LXA_INSTANCE_LOCAL int g_last_buttons = 0;  /* Track button state for inject release detection */
 
 static uint32_t display_palette_fallback_argb(uint8_t idx)
 {
@@ -322,27 +356,8 @@ static void display_window_copy_screen_rect(display_window_t *window,
         uint8_t *dst = window->pixels + (size_t)(screen_y - window->host_y) * (size_t)window->width;
         int src_row_offset = screen_y * (int)bytes_per_row;
 
-        for (int screen_x = clipped.x0; screen_x <= clipped.x1; screen_x++)
-        {
-            int dst_x = screen_x - window->host_x;
-            int byte_idx = screen_x / 8;
-            int bit_idx = 7 - (screen_x % 8);
-            uint8_t pixel = 0;
-
-            for (uint32_t plane = 0; plane < bitmap_depth && plane < 8; plane++)
-            {
-                if (planes[plane])
-                {
-                    uint8_t plane_byte = planes[plane][src_row_offset + byte_idx];
-                    if (plane_byte & (1 << bit_idx))
-                    {
-                        pixel |= (1 << plane);
-                    }
-                }
-            }
-
-            dst[dst_x] = pixel;
-        }
+        planar_to_chunky_row(dst + (clipped.x0 - window->host_x), planes, src_row_offset,
+                             clipped.x0, clipped.x1 + 1, bitmap_depth < 8 ? (int)bitmap_depth : 8);
     }
 }
 
@@ -398,6 +413,7 @@ static void display_window_remove_front_window_overlaps(display_window_t *window
     }
 }
 
+#if HAS_SDL2
 static void display_event_set_rootless_coords(display_event_t *event,
                                               uint32_t sdl_window_id,
                                               int local_x,
@@ -426,6 +442,7 @@ static void display_event_set_rootless_coords(display_event_t *event,
                                   &event->mouse_x,
                                   &event->mouse_y);
 }
+#endif
 
 #if HAS_SDL2
 static uint32_t display_renderer_flags(void)
@@ -435,8 +452,123 @@ static uint32_t display_renderer_flags(void)
      * especially in rootless mode where both screen and window presents can stack. */
     return SDL_RENDERER_ACCELERATED;
 }
+
+/*
+ * Frame pacing without blocking on vsync.  Only changed frames
+ * are presented, and no faster than the refresh rate of the monitor the
+ * window is on: with a host slower than the 50Hz VBlank (remote desktops,
+ * 30Hz panels) a frame that could not be shown yet stays dirty and its
+ * changes go out with the next one.  A quarter of a frame of slack keeps
+ * timer jitter from dropping frames on a 50Hz host.
+ */
+static bool display_present_due(SDL_Window *window, uint32_t *last_present_ms)
+{
+    SDL_DisplayMode mode;
+    uint32_t        now = SDL_GetTicks();
+
+    if (SDL_GetWindowDisplayMode(window, &mode) == 0 && mode.refresh_rate > 0 &&
+        now - *last_present_ms < 750u / (uint32_t)mode.refresh_rate)
+    {
+        return false;
+    }
+
+    *last_present_ms = now;
+    return true;
+}
+
+/*
+ * Create the renderer and streaming texture of a screen's host window.
+ * Runs on the render thread when there is one, which then owns
+ * both.
+ */
+static bool display_create_renderer(display_t *display)
+{
+    display->renderer = SDL_CreateRenderer(
+        display->window, -1,
+        display_renderer_flags()
+    );
+
+    if (!display->renderer)
+    {
+        /* Fall back to software renderer */
+        display->renderer = SDL_CreateRenderer(display->window, -1, 0);
+    }
+
+    if (!display->renderer)
+    {
+        LPRINTF(LOG_ERROR, "display: SDL_CreateRenderer failed: %s\n",
+                SDL_GetError());
+        return false;
+    }
+
+    /* Create streaming texture for pixel updates */
+    display->texture = SDL_CreateTexture(
+        display->renderer,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STREAMING,
+        display->width, display->height
+    );
+
+    if (!display->texture)
+    {
+        LPRINTF(LOG_ERROR, "display: SDL_CreateTexture failed: %s\n",
+                SDL_GetError());
+        SDL_DestroyRenderer(display->renderer);
+        display->renderer = NULL;
+        return false;
+    }
+
+    /* Set logical size for proper scaling */
+    SDL_RenderSetLogicalSize(display->renderer, display->width, display->height);
+    return true;
+}
+
+/* Render thread, see display_render_start() */
+static bool display_render_start(display_t *display);
+static void display_render_stop(display_t *display);
+static void display_render_publish(display_t *display);
 #endif
 
+/*
+ * Add window rows y0..y1 to the range the next refresh uploads.
+ */
+static void display_window_mark_rows(display_window_t *window, int y0, int y1)
+{
+    if (!window->dirty)
+    {
+        window->dirty_row_min = y0;
+        window->dirty_row_max = y1;
+    }
+    else if (window->dirty_row_min <= window->dirty_row_max)
+    {
+        if (y0 < window->dirty_row_min) window->dirty_row_min = y0;
+        if (y1 > window->dirty_row_max) window->dirty_row_max = y1;
+    }
+    window->dirty = true;
+}
+
+/*
+ * The backing store changed behind the screen sync: sync and
+ * upload the whole window next time.
+ */
+static void display_window_invalidate(display_window_t *window)
+{
+    window->dirty = true;
+    window->dirty_row_min = 0;
+    window->dirty_row_max = -1;
+    window->synced = false;
+}
+
+/*
+ * Copy the visible parts of a rootless window from its screen's bitmap.
+ *
+ * Windows of the active screen copy only the screen rows that
+ * changed since the last sync (display_t.sync_row_min/max, fed by the
+ * VBlank planar sync) and note the window rows for a partial texture
+ * upload.  A different set of visible rectangles (the window moved, or a
+ * window in front of it did) or a window on another screen, whose rows
+ * nobody tracks, copies everything.
+ */
 static void display_window_sync_from_screen(display_window_t *window)
 {
     uint32_t planes_ptr;
@@ -448,12 +580,20 @@ static void display_window_sync_from_screen(display_window_t *window)
     const uint8_t *planes[8] = {0};
     display_rect_t visible_rects[DISPLAY_MAX_VISIBLE_RECTS];
     int visible_rect_count = 0;
+    display_t *screen;
+    bool full;
+    int row_min;
+    int row_max;
 
     if (!window || !window->in_use || !window->screen || !window->pixels)
     {
         return;
     }
 
+    screen = window->screen;
+    full = !window->synced || screen != g_active_display;
+    window->synced = false;
+
     if (!display_get_amiga_bitmap(window->screen, &planes_ptr, &bpr, &depth))
     {
         return;
@@ -469,7 +609,7 @@ static void display_window_sync_from_screen(display_window_t *window)
     for (uint32_t plane = 0; plane < depth && plane < 8; plane++)
     {
         uint32_t plane_addr = m68k_read_memory_32(planes_ptr + plane * 4);
-        if (plane_addr && plane_addr < LXA_RAM_SIZE)
+        if (plane_addr && plane_addr < g_ram_size)
         {
             planes[plane] = &g_ram[plane_addr];
         }
@@ -486,18 +626,41 @@ static void display_window_sync_from_screen(display_window_t *window)
                                                 &visible_rect_count,
                                                 DISPLAY_MAX_VISIBLE_RECTS);
 
+    full = full || visible_rect_count != window->sync_rect_count ||
+           memcmp(visible_rects, window->sync_rects,
+                  sizeof(display_rect_t) * (size_t)visible_rect_count) != 0;
+    row_min = full ? 0 : screen->sync_row_min;
+    row_max = full ? screen_height - 1 : screen->sync_row_max;
+
     for (int i = 0; i < visible_rect_count; i++)
     {
+        display_rect_t rows = visible_rects[i];
+
+        if (rows.y0 < row_min) rows.y0 = row_min;
+        if (rows.y1 > row_max) rows.y1 = row_max;
+        if (rows.y0 > rows.y1)
+        {
+            continue;
+        }
+
         display_window_copy_screen_rect(window,
                                         planes,
                                         bpr,
                                         depth,
                                         screen_width,
                                         screen_height,
-                                        &visible_rects[i]);
+                                        &rows);
+        display_window_mark_rows(window, rows.y0 - window->host_y, rows.y1 - window->host_y);
     }
 
-    window->dirty = true;
+    if (full || screen->sync_palette)
+    {
+        display_window_mark_rows(window, 0, window->height - 1);
+    }
+
+    memcpy(window->sync_rects, visible_rects, sizeof(display_rect_t) * (size_t)visible_rect_count);
+    window->sync_rect_count = visible_rect_count;
+    window->synced = true;
 }
 
 /*
@@ -516,9 +679,11 @@ bool display_init(void)
     {
         LPRINTF(LOG_INFO, "display: Rootless mode enabled\n");
     }
+    g_render_thread = config_get_render_thread();
 
     /* Initialize rootless window slots */
     memset(g_windows, 0, sizeof(g_windows));
+    memset(g_displays, 0, sizeof(g_displays));
     g_active_display = NULL;
     memset(g_event_queue, 0, sizeof(g_event_queue));
     g_event_queue_head = 0;
@@ -528,6 +693,12 @@ bool display_init(void)
     g_last_buttons = 0;
 
 #if HAS_SDL2
+    /* Render threads use Xlib too */
+    if (g_render_thread)
+    {
+        SDL_SetHint(SDL_HINT_VIDEO_X11_XINITTHREADS, "1");
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) < 0)
     {
         LPRINTF(LOG_WARNING, "display: SDL_Init failed: %s\n", SDL_GetError());
@@ -539,6 +710,21 @@ bool display_init(void)
         LPRINTF(LOG_INFO, "display: SDL2 initialized\n");
         g_sdl_available = true;
     }
+
+    /* Only X11 (made thread-safe above) renders into a window from a
+     * thread other than the one that created it; Cocoa, Wayland and
+     * Windows want the window's thread */
+    if (g_render_thread && g_sdl_available)
+    {
+        const char *driver = SDL_GetCurrentVideoDriver();
+
+        if (!driver || strcmp(driver, "x11") != 0)
+        {
+            LPRINTF(LOG_WARNING, "display: render_thread needs the x11 video driver (have %s), presenting inline\n",
+                    driver ? driver : "none");
+            g_render_thread = false;
+        }
+    }
 #else
     LPRINTF(LOG_INFO, "display: Built without SDL2 support\n");
     g_sdl_available = false;
@@ -558,6 +744,15 @@ void display_shutdown(void)
         return;
     }
 
+    for (int i = 0; i < MAX_ROOTLESS_WINDOWS; i++)
+    {
+        display_window_close(&g_windows[i]);
+    }
+    for (int i = 0; i < MAX_DISPLAYS; i++)
+    {
+        display_close(g_displays[i]);
+    }
+
 #if HAS_SDL2
     if (g_sdl_available)
     {
@@ -596,8 +791,8 @@ display_t *display_open(int width, int height, int depth, const char *title)
     return display_open_ex(width, height, depth, title, true);
 }
 
-display_t *display_open_ex(int width, int height, int depth,
-                           const char *title, bool wants_host_window)
+static display_t *display_open_slot(int slot, int width, int height, int depth,
+                                    const char *title, bool wants_host_window)
 {
     display_t *display;
 
@@ -626,6 +821,9 @@ display_t *display_open_ex(int width, int height, int depth,
     display->width = width;
     display->height = height;
     display->depth = depth;
+    display->slot = slot;
+    display->wants_host_window = wants_host_window;
+    snprintf(display->title, sizeof(display->title), "%s", title ? title : "");
 
     /* Allocate pixel buffer */
     display->pixels = calloc(width * height, sizeof(uint8_t));
@@ -684,49 +882,16 @@ display_t *display_open_ex(int width, int height, int depth,
             return NULL;
         }
 
-        display->renderer = SDL_CreateRenderer(
-            display->window, -1,
-            display_renderer_flags()
-        );
-
-        if (!display->renderer)
-        {
-            /* Fall back to software renderer */
-            display->renderer = SDL_CreateRenderer(display->window, -1, 0);
-        }
-
-        if (!display->renderer)
-        {
-            LPRINTF(LOG_ERROR, "display: SDL_CreateRenderer failed: %s\n",
-                    SDL_GetError());
-            SDL_DestroyWindow(display->window);
-            free(display->pixels);
-            free(display);
-            return NULL;
-        }
-
-        /* Create streaming texture for pixel updates */
-        display->texture = SDL_CreateTexture(
-            display->renderer,
-            SDL_PIXELFORMAT_ARGB8888,
-            SDL_TEXTUREACCESS_STREAMING,
-            width, height
-        );
-
-        if (!display->texture)
+        /* With a render thread, it creates the renderer */
+        if (!(g_render_thread && display_render_start(display)) &&
+            !display_create_renderer(display))
         {
-            LPRINTF(LOG_ERROR, "display: SDL_CreateTexture failed: %s\n",
-                    SDL_GetError());
-            SDL_DestroyRenderer(display->renderer);
             SDL_DestroyWindow(display->window);
             free(display->pixels);
             free(display);
             return NULL;
         }
 
-        /* Set logical size for proper scaling */
-        SDL_RenderSetLogicalSize(display->renderer, width, height);
-
         LPRINTF(LOG_INFO, "display: opened %dx%dx%d window '%s'\n",
                 width, height, depth, window_title);
     }
@@ -745,6 +910,10 @@ display_t *display_open_ex(int width, int height, int depth,
     display->dirty = true;
     display->dirty_row_min = 0;
     display->dirty_row_max = height - 1;
+    display->sync_row_min = 0;
+    display->sync_row_max = height - 1;
+    display->sync_palette = true;
+    g_displays[slot] = display;
     
     /* Set this as the active display for event routing */
     g_active_display = display;
@@ -752,6 +921,32 @@ display_t *display_open_ex(int width, int height, int depth,
     return display;
 }
 
+display_t *display_open_ex(int width, int height, int depth,
+                           const char *title, bool wants_host_window)
+{
+    for (int slot = 0; slot < MAX_DISPLAYS; slot++)
+    {
+        if (!g_displays[slot])
+        {
+            return display_open_slot(slot, width, height, depth,
+                                     title, wants_host_window);
+        }
+    }
+
+    LPRINTF(LOG_ERROR, "display: no free display slots (max %d)\n", MAX_DISPLAYS);
+    return NULL;
+}
+
+uint32_t display_handle(display_t *display)
+{
+    return display ? (uint32_t)display->slot + 1 : 0;
+}
+
+display_t *display_from_handle(uint32_t handle)
+{
+    return (handle >= 1 && handle <= MAX_DISPLAYS) ? g_displays[handle - 1] : NULL;
+}
+
 /*
  * Close a display window.
  */
@@ -768,9 +963,19 @@ void display_close(display_t *display)
         g_active_display = NULL;
     }
 
+    if (g_displays[display->slot] == display)
+    {
+        g_displays[display->slot] = NULL;
+    }
+
 #if HAS_SDL2
     if (g_sdl_available)
     {
+        /* The render thread destroys its renderer on the way out */
+        if (display->render)
+        {
+            display_render_stop(display);
+        }
         if (display->texture)
         {
             SDL_DestroyTexture(display->texture);
@@ -786,10 +991,24 @@ void display_close(display_t *display)
     }
 #endif
 
+    free(display->staging);
     free(display->pixels);
     free(display);
 }
 
+/*
+ * Any pixel may have changed colour, so the next refresh uploads
+ * all rows - also when some are dirty already, which used to leave the rest
+ * in the old colours - and the rootless windows redraw theirs.
+ */
+static void display_palette_changed(display_t *display)
+{
+    display->dirty = true;
+    display->dirty_row_min = 0;
+    display->dirty_row_max = display->height - 1;
+    display->sync_palette = true;
+}
+
 /*
  * Set a palette entry.
  */
@@ -815,7 +1034,7 @@ void display_set_color(display_t *display, int index, uint8_t r, uint8_t g, uint
     /* Store as ARGB */
     display->palette[index] = 0xFF000000 | ((uint32_t)r << 16) |
                               ((uint32_t)g << 8) | (uint32_t)b;
-    display->dirty = true;
+    display_palette_changed(display);
 }
 
 /*
@@ -839,7 +1058,7 @@ void display_set_palette_rgb4(display_t *display, int start, int count,
         display->palette[start + i] = 0xFF000000 | ((uint32_t)r << 16) |
                                       ((uint32_t)g << 8) | (uint32_t)b;
     }
-    display->dirty = true;
+    display_palette_changed(display);
 }
 
 /*
@@ -859,144 +1078,16 @@ void display_set_palette_rgb32(display_t *display, int start, int count,
         /* Assume input is 0x00RRGGBB, we need 0xFFRRGGBB (add alpha) */
         display->palette[start + i] = 0xFF000000 | (colors[i] & 0x00FFFFFF);
     }
-    display->dirty = true;
-}
-
-/*
- * Phase 128: SSE2-accelerated planar-to-chunky conversion for a single row.
- *
- * Converts one row of Amiga planar data (up to 8 planes) to an array of
- * 8-bit chunky pixel indices.  On SSE2 hosts this processes 8 pixels at a
- * time by loading each plane byte once and broadcasting it, then
- * bit-testing each bit position with a precomputed mask.
- *
- * @param dst          Destination chunky row buffer (one byte per pixel)
- * @param planes       Per-plane row start pointers (NULL entries are treated as plane=0)
- * @param byte_offset  Byte offset within each plane row for the current column block
- * @param col_start    First column to convert
- * @param col_end      One past the last column to convert
- * @param depth        Number of active planes (1–8)
- */
-static void planar_to_chunky_row(uint8_t *dst,
-                                 const uint8_t **planes,
-                                 int src_row_offset,
-                                 int col_start, int col_end,
-                                 int depth)
-{
-#if HAS_SSE2
-    /* Process groups of 8 pixels (= 1 byte per plane) using SSE2.
-     * Each iteration handles exactly 8 consecutive pixels. */
-    int col = col_start;
-
-    /* Align to the next 8-pixel boundary if needed */
-    int first_block = ((col_start + 7) / 8) * 8;
-    if (first_block > col_end) first_block = col_end;
-
-    /* Scalar prefix: columns before the first aligned 8-pixel block */
-    for (; col < first_block; col++)
-    {
-        int byte_idx = col / 8;
-        int bit_idx  = 7 - (col % 8);
-        uint8_t pixel = 0;
-        for (int p = 0; p < depth; p++)
-        {
-            if (planes[p] && (planes[p][src_row_offset + byte_idx] & (1 << bit_idx)))
-                pixel |= (1 << p);
-        }
-        dst[col - col_start] = pixel;
-    }
-
-    /* SSE2 loop: 8 pixels per iteration */
-    for (; col + 8 <= col_end; col += 8)
-    {
-        int byte_idx = col / 8;
-
-        /* Bit-mask constants: bit7..bit0 → pixel 0..7 */
-        __m128i bits = _mm_set_epi8(
-            0,0,0,0,0,0,0,0,
-            1<<0, 1<<1, 1<<2, 1<<3, 1<<4, 1<<5, 1<<6, (int8_t)(1<<7));
-        __m128i result = _mm_setzero_si128();
-
-        for (int p = 0; p < depth; p++)
-        {
-            if (!planes[p]) continue;
-            uint8_t plane_byte = planes[p][src_row_offset + byte_idx];
-            /* Broadcast the plane byte across all 16 lanes */
-            __m128i pb = _mm_set1_epi8((int8_t)plane_byte);
-            /* AND with bit masks → non-zero where the bit is set */
-            __m128i masked = _mm_and_si128(pb, bits);
-            /* Compare: produce 0xFF where bit was set, 0x00 elsewhere */
-            __m128i nonzero = _mm_cmpeq_epi8(masked, _mm_setzero_si128());
-            /* nonzero is 0xFF where bit was zero; invert to get 0xFF where bit was set */
-            __m128i bit_set = _mm_andnot_si128(nonzero, _mm_set1_epi8((int8_t)0xFF));
-            /* Mask to exactly 1 or 0 per lane, then scale by plane contribution */
-            __m128i contribution = _mm_and_si128(bit_set, _mm_set1_epi8(1));
-            /* Shift left by plane index via scalar multiplication (planes 0..7) */
-            if (p == 0) contribution = contribution;
-            else
-            {
-                /* For plane p, each contributing pixel should add (1<<p).
-                 * We can't do variable per-element shifts in SSE2, but we can
-                 * multiply by (1<<p) since values are 0 or 1. */
-                __m128i scale = _mm_set1_epi8((int8_t)(1 << p));
-                /* mullo_epi8 doesn't exist; use mullo_epi16 on 16-bit pairs */
-                __m128i lo = _mm_unpacklo_epi8(contribution, _mm_setzero_si128());
-                __m128i hi = _mm_unpackhi_epi8(contribution, _mm_setzero_si128());
-                __m128i slo = _mm_unpacklo_epi8(scale, _mm_setzero_si128());
-                __m128i shi = _mm_unpackhi_epi8(scale, _mm_setzero_si128());
-                lo = _mm_mullo_epi16(lo, slo);
-                hi = _mm_mullo_epi16(hi, shi);
-                contribution = _mm_packus_epi16(lo, hi);
-            }
-            result = _mm_add_epi8(result, contribution);
-        }
-
-        /* Store 8 bytes: low 8 bytes of the 16-byte register contain our pixels */
-        uint8_t tmp[16];
-        _mm_storeu_si128((__m128i *)tmp, result);
-        /* The bit ordering: bit7 of plane_byte = pixel 0 (leftmost).
-         * Our 'bits' mask stored (1<<7) in lane 0, so lane 0 = pixel 0. */
-        for (int i = 0; i < 8; i++)
-            dst[col - col_start + i] = tmp[i];
-    }
-
-    /* Scalar suffix */
-    for (; col < col_end; col++)
-    {
-        int byte_idx = col / 8;
-        int bit_idx  = 7 - (col % 8);
-        uint8_t pixel = 0;
-        for (int p = 0; p < depth; p++)
-        {
-            if (planes[p] && (planes[p][src_row_offset + byte_idx] & (1 << bit_idx)))
-                pixel |= (1 << p);
-        }
-        dst[col - col_start] = pixel;
-    }
-
-#else
-    /* Scalar fallback (non-SSE2 hosts) */
-    for (int col = col_start; col < col_end; col++)
-    {
-        int byte_idx = col / 8;
-        int bit_idx  = 7 - (col % 8);
-        uint8_t pixel = 0;
-        for (int p = 0; p < depth; p++)
-        {
-            if (planes[p] && (planes[p][src_row_offset + byte_idx] & (1 << bit_idx)))
-                pixel |= (1 << p);
-        }
-        dst[col - col_start] = pixel;
-    }
-#endif
+    display_palette_changed(display);
 }
 
 /*
  * Update display from planar bitmap data.
  * Converts Amiga planar format to chunky 8-bit indexed.
  *
- * Phase 128: uses SSE2-accelerated row conversion and tracks dirty-row
- * min/max so that display_refresh() uploads only the changed rectangle.
+ * Phase 128: tracks dirty-row min/max so that display_refresh() uploads
+ * only the changed rectangle.  Rows go through the vectorized
+ * kernels in planar.c.
  */
 void display_update_planar(display_t *display, int x, int y, int width, int height,
                            const uint8_t **planes, int bytes_per_row, int depth)
@@ -1044,6 +1135,10 @@ void display_update_planar(display_t *display, int x, int y, int width, int heig
         if (y + height - 1 > display->dirty_row_max) display->dirty_row_max = y + height - 1;
     }
     display->dirty = true;
+
+    /* Same rows for the rootless windows on this screen */
+    if (y < display->sync_row_min) display->sync_row_min = y;
+    if (y + height - 1 > display->sync_row_max) display->sync_row_max = y + height - 1;
 }
 
 /*
@@ -1091,8 +1186,372 @@ void display_update_chunky(display_t *display, int x, int y, int width, int heig
         if (y + height - 1 > display->dirty_row_max) display->dirty_row_max = y + height - 1;
     }
     display->dirty = true;
+
+    /* Same rows for the rootless windows on this screen */
+    if (y < display->sync_row_min) display->sync_row_min = y;
+    if (y + height - 1 > display->sync_row_max) display->sync_row_max = y + height - 1;
+}
+
+#if HAS_SDL2
+/*
+ * Phase 128: convert rows row_min..row_max of an indexed pixel buffer to
+ * ARGB and upload them into texture.  Shared by screens and
+ * rootless windows; the rows are converted straight into the locked
+ * streaming texture, with a palette lookup table resolved once per upload.
+ * Should the lock fail, they go through *staging (kept across calls, grown
+ * as needed) and SDL_UpdateTexture.
+ */
+static void display_upload_rows(SDL_Texture *texture, const uint8_t *pixels,
+                                int width, int height, const uint32_t *palette,
+                                int row_min, int row_max,
+                                uint32_t **staging, size_t *staging_size)
+{
+    uint32_t  lut[DISPLAY_MAX_COLORS];
+    SDL_Rect  dirty_rect;
+    uint32_t *dst;
+    int       pitch;
+
+    if (row_min < 0) row_min = 0;
+    if (row_max >= height) row_max = height - 1;
+    if (row_min > row_max)
+    {
+        /* Dirty without a row range (palette change): all rows */
+        row_min = 0;
+        row_max = height - 1;
+    }
+
+    for (int i = 0; i < DISPLAY_MAX_COLORS; i++)
+        lut[i] = display_palette_argb(palette, (uint8_t)i);
+
+    dirty_rect.x = 0;
+    dirty_rect.y = row_min;
+    dirty_rect.w = width;
+    dirty_rect.h = row_max - row_min + 1;
+
+    if (SDL_LockTexture(texture, &dirty_rect, (void **)&dst, &pitch) == 0)
+    {
+        for (int y = row_min; y <= row_max; y++)
+        {
+            chunky_to_argb_row(dst, pixels + (size_t)y * width, width, lut);
+            dst = (uint32_t *)((uint8_t *)dst + pitch);
+        }
+        SDL_UnlockTexture(texture);
+        return;
+    }
+
+    size_t needed = (size_t)width * (size_t)dirty_rect.h;
+    if (*staging_size < needed)
+    {
+        uint32_t *grown = (uint32_t *)realloc(*staging, needed * sizeof(uint32_t));
+        if (!grown)
+            return;
+        *staging      = grown;
+        *staging_size = needed;
+    }
+
+    for (int y = row_min; y <= row_max; y++)
+        chunky_to_argb_row(*staging + (size_t)(y - row_min) * width,
+                           pixels + (size_t)y * width, width, lut);
+
+    SDL_UpdateTexture(texture, &dirty_rect, *staging, width * (int)sizeof(uint32_t));
+}
+
+/*
+ * Phase 128: convert the dirty rows of the indexed pixel buffer to ARGB and
+ * upload them into the display texture.
+ */
+static void display_upload_dirty_rows(display_t *display)
+{
+    display_upload_rows(display->texture, display->pixels, display->width, display->height,
+                        display->palette, display->dirty_row_min, display->dirty_row_max,
+                        &display->staging, &display->staging_size);
+}
+
+/*
+ * Render thread of a screen's host window ([display]
+ * render_thread = true).
+ *
+ * At VBlank the emulation thread copies the rows changed since a slot was
+ * last filled, plus the palette, into the back slot of a triple buffer and
+ * swaps it with the ready slot.  The render thread swaps the ready slot
+ * with its front slot, converts the rows changed since its last frame to
+ * ARGB, uploads and presents - a slow present no longer holds up
+ * m68k_execute(), and frames it cannot keep up with are dropped rather
+ * than queued.
+ *
+ * SDL wants events pumped on the thread that initialised video, so that
+ * stays with the emulation thread (display_poll_events()).  The renderer
+ * is created, used and destroyed only on the render thread, which holds
+ * sdl_lock while it does; pumping, where SDL's renderer event watch
+ * updates the viewport on resizes, takes sdl_lock too and is put off to
+ * the next VBlank if a present is in progress.
+ */
+#define DISPLAY_RENDER_SLOTS 3
+
+typedef struct display_render_t
+{
+    pthread_t       thread;
+    pthread_mutex_t lock;           /* slots, fresh, upload rows, quit */
+    pthread_cond_t  wake;           /* frame published, quit, renderer ready */
+    pthread_mutex_t sdl_lock;       /* renderer in use */
+    bool            ready;          /* renderer created (or failed, !ok) */
+    bool            ok;
+    bool            quit;
+
+    uint8_t        *pixels[DISPLAY_RENDER_SLOTS];
+    uint32_t        palette[DISPLAY_RENDER_SLOTS][DISPLAY_MAX_COLORS];
+    int             back;           /* emulation thread fills it */
+    int             pending;        /* newest complete frame */
+    int             front;          /* render thread reads it */
+    bool            fresh;          /* pending not taken yet */
+    int             upload_min;     /* rows to upload with the next frame */
+    int             upload_max;     /*   (min > max: none) */
+
+    /* Emulation thread only: rows of each slot older than display->pixels */
+    int             stale_min[DISPLAY_RENDER_SLOTS];
+    int             stale_max[DISPLAY_RENDER_SLOTS];
+
+    uint32_t       *staging;        /* for display_upload_rows() */
+    size_t          staging_size;
+} display_render_t;
+
+static void *display_render_main(void *arg)
+{
+    display_t        *display = arg;
+    display_render_t *r       = display->render;
+
+    pthread_mutex_lock(&r->sdl_lock);
+    r->ok = display_create_renderer(display);
+    pthread_mutex_unlock(&r->sdl_lock);
+
+    pthread_mutex_lock(&r->lock);
+    r->ready = true;
+    pthread_cond_broadcast(&r->wake);
+
+    while (r->ok)
+    {
+        int front, row_min, row_max;
+
+        while (!r->fresh && !r->quit)
+            pthread_cond_wait(&r->wake, &r->lock);
+        if (r->quit)
+            break;
+
+        front         = r->pending;
+        r->pending    = r->front;
+        r->front      = front;
+        r->fresh      = false;
+        row_min       = r->upload_min;
+        row_max       = r->upload_max;
+        r->upload_min = display->height;
+        r->upload_max = -1;
+        pthread_mutex_unlock(&r->lock);
+
+        pthread_mutex_lock(&r->sdl_lock);
+        display_upload_rows(display->texture, r->pixels[front], display->width, display->height,
+                            r->palette[front], row_min, row_max, &r->staging, &r->staging_size);
+        SDL_RenderClear(display->renderer);
+        SDL_RenderCopy(display->renderer, display->texture, NULL, NULL);
+        SDL_RenderPresent(display->renderer);
+        pthread_mutex_unlock(&r->sdl_lock);
+
+        pthread_mutex_lock(&r->lock);
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    if (r->ok)
+    {
+        SDL_DestroyTexture(display->texture);
+        SDL_DestroyRenderer(display->renderer);
+        display->texture  = NULL;
+        display->renderer = NULL;
+    }
+    return NULL;
+}
+
+static void display_render_free(display_render_t *r)
+{
+    for (int i = 0; i < DISPLAY_RENDER_SLOTS; i++)
+        free(r->pixels[i]);
+    free(r->staging);
+    pthread_mutex_destroy(&r->lock);
+    pthread_mutex_destroy(&r->sdl_lock);
+    pthread_cond_destroy(&r->wake);
+    free(r);
+}
+
+/*
+ * Start the render thread of display, which creates the renderer.  false
+ * if it could not: the caller creates the renderer itself.
+ */
+static bool display_render_start(display_t *display)
+{
+    display_render_t *r = calloc(1, sizeof(*r));
+    size_t            frame = (size_t)display->width * (size_t)display->height;
+    bool              ok;
+
+    if (!r)
+        return false;
+
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_mutex_init(&r->sdl_lock, NULL);
+    pthread_cond_init(&r->wake, NULL);
+
+    for (int i = 0; i < DISPLAY_RENDER_SLOTS; i++)
+    {
+        r->pixels[i] = malloc(frame);
+        if (!r->pixels[i])
+        {
+            display_render_free(r);
+            return false;
+        }
+        r->stale_min[i] = 0;
+        r->stale_max[i] = display->height - 1;
+    }
+    r->back       = 0;
+    r->pending    = 1;
+    r->front      = 2;
+    r->upload_min = display->height;
+    r->upload_max = -1;
+
+    display->render = r;
+    if (pthread_create(&r->thread, NULL, display_render_main, display) != 0)
+    {
+        display->render = NULL;
+        display_render_free(r);
+        return false;
+    }
+
+    pthread_mutex_lock(&r->lock);
+    while (!r->ready)
+        pthread_cond_wait(&r->wake, &r->lock);
+    ok = r->ok;
+    pthread_mutex_unlock(&r->lock);
+
+    if (!ok)
+    {
+        pthread_join(r->thread, NULL);
+        display->render = NULL;
+        display_render_free(r);
+        LPRINTF(LOG_WARNING, "display: no render thread, presenting inline\n");
+    }
+    return ok;
+}
+
+static void display_render_stop(display_t *display)
+{
+    display_render_t *r = display->render;
+
+    pthread_mutex_lock(&r->lock);
+    r->quit = true;
+    pthread_cond_broadcast(&r->wake);
+    pthread_mutex_unlock(&r->lock);
+
+    pthread_join(r->thread, NULL);
+    display->render = NULL;
+    display_render_free(r);
+}
+
+/* Hand the display's current frame to its render thread */
+static void display_render_publish(display_t *display)
+{
+    display_render_t *r       = display->render;
+    int               row_min = display->dirty_row_min;
+    int               row_max = display->dirty_row_max;
+    int               up_min, up_max, b;
+
+    if (row_min < 0) row_min = 0;
+    if (row_max >= display->height) row_max = display->height - 1;
+
+    /* Dirty without a row range (palette change, expose): upload all rows */
+    up_min = row_min <= row_max ? row_min : 0;
+    up_max = row_min <= row_max ? row_max : display->height - 1;
+
+    for (int i = 0; i < DISPLAY_RENDER_SLOTS && row_min <= row_max; i++)
+    {
+        if (r->stale_min[i] > r->stale_max[i])
+        {
+            r->stale_min[i] = row_min;
+            r->stale_max[i] = row_max;
+        }
+        else
+        {
+            if (row_min < r->stale_min[i]) r->stale_min[i] = row_min;
+            if (row_max > r->stale_max[i]) r->stale_max[i] = row_max;
+        }
+    }
+
+    b = r->back;
+    if (r->stale_min[b] <= r->stale_max[b])
+    {
+        size_t offset = (size_t)r->stale_min[b] * (size_t)display->width;
+
+        memcpy(r->pixels[b] + offset, display->pixels + offset,
+               (size_t)(r->stale_max[b] - r->stale_min[b] + 1) * (size_t)display->width);
+        r->stale_min[b] = display->height;
+        r->stale_max[b] = -1;
+    }
+    memcpy(r->palette[b], display->palette, sizeof(display->palette));
+
+    pthread_mutex_lock(&r->lock);
+    r->back    = r->pending;
+    r->pending = b;
+    r->fresh   = true;
+    if (up_min < r->upload_min) r->upload_min = up_min;
+    if (up_max > r->upload_max) r->upload_max = up_max;
+    pthread_cond_signal(&r->wake);
+    pthread_mutex_unlock(&r->lock);
+}
+
+/*
+ * Keep render threads off their renderers while SDL events are
+ * pumped.  false (nothing locked) if one is presenting right now - unless
+ * that already put pumping off a few times, then wait for it, so that a
+ * render thread presenting back to back cannot starve input.
+ */
+#define DISPLAY_MAX_DEFERRED_PUMPS 4
+
+static LXA_INSTANCE_LOCAL int g_deferred_pumps = 0;
+
+static bool display_render_pause(void)
+{
+    bool wait = g_deferred_pumps >= DISPLAY_MAX_DEFERRED_PUMPS;
+
+    for (int i = 0; i < MAX_DISPLAYS; i++)
+    {
+        display_t *d = g_displays[i];
+
+        if (!d || !d->render)
+            continue;
+        if (wait)
+        {
+            pthread_mutex_lock(&d->render->sdl_lock);
+        }
+        else if (pthread_mutex_trylock(&d->render->sdl_lock) != 0)
+        {
+            while (--i >= 0)
+            {
+                if (g_displays[i] && g_displays[i]->render)
+                    pthread_mutex_unlock(&g_displays[i]->render->sdl_lock);
+            }
+            g_deferred_pumps++;
+            return false;
+        }
+    }
+    g_deferred_pumps = 0;
+    return true;
 }
 
+static void display_render_resume(void)
+{
+    for (int i = 0; i < MAX_DISPLAYS; i++)
+    {
+        if (g_displays[i] && g_displays[i]->render)
+            pthread_mutex_unlock(&g_displays[i]->render->sdl_lock);
+    }
+}
+#endif
+
 /*
  * Refresh the display - convert indexed pixels to ARGB and present.
  *
@@ -1112,67 +1571,25 @@ void display_refresh(display_t *display)
 #if HAS_SDL2
     if (g_sdl_available && display->texture)
     {
-        /* Phase 128: clamp dirty rows to valid range */
-        int row_min = display->dirty_row_min;
-        int row_max = display->dirty_row_max;
-        if (row_min < 0) row_min = 0;
-        if (row_max >= display->height) row_max = display->height - 1;
-        if (row_min > row_max)
-        {
-            /* Nothing dirty — still need to present the last frame */
-            row_min = 0;
-            row_max = display->height - 1;
-        }
-
-        int dirty_height = row_max - row_min + 1;
+        /* A clean display is already on screen, no present */
+        if (!display->dirty)
+            return;
 
-        /* Allocate a temporary ARGB row buffer for the dirty region */
-        uint32_t *argb_buf = (uint32_t *)malloc((size_t)display->width * (size_t)dirty_height * sizeof(uint32_t));
-        if (argb_buf)
+        if (display->render)
         {
-            /* Convert the dirty rows from indexed to ARGB */
-            for (int row = 0; row < dirty_height; row++)
-            {
-                uint32_t *dst = argb_buf + (size_t)row * display->width;
-                const uint8_t *src = display->pixels + (size_t)(row_min + row) * display->width;
-                for (int x = 0; x < display->width; x++)
-                {
-                    dst[x] = display_palette_argb(display->palette, src[x]);
-                }
-            }
-
-            /* Upload only the dirty rectangle */
-            SDL_Rect dirty_rect;
-            dirty_rect.x = 0;
-            dirty_rect.y = row_min;
-            dirty_rect.w = display->width;
-            dirty_rect.h = dirty_height;
-
-            SDL_UpdateTexture(display->texture, &dirty_rect,
-                              argb_buf, display->width * (int)sizeof(uint32_t));
-            free(argb_buf);
+            display_render_publish(display);
         }
         else
         {
-            /* OOM fallback: lock-based full upload */
-            uint32_t *tex_pixels;
-            int tex_pitch;
-            if (SDL_LockTexture(display->texture, NULL, (void **)&tex_pixels, &tex_pitch) == 0)
-            {
-                for (int y = 0; y < display->height; y++)
-                {
-                    uint32_t *dst = (uint32_t *)((uint8_t *)tex_pixels + y * tex_pitch);
-                    const uint8_t *src = display->pixels + y * display->width;
-                    for (int x = 0; x < display->width; x++)
-                        dst[x] = display_palette_argb(display->palette, src[x]);
-                }
-                SDL_UnlockTexture(display->texture);
-            }
-        }
+            if (!display_present_due(display->window, &display->last_present_ms))
+                return;
 
-        SDL_RenderClear(display->renderer);
-        SDL_RenderCopy(display->renderer, display->texture, NULL, NULL);
-        SDL_RenderPresent(display->renderer);
+            display_upload_dirty_rows(display);
+
+            SDL_RenderClear(display->renderer);
+            SDL_RenderCopy(display->renderer, display->texture, NULL, NULL);
+            SDL_RenderPresent(display->renderer);
+        }
     }
 #endif
 
@@ -1398,7 +1815,7 @@ static int sdl_mod_to_qualifier(uint16_t mod)
  * Returns true if quit was requested.
  * Also queues events for IDCMP processing.
  */
-bool display_poll_events(void)
+static bool display_poll_sdl_events(void)
 {
 #if HAS_SDL2
     /* In headless mode, skip SDL event polling but don't return early -
@@ -1425,6 +1842,25 @@ bool display_poll_events(void)
                     disp_event.type = DISPLAY_EVENT_CLOSEWINDOW;
                     queue_event(&disp_event);
                 }
+                else if (event.window.event == SDL_WINDOWEVENT_EXPOSED)
+                {
+                    /* Clean windows are not presented, redraw this one */
+                    display_window_t *win = display_window_from_sdl_id(event.window.windowID);
+                    if (win)
+                    {
+                        display_window_mark_rows(win, 0, win->height - 1);
+                    }
+
+                    /* Likewise for a screen's own window */
+                    for (int i = 0; i < MAX_DISPLAYS; i++)
+                    {
+                        display_t *d = g_displays[i];
+                        if (d && d->window && SDL_GetWindowID(d->window) == event.window.windowID)
+                        {
+                            d->dirty = true;
+                        }
+                    }
+                }
                 break;
 
             case SDL_MOUSEMOTION:
@@ -1545,6 +1981,22 @@ bool display_poll_events(void)
     return false;
 }
 
+bool display_poll_events(void)
+{
+#if HAS_SDL2
+    bool quit;
+
+    /* Not while a render thread is presenting, next VBlank then */
+    if (!display_render_pause())
+        return false;
+    quit = display_poll_sdl_events();
+    display_render_resume();
+    return quit;
+#else
+    return display_poll_sdl_events();
+#endif
+}
+
 /*
  * Set the active display (for event routing)
  * Called when a display is opened or focused
@@ -1583,6 +2035,16 @@ static display_window_t *find_free_window_slot(void)
     return NULL;
 }
 
+uint32_t display_window_handle(display_window_t *window)
+{
+    return window ? (uint32_t)(window - g_windows) + 1 : 0;
+}
+
+display_window_t *display_window_from_handle(uint32_t handle)
+{
+    return (handle >= 1 && handle <= MAX_ROOTLESS_WINDOWS) ? &g_windows[handle - 1] : NULL;
+}
+
 static bool display_window_reallocate_backing_store(display_window_t *window,
                                                     int host_width,
                                                     int host_height)
@@ -1651,7 +2113,7 @@ static bool display_window_reallocate_backing_store(display_window_t *window,
     }
 #endif
 
-    window->dirty = true;
+    display_window_invalidate(window);
     return true;
 }
 
@@ -1722,13 +2184,12 @@ display_window_t *display_window_open(display_t *screen, int x, int y,
  * is allocated. The window is rendered into its parent screen's host
  * display (the screen owns the SDL window via display_open()).
  */
-display_window_t *display_window_open_ex(display_t *screen, int x, int y,
-                                          int width, int height, int depth,
-                                          const char *title,
-                                          bool uses_native_host)
+static display_window_t *display_window_open_slot(display_window_t *win,
+                                                  display_t *screen, int x, int y,
+                                                  int width, int height, int depth,
+                                                  const char *title,
+                                                  bool uses_native_host)
 {
-    display_window_t *win;
-
     if (!g_display_initialized)
     {
         LPRINTF(LOG_ERROR, "display: display_window_open called before display_init\n");
@@ -1744,16 +2205,9 @@ display_window_t *display_window_open_ex(display_t *screen, int x, int y,
         return NULL;
     }
 
-    win = find_free_window_slot();
-    if (!win)
-    {
-        LPRINTF(LOG_ERROR, "display: no free window slots (max %d)\n",
-                MAX_ROOTLESS_WINDOWS);
-        return NULL;
-    }
-
     memset(win, 0, sizeof(*win));
     win->screen = screen;
+    win->native_host = uses_native_host;
     win->x = x;
     win->y = y;
     win->logical_width = width;
@@ -1918,10 +2372,28 @@ display_window_t *display_window_open_ex(display_t *screen, int x, int y,
             win->width, win->height);
 #endif
 
-    win->dirty = true;
+    display_window_invalidate(win);
     return win;
 }
 
+display_window_t *display_window_open_ex(display_t *screen, int x, int y,
+                                          int width, int height, int depth,
+                                          const char *title,
+                                          bool uses_native_host)
+{
+    display_window_t *win = find_free_window_slot();
+
+    if (!win)
+    {
+        LPRINTF(LOG_ERROR, "display: no free window slots (max %d)\n",
+                MAX_ROOTLESS_WINDOWS);
+        return NULL;
+    }
+
+    return display_window_open_slot(win, screen, x, y, width, height, depth,
+                                    title, uses_native_host);
+}
+
 /*
  * Close a rootless window.
  */
@@ -1950,6 +2422,7 @@ void display_window_close(display_window_t *window)
     }
 #endif
 
+    free(window->staging);
     free(window->pixels);
     memset(window, 0, sizeof(*window));
     /* in_use is already false from memset */
@@ -2007,7 +2480,7 @@ bool display_window_size(display_window_t *window, int width, int height)
         return false;
     }
 
-    window->dirty = true;
+    display_window_invalidate(window);
     return true;
 }
 
@@ -2100,10 +2573,12 @@ void display_window_refresh(display_window_t *window)
     }
 
 #if HAS_SDL2
-    if (g_sdl_available && window->texture)
+    /* A clean window already shows its frame, no present */
+    if (g_sdl_available && window->texture && window->dirty)
     {
-        uint32_t *tex_pixels;
-        int tex_pitch;
+        if (!display_present_due(window->window, &window->last_present_ms))
+            return;
+
         const uint32_t *palette;
 
         /* Use screen palette if available, otherwise local */
@@ -2116,22 +2591,9 @@ void display_window_refresh(display_window_t *window)
             palette = window->palette;
         }
 
-        if (SDL_LockTexture(window->texture, NULL, (void **)&tex_pixels, &tex_pitch) == 0)
-        {
-            /* Convert indexed pixels to ARGB using palette */
-            for (int y = 0; y < window->height; y++)
-            {
-                uint32_t *dst = (uint32_t *)((uint8_t *)tex_pixels + y * tex_pitch);
-                uint8_t *src = window->pixels + y * window->width;
-
-                for (int x = 0; x < window->width; x++)
-                {
-                    dst[x] = display_palette_argb(palette, src[x]);
-                }
-            }
-
-            SDL_UnlockTexture(window->texture);
-        }
+        display_upload_rows(window->texture, window->pixels, window->width, window->height,
+                            palette, window->dirty_row_min, window->dirty_row_max,
+                            &window->staging, &window->staging_size);
 
         SDL_RenderClear(window->renderer);
         SDL_RenderCopy(window->renderer, window->texture, NULL, NULL);
@@ -2173,31 +2635,12 @@ void display_window_update_planar(display_window_t *window, int x, int y,
     for (int row = 0; row < height; row++)
     {
         uint8_t *dst = window->pixels + (y + row) * window->width + x;
-        int src_row_offset = row * bytes_per_row;
 
-        for (int col = 0; col < width; col++)
-        {
-            int byte_idx = col / 8;
-            int bit_idx = 7 - (col % 8);  /* Amiga: MSB is leftmost pixel */
-            uint8_t pixel = 0;
-
-            /* Combine bits from all planes */
-            for (int plane = 0; plane < depth && plane < 8; plane++)
-            {
-                if (planes[plane])
-                {
-                    uint8_t plane_byte = planes[plane][src_row_offset + byte_idx];
-                    if (plane_byte & (1 << bit_idx))
-                    {
-                        pixel |= (1 << plane);
-                    }
-                }
-            }
-            dst[col] = pixel;
-        }
+        planar_to_chunky_row(dst, planes, row * bytes_per_row, 0, width, depth < 8 ? depth : 8);
     }
 
-    window->dirty = true;
+    display_window_mark_rows(window, y, y + height - 1);
+    window->synced = false;
 }
 
 /*
@@ -2272,6 +2715,14 @@ void display_refresh_all(void)
 #endif
         }
     }
+
+    /* Every window of the active screen has seen its changes */
+    if (g_active_display)
+    {
+        g_active_display->sync_row_min = g_active_display->height;
+        g_active_display->sync_row_max = -1;
+        g_active_display->sync_palette = false;
+    }
 }
 
 /*
@@ -2847,7 +3298,7 @@ bool display_capture_screen(display_t *display, const char *filename)
             for (uint32_t p = 0; p < depth && p < 8; p++)
             {
                 uint32_t addr = m68k_read_memory_32(planes_ptr + p * 4);
-                if (addr && addr < LXA_RAM_SIZE)
+                if (addr && addr < g_ram_size)
                 {
                     planes[p] = &g_ram[addr];
                     valid_planes++;
@@ -3381,3 +3832,192 @@ bool display_get_screen_info(int *width, int *height, int *depth, int *num_color
     
     return true;
 }
+
+/*
+ * Snapshot section.
+ *
+ * Displays and windows are saved with their geometry, palette and pixel
+ * buffers.  Loading closes everything that is open and reopens each saved
+ * display/window in its old slot, so the handles kept in guest memory stay
+ * valid; SDL objects are created anew.  Queued input events refer to
+ * their display by handle.
+ */
+void display_save_state(lxa_snap_buf_t *buf)
+{
+    uint32_t count = 0;
+
+    for (int i = 0; i < MAX_DISPLAYS; i++)
+        count += g_displays[i] != NULL;
+    lxa_snap_put_u32(buf, count);
+
+    for (int i = 0; i < MAX_DISPLAYS; i++)
+    {
+        display_t *d = g_displays[i];
+
+        if (!d)
+            continue;
+
+        lxa_snap_put_u32(buf, i);
+        lxa_snap_put_u32(buf, d->width);
+        lxa_snap_put_u32(buf, d->height);
+        lxa_snap_put_u32(buf, d->depth);
+        lxa_snap_put_u32(buf, d->wants_host_window);
+        lxa_snap_put(buf, d->title, sizeof(d->title));
+        lxa_snap_put(buf, d->palette, sizeof(d->palette));
+        lxa_snap_put_u32(buf, d->amiga_planes_ptr);
+        lxa_snap_put_u32(buf, d->amiga_bpr);
+        lxa_snap_put_u32(buf, d->amiga_depth);
+        lxa_snap_put(buf, d->pixels, (size_t)d->width * d->height);
+    }
+
+    count = 0;
+    for (int i = 0; i < MAX_ROOTLESS_WINDOWS; i++)
+        count += g_windows[i].in_use;
+    lxa_snap_put_u32(buf, count);
+
+    for (int i = 0; i < MAX_ROOTLESS_WINDOWS; i++)
+    {
+        display_window_t *w = &g_windows[i];
+
+        if (!w->in_use)
+            continue;
+
+        lxa_snap_put_u32(buf, i);
+        lxa_snap_put_u32(buf, display_handle(w->screen));
+        lxa_snap_put_u32(buf, w->native_host);
+        lxa_snap_put_u32(buf, w->x);
+        lxa_snap_put_u32(buf, w->y);
+        lxa_snap_put_u32(buf, w->host_x);
+        lxa_snap_put_u32(buf, w->host_y);
+        lxa_snap_put_u32(buf, w->width);
+        lxa_snap_put_u32(buf, w->height);
+        lxa_snap_put_u32(buf, w->logical_width);
+        lxa_snap_put_u32(buf, w->logical_height);
+        lxa_snap_put_u32(buf, w->depth);
+        lxa_snap_put_u32(buf, w->amiga_window_ptr);
+        lxa_snap_put(buf, w->title, sizeof(w->title));
+        lxa_snap_put(buf, w->palette, sizeof(w->palette));
+        lxa_snap_put(buf, w->pixels, (size_t)w->width * w->height);
+    }
+
+    lxa_snap_put_u32(buf, display_handle(g_active_display));
+    lxa_snap_put_u32(buf, g_active_rootless_window);
+    lxa_snap_put_u32(buf, g_mouse_x);
+    lxa_snap_put_u32(buf, g_mouse_y);
+    lxa_snap_put_u32(buf, g_last_buttons);
+    lxa_snap_put_u32(buf, g_event_queue_head);
+    lxa_snap_put_u32(buf, g_event_queue_tail);
+    for (int i = 0; i < EVENT_QUEUE_SIZE; i++)
+    {
+        display_event_t event = g_event_queue[i];
+
+        event.window = NULL;
+        lxa_snap_put(buf, &event, sizeof(event));
+        lxa_snap_put_u32(buf, display_handle(g_event_queue[i].window));
+    }
+}
+
+bool display_load_state(lxa_snap_buf_t *buf)
+{
+    uint32_t count;
+
+    if (!g_display_initialized)
+        return false;
+
+    for (int i = 0; i < MAX_ROOTLESS_WINDOWS; i++)
+        display_window_close(&g_windows[i]);
+    for (int i = 0; i < MAX_DISPLAYS; i++)
+        display_close(g_displays[i]);
+
+    count = lxa_snap_get_u32(buf);
+    for (uint32_t n = 0; n < count && !buf->error; n++)
+    {
+        uint32_t   slot   = lxa_snap_get_u32(buf);
+        int        width  = (int)lxa_snap_get_u32(buf);
+        int        height = (int)lxa_snap_get_u32(buf);
+        int        depth  = (int)lxa_snap_get_u32(buf);
+        bool       host   = lxa_snap_get_u32(buf) != 0;
+        char       title[sizeof(((display_t *)0)->title)];
+        display_t *d;
+
+        lxa_snap_get(buf, title, sizeof(title));
+        title[sizeof(title) - 1] = '\0';
+        if (buf->error || slot >= MAX_DISPLAYS || g_displays[slot])
+            return false;
+
+        d = display_open_slot(slot, width, height, depth, title[0] ? title : NULL, host);
+        if (!d)
+            return false;
+
+        lxa_snap_get(buf, d->palette, sizeof(d->palette));
+        d->amiga_planes_ptr = lxa_snap_get_u32(buf);
+        d->amiga_bpr        = lxa_snap_get_u32(buf);
+        d->amiga_depth      = lxa_snap_get_u32(buf);
+        lxa_snap_get(buf, d->pixels, (size_t)width * height);
+    }
+
+    count = lxa_snap_get_u32(buf);
+    for (uint32_t n = 0; n < count && !buf->error; n++)
+    {
+        uint32_t          slot   = lxa_snap_get_u32(buf);
+        display_t        *screen = display_from_handle(lxa_snap_get_u32(buf));
+        bool              native = lxa_snap_get_u32(buf) != 0;
+        display_window_t  saved;
+        display_window_t *w;
+
+        memset(&saved, 0, sizeof(saved));
+        saved.x              = (int)lxa_snap_get_u32(buf);
+        saved.y              = (int)lxa_snap_get_u32(buf);
+        saved.host_x         = (int)lxa_snap_get_u32(buf);
+        saved.host_y         = (int)lxa_snap_get_u32(buf);
+        saved.width          = (int)lxa_snap_get_u32(buf);
+        saved.height         = (int)lxa_snap_get_u32(buf);
+        saved.logical_width  = (int)lxa_snap_get_u32(buf);
+        saved.logical_height = (int)lxa_snap_get_u32(buf);
+        saved.depth          = (int)lxa_snap_get_u32(buf);
+        saved.amiga_window_ptr = lxa_snap_get_u32(buf);
+        lxa_snap_get(buf, saved.title, sizeof(saved.title));
+        saved.title[sizeof(saved.title) - 1] = '\0';
+        if (buf->error || slot >= MAX_ROOTLESS_WINDOWS)
+            return false;
+
+        w = display_window_open_slot(&g_windows[slot], screen, saved.x, saved.y,
+                                     saved.logical_width, saved.logical_height,
+                                     saved.depth, saved.title, native);
+        if (!w)
+            return false;
+
+        w->host_x = saved.host_x;
+        w->host_y = saved.host_y;
+        if (!display_window_reallocate_backing_store(w, saved.width, saved.height))
+            return false;
+#if HAS_SDL2
+        if (w->window)
+        {
+            SDL_SetWindowPosition(w->window, w->host_x, w->host_y);
+        }
+#endif
+        w->amiga_window_ptr = saved.amiga_window_ptr;
+        lxa_snap_get(buf, w->palette, sizeof(w->palette));
+        lxa_snap_get(buf, w->pixels, (size_t)w->width * w->height);
+        display_window_invalidate(w);
+    }
+
+    g_active_display         = display_from_handle(lxa_snap_get_u32(buf));
+    g_active_rootless_window = (int)lxa_snap_get_u32(buf);
+    g_mouse_x                = (int)lxa_snap_get_u32(buf);
+    g_mouse_y                = (int)lxa_snap_get_u32(buf);
+    g_last_buttons           = (int)lxa_snap_get_u32(buf);
+    g_event_queue_head       = (int)lxa_snap_get_u32(buf);
+    g_event_queue_tail       = (int)lxa_snap_get_u32(buf);
+    for (int i = 0; i < EVENT_QUEUE_SIZE; i++)
+    {
+        lxa_snap_get(buf, &g_event_queue[i], sizeof(g_event_queue[i]));
+        g_event_queue[i].window = display_from_handle(lxa_snap_get_u32(buf));
+    }
+
+    return !buf->error &&
+           g_event_queue_head >= 0 && g_event_queue_head < EVENT_QUEUE_SIZE &&
+           g_event_queue_tail >= 0 && g_event_queue_tail < EVENT_QUEUE_SIZE &&
+           g_active_rootless_window >= -1 && g_active_rootless_window < MAX_ROOTLESS_WINDOWS;
+}
@@ -70,6 +70,14 @@ display_t *display_open_ex(int width, int height, int depth,
  */
 void display_close(display_t *display);
 
+/*
+ * Guest-visible display handle (1..32, 0 for NULL) and its
+ * reverse. Handles stay valid across a snapshot restore; host pointers
+ * would not, and do not fit into 32 bits on every host.
+ */
+uint32_t   display_handle(display_t *display);
+display_t *display_from_handle(uint32_t handle);
+
 /*
  * Set a palette entry.
  * @param display  Display handle
@@ -303,6 +311,13 @@ display_window_t *display_window_open_ex(display_t *screen, int x, int y,
  */
 void display_window_close(display_window_t *window);
 
+/*
+ * Guest-visible window handle (slot + 1, 0 for NULL) and its
+ * reverse, see display_handle().
+ */
+uint32_t          display_window_handle(display_window_t *window);
+display_window_t *display_window_from_handle(uint32_t handle);
+
 /*
  * Move a rootless window.
  * @param window  Window handle
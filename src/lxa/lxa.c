@@ -1,11 +1,11 @@
 #include "lxa_internal.h"
 #include "lxa_memory.h"
+#include "lxa_snapshot.h"
+#include "lxa_watch.h"
 #include "lxa_api.h"
 
+#include <sys/syscall.h>
 
-#define RAM_START   0x000000
-#define RAM_SIZE    10 * 1024 * 1024
-#define RAM_END     RAM_START + RAM_SIZE - 1
 
 #define DEFAULT_ROM_PATH "../rom/lxa.rom"
 
@@ -130,40 +130,44 @@
 #define MAX_BREAKPOINTS       16
 
 /* Core emulator state - exported for lxa_api.c */
-uint8_t  g_ram[RAM_SIZE];
-uint8_t  g_rom[ROM_SIZE];
-bool     g_verbose                       = FALSE;
-bool     g_trace                         = FALSE;
-static bool     g_stepping                      = FALSE;
-static uint32_t g_next_pc                       = 0;
-static int      g_trace_buf[TRACE_BUF_ENTRIES];
-static int      g_trace_buf_idx                 = 0;
+LXA_INSTANCE_LOCAL uint8_t  *g_rom;                          /* ROM_SIZE bytes */
+LXA_INSTANCE_LOCAL bool      g_verbose                       = FALSE;
+LXA_INSTANCE_LOCAL bool      g_trace                         = FALSE;
+static LXA_INSTANCE_LOCAL bool     g_stepping                = FALSE;
+static LXA_INSTANCE_LOCAL uint32_t g_next_pc                 = 0;
+static LXA_INSTANCE_LOCAL int     *g_trace_buf;              /* TRACE_BUF_ENTRIES */
+static LXA_INSTANCE_LOCAL int      g_trace_buf_idx           = 0;
 
 /*
  * g_debug_active: fast-path gate for cpu_instr_callback().
  * When FALSE, the callback only checks for PC=0 (safety net).
  * When TRUE, full debugging (trace buffer, breakpoints, tracing, stepping).
+ *
+ * g_debug_active also selects the CPU execute loop.  While it is
+ * FALSE the fast loop runs, which calls cpu_instr_callback() only at block
+ * dispatch (branch targets), so the trace buffer holds control-flow history
+ * rather than every instruction.
  */
 
-static bool     g_debug_active                  = FALSE;
-bool     g_running                       = TRUE;
-char    *g_loadfile                      = NULL;
+static LXA_INSTANCE_LOCAL bool g_debug_active         = FALSE;
+LXA_INSTANCE_LOCAL bool     g_running                  = TRUE;
+LXA_INSTANCE_LOCAL char    *g_loadfile                 = NULL;
 
 /* Output capture callback for test drivers */
-void (*g_console_output_hook)(const char *data, int len) = NULL;
+LXA_INSTANCE_LOCAL void (*g_console_output_hook)(const char *data, int len) = NULL;
 
 /* Text() interception hook for test drivers (Phase 130) */
-void (*g_text_hook)(const char *str, int len, int x, int y, void *userdata) = NULL;
-void *g_text_hook_userdata = NULL;
+LXA_INSTANCE_LOCAL void (*g_text_hook)(const char *str, int len, int x, int y, void *userdata) = NULL;
+LXA_INSTANCE_LOCAL void *g_text_hook_userdata = NULL;
 
 #define MAX_ARGS_LEN 4096
-char     g_args[MAX_ARGS_LEN]            = {0};
-int      g_args_len                      = 0;
+LXA_INSTANCE_LOCAL char     g_args[MAX_ARGS_LEN]            = {0};
+LXA_INSTANCE_LOCAL int      g_args_len                      = 0;
 
-static uint32_t g_breakpoints[MAX_BREAKPOINTS];
-static int      g_num_breakpoints               = 0;
-int      g_rv                            = 0;
-char    *g_sysroot                       = NULL;
+static LXA_INSTANCE_LOCAL uint32_t g_breakpoints[MAX_BREAKPOINTS];
+static LXA_INSTANCE_LOCAL int      g_num_breakpoints     = 0;
+LXA_INSTANCE_LOCAL int      g_rv                         = 0;
+LXA_INSTANCE_LOCAL char    *g_sysroot                    = NULL;
 
 /*
  * Hardware blitter emulation state.
@@ -177,7 +181,7 @@ char    *g_sysroot                       = NULL;
  * copper interpreter (Phase 114). Apps and tests can observe the
  * current palette via lxa_get_color() / EMU_CALL_GFX_GET_COLOR.
  */
-uint16_t g_color_regs[32] = {0};
+LXA_INSTANCE_LOCAL uint16_t g_color_regs[32] = {0};
 
 typedef struct map_sym_s map_sym_t;
 
@@ -189,22 +193,25 @@ struct map_sym_s
     bool       owns_name;
 };
 
-static map_sym_t *_g_map      = NULL;
-
-typedef struct pending_bp_s pending_bp_t;
+static LXA_INSTANCE_LOCAL map_sym_t  *_g_map       = NULL;
+static LXA_INSTANCE_LOCAL map_sym_t **_g_map_index = NULL;    /* _g_map as a sorted array */
+static LXA_INSTANCE_LOCAL int         _g_map_count = 0;
+static LXA_INSTANCE_LOCAL bool        _g_map_dirty = true;
 
-struct pending_bp_s
-{
-    pending_bp_t *next;
-    char          name[256];
-};
+/* Bitmap converted by the previous _sync_active_display() */
+static LXA_INSTANCE_LOCAL display_t *_g_sync_disp;
+static LXA_INSTANCE_LOCAL uint32_t   _g_sync_planes[8];
+static LXA_INSTANCE_LOCAL uint32_t   _g_sync_bpr;
+static LXA_INSTANCE_LOCAL uint32_t   _g_sync_depth;
+static LXA_INSTANCE_LOCAL int        _g_sync_w;
+static LXA_INSTANCE_LOCAL int        _g_sync_h;
 
-pending_bp_t *_g_pending_bps = NULL;
+LXA_INSTANCE_LOCAL pending_bp_t *_g_pending_bps = NULL;
 
 // interrupts
 
-uint16_t g_intena  = INTENA_MASTER | INTENA_VBLANK;
-uint16_t g_intreq  = 0;
+LXA_INSTANCE_LOCAL uint16_t g_intena  = INTENA_MASTER | INTENA_VBLANK;
+LXA_INSTANCE_LOCAL uint16_t g_intreq  = 0;
 
 /* DMA control shadow register.
  * Start with all common DMA channels enabled + master bit:
@@ -218,12 +225,12 @@ uint16_t g_intreq  = 0;
  * Programs read DMACONR to check whether DMA channels are available.
  * Bit 14 (BLTBUSY) is 0 = blitter is idle (our blitter executes synchronously).
  */
-uint16_t g_dmacon = 0x03F0;  /* MASTER|RASTER|COPPER|BLITTER|SPRITE|DISK + audio */
+LXA_INSTANCE_LOCAL uint16_t g_dmacon = 0x03F0;  /* MASTER|RASTER|COPPER|BLITTER|SPRITE|DISK + audio */
 
 /*
  * Phase 6.5: Timer-driven preemptive multitasking
  *
- * We use a host-side timer (setitimer) to generate periodic interrupts
+ * We use a host-side timer (lxa_start_timer()) to generate periodic interrupts
  * at ~50Hz (PAL VBlank rate). The SIGALRM handler sets a pending interrupt
  * flag which is checked in the main emulation loop.
  *
@@ -232,10 +239,13 @@ uint16_t g_dmacon = 0x03F0;  /* MASTER|RASTER|COPPER|BLITTER|SPRITE|DISK + audio
  */
 
 /* Pending interrupt flags (one bit per level 1-7) - exported for lxa_api.c */
-volatile sig_atomic_t g_pending_irq = 0;
+LXA_INSTANCE_LOCAL volatile sig_atomic_t g_pending_irq = 0;
+
+/* No task is ready; the main loop sleeps until the next VBlank */
+LXA_INSTANCE_LOCAL bool g_guest_idle = false;
 
 /* Last input event for IDCMP handling (Phase 14) */
-display_event_t g_last_event = {0};
+LXA_INSTANCE_LOCAL display_event_t g_last_event = {0};
 
 /* Timer frequency in microseconds (50Hz = 20000us = 20ms) */
 #define TIMER_INTERVAL_US 20000
@@ -247,6 +257,65 @@ void sigalrm_handler(int sig)
     g_pending_irq |= (1 << 3);  /* Level 3 = VBlank */
 }
 
+/*
+ * The timer is a POSIX timer aimed at the calling thread rather
+ * than setitimer(), which is one per process: with several instances in
+ * one process each thread gets its own VBlank signal, and the handler sets
+ * that thread's g_pending_irq.
+ */
+static LXA_INSTANCE_LOCAL timer_t g_vblank_timer;
+static LXA_INSTANCE_LOCAL bool    g_vblank_timer_armed = FALSE;
+
+bool lxa_start_timer(void)
+{
+    struct sigaction  sa;
+    struct sigevent   sev;
+    struct itimerspec its;
+
+    lxa_stop_timer();
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigalrm_handler;
+    sa.sa_flags = SA_RESTART;  /* Restart interrupted syscalls */
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGALRM, &sa, NULL) < 0)
+    {
+        perror("sigaction");
+        return false;
+    }
+
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify    = SIGEV_THREAD_ID;
+    sev.sigev_signo     = SIGALRM;
+    sev._sigev_un._tid  = (pid_t)syscall(SYS_gettid);
+    if (timer_create(CLOCK_MONOTONIC, &sev, &g_vblank_timer) < 0)
+    {
+        perror("timer_create");
+        return false;
+    }
+
+    its.it_value.tv_sec     = 0;
+    its.it_value.tv_nsec    = TIMER_INTERVAL_US * 1000;
+    its.it_interval         = its.it_value;
+    if (timer_settime(g_vblank_timer, 0, &its, NULL) < 0)
+    {
+        perror("timer_settime");
+        timer_delete(g_vblank_timer);
+        return false;
+    }
+
+    g_vblank_timer_armed = TRUE;
+    return true;
+}
+
+void lxa_stop_timer(void)
+{
+    if (!g_vblank_timer_armed)
+        return;
+    timer_delete(g_vblank_timer);
+    g_vblank_timer_armed = FALSE;
+}
+
 /*
  * Phase 3: Lock management
  * 
@@ -257,9 +326,9 @@ void sigalrm_handler(int sig)
  *   - A DIR* handle for directory iteration (for ExNext)
  *   - Reference count for DupLock
  */
-static char g_console_input_queue[1024];
-static int g_console_input_head = 0;
-static int g_console_input_tail = 0;
+static LXA_INSTANCE_LOCAL char g_console_input_queue[1024];
+static LXA_INSTANCE_LOCAL int  g_console_input_head = 0;
+static LXA_INSTANCE_LOCAL int  g_console_input_tail = 0;
 
 bool lxa_host_console_input_empty(void)
 {
@@ -376,17 +445,54 @@ bool lxa_host_console_enqueue_rawkey(int rawkey, int qualifier, bool down)
     return lxa_host_console_input_push((char)ch);
 }
 
+/*
+ * Tables too large for thread-local storage (lxa_instance.h).
+ * Allocated once per instance before the ROM is loaded and released by
+ * lxa_shutdown().
+ */
+bool lxa_alloc_host_state(void)
+{
+    if (!g_rom)
+        g_rom = calloc(1, ROM_SIZE);
+    if (!g_trace_buf)
+        g_trace_buf = calloc(TRACE_BUF_ENTRIES, sizeof(*g_trace_buf));
+    if (!g_locks)
+        g_locks = calloc(MAX_LOCKS, sizeof(lock_entry_t));
+    if (!g_notify_requests)
+        g_notify_requests = calloc(MAX_NOTIFY_REQUESTS, sizeof(notify_entry_t));
+
+    if (g_rom && g_trace_buf && g_locks && g_notify_requests)
+        return true;
+
+    lxa_free_host_state();
+    return false;
+}
+
+void lxa_free_host_state(void)
+{
+    free(g_rom);
+    free(g_trace_buf);
+    free(g_locks);
+    free(g_notify_requests);
+    g_rom             = NULL;
+    g_trace_buf       = NULL;
+    g_locks           = NULL;
+    g_notify_requests = NULL;
+}
+
 void lxa_reset_host_state(void)
 {
+    _g_sync_disp = NULL;
     _g_map = NULL;
+    _g_map_dirty = true;
     _g_pending_bps = NULL;
 
     g_trace = FALSE;
     g_stepping = FALSE;
     g_next_pc = 0;
-    memset(g_trace_buf, 0, sizeof(g_trace_buf));
+    if (g_trace_buf)
+        memset(g_trace_buf, 0, TRACE_BUF_ENTRIES * sizeof(*g_trace_buf));
     g_trace_buf_idx = 0;
-    g_debug_active = FALSE;
     g_running = TRUE;
     g_loadfile = NULL;
     g_console_output_hook = NULL;
@@ -396,17 +502,22 @@ void lxa_reset_host_state(void)
     g_args_len = 0;
     memset(g_breakpoints, 0, sizeof(g_breakpoints));
     g_num_breakpoints = 0;
+    _update_debug_active();
+    lxa_watch_clear();
     g_rv = 0;
     g_sysroot = NULL;
     g_last_event = (display_event_t){0};
-    memset(g_locks, 0, sizeof(lock_entry_t) * MAX_LOCKS);
+    if (g_locks)
+        memset(g_locks, 0, sizeof(lock_entry_t) * MAX_LOCKS);
     memset(g_record_locks, 0, sizeof(record_lock_entry_t) * MAX_RECORD_LOCKS);
     memset(g_timer_queue, 0, sizeof(timer_request_t) * MAX_TIMER_REQUESTS);
-    memset(g_notify_requests, 0, sizeof(notify_entry_t) * MAX_NOTIFY_REQUESTS);
+    if (g_notify_requests)
+        memset(g_notify_requests, 0, sizeof(notify_entry_t) * MAX_NOTIFY_REQUESTS);
     memset(g_console_input_queue, 0, sizeof(g_console_input_queue));
     g_console_input_head = 0;
     g_console_input_tail = 0;
     g_pending_irq = 0;
+    g_guest_idle = false;
 
     /* Reset chipset shadow state so a previous in-process run does not
      * leak custom-register values (DMACON, COP1LC, palette) into the
@@ -424,6 +535,65 @@ void lxa_reset_host_state(void)
 #endif
 }
 
+/*
+ * Snapshot section for the state above, loaded after the
+ * display section so display handles resolve.  The program name is
+ * copied since g_loadfile points into the caller's buffer; the VBlank sync
+ * cache is dropped so the first frame after a restore converts the whole
+ * screen.  Debugger state (breakpoints, trace) belongs to this session.
+ */
+static LXA_INSTANCE_LOCAL char g_snap_loadfile[PATH_MAX];
+
+void lxa_save_host_state(lxa_snap_buf_t *buf)
+{
+    char            loadfile[PATH_MAX] = {0};
+    display_event_t last_event = g_last_event;
+
+    last_event.window = NULL;
+    if (g_loadfile)
+        snprintf(loadfile, sizeof(loadfile), "%s", g_loadfile);
+
+    lxa_snap_put(buf, loadfile, sizeof(loadfile));
+    lxa_snap_put(buf, g_args, MAX_ARGS_LEN);
+    lxa_snap_put(buf, &g_args_len, sizeof(g_args_len));
+    lxa_snap_put(buf, &g_running, sizeof(g_running));
+    lxa_snap_put(buf, &g_rv, sizeof(g_rv));
+    lxa_snap_put(buf, &last_event, sizeof(last_event));
+    lxa_snap_put_u32(buf, display_handle(g_last_event.window));
+    lxa_snap_put(buf, g_console_input_queue, sizeof(g_console_input_queue));
+    lxa_snap_put(buf, &g_console_input_head, sizeof(g_console_input_head));
+    lxa_snap_put(buf, &g_console_input_tail, sizeof(g_console_input_tail));
+    lxa_snap_put(buf, g_color_regs, sizeof(g_color_regs));
+    lxa_snap_put(buf, &g_intena, sizeof(g_intena));
+    lxa_snap_put(buf, &g_intreq, sizeof(g_intreq));
+    lxa_snap_put(buf, &g_dmacon, sizeof(g_dmacon));
+}
+
+bool lxa_load_host_state(lxa_snap_buf_t *buf)
+{
+    lxa_snap_get(buf, g_snap_loadfile, sizeof(g_snap_loadfile));
+    lxa_snap_get(buf, g_args, MAX_ARGS_LEN);
+    lxa_snap_get(buf, &g_args_len, sizeof(g_args_len));
+    lxa_snap_get(buf, &g_running, sizeof(g_running));
+    lxa_snap_get(buf, &g_rv, sizeof(g_rv));
+    lxa_snap_get(buf, &g_last_event, sizeof(g_last_event));
+    g_last_event.window = display_from_handle(lxa_snap_get_u32(buf));
+    lxa_snap_get(buf, g_console_input_queue, sizeof(g_console_input_queue));
+    lxa_snap_get(buf, &g_console_input_head, sizeof(g_console_input_head));
+    lxa_snap_get(buf, &g_console_input_tail, sizeof(g_console_input_tail));
+    lxa_snap_get(buf, g_color_regs, sizeof(g_color_regs));
+    lxa_snap_get(buf, &g_intena, sizeof(g_intena));
+    lxa_snap_get(buf, &g_intreq, sizeof(g_intreq));
+    if (!lxa_snap_get(buf, &g_dmacon, sizeof(g_dmacon)))
+        return false;
+
+    g_snap_loadfile[sizeof(g_snap_loadfile) - 1] = 0;
+    g_loadfile = g_snap_loadfile[0] ? g_snap_loadfile : NULL;
+    g_pending_irq = 0;
+    _g_sync_disp = NULL;
+    return true;
+}
+
 /* Get current time in microseconds since epoch */
 void _debug(uint32_t pc);
 
@@ -494,6 +664,7 @@ static bool _symtab_add_owned (char *name, uint32_t offset, bool owns_name)
     m->offset = offset;
     m->name   = name;
     m->owns_name = owns_name;
+    _g_map_dirty = true;
 
     // add to sorted map list
 
@@ -531,6 +702,47 @@ static uint32_t _find_symbol (const char *name)
     return 0;
 }
 
+/*
+ * Name of the symbol containing addr (the closest one at or
+ * below it, within MAX_JITTER) for the sampling profiler. The sorted list
+ * is mirrored into an array for binary search whenever it changed.
+ */
+const char *_symtab_lookup (uint32_t addr)
+{
+    if (_g_map_dirty)
+    {
+        int n = 0;
+        for (map_sym_t *sym = _g_map; sym; sym=sym->next)
+            n++;
+
+        map_sym_t **index = realloc (_g_map_index, (n ? n : 1) * sizeof (*index));
+        if (!index)
+            return NULL;
+        _g_map_index = index;
+        _g_map_count = 0;
+        for (map_sym_t *sym = _g_map; sym; sym=sym->next)
+            _g_map_index[_g_map_count++] = sym;
+        _g_map_dirty = false;
+    }
+
+    int lo = 0, hi = _g_map_count - 1, found = -1;
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (_g_map_index[mid]->offset <= addr)
+        {
+            found = mid;
+            lo = mid + 1;
+        }
+        else
+            hi = mid - 1;
+    }
+
+    if (found < 0 || addr - _g_map_index[found]->offset >= MAX_JITTER)
+        return NULL;
+    return _g_map_index[found]->name;
+}
+
 
 void make_hex(char* buff, unsigned int pc, unsigned int length)
 {
@@ -582,11 +794,102 @@ static void print68kstate(int lvl)
 /*
  * _update_debug_active() - recalculate the g_debug_active fast-path flag.
  * Must be called whenever g_trace, g_stepping, g_next_pc, or
- * g_num_breakpoints changes.
+ * g_num_breakpoints changes.  Switches the CPU between the fast and the
+ * debug execute loop.
  */
 void _update_debug_active(void)
 {
     g_debug_active = g_trace || g_stepping || g_next_pc || g_num_breakpoints > 0;
+    m68k_cache_set_fast_mode(!g_debug_active);
+}
+
+/*
+ * VBlank planar-to-chunky sync of the active screen.
+ *
+ * Only bitplane rows that were stored to since the previous sync (the RAM
+ * dirty map in lxa_memory.h) are converted; consecutive dirty rows are
+ * handed to display_update_planar() as one band, so its dirty-row range and
+ * the texture upload shrink with them.  A different display, bitmap, size
+ * or plane address converts the whole screen.  An idle screen costs one
+ * dirty-map probe per plane row.
+ */
+void _sync_active_display(void)
+{
+    display_t *disp = display_get_active();
+    uint32_t planes_ptr, bpr, depth;
+    uint32_t plane_addr[8] = {0};
+    const uint8_t *planes[8] = {0};
+    bool full;
+    int w, h, d;
+
+    if (!disp || !display_get_amiga_bitmap(disp, &planes_ptr, &bpr, &depth))
+        return;
+
+    display_get_size(disp, &w, &h, &d);
+    if (depth > 8)
+        depth = 8;
+
+    /* Read plane pointers from m68k memory */
+    for (uint32_t i = 0; i < depth; i++)
+    {
+        uint32_t addr = m68k_read_memory_32(planes_ptr + i * 4);
+        if (addr && addr < g_ram_size && (uint64_t)addr + (uint64_t)bpr * h <= g_ram_size)
+        {
+            plane_addr[i] = addr;
+            planes[i] = (const uint8_t *)&g_ram[addr];
+        }
+    }
+
+    full = disp != _g_sync_disp || bpr != _g_sync_bpr || depth != _g_sync_depth ||
+           w != _g_sync_w || h != _g_sync_h ||
+           memcmp(plane_addr, _g_sync_planes, sizeof(plane_addr)) != 0;
+
+    if (full)
+    {
+        display_update_planar(disp, 0, 0, w, h, planes, bpr, depth);
+    }
+    else
+    {
+        uint32_t bytes = ((uint32_t)w + 7) / 8;
+        int band = -1;
+
+        if (bytes > bpr)
+            bytes = bpr;
+
+        for (int row = 0; row <= h; row++)
+        {
+            bool dirty = false;
+
+            for (uint32_t i = 0; row < h && i < depth && !dirty; i++)
+                dirty = plane_addr[i] && lxa_mem_is_dirty(plane_addr[i] + row * bpr, bytes);
+
+            if (dirty && band < 0)
+            {
+                band = row;
+            }
+            else if (!dirty && band >= 0)
+            {
+                const uint8_t *band_planes[8] = {0};
+
+                for (uint32_t i = 0; i < depth; i++)
+                    if (planes[i])
+                        band_planes[i] = planes[i] + band * bpr;
+                display_update_planar(disp, 0, band, w, row - band, band_planes, bpr, depth);
+                band = -1;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < depth; i++)
+        if (plane_addr[i])
+            lxa_mem_clear_dirty(plane_addr[i], bpr * h);
+
+    _g_sync_disp  = disp;
+    _g_sync_bpr   = bpr;
+    _g_sync_depth = depth;
+    _g_sync_w     = w;
+    _g_sync_h     = h;
+    memcpy(_g_sync_planes, plane_addr, sizeof(plane_addr));
 }
 
 /*
@@ -599,6 +902,10 @@ void _update_debug_active(void)
  */
 void cpu_instr_callback(int pc)
 {
+#ifdef PROFILE_BUILD
+    _profile_lvo_hook(pc);
+#endif
+
     /* Always record PC in trace buffer for post-mortem debugging */
     g_trace_buf[g_trace_buf_idx] = pc;
     g_trace_buf_idx = (g_trace_buf_idx+1) % TRACE_BUF_ENTRIES;
@@ -627,8 +934,8 @@ void cpu_instr_callback(int pc)
 
     if (g_trace)
     {
-        static char buff[100];
-        static char buff2[100];
+        static LXA_INSTANCE_LOCAL char buff[100];
+        static LXA_INSTANCE_LOCAL char buff2[100];
         static unsigned int instr_size;
         print68kstate(LOG_DEBUG);
         instr_size = m68k_disassemble(buff, pc, M68K_CPU_TYPE_68030);
@@ -780,6 +1087,30 @@ static bool _debug_toggle_bp (uint32_t addr)
     return true;
 }
 
+/* Report queued watchpoint hits, enter the debugger if one asks for it */
+void _debug_watch_hits (void)
+{
+    lxa_watch_hit_t hit;
+    bool            brk = false;
+    uint32_t        lost;
+
+    while (lxa_watch_poll (&hit))
+    {
+        const char *name = _symtab_lookup (hit.pc);
+
+        LPRINTF (LOG_INFO, "lxa: watchpoint 0x%08x: %s write to 0x%08x at PC 0x%08x (%s)\n",
+                 hit.watch, hit.host ? "host" : "cpu", hit.address, hit.pc, name ? name : "?");
+        brk |= hit.brk;
+    }
+
+    lost = lxa_watch_lost_hits ();
+    if (lost)
+        LPRINTF (LOG_WARNING, "lxa: %u watchpoint hits not reported (queue full)\n", lost);
+
+    if (brk)
+        _debug (m68k_get_reg (NULL, M68K_REG_PC));
+}
+
 static char *_m68k_regnames[NUM_M68K_REGS] = {
     "d0",
     "d1",
@@ -835,8 +1166,8 @@ uint32_t _debug_parse_addr(const char *buf)
 
 static uint32_t _debug_print_diss (uint32_t pc, uint32_t curPC)
 {
-    static char buff[100];
-    static char buff2[100];
+    static LXA_INSTANCE_LOCAL char buff[100];
+    static LXA_INSTANCE_LOCAL char buff2[100];
     char *prefix="";
 
     if (pc==curPC)
@@ -935,6 +1266,7 @@ static void _debug_help (void)
     CPRINTF ("s            - step\n");
     CPRINTF ("n            - next\n");
     CPRINTF ("b <addr/reg> - toggle breakpoint\n");
+    CPRINTF ("w <addr/reg> [size] - toggle write watchpoint (default: 4 bytes)\n");
     CPRINTF ("t <num>      - traceback\n");
     CPRINTF ("m <addr/reg> - memory dump\n");
     CPRINTF ("d <addr/reg> - disassemble\n");
@@ -952,7 +1284,7 @@ static void _debug_print_symtab (void)
 
 void _debug(uint32_t pcFinal)
 {
-    static bool in_debug = FALSE;
+    static LXA_INSTANCE_LOCAL bool in_debug = FALSE;
 
     if (in_debug)
         return;
@@ -999,7 +1331,7 @@ void _debug(uint32_t pcFinal)
                 return;
             case 'n':
             {
-                static char buff[100];
+                static LXA_INSTANCE_LOCAL char buff[100];
                 in_debug   = FALSE;
                 g_stepping = FALSE;
                 uint32_t instr_size = m68k_disassemble(buff, pcFinal, M68K_CPU_TYPE_68030);
@@ -1025,6 +1357,23 @@ void _debug(uint32_t pcFinal)
                 }
                 break;
             }
+            case 'w':
+            {
+                char     arg[64];
+                uint32_t addr = 0;
+                uint32_t size = 4;
+                if (sscanf (&buf[1], "%63s %i", arg, (int *)&size) >= 1)
+                    addr = _debug_parse_addr (arg);
+                if (!addr)
+                    CPRINTF ("   *** error: failed to parse/resolve watchpoint address\n");
+                else if (lxa_watch_remove (addr))
+                    CPRINTF ("   removed watchpoint at 0x%08x\n", addr);
+                else if (lxa_watch_add (addr, size, true))
+                    CPRINTF ("   added watchpoint at 0x%08x, %u bytes\n", addr, size);
+                else
+                    CPRINTF ("   *** error: cannot watch 0x%08x (%u bytes): not in RAM or too many watchpoints\n", addr, size);
+                break;
+            }
             case 'r':
                 _debug_machine_state ();
                 break;
@@ -1078,6 +1427,71 @@ void _debug(uint32_t pcFinal)
 
 #define MAX_LINE_LEN 1024
 
+#ifdef PROFILE_BUILD
+static const char *_symbol_at (uint32_t offset)
+{
+    for (map_sym_t *sym = _g_map; sym && sym->offset <= offset; sym=sym->next)
+    {
+        if (sym->offset == offset)
+            return sym->name;
+    }
+    return NULL;
+}
+
+/*
+ * Register the ROM functions behind every library jump table
+ * with the per-LVO profiler. Library function tables are the
+ * __g_lxa_<lib>_FuncTab arrays in ROM (LVO -6 first, terminated by -1);
+ * exec builds its table at runtime, so its _exec_<Func> symbols are used
+ * directly. Functions without a map symbol (static ones) are named by
+ * their LVO.
+ */
+static void _profile_lvo_scan_map (void)
+{
+    char name[64];
+
+    for (map_sym_t *sym = _g_map; sym; sym=sym->next)
+    {
+        const char *s = sym->name;
+        while (*s == '_')
+            s++;
+
+        if (!strncmp (s, "exec_", 5))
+        {
+            snprintf (name, sizeof(name), "exec/%s", s + 5);
+            _profile_lvo_register (sym->offset, name);
+            continue;
+        }
+
+        size_t l = strlen (s);
+        if (strncmp (s, "g_lxa_", 6) || l <= 6 + 8 || strcmp (s + l - 8, "_FuncTab") ||
+            sym->offset < ROM_START || sym->offset > ROM_END)
+            continue;
+
+        char lib[32];
+        snprintf (lib, sizeof(lib), "%.*s", (int)(l - 6 - 8), s + 6);
+
+        for (uint32_t a = sym->offset, lvo = 6; a + 3 <= ROM_END; a += 4, lvo += 6)
+        {
+            const uint8_t *p = &g_rom[a - ROM_START];
+            uint32_t func = ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+            if (func == 0xffffffff)
+                break;
+
+            const char *fn = _symbol_at (func);
+            size_t      ll = strlen (lib);
+            while (fn && *fn == '_')
+                fn++;
+            if (fn && !strncmp (fn, lib, ll) && fn[ll] == '_')
+                snprintf (name, sizeof(name), "%s/%s", lib, fn + ll + 1);
+            else
+                snprintf (name, sizeof(name), "%s/-%u", lib, lvo);
+            _profile_lvo_register (func, name);
+        }
+    }
+}
+#endif
+
 /* Load ROM symbol map - exported for lxa_api.c */
 bool _load_rom_map (const char *rom_path)
 {
@@ -1138,6 +1552,10 @@ bool _load_rom_map (const char *rom_path)
 
     fclose (mapf);
 
+#ifdef PROFILE_BUILD
+    _profile_lvo_scan_map ();
+#endif
+
     return true;
 }
 
@@ -1170,6 +1588,27 @@ void lxa_clear_text_hook(void)
 
 /* When building liblxa as a library, we don't include main() or print_usage() */
 #ifndef LXA_LIBRARY_BUILD
+#define SAMPLE_INTERVAL_DEFAULT 10000   /* --sample period in cycles */
+
+/*
+ * The guest is busy-waiting (m68k_cache_spin_detected()) or
+ * the dispatcher has no ready task (g_guest_idle).  Every event that could
+ * end the wait - VBlank, timer.device requests, input, DOS notifications -
+ * is delivered at the next SIGALRM tick, so sleep until then instead of
+ * feeding the polling loop more cycles.
+ */
+static void _wait_for_vblank(void)
+{
+    sigset_t alrm, old;
+
+    sigemptyset(&alrm);
+    sigaddset(&alrm, SIGALRM);
+    sigprocmask(SIG_BLOCK, &alrm, &old);
+    if (!g_pending_irq)
+        sigsuspend(&old);
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
 static void print_usage(char *argv[])
 {
     fprintf(stderr, "lxa - Linux Amiga Emulation Layer\n");
@@ -1184,9 +1623,12 @@ static void print_usage(char *argv[])
     fprintf(stderr, "    -d             enable debug output\n");
     fprintf(stderr, "    -h, --help     display this help and exit\n");
     fprintf(stderr, "    --profile <path>  write profiling JSON to path on exit\n");
+    fprintf(stderr, "    --sample <path>   sample the guest PC, write folded stacks to path on exit\n");
+    fprintf(stderr, "    --sample-interval <cycles>  sampling period (default: %d)\n", SAMPLE_INTERVAL_DEFAULT);
     fprintf(stderr, "    -r <rom>       use kickstart ROM (auto-detected if not specified)\n");
     fprintf(stderr, "    -v             verbose mode\n");
     fprintf(stderr, "    -t             trace mode\n");
+    fprintf(stderr, "    -w <addr>[,size]  log writes to guest RAM at hex addr (default size: 4)\n");
     fprintf(stderr, "\n");
     fprintf(stderr, "If no program is specified, the interactive Amiga shell is launched.\n");
     fprintf(stderr, "\n");
@@ -1278,6 +1720,11 @@ int main(int argc, char **argv, char **envp)
     char *rom_path = NULL;
     char *config_path = NULL;
     char *profile_path = NULL;
+    char *sample_path = NULL;
+    long  sample_interval = SAMPLE_INTERVAL_DEFAULT;
+    uint32_t watch_addr[LXA_WATCH_MAX];
+    uint32_t watch_size[LXA_WATCH_MAX];
+    int num_watches = 0;
     int optind=0;
 
     /* Pending assigns from command line flags (applied after config is loaded) */
@@ -1336,6 +1783,32 @@ int main(int argc, char **argv, char **envp)
             continue;
         }
 
+        if (strcmp(argv[optind], "--sample") == 0)
+        {
+            const char *val = get_option_value(argc, argv, &optind, argv[optind], "--sample");
+            if (!val)
+            {
+                print_usage(argv);
+                exit(EXIT_FAILURE);
+            }
+            sample_path = (char *)val;
+            continue;
+        }
+
+        if (strcmp(argv[optind], "--sample-interval") == 0)
+        {
+            const char *val = get_option_value(argc, argv, &optind, argv[optind], "--sample-interval");
+            char *end = NULL;
+            if (val)
+                sample_interval = strtol(val, &end, 0);
+            if (!val || !end || *end || sample_interval <= 0)
+            {
+                print_usage(argv);
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+
         switch (argv[optind][1])
         {
             case 'a':
@@ -1359,6 +1832,20 @@ int main(int argc, char **argv, char **envp)
                 _g_pending_bps = pbp;
                 break;
             }
+            case 'w':
+            {
+                optind++;
+                char *end;
+                if (optind >= argc || num_watches == LXA_WATCH_MAX)
+                {
+                    print_usage(argv);
+                    exit(EXIT_FAILURE);
+                }
+                watch_addr[num_watches] = strtoul(argv[optind], &end, 16);
+                watch_size[num_watches] = *end == ',' ? strtoul(end + 1, NULL, 0) : 4;
+                num_watches++;
+                break;
+            }
             case 'c':
             {
                 optind++;
@@ -1511,8 +1998,12 @@ int main(int argc, char **argv, char **envp)
 
     DPRINTF (g_verbose ? LOG_INFO : LOG_DEBUG, "lxa:       ROM_START          = 0x%08x\n", ROM_START         );
     DPRINTF (g_verbose ? LOG_INFO : LOG_DEBUG, "lxa:       ROM_END            = 0x%08x\n", ROM_END           );
-    DPRINTF (g_verbose ? LOG_INFO : LOG_DEBUG, "lxa:       RAM_START          = 0x%08x\n", RAM_START         );
-    DPRINTF (g_verbose ? LOG_INFO : LOG_DEBUG, "lxa:       RAM_END            = 0x%08x\n", RAM_END           );
+
+    if (!lxa_alloc_host_state())
+    {
+        fprintf (stderr, "failed to allocate emulator state\n");
+        exit(4);
+    }
 
     // load rom code
     FILE *romf = fopen (rom_path, "r");
@@ -1534,7 +2025,26 @@ int main(int argc, char **argv, char **envp)
 
     // setup memory image
 
-    uint32_t initial_sp   = RAM_END-1;
+    if (!lxa_mem_alloc_ram())
+    {
+        fprintf (stderr, "failed to allocate guest RAM\n");
+        exit(4);
+    }
+    DPRINTF (g_verbose ? LOG_INFO : LOG_DEBUG, "lxa:       RAM_START          = 0x%08x\n", RAM_START         );
+    DPRINTF (g_verbose ? LOG_INFO : LOG_DEBUG, "lxa:       RAM_END            = 0x%08x\n", RAM_START + g_ram_size - 1);
+
+    lxa_mem_init();  /* Guest page table */
+
+    for (int i = 0; i < num_watches; i++)
+    {
+        if (!lxa_watch_add(watch_addr[i], watch_size[i], false))
+        {
+            fprintf (stderr, "lxa: cannot watch 0x%08x (%u bytes): not in RAM\n", watch_addr[i], watch_size[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    uint32_t initial_sp   = RAM_START + g_ram_size - 16;  /* coldstart keeps this as its stack */
     uint32_t reset_vector = ROM_START+2;
 
     m68k_write_memory_32 (0, initial_sp);   // m68k initial SP
@@ -1547,6 +2057,15 @@ int main(int argc, char **argv, char **envp)
 
     m68k_init();
     m68k_set_cpu_type(M68K_CPU_TYPE_68030);  /* Phase 31: Support 68030 MMU instructions for SysInfo */
+    m68k_set_fetch_callback(lxa_mem_fetch_page);  /* Direct instruction fetch */
+    m68k_set_host_memory_callback(lxa_mem_host_range);  /* Bulk copy/fill loops */
+    _update_debug_active();                       /* Pick the execute loop */
+    m68k_set_fpu_mode(config_get_fpu_host() ? M68K_FPU_HOST : M68K_FPU_EXACT);
+
+    /* Code in RAM and ROM may be predecoded by the block cache */
+    m68k_cache_set_cacheable(RAM_START, RAM_START + g_ram_size - 1);
+    m68k_cache_set_cacheable(ROM_START, ROM_END);
+
     m68k_pulse_reset();
 
     /*
@@ -1564,32 +2083,20 @@ int main(int argc, char **argv, char **envp)
     /*
      * Phase 6.5: Set up timer-driven preemptive multitasking
      *
-     * We use setitimer() to generate SIGALRM at ~50Hz (PAL VBlank rate).
-     * The signal handler sets g_pending_irq which is checked each iteration.
+     * We use a timer (lxa_start_timer()) to generate SIGALRM at ~50Hz (PAL
+     * VBlank rate).  The signal handler sets g_pending_irq which is checked
+     * each iteration.
      */
-    struct sigaction sa;
-    sa.sa_handler = sigalrm_handler;
-    sa.sa_flags = SA_RESTART;  /* Restart interrupted syscalls */
-    sigemptyset(&sa.sa_mask);
-    if (sigaction(SIGALRM, &sa, NULL) < 0)
-    {
-        perror("sigaction");
+    if (!lxa_start_timer())
         exit(EXIT_FAILURE);
-    }
-
-    struct itimerval timer;
-    timer.it_value.tv_sec = 0;
-    timer.it_value.tv_usec = TIMER_INTERVAL_US;
-    timer.it_interval.tv_sec = 0;
-    timer.it_interval.tv_usec = TIMER_INTERVAL_US;
-    if (setitimer(ITIMER_REAL, &timer, NULL) < 0)
-    {
-        perror("setitimer");
-        exit(EXIT_FAILURE);
-    }
 
     DPRINTF(LOG_DEBUG, "lxa: Timer-driven scheduler enabled at %d Hz\n", 1000000 / TIMER_INTERVAL_US);
 
+    m68k_cache_set_spin_detect(1);
+
+    if (sample_path)
+        lxa_profile_sample_start((uint32_t)sample_interval);
+
     while (g_running)
     {
         /*
@@ -1624,28 +2131,9 @@ int main(int argc, char **argv, char **envp)
              * Update display from Amiga's planar bitmap if configured.
              * This converts the planar data in emulated RAM to chunky pixels
              * so that display_refresh_all() can present them via SDL.
+             * Only rows written since the last VBlank.
              */
-            display_t *disp = display_get_active();
-            uint32_t planes_ptr, bpr, depth;
-            if (disp && display_get_amiga_bitmap(disp, &planes_ptr, &bpr, &depth))
-            {
-                int w, h, d;
-                display_get_size(disp, &w, &h, &d);
-
-                /* Read plane pointers from m68k memory */
-                const uint8_t *planes[8] = {0};
-                for (uint32_t i = 0; i < depth && i < 8; i++)
-                {
-                    uint32_t plane_addr = m68k_read_memory_32(planes_ptr + i * 4);
-                    if (plane_addr && plane_addr < RAM_SIZE)
-                    {
-                        planes[i] = (const uint8_t *)&g_ram[plane_addr];
-                    }
-                }
-
-                /* Update display from planar data */
-                display_update_planar(disp, 0, 0, w, h, planes, bpr, depth);
-            }
+            _sync_active_display();
 
             display_refresh_all();
 
@@ -1678,20 +2166,26 @@ int main(int argc, char **argv, char **envp)
          * small enough that we check for interrupts frequently (~1000 cycles
          * gives reasonable responsiveness while keeping overhead low).
          */
-        m68k_execute(1000);
+        _profile_execute(1000);  /* Sample points, g_profile_cycles */
+        if (g_watch_count)
+            _debug_watch_hits();
+
+        if (m68k_cache_spin_detected() || g_guest_idle)
+        {
+            g_guest_idle = false;
+            _wait_for_vblank();
+        }
     }
 
     /* Stop the timer */
-    timer.it_value.tv_sec = 0;
-    timer.it_value.tv_usec = 0;
-    timer.it_interval.tv_sec = 0;
-    timer.it_interval.tv_usec = 0;
-    setitimer(ITIMER_REAL, &timer, NULL);
+    lxa_stop_timer();
 
     _audio_shutdown();
 
     if (profile_path)
         lxa_profile_write_json(profile_path);
+    if (sample_path && !lxa_profile_write_folded(sample_path))
+        fprintf(stderr, "lxa: failed to write %s\n", sample_path);
 
     return g_rv;
 }
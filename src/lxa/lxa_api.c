@@ -10,8 +10,12 @@
 #include "vfs.h"
 #include "config.h"
 #include "m68k.h"
+#include "m68kcache.h"
 #include "util.h"
 #include "lxa_copper.h"
+#include "lxa_snapshot.h"
+#include "lxa_instance.h"
+#include "lxa_watch.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -23,28 +27,42 @@
 #include <linux/limits.h>
 
 /* External declarations for lxa.c globals and functions */
-extern uint8_t g_ram[];
-extern uint8_t g_rom[];
-extern bool g_running;
-extern bool g_verbose;
-extern int g_rv;
-extern char *g_loadfile;
+extern LXA_INSTANCE_LOCAL uint8_t *g_ram;
+extern LXA_INSTANCE_LOCAL uint32_t g_ram_size;
+extern LXA_INSTANCE_LOCAL uint8_t *g_rom;
+extern LXA_INSTANCE_LOCAL bool g_running;
+extern LXA_INSTANCE_LOCAL bool g_verbose;
+extern LXA_INSTANCE_LOCAL int g_rv;
+extern LXA_INSTANCE_LOCAL char *g_loadfile;
 
 #define MAX_ARGS_LEN 4096
-extern char g_args[MAX_ARGS_LEN];
-extern int g_args_len;
+extern LXA_INSTANCE_LOCAL char g_args[MAX_ARGS_LEN];
+extern LXA_INSTANCE_LOCAL int g_args_len;
 
 /* Forward declarations for internal lxa.c functions we need */
 extern bool _load_rom_map(const char *rom_path);
+extern void lxa_mem_init(void);
+extern bool lxa_mem_alloc_ram(void);
+extern void lxa_mem_shutdown(void);
+extern const unsigned char *lxa_mem_fetch_page(unsigned int address, unsigned int *base, unsigned int *size);
+extern unsigned char *lxa_mem_host_range(unsigned int address, unsigned int *size, int write);
 extern void sigalrm_handler(int sig);
 extern int _timer_check_expired(void);
 extern void lxa_set_console_output_hook(void (*hook)(const char *data, int len));
 extern void lxa_reset_host_state(void);
-extern void (*g_text_hook)(const char *str, int len, int x, int y, void *userdata);
-extern void *g_text_hook_userdata;
+extern bool lxa_alloc_host_state(void);
+extern void lxa_free_host_state(void);
+extern bool lxa_start_timer(void);
+extern void lxa_stop_timer(void);
+extern void _update_debug_active(void);
+extern void _sync_active_display(void);
+extern LXA_INSTANCE_LOCAL void (*g_text_hook)(const char *str, int len, int x, int y, void *userdata);
+extern LXA_INSTANCE_LOCAL void *g_text_hook_userdata;
+extern int  _profile_execute(int cycles);
+extern void _profile_shutdown(void);
+extern void _debug_watch_hits(void);
 
 /* Configuration constants from lxa.c */
-#define RAM_SIZE (10 * 1024 * 1024)
 #define ROM_SIZE (512 * 1024)
 #define ROM_START 0xf80000
 #define TIMER_INTERVAL_US 20000
@@ -96,9 +114,9 @@ extern void *g_text_hook_userdata;
 #define GMORE_BOUNDS                0x00000001UL
 
 /* Phase 131: event log state — defined in lxa_events.c, shared with lxa_dispatch.c */
-extern lxa_intui_event_t g_event_log[];
-extern int               g_event_log_head;
-extern int               g_event_log_count;
+extern LXA_INSTANCE_LOCAL lxa_intui_event_t g_event_log[];
+extern LXA_INSTANCE_LOCAL int               g_event_log_head;
+extern LXA_INSTANCE_LOCAL int               g_event_log_count;
 void lxa_reset_intui_events(void); /* defined in lxa_events.c */
 
 static bool lxa_api_memory_string_equals(uint32_t addr, const char *str){
@@ -346,9 +364,9 @@ static uint32_t lxa_api_get_window_gadget(int window_index, int gadget_index)
 }
 
 /* API state */
-static bool g_api_initialized = false;
-static char g_output_buffer[64 * 1024];
-static int g_output_len = 0;
+static LXA_INSTANCE_LOCAL bool g_api_initialized = false;
+static LXA_INSTANCE_LOCAL char g_output_buffer[64 * 1024];
+static LXA_INSTANCE_LOCAL int g_output_len = 0;
 
 /*
  * Phase 106: Track whether the planar-to-chunky pixel buffer is stale.
@@ -358,7 +376,7 @@ static int g_output_len = 0;
  * checks this flag and calls lxa_flush_display() once on demand, keeping
  * per-pixel overhead near zero while still returning correct data.
  */
-static bool s_display_dirty = true;
+static LXA_INSTANCE_LOCAL bool s_display_dirty = true;
 
 /* Output capture hook - called from lxa.c _dos_write */
 void lxa_api_capture_output(const char *data, int len)
@@ -372,7 +390,7 @@ void lxa_api_capture_output(const char *data, int len)
 
 int lxa_init(const lxa_config_t *config)
 {
-    extern volatile sig_atomic_t g_pending_irq;
+    extern LXA_INSTANCE_LOCAL volatile sig_atomic_t g_pending_irq;
 
     if (g_api_initialized) {
         fprintf(stderr, "lxa_init: already initialized\n");
@@ -411,6 +429,10 @@ int lxa_init(const lxa_config_t *config)
     vfs_setup_default_assigns();
 
     /* Load ROM */
+    if (!lxa_alloc_host_state()) {
+        fprintf(stderr, "lxa_init: out of memory\n");
+        return -1;
+    }
     FILE *romf = fopen(config->rom_path, "r");
     if (!romf) {
         fprintf(stderr, "lxa_init: failed to open ROM: %s\n", config->rom_path);
@@ -428,9 +450,13 @@ int lxa_init(const lxa_config_t *config)
         return -1;
     }
 
-    /* Set up initial memory image */
-    memset(g_ram, 0, RAM_SIZE);
-    uint32_t initial_sp = RAM_SIZE - 1;
+    /* Set up initial memory image (fresh zero pages, committed on first touch) */
+    if (!lxa_mem_alloc_ram()) {
+        fprintf(stderr, "lxa_init: failed to allocate guest RAM\n");
+        return -1;
+    }
+    lxa_mem_init();
+    uint32_t initial_sp = g_ram_size - 16;
     uint32_t reset_vector = ROM_START + 2;
     m68k_write_memory_32(0, initial_sp);
     m68k_write_memory_32(4, reset_vector);
@@ -438,6 +464,12 @@ int lxa_init(const lxa_config_t *config)
     /* Initialize CPU */
     m68k_init();
     m68k_set_cpu_type(M68K_CPU_TYPE_68030);
+    m68k_set_fetch_callback(lxa_mem_fetch_page);
+    m68k_set_host_memory_callback(lxa_mem_host_range);
+    _update_debug_active();
+    m68k_set_fpu_mode(config_get_fpu_host() ? M68K_FPU_HOST : M68K_FPU_EXACT);
+    m68k_cache_set_cacheable(0, g_ram_size - 1);
+    m68k_cache_set_cacheable(ROM_START, ROM_START + ROM_SIZE - 1);
     m68k_pulse_reset();
     g_pending_irq = 0;
 
@@ -457,23 +489,8 @@ int lxa_init(const lxa_config_t *config)
         /* Continue anyway - might be headless */
     }
 
-    /* Set up timer for preemptive multitasking */
-    struct sigaction sa;
-    sa.sa_handler = sigalrm_handler;
-    sa.sa_flags = SA_RESTART;
-    sigemptyset(&sa.sa_mask);
-    if (sigaction(SIGALRM, &sa, NULL) < 0) {
-        perror("sigaction");
-        return -1;
-    }
-
-    struct itimerval timer;
-    timer.it_value.tv_sec = 0;
-    timer.it_value.tv_usec = TIMER_INTERVAL_US;
-    timer.it_interval.tv_sec = 0;
-    timer.it_interval.tv_usec = TIMER_INTERVAL_US;
-    if (setitimer(ITIMER_REAL, &timer, NULL) < 0) {
-        perror("setitimer");
+    /* Set up timer for preemptive multitasking (signals this thread only) */
+    if (!lxa_start_timer()) {
         return -1;
     }
 
@@ -493,8 +510,7 @@ void lxa_shutdown(void)
     if (!g_api_initialized) return;
 
     /* Stop timer */
-    struct itimerval timer = {{0, 0}, {0, 0}};
-    setitimer(ITIMER_REAL, &timer, NULL);
+    lxa_stop_timer();
 
     /* Shutdown display */
     display_shutdown();
@@ -503,7 +519,10 @@ void lxa_shutdown(void)
     vfs_reset();
     util_shutdown();
     lxa_reset_host_state();
-    lxa_profile_reset();
+    _profile_shutdown();
+    m68k_cache_release();
+    lxa_mem_shutdown();
+    lxa_free_host_state();
 
     g_api_initialized = false;
 }
@@ -513,7 +532,7 @@ int lxa_load_program(const char *program, const char *args)
     if (!g_api_initialized) return -1;
 
     /* Store program path */
-    static char loadfile_buf[PATH_MAX];
+    static LXA_INSTANCE_LOCAL char loadfile_buf[PATH_MAX];
     strncpy(loadfile_buf, program, PATH_MAX - 1);
     loadfile_buf[PATH_MAX - 1] = '\0';
     g_loadfile = loadfile_buf;
@@ -560,8 +579,8 @@ bool lxa_add_drive(const char *name, const char *linux_path)
     return true;
 }
 
-static int s_vblank_count = 0;
-static int s_cycles_since_auto_vblank = 0;
+static LXA_INSTANCE_LOCAL int s_vblank_count = 0;
+static LXA_INSTANCE_LOCAL int s_cycles_since_auto_vblank = 0;
 
 /*
  * Automatic VBlank cadence based on emulated cycle count.
@@ -582,13 +601,43 @@ static int s_cycles_since_auto_vblank = 0;
  */
 #define AUTO_VBLANK_CYCLES 500000
 
+/* Snapshot section for the API state; false before lxa_init() */
+bool lxa_api_save_state(lxa_snap_buf_t *buf)
+{
+    if (!g_api_initialized) return false;
+
+    lxa_snap_put(buf, &g_output_len, sizeof(g_output_len));
+    lxa_snap_put(buf, g_output_buffer, g_output_len);
+    lxa_snap_put(buf, &s_vblank_count, sizeof(s_vblank_count));
+    lxa_snap_put(buf, &s_cycles_since_auto_vblank, sizeof(s_cycles_since_auto_vblank));
+    return true;
+}
+
+bool lxa_api_load_state(lxa_snap_buf_t *buf)
+{
+    int len = 0;
+
+    if (!g_api_initialized) return false;
+
+    if (!lxa_snap_get(buf, &len, sizeof(len)) || len < 0 || len >= (int)sizeof(g_output_buffer))
+        return false;
+    lxa_snap_get(buf, g_output_buffer, len);
+    g_output_buffer[len] = '\0';
+    g_output_len = len;
+    lxa_snap_get(buf, &s_vblank_count, sizeof(s_vblank_count));
+    lxa_snap_get(buf, &s_cycles_since_auto_vblank, sizeof(s_cycles_since_auto_vblank));
+
+    s_display_dirty = true;
+    return !buf->error;
+}
+
 int lxa_run_cycles(int cycles)
 {
     if (!g_api_initialized || !g_running) return 1;
 
     /* Check for pending timer interrupts */
-    extern volatile sig_atomic_t g_pending_irq;
-    extern uint16_t g_intena;
+    extern LXA_INSTANCE_LOCAL volatile sig_atomic_t g_pending_irq;
+    extern LXA_INSTANCE_LOCAL uint16_t g_intena;
     
     if (g_pending_irq & (1 << 3)) {
         s_vblank_count++;
@@ -619,27 +668,8 @@ int lxa_run_cycles(int cycles)
          * test SetUp.
          */
         if (!display_get_headless()) {
-            display_t *disp = display_get_active();
-            uint32_t planes_ptr, bpr, depth;
-            if (disp && display_get_amiga_bitmap(disp, &planes_ptr, &bpr, &depth))
-            {
-                int w, h, d;
-                display_get_size(disp, &w, &h, &d);
-
-                /* Read plane pointers from m68k memory */
-                const uint8_t *planes[8] = {0};
-                for (uint32_t i = 0; i < depth && i < 8; i++)
-                {
-                    uint32_t plane_addr = m68k_read_memory_32(planes_ptr + i * 4);
-                    if (plane_addr && plane_addr < RAM_SIZE)
-                    {
-                        planes[i] = (const uint8_t *)&g_ram[plane_addr];
-                    }
-                }
-
-                /* Update display from planar data */
-                display_update_planar(disp, 0, 0, w, h, planes, bpr, depth);
-            }
+            /* Convert only the rows written since the last VBlank */
+            _sync_active_display();
 
             /* Refresh displays (now with updated pixel data) */
             display_refresh_all();
@@ -690,8 +720,11 @@ int lxa_run_cycles(int cycles)
         m68k_set_irq(0);
     }
 
-    /* Execute CPU cycles */
-    m68k_execute(cycles);
+    /* Execute CPU cycles (in pieces ending at sample points
+     * while the sampling profiler runs) */
+    _profile_execute(cycles);
+    if (g_watch_count)
+        _debug_watch_hits();
 
     if (!g_running) {
         DPRINTF(LOG_DEBUG, "lxa_run_cycles: g_running became false during m68k_execute\n");
@@ -708,7 +741,7 @@ void lxa_trigger_vblank(void)
 {
     /* Manually trigger VBlank processing for test drivers that need
      * event processing without waiting for real-time SIGALRM */
-    extern volatile sig_atomic_t g_pending_irq;
+    extern LXA_INSTANCE_LOCAL volatile sig_atomic_t g_pending_irq;
     g_pending_irq |= (1 << 3);  /* Level 3 = VBlank */
 }
 
@@ -771,7 +804,7 @@ void lxa_flush_display(void)
         for (uint32_t i = 0; i < depth && i < 8; i++)
         {
             uint32_t plane_addr = m68k_read_memory_32(planes_ptr + i * 4);
-            if (plane_addr && plane_addr < RAM_SIZE)
+            if (plane_addr && plane_addr < g_ram_size)
             {
                 planes[i] = (const uint8_t *)&g_ram[plane_addr];
             }
@@ -1383,6 +1416,11 @@ uint8_t lxa_peek8(uint32_t addr)
     return m68k_read_memory_8(addr);
 }
 
+void lxa_poke32(uint32_t addr, uint32_t value)
+{
+    m68k_write_memory_32(addr, value);
+}
+
 /* ========== Phase 131: Window/Screen Event Log ========== */
 
 /* Intuition struct offsets used for menu traversal */
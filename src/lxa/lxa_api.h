@@ -33,6 +33,21 @@
  *   }
  *   
  *   lxa_shutdown();
+ *
+ * Threads: every thread has its own emulator instance.  lxa_init() sets up
+ * the instance of the calling thread and all other calls act on it, so a
+ * test driver can run several independent machines in parallel, one per
+ * thread.  The VBlank timer signals only the thread that called lxa_init().
+ * The profiler (lxa_profile_*()) also works per instance.  Shared by all
+ * instances: the log file and the SDL display and audio devices (use
+ * headless mode for more than one instance).
+ *
+ * The instance state is initial-exec thread-local storage, so every thread
+ * of a process that links liblxa gets its own copy, whether it runs an
+ * instance or not: about 390 KB of zero-filled TLS per thread (the static
+ * TLS block of the driver executables).  Large tables (guest RAM, page
+ * tables, code cache, profiler) are allocated per instance by lxa_init()
+ * or on first use and are not part of it.
  */
 
 #ifndef LXA_API_H
@@ -40,6 +55,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -58,8 +74,8 @@ typedef struct lxa_config {
 } lxa_config_t;
 
 /*
- * Initialize the lxa emulator.
- * Must be called before any other lxa_* functions.
+ * Initialize the lxa emulator instance of the calling thread.
+ * Must be called before any other lxa_* functions on that thread.
  *
  * @param config  Configuration options
  * @return 0 on success, non-zero on failure
@@ -713,6 +729,13 @@ uint16_t lxa_peek16(uint32_t addr);
  */
 uint8_t lxa_peek8(uint32_t addr);
 
+/*
+ * Write a 32-bit value to emulated memory, as a CPU store would.
+ * @param addr   Address in emulated memory space
+ * @param value  Value to store
+ */
+void lxa_poke32(uint32_t addr, uint32_t value);
+
 /* ========== Profiling API ========== */
 
 /*
@@ -730,6 +753,27 @@ typedef struct lxa_profile_entry {
     uint64_t total_ns;          /* Total wall-clock nanoseconds spent */
 } lxa_profile_entry_t;
 
+/*
+ * Maximum number of ROM library functions tracked by the
+ * per-LVO profiler (PROFILE_BUILD only).
+ */
+#define LXA_PROFILE_MAX_LVO  4096
+
+/*
+ * Per-library-function profiling record. A call is counted when it enters
+ * a library jump-table slot leading into the ROM and ends when the CPU
+ * comes back to the caller's return address. "total" figures include
+ * nested library calls made by the function, "self" figures do not.
+ */
+typedef struct lxa_profile_lvo_entry {
+    char     name[64];          /* "graphics/Text", or "graphics/-60" if unnamed */
+    uint64_t call_count;        /* Number of completed calls */
+    uint64_t total_ns;          /* Inclusive wall-clock nanoseconds */
+    uint64_t self_ns;           /* Exclusive wall-clock nanoseconds */
+    uint64_t total_cycles;      /* Inclusive emulated CPU cycles */
+    uint64_t self_cycles;       /* Exclusive emulated CPU cycles */
+} lxa_profile_lvo_entry_t;
+
 /*
  * Reset all profiling counters.
  * Safe to call at any time (including before lxa_init).
@@ -745,17 +789,56 @@ void lxa_profile_reset(void);
  */
 int lxa_profile_get(lxa_profile_entry_t *entries, int max_count);
 
+/*
+ * Get per-LVO profiling data for all library functions that completed at
+ * least one call.
+ *
+ * @param entries   Caller-supplied array of lxa_profile_lvo_entry_t
+ * @param max_count Size of the entries array
+ * @return Number of entries filled
+ */
+int lxa_profile_get_lvo(lxa_profile_lvo_entry_t *entries, int max_count);
+
 /*
  * Write profiling data as JSON to a file.
  * The JSON is an array of objects:
  *   [{"id": 1000, "name": "EMU_CALL_DOS_OPEN", "calls": 42, "total_ns": 12345}, ...]
- * sorted by total_ns descending.
+ * sorted by total_ns descending, followed by the per-LVO records:
+ *   {"kind": "lvo", "name": "graphics/Text", "calls": 42, "total_ns": ...,
+ *    "self_ns": ..., "cycles": ..., "self_cycles": ...}
+ * also sorted by total_ns descending.
  *
  * @param path  Output file path (creates or truncates)
  * @return true on success
  */
 bool lxa_profile_write_json(const char *path);
 
+/*
+ * Statistical sampling of the guest PC.
+ *
+ * Every interval_cycles emulated cycles the guest PC and the return
+ * addresses found on the stack are recorded under the name of the running
+ * task, symbolised through the ROM map and the symbols of loaded hunks.
+ * Works in any build (no PROFILE_BUILD needed); lxa_profile_reset() drops
+ * the samples collected so far.  Sampling, like the counters above,
+ * belongs to the calling thread's instance: other instances are not
+ * sampled and lxa_shutdown() releases the samples.
+ *
+ * @param interval_cycles  Sampling period in CPU cycles (0 stops sampling)
+ */
+void lxa_profile_sample_start(uint32_t interval_cycles);
+void lxa_profile_sample_stop(void);
+
+/*
+ * Write the collected samples as folded stacks, one line per distinct
+ * stack ("task;outer;...;inner count"), the input format of flamegraph.pl
+ * and of speedscope's import.
+ *
+ * @param path  Output file path (creates or truncates)
+ * @return true on success
+ */
+bool lxa_profile_write_folded(const char *path);
+
 /*
  * Return the canonical name string for an EMU_CALL_* constant, or
  * "EMU_CALL_UNKNOWN_<id>" if the id is not recognized.
@@ -766,6 +849,81 @@ bool lxa_profile_write_json(const char *path);
  */
 void lxa_profile_emucall_name(int emucall_id, char *buf, int buf_size);
 
+/* ========== Snapshots ========== */
+
+/*
+ * A snapshot holds the complete emulator state: CPU, guest RAM, custom
+ * chip and copper state, displays and windows, timer requests, DOS locks
+ * and the files the guest has open.  Restoring one is much faster than
+ * booting the ROM and starting an application again, e.g.:
+ *
+ *     lxa_init(&config);  add drives/assigns;  lxa_snapshot_restore(snap);
+ *
+ * Drives, assigns and display mode are not part of a snapshot; set them
+ * up as for the run that took it.  The ROM and RAM sizes must match.
+ */
+typedef struct lxa_snapshot lxa_snapshot_t;
+
+/*
+ * Capture the current state.  Call between lxa_run_cycles() calls.
+ *
+ * @return New snapshot (free with lxa_snapshot_free()), NULL on failure
+ */
+lxa_snapshot_t *lxa_snapshot_save(void);
+
+/*
+ * Replace the current state with a snapshot (lxa_init() must have been
+ * called).  Fails if a file the guest had open cannot be reopened at its
+ * saved offset.  On failure the emulator state is undefined; call
+ * lxa_shutdown().
+ *
+ * @return true on success
+ */
+bool lxa_snapshot_restore(const lxa_snapshot_t *snapshot);
+
+void   lxa_snapshot_free(lxa_snapshot_t *snapshot);
+size_t lxa_snapshot_size(const lxa_snapshot_t *snapshot);
+
+/*
+ * Store a snapshot in a file, and load it back (in this or another
+ * process running the same lxa build).
+ */
+bool            lxa_snapshot_write(const lxa_snapshot_t *snapshot, const char *path);
+lxa_snapshot_t *lxa_snapshot_read(const char *path);
+
+/* ========== Fork server ========== */
+
+/*
+ * Bring the machine to a checkpoint once (boot, load the program, wait for
+ * its window), then serve test cases from forked copies of it: guest RAM
+ * is shared copy-on-write, so a child costs neither a boot nor a full RAM
+ * image.  Headless mode only.
+ *
+ * The handler runs in the child with the request line and the connection;
+ * what it writes to out_fd goes to the client, its return value (0..255)
+ * becomes the child's exit status.
+ */
+typedef int (*lxa_fork_handler_t)(const char *request, int out_fd, void *userdata);
+
+/*
+ * Listen on a Unix socket and fork one child per request, at most
+ * max_children (<= 0: 256) at a time.  Returns when a client sends
+ * "quit" and all children have finished.
+ *
+ * @return Number of requests served, -1 if the socket cannot be set up
+ */
+int lxa_fork_server(const char *socket_path, int max_children,
+                    lxa_fork_handler_t handler, void *userdata);
+
+/*
+ * Send one request to a fork server and wait for its child to finish.
+ *
+ * @param output  Buffer for the child's output (may be NULL)
+ * @param size    Buffer size
+ * @return The child's exit status, -1 if the server cannot be reached
+ */
+int lxa_fork_request(const char *socket_path, const char *request, char *output, int size);
+
 #ifdef __cplusplus
 }
 #endif
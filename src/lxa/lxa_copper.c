@@ -57,20 +57,21 @@
 
 #include "m68k.h"
 #include "util.h"
+#include "lxa_instance.h"
 
 /* Forward declarations from lxa.c — keep the boundary explicit. */
 extern void _handle_custom_write_ext(uint16_t reg, uint16_t value);
 
 /* Copper state. Public-ish but only via the API below. */
-static uint32_t g_cop1lc = 0;       /* Copper 1 location register (long pointer) */
-static uint32_t g_cop2lc = 0;       /* Copper 2 location register (long pointer) */
-static uint16_t g_copcon = 0;       /* Copper control: bit 1 (0x02) = CDANG */
+static LXA_INSTANCE_LOCAL uint32_t g_cop1lc = 0;       /* Copper 1 location register (long pointer) */
+static LXA_INSTANCE_LOCAL uint32_t g_cop2lc = 0;       /* Copper 2 location register (long pointer) */
+static LXA_INSTANCE_LOCAL uint16_t g_copcon = 0;       /* Copper control: bit 1 (0x02) = CDANG */
 
 /* Statistics — useful for tests and debugging. */
-static uint32_t g_copper_runs       = 0;
-static uint32_t g_copper_moves      = 0;
-static uint32_t g_copper_waits      = 0;
-static uint32_t g_copper_skips      = 0;
+static LXA_INSTANCE_LOCAL uint32_t g_copper_runs       = 0;
+static LXA_INSTANCE_LOCAL uint32_t g_copper_moves      = 0;
+static LXA_INSTANCE_LOCAL uint32_t g_copper_waits      = 0;
+static LXA_INSTANCE_LOCAL uint32_t g_copper_skips      = 0;
 
 /*
  * Maximum number of instructions we will execute per copper run.
@@ -221,7 +222,7 @@ static uint32_t copper_run_at(uint32_t start_addr)
  * interpreter, a single pass over the COP1 list per VBlank covers
  * essentially every productivity-app use case.
  */
-extern uint16_t g_dmacon;
+extern LXA_INSTANCE_LOCAL uint16_t g_dmacon;
 #define DMAF_COPPER 0x0080
 #define DMAF_MASTER 0x0200
 
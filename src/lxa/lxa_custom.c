@@ -15,7 +15,7 @@
  * Shadows the Amiga custom chip blitter registers.
  * Writing to BLTSIZE (or BLTSIZH for ECS) triggers the blit.
  */
-static struct {
+static LXA_INSTANCE_LOCAL struct {
     uint16_t con0;       /* BLTCON0: shift A (15:12), DMA enables (11:8), minterm (7:0) */
     uint16_t con1;       /* BLTCON1: shift B (15:12), fill/line/direction flags */
     uint16_t afwm;       /* First word mask for channel A */
@@ -195,7 +195,7 @@ static void _blitter_execute (uint16_t width_words, uint16_t height)
         {
             /* --- Read C (destination word) --- */
             uint16_t c_data = 0;
-            if (use_c && cpt < RAM_SIZE - 1)
+            if (use_c && cpt < g_ram_size - 1)
                 c_data = (g_ram[cpt] << 8) | g_ram[cpt + 1];
 
             /* --- A is a single-bit mask shifted to current pixel column.
@@ -233,8 +233,9 @@ static void _blitter_execute (uint16_t width_words, uint16_t height)
             }
 
             /* --- Write D --- */
-            if (use_d && dpt < RAM_SIZE - 1)
+            if (use_d && dpt < g_ram_size - 1)
             {
+                lxa_mem_host_write(dpt, 2);
                 g_ram[dpt]     = (uint8_t)((result >> 8) & 0xff);
                 g_ram[dpt + 1] = (uint8_t)(result & 0xff);
             }
@@ -364,7 +365,7 @@ static void _blitter_execute (uint16_t width_words, uint16_t height)
             uint16_t a_data;
             if (use_a)
             {
-                if (apt < RAM_SIZE - 1)
+                if (apt < g_ram_size - 1)
                     a_data = (g_ram[apt] << 8) | g_ram[apt + 1];
                 else
                     a_data = 0;
@@ -378,7 +379,7 @@ static void _blitter_execute (uint16_t width_words, uint16_t height)
             uint16_t b_data;
             if (use_b)
             {
-                if (bpt < RAM_SIZE - 1)
+                if (bpt < g_ram_size - 1)
                     b_data = (g_ram[bpt] << 8) | g_ram[bpt + 1];
                 else
                     b_data = 0;
@@ -392,7 +393,7 @@ static void _blitter_execute (uint16_t width_words, uint16_t height)
             uint16_t c_data;
             if (use_c)
             {
-                if (cpt < RAM_SIZE - 1)
+                if (cpt < g_ram_size - 1)
                     c_data = (g_ram[cpt] << 8) | g_ram[cpt + 1];
                 else
                     c_data = 0;
@@ -490,8 +491,9 @@ static void _blitter_execute (uint16_t width_words, uint16_t height)
 
             if (use_d)
             {
-                if (dpt < RAM_SIZE - 1)
+                if (dpt < g_ram_size - 1)
                 {
+                    lxa_mem_host_write(dpt, 2);
                     g_ram[dpt]     = (result >> 8) & 0xff;
                     g_ram[dpt + 1] = result & 0xff;
                 }
@@ -30,109 +30,40 @@ static int32_t compare_float_values(float left, float right);
 static double host_safe_double_divide(double dividend, double divisor);
 static float host_safe_float_divide(float dividend, float divisor);
 
+/*
+ * All guest accesses go through the page table in lxa_memory.h;
+ * RAM/ROM are a single table lookup plus load/store, everything else is
+ * routed to the page's region handlers.
+ */
+
 void m68k_write_memory_8(unsigned int address, unsigned int value)
 {
-    // if (g_trace)
-    //     DPRINTF("WRITE8  at 0x%08x -> 0x%02x\n", address, value);
     mwrite8 (address, value);
 }
 
 void m68k_write_memory_16(unsigned int address, unsigned int value)
 {
-    /* Fast path: RAM write (most common case) */
-    if (__builtin_expect((address >= RAM_START) && (address + 1 <= RAM_END), 1))
-    {
-        mwrite16_ram(address - RAM_START, (uint16_t)value);
-        return;
-    }
-
-    if ((address >= CUSTOM_START) && (address <= CUSTOM_END))
-    {
-        _handle_custom_write (address & 0xfff, value);
-        return;
-    }
-
-
-    // if (g_trace)
-    //     DPRINTF("WRITE16 at 0x%08x -> 0x%04x\n", address, value);
-    mwrite8 (address  , (value >> 8) & 0xff);
-    mwrite8 (address+1, value & 0xff);
+    mwrite16 (address, value);
 }
 
 void m68k_write_memory_32(unsigned int address, unsigned int value)
 {
-    /* Fast path: RAM write (most common case) */
-    if (__builtin_expect((address >= RAM_START) && (address + 3 <= RAM_END), 1))
-    {
-        mwrite32_ram(address - RAM_START, value);
-        return;
-    }
-
-    // if (g_trace)
-    //     DPRINTF("WRITE32 at 0x%08x -> 0x%08x\n", address, value);
-
-    /*
-     * Custom chip area: 32-bit writes must be handled as two 16-bit writes
-     * (high word first, low word second) because the custom chip register
-     * handler processes 16-bit register writes.  This is critical for
-     * blitter pointer registers (BLTAPT, BLTBPT, BLTCPT, BLTDPT) which
-     * are written as 32-bit values by apps but stored as high/low halves
-     * in adjacent 16-bit registers.
-     */
-    if ((address >= CUSTOM_START) && (address <= CUSTOM_END))
-    {
-        _handle_custom_write ((address    ) & 0xfff, (value >> 16) & 0xffff);
-        _handle_custom_write ((address + 2) & 0xfff, value & 0xffff);
-        return;
-    }
-
-    mwrite8 (address  , (value >>24) & 0xff);
-    mwrite8 (address+1, (value >>16) & 0xff);
-    mwrite8 (address+2, (value >> 8) & 0xff);
-    mwrite8 (address+3, value & 0xff);
+    mwrite32 (address, value);
 }
 
 unsigned int m68k_read_memory_8(unsigned int address)
 {
-    // if (g_trace)
-    //     DPRINTF("READ8  at 0x%08x\n", address);
     return mread8 (address);
 }
 
 unsigned int m68k_read_memory_16(unsigned int address)
 {
-    /* Fast path: RAM read (most common case) */
-    if (__builtin_expect((address >= RAM_START) && (address + 1 <= RAM_END), 1))
-        return mread16_ram(address - RAM_START);
-
-    /* Fast path: ROM read (second most common) */
-    if (__builtin_expect((address >= ROM_START) && (address + 1 <= ROM_END), 0))
-        return mread16_rom(address - ROM_START);
-
-    // if (g_trace)
-    //     DPRINTF("READ16 at 0x%08x\n", address);
-    unsigned int result = (unsigned int)mread8 (address) << 8;
-    result |= mread8 (address + 1);
-    return result;
+    return mread16 (address);
 }
 
 unsigned int m68k_read_memory_32(unsigned int address)
 {
-    /* Fast path: RAM read (most common case) */
-    if (__builtin_expect((address >= RAM_START) && (address + 3 <= RAM_END), 1))
-        return mread32_ram(address - RAM_START);
-
-    /* Fast path: ROM read (second most common) */
-    if (__builtin_expect((address >= ROM_START) && (address + 3 <= ROM_END), 0))
-        return mread32_rom(address - ROM_START);
-
-    // if (g_trace)
-    //     DPRINTF("READ32 at 0x%08x\n", address);
-    unsigned int result = (unsigned int)mread8 (address)     << 24;
-    result |=             (unsigned int)mread8 (address + 1) << 16;
-    result |=             (unsigned int)mread8 (address + 2) <<  8;
-    result |=             (unsigned int)mread8 (address + 3);
-    return result;
+    return mread32 (address);
 }
 
 unsigned int m68k_read_disassembler_16(unsigned int address)
@@ -153,7 +84,7 @@ static const int16_t _DAYS_BEFORE_MONTH[12] = {0, 31, 59, 90, 120, 151, 181, 212
 
 /* Phase 149: host-side flag set by lxa_force_full_redraw().
  * Polled (and cleared) by the ROM VBlank hook via EMU_CALL_INT_FORCE_FULL_REDRAW. */
-static volatile bool s_force_full_redraw_pending = false;
+static LXA_INSTANCE_LOCAL volatile bool s_force_full_redraw_pending = false;
 
 /* Called by lxa_api.c: lxa_force_full_redraw() */
 void lxa_dispatch_set_force_full_redraw(void)
@@ -252,7 +183,7 @@ int op_illg(int level)
             else
             {
                 DPRINTF (LOG_DEBUG, "*** no other tasks, stopping emulator\n");
-                m68k_end_timeslice();
+                m68k_end_timeslice_used();
                 g_running = FALSE;
             }
             break;
@@ -303,7 +234,7 @@ int op_illg(int level)
             else
             {
                 DPRINTF (LOG_DEBUG, "*** no other tasks, exiting emulator\n");
-                m68k_end_timeslice();
+                m68k_end_timeslice_used();
                 g_running = FALSE;
             }
             break;
@@ -386,7 +317,7 @@ int op_illg(int level)
                     fprintf(stderr, "*** FATAL: Trap #%d at PC=0x%08x\n", excn - 32, pc);
                 }
                 _debug(pc);
-                m68k_end_timeslice();
+                m68k_end_timeslice_used();
                 g_running = FALSE;
             } else {
                 LPRINTF (LOG_WARNING, "*** Exception in task - continuing (use -d to halt and debug)\n");
@@ -427,12 +358,30 @@ int op_illg(int level)
                 {
                     fprintf(stderr, "*** EMU_CALL_WAIT: no tasks left, stopping emulator\n");
                     DPRINTF(LOG_DEBUG, "*** EMU_CALL_WAIT: no tasks left, stopping emulator\n");
-                    m68k_end_timeslice();
+                    m68k_end_timeslice_used();
                     g_running = false;
                     break;
                 }
             }
             
+#ifndef LXA_LIBRARY_BUILD
+            /*
+             * The dispatcher's idle loop (supervisor mode; tasks
+             * such as WaitTOF() count on the 1ms nap) has nothing to do
+             * until a VBlank makes a task ready.  Rather than napping 1ms at
+             * a time - a thousand wakeups and SDL polls per second on an
+             * idle desktop - hand back to the main loop, which sleeps until
+             * the next tick and then runs the complete VBlank.  liblxa keeps
+             * the nap: its drivers synthesize VBlanks from emulated cycles.
+             */
+            if (m68k_get_reg(NULL, M68K_REG_SR) & 0x2000)
+            {
+                g_guest_idle = true;
+                m68k_end_timeslice_used();
+                break;
+            }
+#endif
+
             /* If VBlank is pending, set the IRQ now so it fires after we return */
             if ((g_pending_irq & (1 << 3)) && 
                 (g_intena & INTENA_MASTER) && (g_intena & INTENA_VBLANK))
@@ -1251,15 +1200,14 @@ int op_illg(int level)
                     width, height, depth);
 
             display_t *display = display_open(width, height, depth, "LXA Amiga Display");
-            /* Store display handle as a host pointer - we'll use the pointer address as a handle */
-            m68k_set_reg(M68K_REG_D0, (uint32_t)(uintptr_t)display);
+            m68k_set_reg(M68K_REG_D0, display_handle(display));
             break;
         }
 
         case EMU_CALL_GFX_CLOSE_DISPLAY:
         {
             uint32_t d1 = m68k_get_reg(NULL, M68K_REG_D1);
-            display_t *display = (display_t *)(uintptr_t)d1;
+            display_t *display = display_from_handle(d1);
 
             DPRINTF(LOG_DEBUG, "lxa: op_illg(): EMU_CALL_GFX_CLOSE_DISPLAY handle=0x%08x\n", d1);
 
@@ -1270,7 +1218,7 @@ int op_illg(int level)
         case EMU_CALL_GFX_REFRESH:
         {
             uint32_t d1 = m68k_get_reg(NULL, M68K_REG_D1);
-            display_t *display = (display_t *)(uintptr_t)d1;
+            display_t *display = display_from_handle(d1);
 
             DPRINTF(LOG_DEBUG, "lxa: op_illg(): EMU_CALL_GFX_REFRESH handle=0x%08x\n", d1);
 
@@ -1283,7 +1231,7 @@ int op_illg(int level)
             uint32_t d1 = m68k_get_reg(NULL, M68K_REG_D1);
             uint32_t d2 = m68k_get_reg(NULL, M68K_REG_D2);
             uint32_t d3 = m68k_get_reg(NULL, M68K_REG_D3);
-            display_t *display = (display_t *)(uintptr_t)d1;
+            display_t *display = display_from_handle(d1);
             int index = (int)(d2 & 0xFF);
             uint8_t r = (d3 >> 16) & 0xFF;
             uint8_t g = (d3 >> 8) & 0xFF;
@@ -1302,7 +1250,7 @@ int op_illg(int level)
             uint32_t d2 = m68k_get_reg(NULL, M68K_REG_D2);
             uint32_t d3 = m68k_get_reg(NULL, M68K_REG_D3);
             uint32_t a0 = m68k_get_reg(NULL, M68K_REG_A0);
-            display_t *display = (display_t *)(uintptr_t)d1;
+            display_t *display = display_from_handle(d1);
             int start = (int)d2;
             int count = (int)d3;
 
@@ -1332,7 +1280,7 @@ int op_illg(int level)
             uint32_t d2 = m68k_get_reg(NULL, M68K_REG_D2);
             uint32_t d3 = m68k_get_reg(NULL, M68K_REG_D3);
             uint32_t a0 = m68k_get_reg(NULL, M68K_REG_A0);
-            display_t *display = (display_t *)(uintptr_t)d1;
+            display_t *display = display_from_handle(d1);
             int start = (int)d2;
             int count = (int)d3;
 
@@ -1362,7 +1310,7 @@ int op_illg(int level)
             uint32_t d2 = m68k_get_reg(NULL, M68K_REG_D2);
             uint32_t d3 = m68k_get_reg(NULL, M68K_REG_D3);
             uint32_t d4 = m68k_get_reg(NULL, M68K_REG_D4);
-            display_t *display = (display_t *)(uintptr_t)d1;
+            display_t *display = display_from_handle(d1);
             int x = (int)d2;
             int y = (int)d3;
             uint8_t pen = (uint8_t)d4;
@@ -1388,7 +1336,7 @@ int op_illg(int level)
             uint32_t d4 = m68k_get_reg(NULL, M68K_REG_D4);
             uint32_t d5 = m68k_get_reg(NULL, M68K_REG_D5);
             uint32_t d6 = m68k_get_reg(NULL, M68K_REG_D6);
-            display_t *display = (display_t *)(uintptr_t)d1;
+            display_t *display = display_from_handle(d1);
             int x1 = (int)d2;
             int y1 = (int)d3;
             int x2 = (int)d4;
@@ -1422,7 +1370,7 @@ int op_illg(int level)
             uint32_t d4 = m68k_get_reg(NULL, M68K_REG_D4);
             uint32_t d5 = m68k_get_reg(NULL, M68K_REG_D5);
             uint32_t d6 = m68k_get_reg(NULL, M68K_REG_D6);
-            display_t *display = (display_t *)(uintptr_t)d1;
+            display_t *display = display_from_handle(d1);
             int x1 = (int)d2;
             int y1 = (int)d3;
             int x2 = (int)d4;
@@ -1469,7 +1417,7 @@ int op_illg(int level)
             uint32_t d6 = m68k_get_reg(NULL, M68K_REG_D6);
             uint32_t d7 = m68k_get_reg(NULL, M68K_REG_D7);
             uint32_t a0 = m68k_get_reg(NULL, M68K_REG_A0);
-            display_t *display = (display_t *)(uintptr_t)d1;
+            display_t *display = display_from_handle(d1);
             int x = (int)d2;
             int y = (int)d3;
             int width = (int)d4;
@@ -1535,7 +1483,7 @@ int op_illg(int level)
             uint32_t d5 = m68k_get_reg(NULL, M68K_REG_D5);
             uint32_t d6 = m68k_get_reg(NULL, M68K_REG_D6);
             uint32_t a0 = m68k_get_reg(NULL, M68K_REG_A0);
-            display_t *display = (display_t *)(uintptr_t)d1;
+            display_t *display = display_from_handle(d1);
             int x = (int)d2;
             int y = (int)d3;
             int width = (int)d4;
@@ -1855,7 +1803,7 @@ int op_illg(int level)
         case EMU_CALL_GFX_GET_SIZE:
         {
             uint32_t d1 = m68k_get_reg(NULL, M68K_REG_D1);
-            display_t *display = (display_t *)(uintptr_t)d1;
+            display_t *display = display_from_handle(d1);
             int width, height, depth;
 
             display_get_size(display, &width, &height, &depth);
@@ -1880,7 +1828,7 @@ int op_illg(int level)
             if (quit)
             {
                 DPRINTF(LOG_INFO, "lxa: display quit requested\n");
-                m68k_end_timeslice();
+                m68k_end_timeslice_used();
                 g_running = FALSE;
             }
             break;
@@ -1976,8 +1924,8 @@ int op_illg(int level)
                 lxa_push_intui_event(LXA_INTUI_EVENT_OPEN_SCREEN, -1, title,
                                      0, 0, (int)width, (int)height);
 
-            /* Return display handle (pointer cast to uint32_t) */
-            m68k_set_reg(M68K_REG_D0, (uint32_t)(uintptr_t)disp);
+            /* Return display handle */
+            m68k_set_reg(M68K_REG_D0, display_handle(disp));
             break;
         }
 
@@ -1985,7 +1933,7 @@ int op_illg(int level)
         {
             /* d1: display_handle */
             uint32_t d1 = m68k_get_reg(NULL, M68K_REG_D1);
-            display_t *disp = (display_t *)(uintptr_t)d1;
+            display_t *disp = display_from_handle(d1);
 
             DPRINTF(LOG_DEBUG, "lxa: op_illg(): EMU_CALL_INT_CLOSE_SCREEN handle=0x%08x\n", d1);
 
@@ -2006,7 +1954,7 @@ int op_illg(int level)
             uint32_t d1 = m68k_get_reg(NULL, M68K_REG_D1);
             uint32_t d2 = m68k_get_reg(NULL, M68K_REG_D2);
             uint32_t d3 = m68k_get_reg(NULL, M68K_REG_D3);
-            display_t *disp = (display_t *)(uintptr_t)d1;
+            display_t *disp = display_from_handle(d1);
             uint32_t planes_ptr = d2;
             uint32_t bpr = (d3 >> 16) & 0xFFFF;
             uint32_t depth = d3 & 0xFFFF;
@@ -2024,7 +1972,7 @@ int op_illg(int level)
                 for (uint32_t i = 0; i < depth && i < 8; i++)
                 {
                     uint32_t plane_addr = m68k_read_memory_32(planes_ptr + i * 4);
-                    if (plane_addr)
+                    if (plane_addr && plane_addr < g_ram_size)
                     {
                         planes[i] = (const uint8_t *)&g_ram[plane_addr];
                     }
@@ -2053,7 +2001,7 @@ int op_illg(int level)
             uint32_t d1 = m68k_get_reg(NULL, M68K_REG_D1);
             uint32_t d2 = m68k_get_reg(NULL, M68K_REG_D2);
             uint32_t d3 = m68k_get_reg(NULL, M68K_REG_D3);
-            display_t *disp = (display_t *)(uintptr_t)d1;
+            display_t *disp = display_from_handle(d1);
             uint32_t planes_ptr = d2;
             uint32_t bpr = (d3 >> 16) & 0xFFFF;
             uint32_t depth = d3 & 0xFFFF;
@@ -2140,7 +2088,7 @@ int op_illg(int level)
         case EMU_CALL_INT_GET_EVENT_WIN:
         {
             /* Returns display handle for window that received the event */
-            m68k_set_reg(M68K_REG_D0, (uint32_t)(uintptr_t)g_last_event.window);
+            m68k_set_reg(M68K_REG_D0, display_handle(g_last_event.window));
             break;
         }
 
@@ -2157,7 +2105,7 @@ int op_illg(int level)
             uint32_t d3 = m68k_get_reg(NULL, M68K_REG_D3);
             uint32_t d4 = m68k_get_reg(NULL, M68K_REG_D4);
             uint32_t d5 = m68k_get_reg(NULL, M68K_REG_D5);
-            display_t *screen = (display_t *)(uintptr_t)d1;
+            display_t *screen = display_from_handle(d1);
             int x = (int16_t)((d2 >> 16) & 0xFFFF);
             int y = (int16_t)(d2 & 0xFFFF);
             int w = (int16_t)((d3 >> 16) & 0xFFFF);
@@ -2207,7 +2155,7 @@ int op_illg(int level)
                 int win_idx = display_get_window_count() - 1;
                 lxa_push_intui_event(LXA_INTUI_EVENT_OPEN_WINDOW, win_idx, title, x, y, w, h);
             }
-            m68k_set_reg(M68K_REG_D0, (uint32_t)(uintptr_t)win);
+            m68k_set_reg(M68K_REG_D0, display_window_handle(win));
             break;
         }
 
@@ -2215,7 +2163,7 @@ int op_illg(int level)
         {
             /* d1: window_handle */
             uint32_t d1 = m68k_get_reg(NULL, M68K_REG_D1);
-            display_window_t *win = (display_window_t *)(uintptr_t)d1;
+            display_window_t *win = display_window_from_handle(d1);
 
             DPRINTF(LOG_DEBUG, "lxa: EMU_CALL_INT_CLOSE_WINDOW handle=0x%08x\n", d1);
 
@@ -2234,7 +2182,7 @@ int op_illg(int level)
             /* d1: window_handle, d2: (x << 16) | y */
             uint32_t d1 = m68k_get_reg(NULL, M68K_REG_D1);
             uint32_t d2 = m68k_get_reg(NULL, M68K_REG_D2);
-            display_window_t *win = (display_window_t *)(uintptr_t)d1;
+            display_window_t *win = display_window_from_handle(d1);
             int x = (int16_t)((d2 >> 16) & 0xFFFF);
             int y = (int16_t)(d2 & 0xFFFF);
 
@@ -2253,7 +2201,7 @@ int op_illg(int level)
             uint32_t d1 = m68k_get_reg(NULL, M68K_REG_D1);
             uint32_t d2 = m68k_get_reg(NULL, M68K_REG_D2);
             uint32_t d3 = m68k_get_reg(NULL, M68K_REG_D3);
-            display_window_t *win = (display_window_t *)(uintptr_t)d1;
+            display_window_t *win = display_window_from_handle(d1);
             int w = (int)d2;
             int h = (int)d3;
 
@@ -2269,7 +2217,7 @@ int op_illg(int level)
         {
             /* d1: window_handle */
             uint32_t d1 = m68k_get_reg(NULL, M68K_REG_D1);
-            display_window_t *win = (display_window_t *)(uintptr_t)d1;
+            display_window_t *win = display_window_from_handle(d1);
 
             DPRINTF(LOG_DEBUG, "lxa: EMU_CALL_INT_WINDOW_TOFRONT handle=0x%08x\n", d1);
 
@@ -2282,7 +2230,7 @@ int op_illg(int level)
         {
             /* d1: window_handle */
             uint32_t d1 = m68k_get_reg(NULL, M68K_REG_D1);
-            display_window_t *win = (display_window_t *)(uintptr_t)d1;
+            display_window_t *win = display_window_from_handle(d1);
 
             DPRINTF(LOG_DEBUG, "lxa: EMU_CALL_INT_WINDOW_TOBACK handle=0x%08x\n", d1);
 
@@ -2296,7 +2244,7 @@ int op_illg(int level)
             /* d1: window_handle, d2: title_ptr */
             uint32_t d1 = m68k_get_reg(NULL, M68K_REG_D1);
             uint32_t d2 = m68k_get_reg(NULL, M68K_REG_D2);
-            display_window_t *win = (display_window_t *)(uintptr_t)d1;
+            display_window_t *win = display_window_from_handle(d1);
             uint32_t title_ptr = d2;
 
             char title[128] = "";
@@ -2327,7 +2275,7 @@ int op_illg(int level)
             uint32_t d1 = m68k_get_reg(NULL, M68K_REG_D1);
             uint32_t d2 = m68k_get_reg(NULL, M68K_REG_D2);
             uint32_t d3 = m68k_get_reg(NULL, M68K_REG_D3);
-            display_window_t *win = (display_window_t *)(uintptr_t)d1;
+            display_window_t *win = display_window_from_handle(d1);
             uint32_t planes_ptr = d2;
             uint32_t bpr = (d3 >> 16) & 0xFFFF;
             uint32_t depth = d3 & 0xFFFF;
@@ -2342,7 +2290,7 @@ int op_illg(int level)
                 for (uint32_t i = 0; i < depth && i < 8; i++)
                 {
                     uint32_t plane_addr = m68k_read_memory_32(planes_ptr + i * 4);
-                    if (plane_addr)
+                    if (plane_addr && plane_addr < g_ram_size)
                     {
                         planes[i] = (const uint8_t *)&g_ram[plane_addr];
                     }
@@ -2374,7 +2322,7 @@ int op_illg(int level)
             /* d1: window_handle, d2: emulated Window* */
             uint32_t d1 = m68k_get_reg(NULL, M68K_REG_D1);
             uint32_t d2 = m68k_get_reg(NULL, M68K_REG_D2);
-            display_window_t *win = (display_window_t *)(uintptr_t)d1;
+            display_window_t *win = display_window_from_handle(d1);
 
             DPRINTF(LOG_DEBUG, "lxa: EMU_CALL_INT_ATTACH_WINDOW handle=0x%08x, window=0x%08x\n",
                     d1, d2);
@@ -2673,7 +2621,7 @@ int op_illg(int level)
             }
             filename[i] = '\0';
             
-            bool result = display_capture_window((display_window_t *)(uintptr_t)window_handle, filename);
+            bool result = display_capture_window(display_window_from_handle(window_handle), filename);
             m68k_set_reg(M68K_REG_D0, result ? 1 : 0);
             break;
         }
@@ -3559,7 +3507,7 @@ int op_illg(int level)
              * 2. Child tasks that didn't get to cleanup are acceptable loss
              * 3. This prevents hangs from orphaned child tasks
              */
-            m68k_end_timeslice();
+            m68k_end_timeslice_used();
             g_running = FALSE;
             break;
         }
@@ -3567,12 +3515,8 @@ int op_illg(int level)
 
 #ifdef PROFILE_BUILD
     clock_gettime(CLOCK_MONOTONIC, &_prof_end);
-    if (d0 < LXA_PROFILE_MAX_EMUCALL)
-    {
-        g_profile_calls[d0]++;
-        g_profile_ns[d0] += (uint64_t)(_prof_end.tv_sec  - _prof_start.tv_sec)  * 1000000000ULL
-                           + (uint64_t)(_prof_end.tv_nsec - _prof_start.tv_nsec);
-    }
+    _profile_count_emucall(d0, (uint64_t)(_prof_end.tv_sec  - _prof_start.tv_sec)  * 1000000000ULL
+                               + (uint64_t)(_prof_end.tv_nsec - _prof_start.tv_nsec));
 #endif
 
     return M68K_INT_ACK_AUTOVECTOR;
@@ -9,15 +9,16 @@
 
 #include "lxa_internal.h"
 #include "lxa_memory.h"
+#include "lxa_snapshot.h"
 
 /* Forward declaration (definition near end of file) */
 static int _linux_path_to_amiga(const char *linux_path, char *amiga_buf, size_t bufsize);
 
 /* Private static data owned by lxa_dos_host.c */
-lock_entry_t        g_locks[MAX_LOCKS];
-record_lock_entry_t g_record_locks[MAX_RECORD_LOCKS];
-timer_request_t     g_timer_queue[MAX_TIMER_REQUESTS];
-notify_entry_t      g_notify_requests[MAX_NOTIFY_REQUESTS];
+LXA_INSTANCE_LOCAL lock_entry_t        *g_locks;              /* lxa_alloc_host_state() */
+LXA_INSTANCE_LOCAL record_lock_entry_t  g_record_locks[MAX_RECORD_LOCKS];
+LXA_INSTANCE_LOCAL timer_request_t      g_timer_queue[MAX_TIMER_REQUESTS];
+LXA_INSTANCE_LOCAL notify_entry_t      *g_notify_requests;    /* lxa_alloc_host_state() */
 
 #ifdef SDL2_FOUND
 audio_channel_state_t g_audio_channels[AUDIO_HOST_CHANNELS];
@@ -32,6 +33,29 @@ static uint64_t _timer_get_time_us(void)
     return (uint64_t)tv.tv_sec * 1000000ULL + (uint64_t)tv.tv_usec;
 }
 
+/*
+ * Host fds held by guest FileHandles (fh_Args).  Only tracked
+ * so that snapshots can record and reopen them, see _dos_host_save_state().
+ */
+#define MAX_GUEST_FDS 4096
+
+static LXA_INSTANCE_LOCAL uint8_t s_guest_fds[MAX_GUEST_FDS / 8];
+
+static void _guest_fd_track(int fd, bool open)
+{
+    if (fd < 0 || fd >= MAX_GUEST_FDS)
+        return;
+    if (open)
+        s_guest_fds[fd >> 3] |= 1 << (fd & 7);
+    else
+        s_guest_fds[fd >> 3] &= ~(1 << (fd & 7));
+}
+
+static bool _guest_fd_tracked(int fd)
+{
+    return s_guest_fds[fd >> 3] & (1 << (fd & 7));
+}
+
 static void __attribute__((unused)) _audio_init(void)
 {
 #ifdef SDL2_FOUND
@@ -674,7 +698,7 @@ bool other_tasks_running(void)
 
 char *_mgetstr (uint32_t address)
 {
-    if ((address >= RAM_START) && (address <= RAM_END))
+    if ((address >= RAM_START) && (address - RAM_START < g_ram_size))
     {
         uint32_t addr = address - RAM_START;
         return (char *) &g_ram[addr];
@@ -804,6 +828,7 @@ int _dos_open (uint32_t path68k, uint32_t accessMode, uint32_t fh68k)
         {
             m68k_write_memory_32 (fh68k+36, fd);                // fh_Args
             m68k_write_memory_32 (fh68k+32, FILE_KIND_REGULAR); // fh_Func3
+            _guest_fd_track (fd, true);
             return 0;  // Success
         }
         else
@@ -826,6 +851,11 @@ int _dos_read (uint32_t fh68k, uint32_t buf68k, uint32_t len68k)
     DPRINTF (LOG_DEBUG, "                  -> fd = %d\n", fd);
 
     void *buf = _mgetstr (buf68k);
+
+    /* Read() may load code (LoadSeg) over pages that held
+     * previously executed code - retire the predecoded blocks there. */
+    lxa_mem_host_write (buf68k, len68k);
+
     if (kind == FILE_KIND_CONSOLE && !lxa_host_console_input_empty())
     {
         uint8_t *dst = (uint8_t *)buf;
@@ -1572,10 +1602,10 @@ int _dos_write(uint32_t fh68k, uint32_t buf68k, uint32_t len68k)
         }
         case FILE_KIND_CONSOLE:
         {
-            static bool     bCSI = FALSE;
-            static bool     bESC = FALSE;
-            static char     csiBuf[CSI_BUF_LEN];
-            static uint16_t csiBufLen = 0;
+            static LXA_INSTANCE_LOCAL bool     bCSI = FALSE;
+            static LXA_INSTANCE_LOCAL bool     bESC = FALSE;
+            static LXA_INSTANCE_LOCAL char     csiBuf[CSI_BUF_LEN];
+            static LXA_INSTANCE_LOCAL uint16_t csiBufLen = 0;
 
             l = len68k;
 
@@ -1687,6 +1717,7 @@ int _dos_close (uint32_t fh68k)
     _record_lock_release_all(fh68k);
 
     close(fd);
+    _guest_fd_track(fd, false);
 
     DPRINTF (LOG_DEBUG, "lxa: _dos_close(): fh=0x%08x done\n", fh68k);
     return 1;
@@ -3602,6 +3633,7 @@ int _dos_openfromlock(uint32_t lock_id, uint32_t fh68k)
     /* Set up the file handle */
     m68k_write_memory_32(fh68k + 36, fd);                /* fh_Args */
     m68k_write_memory_32(fh68k + 32, FILE_KIND_REGULAR); /* fh_Func3 */
+    _guest_fd_track(fd, true);
     
     /* Free the lock - it's consumed */
     _lock_free(lock_id);
@@ -3636,3 +3668,233 @@ int _dos_waitforchar(uint32_t fh68k, uint32_t timeout_us)
     
     return (result > 0) ? 1 : 0;
 }
+
+/*
+ * Snapshot section.
+ *
+ * Locks, record locks, timer requests and notify requests are copied (an
+ * open ExNext() directory stream is reopened from its start on demand).
+ * Timer wake times are stored relative to the save so pending delays run
+ * out after the restore as they would have.  Guest file descriptors are
+ * recorded by path, flags and offset and reopened under the same numbers,
+ * since the fd lives in guest RAM; a number the host has meanwhile used
+ * for something else makes the restore fail.
+ */
+typedef struct
+{
+    int32_t  fd;
+    int32_t  flags;
+    int64_t  offset;
+    char     path[PATH_MAX];
+} snap_fd_t;
+
+static void _snap_put_table(lxa_snap_buf_t *buf, const void *table, int count, size_t entry_size)
+{
+    uint32_t used = 0;
+
+    for (int i = 0; i < count; i++)
+        if (*(const bool *)((const uint8_t *)table + i * entry_size))  /* in_use comes first */
+            used++;
+
+    lxa_snap_put_u32(buf, used);
+    for (int i = 0; i < count; i++)
+    {
+        const uint8_t *entry = (const uint8_t *)table + i * entry_size;
+        if (*(const bool *)entry)
+        {
+            lxa_snap_put_u32(buf, i);
+            lxa_snap_put(buf, entry, entry_size);
+        }
+    }
+}
+
+static bool _snap_get_table(lxa_snap_buf_t *buf, void *table, int count, size_t entry_size)
+{
+    uint32_t used = lxa_snap_get_u32(buf);
+
+    memset(table, 0, count * entry_size);
+    for (uint32_t n = 0; n < used && !buf->error; n++)
+    {
+        uint32_t i = lxa_snap_get_u32(buf);
+        if (i >= (uint32_t)count)
+            return false;
+        lxa_snap_get(buf, (uint8_t *)table + i * entry_size, entry_size);
+    }
+    return !buf->error;
+}
+
+void _dos_host_save_state(lxa_snap_buf_t *buf)
+{
+    uint64_t now = _timer_get_time_us();
+    uint32_t num_fds = 0;
+
+    _snap_put_table(buf, g_locks, MAX_LOCKS, sizeof(lock_entry_t));
+    _snap_put_table(buf, g_record_locks, MAX_RECORD_LOCKS, sizeof(record_lock_entry_t));
+    _snap_put_table(buf, g_notify_requests, MAX_NOTIFY_REQUESTS, sizeof(notify_entry_t));
+
+    lxa_snap_put(buf, &now, sizeof(now));
+    _snap_put_table(buf, g_timer_queue, MAX_TIMER_REQUESTS, sizeof(timer_request_t));
+
+    for (int fd = 0; fd < MAX_GUEST_FDS; fd++)
+        if (_guest_fd_tracked(fd))
+            num_fds++;
+
+    lxa_snap_put_u32(buf, num_fds);
+    for (int fd = 0; fd < MAX_GUEST_FDS; fd++)
+    {
+        snap_fd_t entry;
+        char      link[64];
+        ssize_t   len;
+
+        if (!_guest_fd_tracked(fd))
+            continue;
+
+        memset(&entry, 0, sizeof(entry));
+        entry.fd     = fd;
+        entry.flags  = fcntl(fd, F_GETFL);
+        entry.offset = lseek(fd, 0, SEEK_CUR);
+
+        snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+        len = readlink(link, entry.path, sizeof(entry.path) - 1);
+        if (len < 0 || entry.flags < 0 || entry.offset < 0)
+            entry.path[0] = 0;                       /* closed behind our back, or not a file */
+        else
+            entry.path[len] = 0;
+
+        lxa_snap_put(buf, &entry, sizeof(entry));
+    }
+}
+
+bool _dos_host_load_state(lxa_snap_buf_t *buf)
+{
+    uint64_t saved_now = 0;
+    uint64_t now       = _timer_get_time_us();
+    uint32_t num_fds;
+    bool     ok = true;
+
+    for (int i = 0; i < MAX_LOCKS; i++)
+    {
+        if (g_locks[i].dir)
+            closedir(g_locks[i].dir);
+    }
+    if (!_snap_get_table(buf, g_locks, MAX_LOCKS, sizeof(lock_entry_t)) ||
+        !_snap_get_table(buf, g_record_locks, MAX_RECORD_LOCKS, sizeof(record_lock_entry_t)) ||
+        !_snap_get_table(buf, g_notify_requests, MAX_NOTIFY_REQUESTS, sizeof(notify_entry_t)))
+        return false;
+    for (int i = 0; i < MAX_LOCKS; i++)
+        g_locks[i].dir = NULL;                      /* saved DIR * are stale */
+
+    lxa_snap_get(buf, &saved_now, sizeof(saved_now));
+    if (!_snap_get_table(buf, g_timer_queue, MAX_TIMER_REQUESTS, sizeof(timer_request_t)))
+        return false;
+    for (int i = 0; i < MAX_TIMER_REQUESTS; i++)
+    {
+        if (g_timer_queue[i].in_use)
+            g_timer_queue[i].wake_time_us += now - saved_now;
+    }
+
+    /* The files of the current session go, the snapshot's come back */
+    for (int fd = 0; fd < MAX_GUEST_FDS; fd++)
+    {
+        if (_guest_fd_tracked(fd))
+        {
+            close(fd);
+            _guest_fd_track(fd, false);
+        }
+    }
+
+    num_fds = lxa_snap_get_u32(buf);
+    for (uint32_t n = 0; n < num_fds && !buf->error; n++)
+    {
+        snap_fd_t entry;
+        int       fd;
+
+        if (!lxa_snap_get(buf, &entry, sizeof(entry)))
+            return false;
+        entry.path[sizeof(entry.path) - 1] = 0;
+        if (entry.fd < 0 || entry.fd >= MAX_GUEST_FDS)
+            return false;
+
+        /* A FileHandle of the guest would be left on a closed fd */
+        if (!entry.path[0])
+        {
+            LPRINTF(LOG_ERROR, "lxa: snapshot: fd %d was not a file when saved\n", entry.fd);
+            ok = false;
+            continue;
+        }
+
+        if (fcntl(entry.fd, F_GETFD) != -1)
+        {
+            LPRINTF(LOG_ERROR, "lxa: snapshot: fd %d of %s is in use by the host\n", entry.fd, entry.path);
+            ok = false;
+            continue;
+        }
+
+        fd = open(entry.path, entry.flags & (O_ACCMODE | O_APPEND));
+        if (fd < 0)
+        {
+            LPRINTF(LOG_ERROR, "lxa: snapshot: cannot reopen %s: %s\n", entry.path, strerror(errno));
+            ok = false;
+            continue;
+        }
+        if (fd != entry.fd)
+        {
+            if (dup2(fd, entry.fd) < 0)
+            {
+                close(fd);
+                ok = false;
+                continue;
+            }
+            close(fd);
+        }
+        _guest_fd_track(entry.fd, true);
+        if (lseek(entry.fd, entry.offset, SEEK_SET) != entry.offset)
+        {
+            LPRINTF(LOG_ERROR, "lxa: snapshot: cannot seek %s to %lld\n", entry.path, (long long)entry.offset);
+            ok = false;
+        }
+    }
+
+    return ok && !buf->error;
+}
+
+/*
+ * Fork server children (lxa_fork_server()) inherit the guest
+ * fds, and a forked fd shares its file offset with the parent.  Reopen
+ * each one so a child reading or seeking a file does not move the file
+ * position of the parent and its siblings.
+ */
+void _dos_host_unshare_fds(void)
+{
+    for (int fd = 0; fd < MAX_GUEST_FDS; fd++)
+    {
+        char    link[64];
+        char    path[PATH_MAX];
+        ssize_t len;
+        int     flags, nfd;
+        off_t   offset;
+
+        if (!_guest_fd_tracked(fd))
+            continue;
+
+        flags  = fcntl(fd, F_GETFL);
+        offset = lseek(fd, 0, SEEK_CUR);
+        snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+        len = readlink(link, path, sizeof(path) - 1);
+        if (flags < 0 || offset < 0 || len < 0)
+            continue;
+        path[len] = 0;
+        if (path[0] != '/')
+            continue;                               /* pipe or socket: keep sharing */
+
+        nfd = open(path, flags & (O_ACCMODE | O_APPEND));
+        if (nfd < 0)
+        {
+            LPRINTF(LOG_WARNING, "lxa: fork server: cannot reopen %s: %s\n", path, strerror(errno));
+            continue;
+        }
+        if (dup2(nfd, fd) >= 0)
+            lseek(fd, offset, SEEK_SET);
+        close(nfd);
+    }
+}
@@ -17,13 +17,14 @@
 
 #include "lxa_internal.h"
 #include "lxa_api.h"
+#include "lxa_snapshot.h"
 
 #include <string.h>
 
 /* Circular event log storage — accessed by lxa_api.c via extern */
-lxa_intui_event_t g_event_log[LXA_EVENT_LOG_SIZE];
-int               g_event_log_head;
-int               g_event_log_count;
+LXA_INSTANCE_LOCAL lxa_intui_event_t g_event_log[LXA_EVENT_LOG_SIZE];
+LXA_INSTANCE_LOCAL int               g_event_log_head;
+LXA_INSTANCE_LOCAL int               g_event_log_count;
 
 void lxa_push_intui_event(int type, int window_index, const char *title,
                           int x, int y, int w, int h)
@@ -56,3 +57,21 @@ void lxa_reset_intui_events(void)
     g_event_log_head  = 0;
     g_event_log_count = 0;
 }
+
+/* Snapshot section */
+void lxa_events_save_state(lxa_snap_buf_t *buf)
+{
+    lxa_snap_put(buf, g_event_log, sizeof(g_event_log));
+    lxa_snap_put(buf, &g_event_log_head, sizeof(g_event_log_head));
+    lxa_snap_put(buf, &g_event_log_count, sizeof(g_event_log_count));
+}
+
+bool lxa_events_load_state(lxa_snap_buf_t *buf)
+{
+    lxa_snap_get(buf, g_event_log, sizeof(g_event_log));
+    lxa_snap_get(buf, &g_event_log_head, sizeof(g_event_log_head));
+    lxa_snap_get(buf, &g_event_log_count, sizeof(g_event_log_count));
+
+    return !buf->error && g_event_log_head >= 0 && g_event_log_head < LXA_EVENT_LOG_SIZE &&
+           g_event_log_count >= 0 && g_event_log_count <= LXA_EVENT_LOG_SIZE;
+}
@@ -0,0 +1,295 @@
+/*
+ * lxa_forkserver.c — Copy-on-write fork server (lxa_fork_server() & co.).
+ *
+ * Booting the ROM and starting the application under test is
+ * most of the run time of a short test case.  Guest RAM is plain private
+ * process memory, so once a test driver has brought the machine to a
+ * checkpoint it can fork() one child per test case: each child starts from
+ * the checkpoint and shares every page it does not write with the parent.
+ *
+ * Protocol, over a Unix stream socket, one connection per test case:
+ *
+ *   client -> server   request line, terminated by '\n' (or EOF)
+ *   server -> client   whatever the child's handler writes, then
+ *                      "\x1elxa-exit <status>\n" once the child has exited
+ *
+ * The request "quit" makes the server wait for its children and return.
+ * A child killed by a signal reports 128 + the signal number.
+ */
+
+#include "lxa_api.h"
+#include "lxa_internal.h"
+#include "display.h"
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define FORK_REQUEST_MAX    4096
+#define FORK_MAX_CHILDREN   256
+#define FORK_POLL_MS        10
+#define FORK_TRAILER        "\x1elxa-exit "
+
+typedef struct
+{
+    pid_t pid;
+    int   conn;
+} fork_child_t;
+
+static LXA_INSTANCE_LOCAL fork_child_t s_children[FORK_MAX_CHILDREN];
+static LXA_INSTANCE_LOCAL int          s_num_children;
+
+static bool _make_address(struct sockaddr_un *addr, const char *socket_path)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr->sun_path))
+        return false;
+    strcpy(addr->sun_path, socket_path);
+    return true;
+}
+
+static bool _write_all(int fd, const void *data, size_t len)
+{
+    const char *p = data;
+
+    while (len > 0)
+    {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p   += n;
+        len -= n;
+    }
+    return true;
+}
+
+/* Request line up to '\n' or EOF; false if the client sent nothing */
+static bool _read_request(int conn, char *request, size_t size)
+{
+    size_t len = 0;
+
+    while (len < size - 1)
+    {
+        ssize_t n = read(conn, request + len, 1);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0 || request[len] == '\n')
+            break;
+        len++;
+    }
+    request[len] = 0;
+    return len > 0;
+}
+
+/* Report the exit status of a reaped child to its client */
+static void _finish_child(pid_t pid, int status)
+{
+    for (int i = 0; i < s_num_children; i++)
+    {
+        char trailer[64];
+        int  rv;
+
+        if (s_children[i].pid != pid)
+            continue;
+
+        rv = WIFEXITED(status) ? WEXITSTATUS(status)
+           : WIFSIGNALED(status) ? 128 + WTERMSIG(status) : -1;
+        snprintf(trailer, sizeof(trailer), FORK_TRAILER "%d\n", rv);
+        _write_all(s_children[i].conn, trailer, strlen(trailer));
+        close(s_children[i].conn);
+
+        s_children[i] = s_children[--s_num_children];
+        return;
+    }
+}
+
+static void _reap_children(bool block)
+{
+    int   status;
+    pid_t pid;
+
+    while (s_num_children > 0 && (pid = waitpid(-1, &status, block ? 0 : WNOHANG)) != 0)
+    {
+        if (pid < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        _finish_child(pid, status);
+        block = false;
+    }
+}
+
+/*
+ * In the child: drop the server's sockets, get a scheduler timer of our
+ * own (timers are not inherited) and private file offsets.
+ */
+static void _child_setup(int listen_fd)
+{
+    close(listen_fd);
+    for (int i = 0; i < s_num_children; i++)
+        close(s_children[i].conn);
+    s_num_children = 0;
+
+    lxa_start_timer();
+    _dos_host_unshare_fds();
+}
+
+int lxa_fork_server(const char *socket_path, int max_children,
+                    lxa_fork_handler_t handler, void *userdata)
+{
+    struct sockaddr_un addr;
+    int                listen_fd;
+    int                served = 0;
+
+    if (!socket_path || !handler || !_make_address(&addr, socket_path))
+        return -1;
+    if (!display_get_headless())
+    {
+        LPRINTF(LOG_ERROR, "lxa: fork server: requires headless mode\n");
+        return -1;
+    }
+    if (max_children <= 0 || max_children > FORK_MAX_CHILDREN)
+        max_children = FORK_MAX_CHILDREN;
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0)
+        return -1;
+    unlink(socket_path);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, 64) < 0)
+    {
+        LPRINTF(LOG_ERROR, "lxa: fork server: cannot listen on %s: %s\n", socket_path, strerror(errno));
+        close(listen_fd);
+        return -1;
+    }
+
+    for (;;)
+    {
+        struct pollfd pfd = { .fd = listen_fd, .events = POLLIN };
+        char          request[FORK_REQUEST_MAX];
+        int           conn;
+        pid_t         pid;
+
+        _reap_children(false);
+        if (poll(&pfd, 1, FORK_POLL_MS) <= 0)
+            continue;
+
+        conn = accept(listen_fd, NULL, NULL);
+        if (conn < 0)
+            continue;
+        if (!_read_request(conn, request, sizeof(request)))
+        {
+            close(conn);
+            continue;
+        }
+        if (!strcmp(request, "quit"))
+        {
+            close(conn);
+            break;
+        }
+
+        while (s_num_children >= max_children)
+            _reap_children(true);
+
+        fflush(NULL);                   /* or the child writes our buffered output again */
+        pid = fork();
+        if (pid == 0)
+        {
+            int rv;
+
+            _child_setup(listen_fd);
+            rv = handler(request, conn, userdata);
+            fflush(NULL);
+            _exit(rv & 0xff);
+        }
+        if (pid < 0)
+        {
+            LPRINTF(LOG_ERROR, "lxa: fork server: fork failed: %s\n", strerror(errno));
+            close(conn);
+            continue;
+        }
+
+        s_children[s_num_children].pid  = pid;
+        s_children[s_num_children].conn = conn;
+        s_num_children++;
+        served++;
+    }
+
+    while (s_num_children > 0)
+        _reap_children(true);
+    close(listen_fd);
+    unlink(socket_path);
+    return served;
+}
+
+int lxa_fork_request(const char *socket_path, const char *request, char *output, int size)
+{
+    struct sockaddr_un addr;
+    char              *reply = NULL;
+    size_t             len = 0, cap = 0;
+    char              *trailer;
+    int                fd;
+    int                rv = -1;
+
+    if (!socket_path || !request || !_make_address(&addr, socket_path))
+        return -1;
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        !_write_all(fd, request, strlen(request)) || !_write_all(fd, "\n", 1))
+    {
+        close(fd);
+        return -1;
+    }
+
+    for (;;)
+    {
+        ssize_t n;
+
+        if (len + 4096 + 1 > cap)
+        {
+            size_t grow_cap = cap ? cap * 2 : 65536;
+            char  *grow     = realloc(reply, grow_cap);
+
+            if (!grow)
+                break;
+            reply = grow;
+            cap   = grow_cap;
+        }
+        n = read(fd, reply + len, cap - len - 1);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        len += n;
+    }
+    close(fd);
+
+    if (reply)
+    {
+        reply[len] = 0;
+        trailer = strrchr(reply, FORK_TRAILER[0]);
+        if (trailer && !strncmp(trailer, FORK_TRAILER, strlen(FORK_TRAILER)))
+        {
+            rv       = atoi(trailer + strlen(FORK_TRAILER));
+            *trailer = 0;
+            len      = trailer - reply;
+        }
+        if (output && size > 0)
+        {
+            size_t n = len < (size_t)size - 1 ? len : (size_t)size - 1;
+            memcpy(output, reply, n);
+            output[n] = 0;
+        }
+        free(reply);
+    }
+    return rv;
+}
@@ -0,0 +1,33 @@
+/*
+ * lxa_instance.h — Per-instance emulator state.
+ *
+ * liblxa runs one emulator per thread.  Every variable that
+ * belongs to a single emulator (CPU core, guest memory map, DOS, display
+ * and event state, configuration, ...) is declared LXA_INSTANCE_LOCAL,
+ * which is thread-local storage in the library build and a plain global
+ * in the (single instance) lxa executable.
+ *
+ * Thread-local storage is set up for every thread of the process, so
+ * tables of a megabyte or more are pointers to memory allocated when the
+ * instance starts (lxa_alloc_host_state(), lxa_mem_alloc_ram(),
+ * m68k_cache_run(), the profiler).  Tables computed once from the code
+ * itself (opcode handlers, cycle counts, disassembler tables) stay shared
+ * by all instances.
+ *
+ * The initial-exec TLS model keeps every access a fixed offset from the
+ * thread pointer, never a call to __tls_get_addr(): the watchpoint signal
+ * handlers (lxa_watch.c) read instance state and must stay
+ * async-signal-safe.  liblxa is a static library, so its TLS is always
+ * part of the executable's static TLS block.
+ */
+
+#ifndef LXA_INSTANCE_H
+#define LXA_INSTANCE_H
+
+#ifdef LXA_LIBRARY_BUILD
+#define LXA_INSTANCE_LOCAL __thread __attribute__((tls_model("initial-exec")))
+#else
+#define LXA_INSTANCE_LOCAL
+#endif
+
+#endif /* LXA_INSTANCE_H */
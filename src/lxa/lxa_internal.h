@@ -41,6 +41,7 @@
 #endif
 
 #include "m68k.h"
+#include "lxa_instance.h"
 #include "emucalls.h"
 #include "util.h"
 #include "vfs.h"
@@ -53,8 +54,8 @@
  * ========================================================= */
 
 #define RAM_START   0x000000
-#define RAM_SIZE    10 * 1024 * 1024
-#define RAM_END     RAM_START + RAM_SIZE - 1
+
+#define RAM_SIZE    (10 * 1024 * 1024)     /* allocated by lxa_mem_alloc_ram() */
 
 #define DEFAULT_ROM_PATH "../rom/lxa.rom"
 
@@ -314,27 +315,38 @@ typedef struct notify_entry_s {
  * Exported globals (defined in lxa.c)
  * ========================================================= */
 
-extern uint8_t  g_ram[];
-extern uint8_t  g_rom[];
-extern bool     g_verbose;
-extern bool     g_running;
-extern char    *g_loadfile;
-extern char     g_args[];
-extern int      g_args_len;
-extern int      g_rv;
-extern uint16_t g_color_regs[32];
-extern uint16_t g_intena;
-extern uint16_t g_intreq;
-extern uint16_t g_dmacon;
-extern volatile sig_atomic_t g_pending_irq;
+extern LXA_INSTANCE_LOCAL uint8_t *g_ram;              /* defined in lxa_memory.c */
+extern LXA_INSTANCE_LOCAL uint32_t g_ram_size;
+extern LXA_INSTANCE_LOCAL uint8_t *g_rom;              /* ROM_SIZE bytes, lxa_alloc_host_state() */
+extern LXA_INSTANCE_LOCAL bool     g_verbose;
+extern LXA_INSTANCE_LOCAL bool     g_running;
+extern LXA_INSTANCE_LOCAL char    *g_loadfile;
+extern LXA_INSTANCE_LOCAL char     g_args[];
+extern LXA_INSTANCE_LOCAL int      g_args_len;
+extern LXA_INSTANCE_LOCAL int      g_rv;
+extern LXA_INSTANCE_LOCAL uint16_t g_color_regs[32];
+extern LXA_INSTANCE_LOCAL uint16_t g_intena;
+extern LXA_INSTANCE_LOCAL uint16_t g_intreq;
+extern LXA_INSTANCE_LOCAL uint16_t g_dmacon;
+extern LXA_INSTANCE_LOCAL volatile sig_atomic_t g_pending_irq;
+extern LXA_INSTANCE_LOCAL bool     g_guest_idle;   /* Dispatcher waits (EMU_CALL_WAIT) */
 
 /* Globals defined in lxa.c needed by other modules */
-extern bool     g_trace;
-extern display_event_t g_last_event;
-extern void   (*g_console_output_hook)(const char *data, int len);
-extern void   (*g_text_hook)(const char *str, int len, int x, int y, void *userdata);
-extern void    *g_text_hook_userdata;
-extern char    *g_sysroot;
+extern LXA_INSTANCE_LOCAL bool     g_trace;
+extern LXA_INSTANCE_LOCAL display_event_t g_last_event;
+extern LXA_INSTANCE_LOCAL void   (*g_console_output_hook)(const char *data, int len);
+extern LXA_INSTANCE_LOCAL void   (*g_text_hook)(const char *str, int len, int x, int y, void *userdata);
+extern LXA_INSTANCE_LOCAL void    *g_text_hook_userdata;
+extern LXA_INSTANCE_LOCAL char    *g_sysroot;
+
+/* Allocate / release the tables above and in lxa_dos_host.c
+ * that are too large for thread-local storage (see lxa_instance.h) */
+bool lxa_alloc_host_state(void);
+void lxa_free_host_state(void);
+
+/* Per-thread VBlank timer raising SIGALRM (sigalrm_handler()) */
+bool lxa_start_timer(void);
+void lxa_stop_timer(void);
 
 /* Phase 131: event log — declared in lxa_api.c, called from lxa_dispatch.c */
 #ifndef LXA_INTUI_EVENT_OPEN_WINDOW
@@ -350,11 +362,12 @@ void lxa_push_intui_event(int type, int window_index, const char *title,
 void lxa_reset_intui_events(void);
 
 /* Globals defined in lxa_dos_host.c */
-extern lock_entry_t        g_locks[];
-extern record_lock_entry_t g_record_locks[];
-extern timer_request_t     g_timer_queue[];
-extern notify_entry_t      g_notify_requests[];
+extern LXA_INSTANCE_LOCAL lock_entry_t        *g_locks;             /* MAX_LOCKS */
+extern LXA_INSTANCE_LOCAL record_lock_entry_t  g_record_locks[];
+extern LXA_INSTANCE_LOCAL timer_request_t      g_timer_queue[];
+extern LXA_INSTANCE_LOCAL notify_entry_t      *g_notify_requests;   /* MAX_NOTIFY_REQUESTS */
 #ifdef SDL2_FOUND
+/* Shared with the SDL audio thread, so one audio device per process */
 extern audio_channel_state_t g_audio_channels[];
 extern SDL_AudioDeviceID     g_audio_device;
 extern bool                  g_audio_initialized;
@@ -366,7 +379,7 @@ struct pending_bp_s {
     pending_bp_t *next;
     char          name[256];
 };
-extern pending_bp_t *_g_pending_bps;
+extern LXA_INSTANCE_LOCAL pending_bp_t *_g_pending_bps;
 
 /* Console input queue helpers (defined in lxa.c, used by lxa_dos_host.c) */
 bool lxa_host_console_input_empty(void);
@@ -382,14 +395,16 @@ void _handle_custom_write_ext(uint16_t reg, uint16_t value);
 
 /* From lxa.c (debugger) */
 void _debug(uint32_t pc);
+void _debug_watch_hits(void);
 void hexdump(int lvl, uint32_t offset, uint32_t len);
 void _update_debug_active(void);
+void _sync_active_display(void);      /* VBlank planar sync */
 char *_mgetstr(uint32_t address);
 /* Debugger internals called by op_illg in lxa_dispatch.c */
 void     _debug_add_bp(uint32_t addr);
 uint32_t _debug_parse_addr(const char *buf);
 bool     _symtab_add(char *name, uint32_t offset);
-extern   pending_bp_t *_g_pending_bps;
+extern   LXA_INSTANCE_LOCAL pending_bp_t *_g_pending_bps;
 
 /* From lxa_dos_host.c */
 int errno2Amiga(void);
@@ -414,6 +429,8 @@ int _dos_close(uint32_t fh68k);
 uint32_t _dos_lock(uint32_t name68k, int32_t mode);
 void _dos_unlock(uint32_t lock_id);
 uint32_t _dos_duplock(uint32_t lock_id);
+
+void _dos_host_unshare_fds(void);   /* After fork() in a fork server child */
 uint32_t _dos_lockrecord(uint32_t fh68k, uint32_t offset, uint32_t length,
                           uint32_t timeout, uint32_t mode);
 uint32_t _dos_unlockrecord(uint32_t fh68k, uint32_t offset, uint32_t length);
@@ -462,10 +479,36 @@ bool lxa_host_console_enqueue_rawkey(int rawkey, int qualifier, bool down);
 /* From lxa_dispatch.c */
 int op_illg(int level);
 
-/* Phase 126: Profiling counters (defined in lxa_api.c, updated in lxa_dispatch.c) */
+/* Phase 126: Profiling counters (lxa_profile.c, updated in lxa_dispatch.c) */
 #define LXA_PROFILE_MAX_EMUCALL 6000
-extern uint64_t g_profile_calls[LXA_PROFILE_MAX_EMUCALL];
-extern uint64_t g_profile_ns[LXA_PROFILE_MAX_EMUCALL];
+void _profile_count_emucall(uint32_t id, uint64_t ns);
+
+/* Release the profiler state of this instance (lxa_shutdown()). */
+void _profile_shutdown(void);
+
+/*
+ * Per-LVO profiler (lxa_profile.c). _load_rom_map() registers
+ * the ROM functions behind the library jump tables, cpu_instr_callback()
+ * feeds every dispatched PC to the hook when PROFILE_BUILD is defined, and
+ * the execute loops add the cycles of each timeslice to g_profile_cycles.
+ */
+extern LXA_INSTANCE_LOCAL uint64_t g_profile_cycles;
+void _profile_lvo_register(uint32_t func, const char *name);
+void _profile_lvo_hook(uint32_t pc);
+
+/*
+ * Sampling profiler (lxa_profile.c). _profile_execute() runs
+ * the CPU for the execute loops: it clamps each timeslice with
+ * _profile_sample_slice() so it ends at the next sample point, adds the
+ * cycles used to g_profile_cycles and then calls _profile_sample_tick().
+ * It returns the cycles run, fewer than asked when the timeslice was ended
+ * (m68k_end_timeslice_used()). Frames are named through _symtab_lookup()
+ * (lxa.c).
+ */
+int  _profile_execute(int cycles);
+int  _profile_sample_slice(int cycles);
+void _profile_sample_tick(void);
+const char *_symtab_lookup(uint32_t addr);
 
 /* Debugger jitter tolerance when matching symbol names to PC */
 #define MAX_JITTER 1024
@@ -0,0 +1,656 @@
+/*
+ * lxa_memory.c - Guest memory map (page table) and region handlers.
+ *
+ * Replaces the address-range if-chains that used to live in
+ * mread8()/mwrite8().  See lxa_memory.h for the table layout.
+ *
+ * The default map mirrors the old chains exactly, including their order:
+ * the RAM overflow area 0x00A00000-0x00DFEFFF is tested before the CIA and
+ * slow RAM ranges, so those addresses keep reading as 0.  The custom chip
+ * page 0x00DF0000 is shared with the tail of the overflow area and its
+ * handlers split on CUSTOM_START.
+ *
+ * Guest RAM is allocated here as well.  It is a private anonymous mapping:
+ * the kernel only commits a page when the guest first writes it, so a
+ * 10 MB guest whose programs touch 2 MB costs about 2 MB of host memory.
+ */
+
+#include "lxa_internal.h"
+#include "lxa_memory.h"
+
+#include <sys/mman.h>
+
+LXA_INSTANCE_LOCAL uint8_t                **g_mem_read_page;
+LXA_INSTANCE_LOCAL uint8_t                **g_mem_write_page;
+LXA_INSTANCE_LOCAL const lxa_mem_region_t **g_mem_region;
+
+LXA_INSTANCE_LOCAL uint8_t                  g_mem_dirty[LXA_MEM_DIRTY_LINES];
+
+LXA_INSTANCE_LOCAL uint8_t  *g_ram;
+LXA_INSTANCE_LOCAL uint32_t  g_ram_size;
+
+/* =========================================================
+ * Invalid address space
+ * ========================================================= */
+
+static uint8_t _invalid_read8(uint32_t address)
+{
+    /*
+     * Invalid address - print warning but don't enter debugger.
+     * Some programs may read from invalid addresses intentionally
+     * (e.g., checking for expansion boards, sentinel values, etc.)
+     * Return 0 and let the program continue.
+     */
+    static LXA_INSTANCE_LOCAL int invalid_read_count = 0;
+    if (invalid_read_count < 10) {
+        uint32_t pc = m68k_get_reg(NULL, M68K_REG_PC);
+        printf("WARNING: mread8 at invalid address 0x%08x (PC=0x%08x)\n", 
+               address, pc);
+        printf("  D0=%08x D1=%08x D2=%08x D3=%08x D4=%08x D5=%08x D6=%08x D7=%08x\n",
+               m68k_get_reg(NULL, M68K_REG_D0), m68k_get_reg(NULL, M68K_REG_D1),
+               m68k_get_reg(NULL, M68K_REG_D2), m68k_get_reg(NULL, M68K_REG_D3),
+               m68k_get_reg(NULL, M68K_REG_D4), m68k_get_reg(NULL, M68K_REG_D5),
+               m68k_get_reg(NULL, M68K_REG_D6), m68k_get_reg(NULL, M68K_REG_D7));
+        printf("  A0=%08x A1=%08x A2=%08x A3=%08x A4=%08x A5=%08x A6=%08x A7=%08x\n",
+               m68k_get_reg(NULL, M68K_REG_A0), m68k_get_reg(NULL, M68K_REG_A1),
+               m68k_get_reg(NULL, M68K_REG_A2), m68k_get_reg(NULL, M68K_REG_A3),
+               m68k_get_reg(NULL, M68K_REG_A4), m68k_get_reg(NULL, M68K_REG_A5),
+               m68k_get_reg(NULL, M68K_REG_A6), m68k_get_reg(NULL, M68K_REG_A7));
+        /* Raw instruction bytes around PC */
+        {
+            uint32_t p;
+            printf("    bytes near PC:");
+            for (p = pc - 4; p < pc + 12; p++) {
+                if (lxa_mem_is_ram(p, 1)) {
+                    printf(" %s%02x", (p == pc) ? "[" : "", mread8(p));
+                }
+            }
+            printf("\n");
+        }
+        /* Stack trace - try to walk return addresses on stack */
+        {
+            uint32_t a7 = m68k_get_reg(NULL, M68K_REG_A7);
+            int i;
+            printf("  Stack (A7=%08x):", a7);
+            for (i = 0; i < 8; i++) {
+                if (lxa_mem_is_ram(a7 + i*4, 4)) {
+                    printf(" %08x", mread32(a7 + i*4));
+                }
+            }
+            printf("\n");
+        }
+        invalid_read_count++;
+        if (invalid_read_count == 10) {
+            printf("WARNING: suppressing further invalid read warnings\n");
+        }
+    }
+
+    return 0;
+}
+
+static void _invalid_write8(uint32_t address, uint8_t value)
+{
+    (void)value;
+    printf("ERROR: mwrite8 at invalid address 0x%08x\n", address);
+    _debug(m68k_get_reg(NULL, M68K_REG_PC));
+    assert (false);
+}
+
+static const lxa_mem_region_t s_region_invalid = {
+    "invalid", _invalid_read8, _invalid_write8, NULL, NULL
+};
+
+/* =========================================================
+ * Probe areas: no hardware present
+ * ========================================================= */
+
+static uint8_t _overflow_read8(uint32_t address)
+{
+    /* RAM overflow area (10MB - just before custom chips at 0xDFF000) - some apps allocate
+     * to end of RAM and overflow into what would be expansion RAM, slow RAM, or CIA areas.
+     * Return 0 for reads in this area. */
+    DPRINTF (LOG_DEBUG, "lxa: mread8 RAM overflow area 0x%08x -> 0x00\n", address);
+    return 0;
+}
+
+static void _overflow_write8(uint32_t address, uint8_t value)
+{
+    /* Silently ignore writes to the RAM overflow area. */
+    DPRINTF (LOG_DEBUG, "lxa: mwrite8 RAM overflow area 0x%08x <- 0x%02x (ignored)\n", address, value);
+}
+
+static const lxa_mem_region_t s_region_overflow = {
+    "overflow", _overflow_read8, _overflow_write8, NULL, NULL
+};
+
+static uint8_t _zorro3_read8(uint32_t address)
+{
+    /* 16MB-256MB range - Zorro-III expansion area, return 0xFF (no expansion)
+     * This covers addresses 0x01000000-0x0FFFFFFF which are used for:
+     * - Zorro-III memory expansion
+     * - Fast RAM on accelerator cards
+     * Returning 0xFF indicates no memory/expansion present.
+     */
+    (void)address;
+    return 0xFF;
+}
+
+static void _zorro3_write8(uint32_t address, uint8_t value)
+{
+    /* Zorro-III expansion area writes - ignore (no expansion present) */
+    DPRINTF (LOG_DEBUG, "lxa: mwrite8 Zorro-III area 0x%08x <- 0x%02x (ignored)\n", address, value);
+}
+
+static const lxa_mem_region_t s_region_zorro3 = {
+    "zorro3", _zorro3_read8, _zorro3_write8, NULL, NULL
+};
+
+static uint8_t _ranger_read8(uint32_t address)
+{
+    /* Ranger/expansion RAM area - return 0 (no expansion memory present) */
+    DPRINTF (LOG_DEBUG, "lxa: mread8 Ranger RAM area 0x%08x -> 0x00\n", address);
+    return 0;
+}
+
+static void _ranger_write8(uint32_t address, uint8_t value)
+{
+    /* Ranger/expansion RAM area writes - ignore (no expansion memory present) */
+    DPRINTF (LOG_DEBUG, "lxa: mwrite8 Ranger RAM area 0x%08x <- 0x%02x (ignored)\n", address, value);
+}
+
+static const lxa_mem_region_t s_region_ranger = {
+    "ranger", _ranger_read8, _ranger_write8, NULL, NULL
+};
+
+static uint8_t _zorro2_read8(uint32_t address)
+{
+    /* Zorro-II autoconfig space - return 0 (no boards) */
+    (void)address;
+    return 0;
+}
+
+static void _zorro2_write8(uint32_t address, uint8_t value)
+{
+    /* Zorro-II autoconfig area writes - ignore (no expansion boards) */
+    DPRINTF (LOG_DEBUG, "lxa: mwrite8 Zorro-II autoconfig area 0x%08x <- 0x%02x (ignored)\n", address, value);
+}
+
+static const lxa_mem_region_t s_region_zorro2 = {
+    "zorro2", _zorro2_read8, _zorro2_write8, NULL, NULL
+};
+
+static uint8_t _extrom_read8(uint32_t address)
+{
+    /* Extended ROM area (A3000/A4000) - return 0 to indicate no extended ROM */
+    (void)address;
+    return 0;
+}
+
+static void _extrom_write8(uint32_t address, uint8_t value)
+{
+    /* Extended ROM area writes - ignore (some apps probe this area) */
+    DPRINTF (LOG_DEBUG, "lxa: mwrite8 Extended ROM area 0x%08x <- 0x%02x (ignored)\n", address, value);
+}
+
+static const lxa_mem_region_t s_region_extrom = {
+    "extrom", _extrom_read8, _extrom_write8, NULL, NULL
+};
+
+/* ROM reads are served from the page pointer; only stores reach here. */
+static void _rom_write8(uint32_t address, uint8_t value)
+{
+    /* ROM area writes - ignore (ROM is read-only, some apps try to write for various reasons) */
+    DPRINTF (LOG_DEBUG, "lxa: mwrite8 ROM area 0x%08x <- 0x%02x (ignored)\n", address, value);
+}
+
+static const lxa_mem_region_t s_region_rom = {
+    "rom", _invalid_read8, _rom_write8, NULL, NULL
+};
+
+/* =========================================================
+ * Custom chips (page shared with the overflow area)
+ * ========================================================= */
+
+static uint8_t _custom_read8(uint32_t address)
+{
+    /* Phase 31: Custom chip area reads (Denise, Agnus, Paula) */
+    uint16_t reg;
+    uint8_t result = 0;
+
+    if (address < CUSTOM_START)
+        return _overflow_read8(address);
+
+    reg = address - CUSTOM_START;
+
+    /* Return sensible defaults for common read registers */
+    switch (reg & ~1) {  /* Use even address for word-aligned registers */
+        case CUSTOM_REG_VPOSR:    /* Vertical position - return 0 (line 0, PAL long frame) */
+            result = (reg & 1) ? 0x00 : 0x00;
+            break;
+        case CUSTOM_REG_VHPOSR:   /* Horiz/vert position - return 0 */
+            result = 0;
+            break;
+        case CUSTOM_REG_JOY0DAT:  /* Joystick 0 - no movement */
+            result = 0;
+            break;
+        case CUSTOM_REG_JOY1DAT:  /* Joystick 1 - no movement */
+            result = 0;
+            break;
+        case CUSTOM_REG_DMACONR:  /* DMA control read - return shadow register */
+            /* Bit 14 (BLTBUSY) is always 0 since our blitter executes synchronously */
+            result = (reg & 1) ? (g_dmacon & 0xFF) : ((g_dmacon >> 8) & 0xFF);
+            break;
+        case CUSTOM_REG_DENISEID: /* Denise ID - return 0xFC for ECS Denise */
+            result = (reg & 1) ? 0xFC : 0x00;
+            break;
+        case CUSTOM_REG_POTINP:   /* Pot port read - return 0xFF (no pots) */
+            result = 0xFF;
+            break;
+        case CUSTOM_REG_SERDATR:  /* Serial port data and status read */
+            /* Bit 13 (TBE) = Transmit Buffer Empty - always set (ready to transmit)
+             * Bit 12 (TSRE) = Transmit Shift Reg Empty - always set
+             * Bit 14 (RBF) = Receive Buffer Full - always 0 (no data received)
+             * Bit 11 (RBF) = not used
+             * Lower bits = received data byte (0)
+             */
+            {
+                uint16_t serdatr = 0x3000;  /* TBE + TSRE set */
+                result = (reg & 1) ? (serdatr & 0xFF) : ((serdatr >> 8) & 0xFF);
+            }
+            break;
+        case CUSTOM_REG_INTENAR:  /* Interrupt enable bits read */
+            result = (reg & 1) ? (g_intena & 0xFF) : ((g_intena >> 8) & 0xFF);
+            break;
+        case CUSTOM_REG_INTREQR:  /* Interrupt request bits read */
+            result = (reg & 1) ? (g_intreq & 0xFF) : ((g_intreq >> 8) & 0xFF);
+            break;
+        case CUSTOM_REG_ADKCONR:  /* Audio/disk control read - return 0 */
+            result = 0;
+            break;
+        default:
+            if ((reg & ~1) >= CUSTOM_REG_COLOR00 &&
+                (reg & ~1) <  CUSTOM_REG_COLOR00 + 64)
+            {
+                /* Color registers are write-only on real hardware (reads
+                 * return undefined), but exposing the shadow makes
+                 * automated tests trivial. */
+                uint32_t idx = ((reg & ~1) - CUSTOM_REG_COLOR00) >> 1;
+                uint16_t v = g_color_regs[idx];
+                result = (reg & 1) ? (v & 0xFF) : ((v >> 8) & 0xFF);
+            }
+            else
+            {
+                result = 0;
+            }
+            break;
+    }
+
+    DPRINTF (LOG_DEBUG, "lxa: mread8 CUSTOM (0x%08x/0x%03x) -> 0x%02x\n",
+            address, reg, result);
+    return result;
+}
+
+static void _custom_write8(uint32_t address, uint8_t value)
+{
+    if (address < CUSTOM_START)
+    {
+        _overflow_write8(address, value);
+        return;
+    }
+
+    /* Custom chip area - handle via custom write handler (byte writes are rare but possible) */
+    DPRINTF (LOG_DEBUG, "lxa: mwrite8 custom area 0x%08x <- 0x%02x (ignored)\n", address, value);
+}
+
+static void _custom_write16(uint32_t address, uint16_t value)
+{
+    if (address < CUSTOM_START)
+    {
+        _custom_write8(address, (value >> 8) & 0xff);
+        _custom_write8(address + 1, value & 0xff);
+        return;
+    }
+
+    _handle_custom_write (address & 0xfff, value);
+}
+
+static void _custom_write32(uint32_t address, uint32_t value)
+{
+    if (address < CUSTOM_START)
+    {
+        _custom_write8(address,     (value >> 24) & 0xff);
+        _custom_write8(address + 1, (value >> 16) & 0xff);
+        _custom_write8(address + 2, (value >>  8) & 0xff);
+        _custom_write8(address + 3, value & 0xff);
+        return;
+    }
+
+    /*
+     * Custom chip area: 32-bit writes must be handled as two 16-bit writes
+     * (high word first, low word second) because the custom chip register
+     * handler processes 16-bit register writes.  This is critical for
+     * blitter pointer registers (BLTAPT, BLTBPT, BLTCPT, BLTDPT) which
+     * are written as 32-bit values by apps but stored as high/low halves
+     * in adjacent 16-bit registers.
+     */
+    _handle_custom_write ((address    ) & 0xfff, (value >> 16) & 0xffff);
+    _handle_custom_write ((address + 2) & 0xfff, value & 0xffff);
+}
+
+static const lxa_mem_region_t s_region_custom = {
+    "custom", _custom_read8, _custom_write8, _custom_write16, _custom_write32
+};
+
+/* =========================================================
+ * Guest RAM
+ * ========================================================= */
+
+/* The page tables are per instance, 1.5 MB together */
+static bool _alloc_page_tables(void)
+{
+    if (g_mem_read_page)
+        return true;
+
+    g_mem_read_page  = calloc(LXA_MEM_NUM_PAGES, sizeof(*g_mem_read_page));
+    g_mem_write_page = calloc(LXA_MEM_NUM_PAGES, sizeof(*g_mem_write_page));
+    g_mem_region     = calloc(LXA_MEM_NUM_PAGES, sizeof(*g_mem_region));
+    if (g_mem_read_page && g_mem_write_page && g_mem_region)
+        return true;
+
+    lxa_mem_shutdown();
+    return false;
+}
+
+bool lxa_mem_alloc_ram(void)
+{
+    void *p;
+
+    if (!_alloc_page_tables())
+        return false;
+
+    lxa_mem_free_ram();
+    memset(g_mem_dirty, 1, sizeof(g_mem_dirty));
+
+    p = mmap(NULL, RAM_SIZE, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED)
+        return false;
+
+    g_ram      = p;
+    g_ram_size = RAM_SIZE;
+    return true;
+}
+
+void lxa_mem_free_ram(void)
+{
+    if (g_ram)
+        munmap(g_ram, g_ram_size);
+
+    g_ram = NULL;
+    g_ram_size = 0;
+}
+
+void lxa_mem_shutdown(void)
+{
+    lxa_mem_free_ram();
+
+    free(g_mem_read_page);
+    free(g_mem_write_page);
+    free(g_mem_region);
+    g_mem_read_page  = NULL;
+    g_mem_write_page = NULL;
+    g_mem_region     = NULL;
+}
+
+void lxa_mem_clear_ram(void)
+{
+    /* MADV_DONTNEED on a private anonymous mapping drops the pages; the
+     * next access sees fresh zero pages.  Unlike memset() this does not
+     * commit the whole guest RAM on every reset. */
+    if (g_ram)
+        madvise(g_ram, g_ram_size, MADV_DONTNEED);
+
+    memset(g_mem_dirty, 1, sizeof(g_mem_dirty));
+}
+
+/* =========================================================
+ * Dirty map
+ * ========================================================= */
+
+void lxa_mem_mark_dirty_range(uint32_t address, uint32_t size)
+{
+    uint32_t line, last;
+
+    if (size == 0)
+        return;
+    if (size >= 0x1000000)
+    {
+        memset(g_mem_dirty, 1, sizeof(g_mem_dirty));
+        return;
+    }
+
+    line = (address & 0xffffff) >> LXA_MEM_DIRTY_SHIFT;
+    last = ((address + size - 1) & 0xffffff) >> LXA_MEM_DIRTY_SHIFT;
+    for (;;)
+    {
+        g_mem_dirty[line] = 1;
+        if (line == last)
+            break;
+        line = (line + 1) & (LXA_MEM_DIRTY_LINES - 1);
+    }
+}
+
+bool lxa_mem_is_dirty(uint32_t address, uint32_t size)
+{
+    uint32_t line, last;
+
+    if (size == 0)
+        return false;
+    if (size >= 0x1000000)
+        return true;
+
+    line = (address & 0xffffff) >> LXA_MEM_DIRTY_SHIFT;
+    last = ((address + size - 1) & 0xffffff) >> LXA_MEM_DIRTY_SHIFT;
+    for (;;)
+    {
+        if (g_mem_dirty[line])
+            return true;
+        if (line == last)
+            return false;
+        line = (line + 1) & (LXA_MEM_DIRTY_LINES - 1);
+    }
+}
+
+void lxa_mem_clear_dirty(uint32_t address, uint32_t size)
+{
+    uint32_t line, last;
+
+    if (size == 0)
+        return;
+    if (size >= 0x1000000)
+    {
+        memset(g_mem_dirty, 0, sizeof(g_mem_dirty));
+        return;
+    }
+
+    line = (address & 0xffffff) >> LXA_MEM_DIRTY_SHIFT;
+    last = ((address + size - 1) & 0xffffff) >> LXA_MEM_DIRTY_SHIFT;
+    for (;;)
+    {
+        g_mem_dirty[line] = 0;
+        if (line == last)
+            break;
+        line = (line + 1) & (LXA_MEM_DIRTY_LINES - 1);
+    }
+}
+
+/* =========================================================
+ * Map construction
+ * ========================================================= */
+
+void lxa_mem_map_host(uint32_t start, uint32_t size, uint8_t *host, bool writable)
+{
+    uint32_t page;
+
+    assert((start & LXA_MEM_PAGE_MASK) == 0 && (size & LXA_MEM_PAGE_MASK) == 0);
+
+    for (page = 0; page < (size >> LXA_MEM_PAGE_SHIFT); page++)
+    {
+        uint32_t p = (start >> LXA_MEM_PAGE_SHIFT) + page;
+
+        g_mem_read_page[p]  = host + ((size_t)page << LXA_MEM_PAGE_SHIFT);
+        g_mem_write_page[p] = writable ? g_mem_read_page[p] : NULL;
+    }
+
+    m68k_invalidate_fetch();
+}
+
+void lxa_mem_map_region(uint32_t start, uint32_t size, const lxa_mem_region_t *region)
+{
+    uint32_t page;
+
+    assert((start & LXA_MEM_PAGE_MASK) == 0 && (size & LXA_MEM_PAGE_MASK) == 0);
+
+    for (page = 0; page < (size >> LXA_MEM_PAGE_SHIFT); page++)
+    {
+        uint32_t p = (start >> LXA_MEM_PAGE_SHIFT) + page;
+
+        g_mem_read_page[p]  = NULL;
+        g_mem_write_page[p] = NULL;
+        g_mem_region[p]     = region;
+    }
+
+    m68k_invalidate_fetch();
+}
+
+/*
+ * Direct instruction fetch (see m68k_set_fetch_callback()).
+ * The fetch window is the host page the PC is in; handler-backed pages
+ * return NULL so the CPU falls back to m68k_read_memory_16/32().
+ */
+const unsigned char *lxa_mem_fetch_page(unsigned int address, unsigned int *base, unsigned int *size)
+{
+    *base = address & ~LXA_MEM_PAGE_MASK;
+    *size = LXA_MEM_PAGE_SIZE;
+
+    return g_mem_read_page[address >> LXA_MEM_PAGE_SHIFT];
+}
+
+/*
+ * Bulk access for copy/fill loops (see m68k_set_host_memory_callback()).
+ * Adjacent pages are merged as long as they are backed by one contiguous
+ * host block, so a copy may span RAM pages but never leaves plain memory.
+ */
+unsigned char *lxa_mem_host_range(unsigned int address, unsigned int *size, int write)
+{
+    uint8_t **table = write ? g_mem_write_page : g_mem_read_page;
+    uint32_t  page = address >> LXA_MEM_PAGE_SHIFT;
+    uint8_t  *host = table[page];
+    uint32_t  avail;
+
+    if (host == NULL)
+    {
+        *size = 0;
+        return NULL;
+    }
+
+    avail = LXA_MEM_PAGE_SIZE - (address & LXA_MEM_PAGE_MASK);
+    while (avail < *size && page + 1 < LXA_MEM_NUM_PAGES &&
+           table[page + 1] == table[page] + LXA_MEM_PAGE_SIZE)
+    {
+        page++;
+        avail += LXA_MEM_PAGE_SIZE;
+    }
+
+    if (avail < *size)
+        *size = avail;
+
+    /*
+     * The caller is about to store into the whole range.  Its
+     * host stores must not fault on watchpoint pages either: report them
+     * like lxa_mem_host_write() does.
+     */
+    if (write)
+    {
+        lxa_mem_mark_dirty_range(address, *size);
+        if (__builtin_expect(g_watch_count != 0, 0))
+            lxa_watch_host_write(address, *size);
+    }
+
+    return host + (address & LXA_MEM_PAGE_MASK);
+}
+
+void lxa_mem_init(void)
+{
+    uint32_t p;
+
+    if (!g_ram)
+        lxa_mem_alloc_ram();
+
+    for (p = 0; p < LXA_MEM_NUM_PAGES; p++)
+    {
+        g_mem_read_page[p]  = NULL;
+        g_mem_write_page[p] = NULL;
+        g_mem_region[p]     = &s_region_invalid;
+    }
+
+    lxa_mem_map_host  (RAM_START, g_ram_size, g_ram, true);
+    lxa_mem_map_region(g_ram_size, (CUSTOM_START & ~LXA_MEM_PAGE_MASK) - g_ram_size, &s_region_overflow);
+    lxa_mem_map_region(CUSTOM_START & ~LXA_MEM_PAGE_MASK, LXA_MEM_PAGE_SIZE, &s_region_custom);
+    lxa_mem_map_region(RANGER_START, RANGER_END - RANGER_START + 1, &s_region_ranger);
+    lxa_mem_map_region(ZORRO2_AUTOCONFIG_START, ZORRO2_AUTOCONFIG_END - ZORRO2_AUTOCONFIG_START + 1, &s_region_zorro2);
+    lxa_mem_map_region(EXTROM_START, EXTROM_END - EXTROM_START + 1, &s_region_extrom);
+    lxa_mem_map_region(ROM_START, ROM_SIZE, &s_region_rom);
+    lxa_mem_map_host  (ROM_START, ROM_SIZE, g_rom, false);
+    lxa_mem_map_region(0x01000000, 0x10000000 - 0x01000000, &s_region_zorro3);
+}
+
+/* =========================================================
+ * Out-of-line access paths
+ * ========================================================= */
+
+uint16_t lxa_mem_read16_slow(uint32_t address)
+{
+    uint16_t result = (uint16_t)mread8 (address) << 8;
+    result |= mread8 (address + 1);
+    return result;
+}
+
+uint32_t lxa_mem_read32_slow(uint32_t address)
+{
+    uint32_t result = (uint32_t)mread8 (address)     << 24;
+    result |=         (uint32_t)mread8 (address + 1) << 16;
+    result |=         (uint32_t)mread8 (address + 2) <<  8;
+    result |=         (uint32_t)mread8 (address + 3);
+    return result;
+}
+
+void lxa_mem_write16_slow(uint32_t address, uint16_t value)
+{
+    const lxa_mem_region_t *region = g_mem_region[address >> LXA_MEM_PAGE_SHIFT];
+
+    if (!g_mem_write_page[address >> LXA_MEM_PAGE_SHIFT] && region->write16)
+    {
+        region->write16(address, value);
+        return;
+    }
+
+    mwrite8 (address  , (value >> 8) & 0xff);
+    mwrite8 (address+1, value & 0xff);
+}
+
+void lxa_mem_write32_slow(uint32_t address, uint32_t value)
+{
+    const lxa_mem_region_t *region = g_mem_region[address >> LXA_MEM_PAGE_SHIFT];
+
+    if (!g_mem_write_page[address >> LXA_MEM_PAGE_SHIFT] && region->write32)
+    {
+        region->write32(address, value);
+        return;
+    }
+
+    mwrite8 (address  , (value >>24) & 0xff);
+    mwrite8 (address+1, (value >>16) & 0xff);
+    mwrite8 (address+2, (value >> 8) & 0xff);
+    mwrite8 (address+3, value & 0xff);
+}
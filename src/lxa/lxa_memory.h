@@ -1,325 +1,262 @@
 /*
- * lxa_memory.h - Inline memory read/write helpers.
+ * lxa_memory.h - Guest memory map and inline read/write helpers.
  *
- * Defines mread8() and mwrite8() as static inline so they can be inlined
- * into any translation unit that needs them.  Include this header (after
- * lxa_internal.h) in every file that calls these functions directly.
+ * Defines mread8()/mwrite8() and their 16/32-bit counterparts as static
+ * inline so they can be inlined into any translation unit that needs
+ * them.  Include this header (after lxa_internal.h) in every file that
+ * calls these functions directly.
  *
  * Phase 125: lxa.c decomposition.
  * Phase 127: fast-path 16/32-bit helpers for RAM and ROM using bswap.
+ * RAM writes notify the CPU block cache (m68kcache.h).
+ * 64 KB page table replaces the mread8()/mwrite8() if-chains.
+ * Guest RAM is sized at runtime and backed by anonymous mmap().
+ * RAM stores mark 256-byte lines in a dirty map (display sync).
+ *
+ * Every 64 KB page of the 32-bit guest address space has three entries:
+ *
+ *   g_mem_read_page[p]   host pointer to the page's bytes, or NULL
+ *   g_mem_write_page[p]  host pointer for stores, or NULL (e.g. ROM)
+ *   g_mem_region[p]      handler set used when the pointer is NULL
+ *
+ * so any guest access is one table lookup: RAM and ROM are plain loads and
+ * stores, everything else (custom chips, probe areas, invalid space) goes
+ * through the region's handlers.  The default Amiga map is built by
+ * lxa_mem_init() in lxa_memory.c; further regions (fast RAM, RTG VRAM,
+ * mapped devices) are added with lxa_mem_map_host()/lxa_mem_map_region().
  */
 
 #ifndef LXA_MEMORY_H
 #define LXA_MEMORY_H
 
 #include "lxa_internal.h"
+#include "m68kcache.h"
+#include "lxa_watch.h"
 #include <string.h>  /* memcpy */
 
+#define LXA_MEM_PAGE_SHIFT  16
+#define LXA_MEM_PAGE_SIZE   (1u << LXA_MEM_PAGE_SHIFT)
+#define LXA_MEM_PAGE_MASK   (LXA_MEM_PAGE_SIZE - 1)
+#define LXA_MEM_NUM_PAGES   (1u << (32 - LXA_MEM_PAGE_SHIFT))
+
+typedef struct lxa_mem_region_s
+{
+    const char *name;
+    uint8_t   (*read8)(uint32_t address);
+    void      (*write8)(uint32_t address, uint8_t value);
+    /* Optional word/long store handlers (custom chip registers are 16 bit
+     * wide); NULL means the access is split into byte stores. */
+    void      (*write16)(uint32_t address, uint16_t value);
+    void      (*write32)(uint32_t address, uint32_t value);
+} lxa_mem_region_t;
+
+/* LXA_MEM_NUM_PAGES entries each, allocated by lxa_mem_alloc_ram() */
+extern LXA_INSTANCE_LOCAL uint8_t                **g_mem_read_page;
+extern LXA_INSTANCE_LOCAL uint8_t                **g_mem_write_page;
+extern LXA_INSTANCE_LOCAL const lxa_mem_region_t **g_mem_region;
+
 /*
- * Fast-path helpers: read/write 16 or 32 bits from g_ram[] (big-endian m68k
- * to little-endian host) without going through four mread8() calls.
- * memcpy is used instead of a raw pointer cast to handle unaligned accesses
- * safely (the compiler will emit a single load instruction on x86-64).
+ * Write-tracked dirty map.  One byte per 256-byte line of the
+ * 24-bit (chip) address space is set by every store into host-backed
+ * memory: the mwrite*() fast paths, host writes reported through
+ * lxa_mem_host_write() and bulk ranges handed out by lxa_mem_host_range().
+ * Bytes instead of bits keep the store barrier a plain byte store.  The
+ * VBlank display sync reads it to convert only the bitplane rows that
+ * changed and clears it afterwards.  Stores above 16 MB (registered host
+ * regions) alias onto the low lines, which only costs a spurious conversion.
  */
+#define LXA_MEM_DIRTY_SHIFT 8
+#define LXA_MEM_DIRTY_LINES (1u << (24 - LXA_MEM_DIRTY_SHIFT))
 
-static inline uint16_t mread16_ram(uint32_t addr)
+extern LXA_INSTANCE_LOCAL uint8_t g_mem_dirty[LXA_MEM_DIRTY_LINES];
+
+static inline void lxa_mem_mark_dirty(uint32_t address, uint32_t size)
+{
+    g_mem_dirty[(address & 0xffffff) >> LXA_MEM_DIRTY_SHIFT] = 1;
+    g_mem_dirty[((address + size - 1) & 0xffffff) >> LXA_MEM_DIRTY_SHIFT] = 1;
+}
+
+/* Mark [address, address + size) dirty (any length). */
+void lxa_mem_mark_dirty_range(uint32_t address, uint32_t size);
+
+/* True if any line overlapping [address, address + size) was stored to. */
+bool lxa_mem_is_dirty(uint32_t address, uint32_t size);
+
+/* Forget the stores to [address, address + size). */
+void lxa_mem_clear_dirty(uint32_t address, uint32_t size);
+
+/*
+ * Allocate the RAM_SIZE bytes of guest chip RAM at RAM_START as an
+ * anonymous mapping, so pages the guest never touches cost no host
+ * memory.  Replaces any previous allocation; call lxa_mem_init() after.
+ * The first call of an instance also allocates the page tables.
+ */
+bool lxa_mem_alloc_ram(void);
+
+/* Release guest RAM (lxa_shutdown()). */
+void lxa_mem_free_ram(void);
+
+/* Release guest RAM and the page tables of this instance. */
+void lxa_mem_shutdown(void);
+
+/* Zero all guest RAM and hand its pages back to the host. */
+void lxa_mem_clear_ram(void);
+
+/* Build the default Amiga memory map (RAM, ROM, custom chips, probe areas). */
+void lxa_mem_init(void);
+
+/*
+ * Map [start, start + size) onto host memory.  start and size must be
+ * multiples of LXA_MEM_PAGE_SIZE.  Read-only mappings keep the page's
+ * region handlers for stores.
+ */
+void lxa_mem_map_host(uint32_t start, uint32_t size, uint8_t *host, bool writable);
+
+/* Route [start, start + size) through a handler set (64 KB granularity). */
+void lxa_mem_map_region(uint32_t start, uint32_t size, const lxa_mem_region_t *region);
+
+/* Fetch window callback for the CPU core (m68k_set_fetch_callback()). */
+const unsigned char *lxa_mem_fetch_page(unsigned int address, unsigned int *base, unsigned int *size);
+
+/* Bulk access callback for the CPU core (m68k_set_host_memory_callback()). */
+unsigned char *lxa_mem_host_range(unsigned int address, unsigned int *size, int write);
+
+/* Out-of-line paths for page-crossing and handler-backed accesses. */
+uint16_t lxa_mem_read16_slow(uint32_t address);
+uint32_t lxa_mem_read32_slow(uint32_t address);
+void     lxa_mem_write16_slow(uint32_t address, uint16_t value);
+void     lxa_mem_write32_slow(uint32_t address, uint32_t value);
+
+/* True if [address, address + size) lies in guest RAM. */
+static inline bool lxa_mem_is_ram(uint32_t address, uint32_t size)
+{
+    return address < g_ram_size && size <= g_ram_size - address;
+}
+
+/*
+ * Big-endian loads/stores on host memory.  memcpy is used instead of a
+ * raw pointer cast to handle unaligned accesses safely (the compiler will
+ * emit a single load instruction on x86-64).
+ */
+
+static inline uint16_t lxa_mem_load16(const uint8_t *p)
 {
     uint16_t v;
-    memcpy(&v, &g_ram[addr], 2);
+    memcpy(&v, p, 2);
     return __builtin_bswap16(v);
 }
 
-static inline uint32_t mread32_ram(uint32_t addr)
+static inline uint32_t lxa_mem_load32(const uint8_t *p)
 {
     uint32_t v;
-    memcpy(&v, &g_ram[addr], 4);
+    memcpy(&v, p, 4);
     return __builtin_bswap32(v);
 }
 
-static inline void mwrite16_ram(uint32_t addr, uint16_t value)
+static inline void lxa_mem_store16(uint8_t *p, uint16_t value)
 {
     uint16_t v = __builtin_bswap16(value);
-    memcpy(&g_ram[addr], &v, 2);
+    memcpy(p, &v, 2);
 }
 
-static inline void mwrite32_ram(uint32_t addr, uint32_t value)
+static inline void lxa_mem_store32(uint8_t *p, uint32_t value)
 {
     uint32_t v = __builtin_bswap32(value);
-    memcpy(&g_ram[addr], &v, 4);
+    memcpy(p, &v, 4);
 }
 
-static inline uint16_t mread16_rom(uint32_t addr)
+static inline uint8_t mread8(uint32_t address)
 {
-    uint16_t v;
-    memcpy(&v, &g_rom[addr], 2);
-    return __builtin_bswap16(v);
-}
+    const uint8_t *page = g_mem_read_page[address >> LXA_MEM_PAGE_SHIFT];
 
-static inline uint32_t mread32_rom(uint32_t addr)
-{
-    uint32_t v;
-    memcpy(&v, &g_rom[addr], 4);
-    return __builtin_bswap32(v);
+    if (__builtin_expect(page != NULL, 1))
+        return page[address & LXA_MEM_PAGE_MASK];
+
+    return g_mem_region[address >> LXA_MEM_PAGE_SHIFT]->read8(address);
 }
 
-static inline uint8_t mread8(uint32_t address)
+static inline void mwrite8(uint32_t address, uint8_t value)
 {
-    /* Note: Reading from address 0 is valid - it's chip RAM on Amiga.
-     * The previous NULL pointer check was removed as it caused false
-     * positives with applications that legitimately read from low memory.
-     */
+    uint8_t *page = g_mem_write_page[address >> LXA_MEM_PAGE_SHIFT];
 
-    if (__builtin_expect((address >= RAM_START) && (address <= RAM_END), 1))
-    {
-        uint32_t addr = address - RAM_START;
-        return g_ram[addr];
-    }
-    else if (__builtin_expect((address >= ROM_START) && (address <= ROM_END), 0))
-    {
-        uint32_t addr = address - ROM_START;
-        return g_rom[addr];
-    }
-    else if ((address >= EXTROM_START) && (address <= EXTROM_END))
-    {
-        /* Extended ROM area (A3000/A4000) - return 0 to indicate no extended ROM */
-        return 0;
-    }
-    else if ((address >= 0x00A00000) && (address < CUSTOM_START))
-    {
-        /* RAM overflow area (10MB - just before custom chips at 0xDFF000) - some apps allocate
-         * to end of RAM and overflow into what would be expansion RAM, slow RAM, or CIA areas.
-         * Return 0 for reads in this area. */
-        DPRINTF (LOG_DEBUG, "lxa: mread8 RAM overflow area 0x%08x -> 0x00\n", address);
-        return 0;
-    }
-    else if ((address >= 0x01000000) && (address <= 0x0FFFFFFF))
-    {
-        /* 16MB-256MB range - Zorro-III expansion area, return 0xFF (no expansion)
-         * This covers addresses 0x01000000-0x0FFFFFFF which are used for:
-         * - Zorro-III memory expansion
-         * - Fast RAM on accelerator cards
-         * Returning 0xFF indicates no memory/expansion present.
-         */
-        return 0xFF;
-    }
-    else if ((address >= ZORRO2_AUTOCONFIG_START) && (address <= ZORRO2_AUTOCONFIG_END))
-    {
-        /* Zorro-II autoconfig space - return 0 (no boards) */
-        return 0;
-    }
-    else if ((address >= SLOWRAM_START) && (address <= SLOWRAM_END))
-    {
-        /* Slow RAM / Ranger RAM area - return 0 (no expansion memory present) */
-        DPRINTF (LOG_DEBUG, "lxa: mread8 Slow RAM area 0x%08x -> 0x00\n", address);
-        return 0;
-    }
-    else if ((address >= RANGER_START) && (address <= RANGER_END))
-    {
-        /* Ranger/expansion RAM area - return 0 (no expansion memory present) */
-        DPRINTF (LOG_DEBUG, "lxa: mread8 Ranger RAM area 0x%08x -> 0x00\n", address);
-        return 0;
-    }
-    else if ((address >= CIA_START) && (address <= CIA_END))
+    if (__builtin_expect(page != NULL, 1))
     {
-        /* CIA chip area - return sensible defaults
-         * 0xFF = all bits high = no buttons pressed, no keys, inactive signals
-         */
-        DPRINTF (LOG_DEBUG, "lxa: mread8 CIA area 0x%08x -> 0xFF\n", address);
-        return 0xff;
-    }
-    else if ((address >= CUSTOM_START) && (address <= CUSTOM_END))
-    {
-        /* Phase 31: Custom chip area reads (Denise, Agnus, Paula) */
-        uint16_t reg = address - CUSTOM_START;
-        uint8_t result = 0;
-        
-        /* Return sensible defaults for common read registers */
-        switch (reg & ~1) {  /* Use even address for word-aligned registers */
-            case CUSTOM_REG_VPOSR:    /* Vertical position - return 0 (line 0, PAL long frame) */
-                result = (reg & 1) ? 0x00 : 0x00;
-                break;
-            case CUSTOM_REG_VHPOSR:   /* Horiz/vert position - return 0 */
-                result = 0;
-                break;
-            case CUSTOM_REG_JOY0DAT:  /* Joystick 0 - no movement */
-                result = 0;
-                break;
-            case CUSTOM_REG_JOY1DAT:  /* Joystick 1 - no movement */
-                result = 0;
-                break;
-            case CUSTOM_REG_DMACONR:  /* DMA control read - return shadow register */
-                /* Bit 14 (BLTBUSY) is always 0 since our blitter executes synchronously */
-                result = (reg & 1) ? (g_dmacon & 0xFF) : ((g_dmacon >> 8) & 0xFF);
-                break;
-            case CUSTOM_REG_DENISEID: /* Denise ID - return 0xFC for ECS Denise */
-                result = (reg & 1) ? 0xFC : 0x00;
-                break;
-            case CUSTOM_REG_POTINP:   /* Pot port read - return 0xFF (no pots) */
-                result = 0xFF;
-                break;
-            case CUSTOM_REG_SERDATR:  /* Serial port data and status read */
-                /* Bit 13 (TBE) = Transmit Buffer Empty - always set (ready to transmit)
-                 * Bit 12 (TSRE) = Transmit Shift Reg Empty - always set
-                 * Bit 14 (RBF) = Receive Buffer Full - always 0 (no data received)
-                 * Bit 11 (RBF) = not used
-                 * Lower bits = received data byte (0)
-                 */
-                {
-                    uint16_t serdatr = 0x3000;  /* TBE + TSRE set */
-                    result = (reg & 1) ? (serdatr & 0xFF) : ((serdatr >> 8) & 0xFF);
-                }
-                break;
-            case CUSTOM_REG_INTENAR:  /* Interrupt enable bits read */
-                result = (reg & 1) ? (g_intena & 0xFF) : ((g_intena >> 8) & 0xFF);
-                break;
-            case CUSTOM_REG_INTREQR:  /* Interrupt request bits read */
-                result = (reg & 1) ? (g_intreq & 0xFF) : ((g_intreq >> 8) & 0xFF);
-                break;
-            case CUSTOM_REG_ADKCONR:  /* Audio/disk control read - return 0 */
-                result = 0;
-                break;
-            default:
-                if ((reg & ~1) >= CUSTOM_REG_COLOR00 &&
-                    (reg & ~1) <  CUSTOM_REG_COLOR00 + 64)
-                {
-                    /* Color registers are write-only on real hardware (reads
-                     * return undefined), but exposing the shadow makes
-                     * automated tests trivial. */
-                    uint32_t idx = ((reg & ~1) - CUSTOM_REG_COLOR00) >> 1;
-                    uint16_t v = g_color_regs[idx];
-                    result = (reg & 1) ? (v & 0xFF) : ((v >> 8) & 0xFF);
-                }
-                else
-                {
-                    result = 0;
-                }
-                break;
-        }
-        
-        DPRINTF (LOG_DEBUG, "lxa: mread8 CUSTOM (0x%08x/0x%03x) -> 0x%02x\n",
-                address, reg, result);
-        return result;
-    }
-    else
-    {
-        /* 
-         * Invalid address - print warning but don't enter debugger.
-         * Some programs may read from invalid addresses intentionally
-         * (e.g., checking for expansion boards, sentinel values, etc.)
-         * Return 0 and let the program continue.
-         */
-        static int invalid_read_count = 0;
-        if (invalid_read_count < 10) {
-            uint32_t pc = m68k_get_reg(NULL, M68K_REG_PC);
-            printf("WARNING: mread8 at invalid address 0x%08x (PC=0x%08x)\n", 
-                   address, pc);
-            printf("  D0=%08x D1=%08x D2=%08x D3=%08x D4=%08x D5=%08x D6=%08x D7=%08x\n",
-                   m68k_get_reg(NULL, M68K_REG_D0), m68k_get_reg(NULL, M68K_REG_D1),
-                   m68k_get_reg(NULL, M68K_REG_D2), m68k_get_reg(NULL, M68K_REG_D3),
-                   m68k_get_reg(NULL, M68K_REG_D4), m68k_get_reg(NULL, M68K_REG_D5),
-                   m68k_get_reg(NULL, M68K_REG_D6), m68k_get_reg(NULL, M68K_REG_D7));
-            printf("  A0=%08x A1=%08x A2=%08x A3=%08x A4=%08x A5=%08x A6=%08x A7=%08x\n",
-                   m68k_get_reg(NULL, M68K_REG_A0), m68k_get_reg(NULL, M68K_REG_A1),
-                   m68k_get_reg(NULL, M68K_REG_A2), m68k_get_reg(NULL, M68K_REG_A3),
-                   m68k_get_reg(NULL, M68K_REG_A4), m68k_get_reg(NULL, M68K_REG_A5),
-                   m68k_get_reg(NULL, M68K_REG_A6), m68k_get_reg(NULL, M68K_REG_A7));
-            /* Raw instruction bytes around PC */
-            {
-                uint32_t p;
-                printf("    bytes near PC:");
-                for (p = pc - 4; p < pc + 12; p++) {
-                    if (p >= RAM_START && p <= RAM_END) {
-                        printf(" %s%02x", (p == pc) ? "[" : "", g_ram[p - RAM_START]);
-                    }
-                }
-                printf("\n");
-            }
-            /* Stack trace - try to walk return addresses on stack */
-            {
-                uint32_t a7 = m68k_get_reg(NULL, M68K_REG_A7);
-                int i;
-                printf("  Stack (A7=%08x):", a7);
-                for (i = 0; i < 8; i++) {
-                    if (a7 + i*4 + 3 <= RAM_END && a7 + i*4 >= RAM_START) {
-                        uint32_t v = (g_ram[a7 + i*4 - RAM_START] << 24) |
-                                     (g_ram[a7 + i*4 - RAM_START + 1] << 16) |
-                                     (g_ram[a7 + i*4 - RAM_START + 2] << 8) |
-                                     (g_ram[a7 + i*4 - RAM_START + 3]);
-                        printf(" %08x", v);
-                    }
-                }
-                printf("\n");
-            }
-            invalid_read_count++;
-            if (invalid_read_count == 10) {
-                printf("WARNING: suppressing further invalid read warnings\n");
-            }
-        }
+        m68k_cache_note_write(address, 1);
+        lxa_mem_mark_dirty(address, 1);
+        page[address & LXA_MEM_PAGE_MASK] = value;
+        return;
     }
 
-    return 0;
+    g_mem_region[address >> LXA_MEM_PAGE_SHIFT]->write8(address, value);
 }
 
-static inline void mwrite8(uint32_t address, uint8_t value)
+static inline uint16_t mread16(uint32_t address)
 {
-    if (__builtin_expect((address >= RAM_START) && (address <= RAM_END), 1))
-    {
-        uint32_t addr = address - RAM_START;
-        g_ram[addr] = value;
-    }
-    else if ((address >= 0x00A00000) && (address < CUSTOM_START))
-    {
-        /* RAM overflow area (10MB - just before custom chips at 0xDFF000) - some apps allocate
-         * to end of RAM and overflow into what would be expansion RAM, slow RAM, or CIA areas.
-         * Silently ignore these writes. */
-        DPRINTF (LOG_DEBUG, "lxa: mwrite8 RAM overflow area 0x%08x <- 0x%02x (ignored)\n", address, value);
-    }
-    else if ((address >= 0x01000000) && (address <= 0x0FFFFFFF))
-    {
-        /* Zorro-III expansion area writes - ignore (no expansion present) */
-        DPRINTF (LOG_DEBUG, "lxa: mwrite8 Zorro-III area 0x%08x <- 0x%02x (ignored)\n", address, value);
-    }
-    else if ((address >= SLOWRAM_START) && (address <= SLOWRAM_END))
-    {
-        /* Slow RAM area writes - ignore (no expansion memory present) */
-        DPRINTF (LOG_DEBUG, "lxa: mwrite8 Slow RAM area 0x%08x <- 0x%02x (ignored)\n", address, value);
-    }
-    else if ((address >= RANGER_START) && (address <= RANGER_END))
-    {
-        /* Ranger/expansion RAM area writes - ignore (no expansion memory present) */
-        DPRINTF (LOG_DEBUG, "lxa: mwrite8 Ranger RAM area 0x%08x <- 0x%02x (ignored)\n", address, value);
-    }
-    else if ((address >= ZORRO2_AUTOCONFIG_START) && (address <= ZORRO2_AUTOCONFIG_END))
-    {
-        /* Zorro-II autoconfig area writes - ignore (no expansion boards) */
-        DPRINTF (LOG_DEBUG, "lxa: mwrite8 Zorro-II autoconfig area 0x%08x <- 0x%02x (ignored)\n", address, value);
-    }
-    else if ((address >= EXTROM_START) && (address <= EXTROM_END))
-    {
-        /* Extended ROM area writes - ignore (some apps probe this area) */
-        DPRINTF (LOG_DEBUG, "lxa: mwrite8 Extended ROM area 0x%08x <- 0x%02x (ignored)\n", address, value);
-    }
-    else if ((address >= ROM_START) && (address <= ROM_END))
-    {
-        /* ROM area writes - ignore (ROM is read-only, some apps try to write for various reasons) */
-        DPRINTF (LOG_DEBUG, "lxa: mwrite8 ROM area 0x%08x <- 0x%02x (ignored)\n", address, value);
-    }
-    else if ((address >= CIA_START) && (address <= CIA_END))
+    const uint8_t *page = g_mem_read_page[address >> LXA_MEM_PAGE_SHIFT];
+
+    if (__builtin_expect(page != NULL && (address & LXA_MEM_PAGE_MASK) <= LXA_MEM_PAGE_MASK - 1, 1))
+        return lxa_mem_load16(page + (address & LXA_MEM_PAGE_MASK));
+
+    return lxa_mem_read16_slow(address);
+}
+
+static inline uint32_t mread32(uint32_t address)
+{
+    const uint8_t *page = g_mem_read_page[address >> LXA_MEM_PAGE_SHIFT];
+
+    if (__builtin_expect(page != NULL && (address & LXA_MEM_PAGE_MASK) <= LXA_MEM_PAGE_MASK - 3, 1))
+        return lxa_mem_load32(page + (address & LXA_MEM_PAGE_MASK));
+
+    return lxa_mem_read32_slow(address);
+}
+
+static inline void mwrite16(uint32_t address, uint16_t value)
+{
+    uint8_t *page = g_mem_write_page[address >> LXA_MEM_PAGE_SHIFT];
+
+    if (__builtin_expect(page != NULL && (address & LXA_MEM_PAGE_MASK) <= LXA_MEM_PAGE_MASK - 1, 1))
     {
-        /* CIA chip area - ignore writes, we don't emulate CIA hardware */
-        DPRINTF (LOG_DEBUG, "lxa: mwrite8 CIA area 0x%08x <- 0x%02x (ignored)\n", address, value);
+        m68k_cache_note_write(address, 2);
+        lxa_mem_mark_dirty(address, 2);
+        lxa_mem_store16(page + (address & LXA_MEM_PAGE_MASK), value);
+        return;
     }
-    else if ((address >= CUSTOM_START) && (address <= CUSTOM_END))
+
+    lxa_mem_write16_slow(address, value);
+}
+
+static inline void mwrite32(uint32_t address, uint32_t value)
+{
+    uint8_t *page = g_mem_write_page[address >> LXA_MEM_PAGE_SHIFT];
+
+    if (__builtin_expect(page != NULL && (address & LXA_MEM_PAGE_MASK) <= LXA_MEM_PAGE_MASK - 3, 1))
     {
-        /* Custom chip area - handle via custom write handler (byte writes are rare but possible) */
-        DPRINTF (LOG_DEBUG, "lxa: mwrite8 custom area 0x%08x <- 0x%02x (ignored)\n", address, value);
+        m68k_cache_note_write(address, 4);
+        lxa_mem_mark_dirty(address, 4);
+        lxa_mem_store32(page + (address & LXA_MEM_PAGE_MASK), value);
+        return;
     }
+
+    lxa_mem_write32_slow(address, value);
+}
+
+/*
+ * Host code that stores into emulated RAM behind the CPU's back
+ * (DOS Read(), the blitter) reports the range here so predecoded code on
+ * those pages is retired (and the display sees the change).
+ * It is also what lets such writes through write-protected watchpoint
+ * pages (lxa_watch.h).
+ */
+static inline void lxa_mem_host_write(uint32_t address, uint32_t size)
+{
+    /* a buffer can span pages between its first and last one */
+    if (size <= 4)
+        m68k_cache_note_write(address, size);
     else
-    {
-        printf("ERROR: mwrite8 at invalid address 0x%08x\n", address);
-        _debug(m68k_get_reg(NULL, M68K_REG_PC));
-        assert (false);
-    }
+        m68k_cache_invalidate_range(address, size);
+    lxa_mem_mark_dirty_range(address, size);
+    if (__builtin_expect(g_watch_count != 0, 0))
+        lxa_watch_host_write(address, size);
 }
 
 #endif /* LXA_MEMORY_H */
@@ -4,10 +4,34 @@
  * Compiled into both the lxa executable and liblxa so both can write
  * profiling JSON.  The counters are updated in op_illg() whenever
  * PROFILE_BUILD is defined.
+ *
+ * The per-LVO profiler attributes the m68k time spent inside
+ * ROM library code to the jump-table entry it was called through. A call
+ * starts when the CPU dispatches a jump-table slot (JMP abs.l) whose
+ * target is a registered ROM function; the return address is taken from
+ * the top of the stack at that point, and the call ends when the CPU
+ * dispatches that address again with the stack popped. Each task keeps its
+ * own shadow stack of open calls (keyed by ExecBase->ThisTask), so calls
+ * that block in Wait() are not ended by other tasks' returns.
+ *
+ * The sampling profiler needs no PROFILE_BUILD. Every N
+ * emulated cycles the execute loops stop at the sample point and record
+ * the guest PC plus the return addresses found on the stack (a value
+ * counts as one if it points right behind a JSR/BSR), under the name of
+ * the running task. Frames are symbolised through the ROM map and the
+ * hunk symbols reported by EMU_CALL_SYMBOL, and the samples are written
+ * as folded stacks for flamegraph.pl and speedscope.
+ *
+ * All of it belongs to the instance being profiled: the counters, the
+ * registered functions and the samples live in one profile_state_t per
+ * instance, allocated on first use and released by _profile_shutdown().
+ * Only the pointer to it and the cycle count are instance-local, the
+ * tables are too large to be paid for by every thread of the process.
  */
 
 #include "lxa_api.h"
 #include "lxa_internal.h"
+#include "lxa_memory.h"
 
 #include <inttypes.h>
 #include <string.h>
@@ -15,11 +39,86 @@
 #include <stdlib.h>
 
 /* =========================================================
- * Counter storage (linked against exactly once)
+ * Profiler state
  * ========================================================= */
 
-uint64_t g_profile_calls[LXA_PROFILE_MAX_EMUCALL];
-uint64_t g_profile_ns[LXA_PROFILE_MAX_EMUCALL];
+/* Per-LVO profiler */
+
+#define LVO_HASH_SIZE       8192        /* > 2 * LXA_PROFILE_MAX_LVO, power of two */
+#define LVO_RET_FILTER      4096
+#define LVO_MAX_TASKS       64
+#define LVO_MAX_DEPTH       64
+#define JMP_ABS_L           0x4ef9
+
+typedef struct
+{
+    int      lvo;               /* index into lvo[] */
+    uint32_t ret;               /* caller's return address */
+    uint32_t sp;                /* A7 when the jump-table slot was entered */
+    uint64_t start_cycles;
+    uint64_t start_ns;
+    uint64_t child_cycles;
+    uint64_t child_ns;
+} lvo_frame_t;
+
+typedef struct
+{
+    uint32_t    task;           /* ExecBase->ThisTask, 0 = free */
+    int         depth;
+    lvo_frame_t frame[LVO_MAX_DEPTH];
+} lvo_stack_t;
+
+/* Sampling profiler */
+
+#define SAMPLE_MAX_DEPTH    8           /* return addresses per sample */
+#define SAMPLE_STACK_SCAN   64          /* longwords above A7 searched for them */
+#define SAMPLE_MAX_STACK    512         /* folded stack string length */
+
+typedef struct
+{
+    char     *stack;            /* "task;outer;...;inner", NULL = empty */
+    uint64_t  count;
+} sample_entry_t;
+
+typedef struct
+{
+    uint64_t                calls[LXA_PROFILE_MAX_EMUCALL];
+    uint64_t                ns[LXA_PROFILE_MAX_EMUCALL];
+
+    lxa_profile_lvo_entry_t lvo[LXA_PROFILE_MAX_LVO];
+    uint32_t                lvo_func[LXA_PROFILE_MAX_LVO];
+    int                     lvo_count;
+    int16_t                 lvo_hash[LVO_HASH_SIZE];        /* index + 1, 0 = empty */
+    uint16_t                ret_filter[LVO_RET_FILTER];     /* open calls per return address hash */
+    lvo_stack_t             stacks[LVO_MAX_TASKS];
+
+    uint32_t                sample_interval;                /* cycles, 0 = off */
+    uint64_t                sample_next;
+    sample_entry_t         *samples;                        /* open addressing, power of two */
+    uint32_t                sample_size;
+    uint32_t                sample_used;
+} profile_state_t;
+
+LXA_INSTANCE_LOCAL uint64_t g_profile_cycles;
+
+static LXA_INSTANCE_LOCAL profile_state_t *s_prof;         /* NULL until profiled */
+
+static profile_state_t *_profile_state(void)
+{
+    if (!s_prof)
+        s_prof = calloc(1, sizeof(*s_prof));
+    return s_prof;
+}
+
+static void _sample_free(profile_state_t *p)
+{
+    for (uint32_t i = 0; i < p->sample_size; i++)
+        free(p->samples[i].stack);
+    free(p->samples);
+    p->samples     = NULL;
+    p->sample_size = 0;
+    p->sample_used = 0;
+}
 
 /* =========================================================
  * Public API
@@ -27,23 +126,222 @@ uint64_t g_profile_ns[LXA_PROFILE_MAX_EMUCALL];
 
 void lxa_profile_reset(void)
 {
-    memset(g_profile_calls, 0, sizeof(g_profile_calls));
-    memset(g_profile_ns,    0, sizeof(g_profile_ns));
+    profile_state_t *p = s_prof;
+
+    if (!p)
+        return;
+
+    memset(p->calls, 0, sizeof(p->calls));
+    memset(p->ns,    0, sizeof(p->ns));
+
+    /* keep the registered functions, drop their counters and open calls */
+    for (int i = 0; i < p->lvo_count; i++)
+    {
+        p->lvo[i].call_count   = 0;
+        p->lvo[i].total_ns     = 0;
+        p->lvo[i].self_ns      = 0;
+        p->lvo[i].total_cycles = 0;
+        p->lvo[i].self_cycles  = 0;
+    }
+    memset(p->ret_filter, 0, sizeof(p->ret_filter));
+    memset(p->stacks,     0, sizeof(p->stacks));
+
+    _sample_free(p);
+}
+
+void _profile_shutdown(void)
+{
+    if (!s_prof)
+        return;
+
+    _sample_free(s_prof);
+    free(s_prof);
+    s_prof = NULL;
+    g_profile_cycles = 0;
+}
+
+void _profile_count_emucall(uint32_t id, uint64_t ns)
+{
+    profile_state_t *p = _profile_state();
+
+    if (!p || id >= LXA_PROFILE_MAX_EMUCALL)
+        return;
+    p->calls[id]++;
+    p->ns[id] += ns;
+}
+
+/* =========================================================
+ * Per-LVO profiler
+ * ========================================================= */
+
+static inline uint32_t _lvo_hash(uint32_t func)
+{
+    return (func >> 1) & (LVO_HASH_SIZE - 1);
+}
+
+static int _lvo_find(profile_state_t *p, uint32_t func)
+{
+    for (uint32_t h = _lvo_hash(func); p->lvo_hash[h]; h = (h + 1) & (LVO_HASH_SIZE - 1))
+    {
+        if (p->lvo_func[p->lvo_hash[h] - 1] == func)
+            return p->lvo_hash[h] - 1;
+    }
+    return -1;
+}
+
+void _profile_lvo_register(uint32_t func, const char *name)
+{
+    profile_state_t *p = _profile_state();
+    uint32_t         h;
+
+    if (!p || _lvo_find(p, func) >= 0 || p->lvo_count >= LXA_PROFILE_MAX_LVO)
+        return;
+
+    for (h = _lvo_hash(func); p->lvo_hash[h]; h = (h + 1) & (LVO_HASH_SIZE - 1))
+        ;
+
+    memset(&p->lvo[p->lvo_count], 0, sizeof(p->lvo[0]));
+    snprintf(p->lvo[p->lvo_count].name, sizeof(p->lvo[0].name), "%s", name);
+    p->lvo_func[p->lvo_count] = func;
+    p->lvo_hash[h] = (int16_t)(++p->lvo_count);
+}
+
+static inline uint64_t _now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static lvo_stack_t *_lvo_stack(profile_state_t *p, uint32_t task, bool create)
+{
+    lvo_stack_t *free_slot = NULL;
+
+    for (int i = 0; i < LVO_MAX_TASKS; i++)
+    {
+        if (p->stacks[i].task == task)
+            return &p->stacks[i];
+        if (!free_slot && p->stacks[i].task == 0)
+            free_slot = &p->stacks[i];
+    }
+    if (!create || !free_slot)
+        return NULL;
+
+    free_slot->task  = task;
+    free_slot->depth = 0;
+    return free_slot;
+}
+
+static void _lvo_pop(profile_state_t *p, lvo_stack_t *st, uint64_t cycles, uint64_t ns)
+{
+    lvo_frame_t             *f = &st->frame[--st->depth];
+    lxa_profile_lvo_entry_t *e = &p->lvo[f->lvo];
+    uint64_t                 dc = cycles - f->start_cycles;
+    uint64_t                 dn = ns - f->start_ns;
+
+    e->call_count++;
+    e->total_cycles += dc;
+    e->total_ns     += dn;
+    e->self_cycles  += dc > f->child_cycles ? dc - f->child_cycles : 0;
+    e->self_ns      += dn > f->child_ns ? dn - f->child_ns : 0;
+
+    if (st->depth > 0)
+    {
+        st->frame[st->depth - 1].child_cycles += dc;
+        st->frame[st->depth - 1].child_ns     += dn;
+    }
+
+    p->ret_filter[(f->ret >> 1) & (LVO_RET_FILTER - 1)]--;
+    if (st->depth == 0)
+        st->task = 0;
+}
+
+void _profile_lvo_hook(uint32_t pc)
+{
+    profile_state_t *p = s_prof;
+    uint32_t         sp, task;
+    int              lvo = -1;
+
+    if (!p || p->lvo_count == 0)
+        return;
+
+    if (m68k_read_memory_16(pc) == JMP_ABS_L)
+        lvo = _lvo_find(p, m68k_read_memory_32(pc + 2));
+
+    if (lvo < 0 && !p->ret_filter[(pc >> 1) & (LVO_RET_FILTER - 1)])
+        return;
+
+    sp   = m68k_get_reg(NULL, M68K_REG_A7);
+    task = m68k_read_memory_32(m68k_read_memory_32(4) + EXECBASE_THISTASK);
+
+    uint64_t cycles = g_profile_cycles + (uint64_t)m68k_cycles_run();
+    uint64_t ns     = _now_ns();
+
+    if (lvo < 0)
+    {
+        /* back at a caller: close its call and anything it left open */
+        lvo_stack_t *st = _lvo_stack(p, task, false);
+        if (!st)
+            return;
+        for (int i = st->depth - 1; i >= 0; i--)
+        {
+            if (st->frame[i].ret == pc && st->frame[i].sp + 4 == sp)
+            {
+                while (st->depth > i)
+                    _lvo_pop(p, st, cycles, ns);
+                break;
+            }
+        }
+        return;
+    }
+
+    lvo_stack_t *st = _lvo_stack(p, task, true);
+    if (!st || st->depth == LVO_MAX_DEPTH)
+        return;
+
+    lvo_frame_t *f = &st->frame[st->depth++];
+    f->lvo          = lvo;
+    f->ret          = m68k_read_memory_32(sp);
+    f->sp           = sp;
+    f->start_cycles = cycles;
+    f->start_ns     = ns;
+    f->child_cycles = 0;
+    f->child_ns     = 0;
+    p->ret_filter[(f->ret >> 1) & (LVO_RET_FILTER - 1)]++;
+}
+
+int lxa_profile_get_lvo(lxa_profile_lvo_entry_t *entries, int max_count)
+{
+    profile_state_t *p = s_prof;
+
+    if (!p || !entries || max_count <= 0)
+        return 0;
+
+    int count = 0;
+    for (int i = 0; i < p->lvo_count && count < max_count; i++)
+    {
+        if (p->lvo[i].call_count > 0)
+            entries[count++] = p->lvo[i];
+    }
+    return count;
 }
 
 int lxa_profile_get(lxa_profile_entry_t *entries, int max_count)
 {
-    if (!entries || max_count <= 0)
+    profile_state_t *p = s_prof;
+
+    if (!p || !entries || max_count <= 0)
         return 0;
 
     int count = 0;
     for (int i = 0; i < LXA_PROFILE_MAX_EMUCALL && count < max_count; i++)
     {
-        if (g_profile_calls[i] > 0)
+        if (p->calls[i] > 0)
         {
             entries[count].emucall_id = i;
-            entries[count].call_count = g_profile_calls[i];
-            entries[count].total_ns   = g_profile_ns[i];
+            entries[count].call_count = p->calls[i];
+            entries[count].total_ns   = p->ns[i];
             count++;
         }
     }
@@ -262,14 +560,247 @@ static int _profile_cmp_by_ns(const void *a, const void *b)
     return 0;
 }
 
+/* =========================================================
+ * Sampling profiler
+ * ========================================================= */
+
+void lxa_profile_sample_start(uint32_t interval_cycles)
+{
+    profile_state_t *p = _profile_state();
+
+    if (!p)
+        return;
+    p->sample_interval = interval_cycles;
+    p->sample_next     = g_profile_cycles + interval_cycles;
+}
+
+void lxa_profile_sample_stop(void)
+{
+    if (s_prof)
+        s_prof->sample_interval = 0;
+}
+
+int _profile_sample_slice(int cycles)
+{
+    profile_state_t *p = s_prof;
+
+    if (!p || !p->sample_interval)
+        return cycles;
+
+    uint64_t left = p->sample_next > g_profile_cycles ? p->sample_next - g_profile_cycles : 1;
+    return left < (uint64_t)cycles ? (int)left : cycles;
+}
+
+static bool _sample_is_code(uint32_t addr)
+{
+    return !(addr & 1) && ((addr >= 0x400 && lxa_mem_is_ram(addr, 2)) || (addr >= ROM_START && addr <= ROM_END));
+}
+
+/* addr is right behind a JSR/BSR, i.e. a plausible return address */
+static bool _sample_after_call(uint32_t addr)
+{
+    uint16_t w2 = m68k_read_memory_16(addr - 2);
+    uint16_t w4 = m68k_read_memory_16(addr - 4);
+    uint16_t w6 = m68k_read_memory_16(addr - 6);
+
+    return (w2 & 0xfff8) == 0x4e90 ||                                   /* JSR (An)       */
+           ((w2 & 0xff00) == 0x6100 && (w2 & 0xff) != 0 && (w2 & 0xff) != 0xff) ||  /* BSR.S */
+           (w4 & 0xfff8) == 0x4ea8 || (w4 & 0xfff8) == 0x4eb0 ||       /* JSR d16/d8(An) */
+           w4 == 0x4eb8 || w4 == 0x4eba || w4 == 0x4ebb ||              /* JSR abs.w/PC   */
+           w4 == 0x6100 ||                                              /* BSR.W          */
+           w6 == 0x4eb9 || w6 == 0x61ff;                                /* JSR abs.l, BSR.L */
+}
+
+static int _sample_append(char *buf, int len, const char *frame)
+{
+    int n = snprintf(buf + len, SAMPLE_MAX_STACK - len, "%s%s", len ? ";" : "", frame);
+    return len + n < SAMPLE_MAX_STACK ? len + n : len;
+}
+
+static int _sample_append_addr(char *buf, int len, uint32_t addr)
+{
+    char        frame[24];
+    const char *sym = _symtab_lookup(addr);
+
+    if (!sym)
+    {
+        snprintf(frame, sizeof(frame), "0x%06x", addr);
+        return _sample_append(buf, len, frame);
+    }
+    while (*sym == '_')
+        sym++;
+    return _sample_append(buf, len, sym);
+}
+
+/* Running task's name with the folded-format separators taken out */
+static int _sample_append_task(char *buf, int len)
+{
+    char     name[32] = "idle";
+    uint32_t task = m68k_read_memory_32(m68k_read_memory_32(4) + EXECBASE_THISTASK);
+    uint32_t str  = task ? m68k_read_memory_32(task + 10) : 0;      /* tc_Node.ln_Name */
+
+    if (str && lxa_mem_is_ram(str, 1))
+    {
+        int i;
+        for (i = 0; i < (int)sizeof(name) - 1; i++)
+        {
+            char c = (char)m68k_read_memory_8(str + i);
+            if (!c)
+                break;
+            name[i] = (c == ';' || c == ' ' || c < 0x20) ? '_' : c;
+        }
+        name[i] = 0;
+    }
+    else if (task)
+        snprintf(name, sizeof(name), "task_0x%06x", task);
+
+    return _sample_append(buf, len, name);
+}
+
+static uint32_t _sample_hash(const char *s)
+{
+    uint32_t h = 2166136261u;
+    while (*s)
+        h = (h ^ (uint8_t)*s++) * 16777619u;
+    return h;
+}
+
+static void _sample_count(profile_state_t *p, const char *stack, uint64_t count)
+{
+    if (p->sample_used * 2 >= p->sample_size)
+    {
+        uint32_t        size = p->sample_size ? p->sample_size * 2 : 1024;
+        sample_entry_t *table = calloc(size, sizeof(*table));
+        if (!table)
+            return;
+
+        sample_entry_t *old = p->samples;
+        uint32_t        old_size = p->sample_size;
+        p->samples     = table;
+        p->sample_size = size;
+        p->sample_used = 0;
+        for (uint32_t i = 0; i < old_size; i++)
+        {
+            if (old[i].stack)
+            {
+                uint32_t h = _sample_hash(old[i].stack) & (size - 1);
+                while (p->samples[h].stack)
+                    h = (h + 1) & (size - 1);
+                p->samples[h] = old[i];
+                p->sample_used++;
+            }
+        }
+        free(old);
+    }
+
+    uint32_t h = _sample_hash(stack) & (p->sample_size - 1);
+    while (p->samples[h].stack && strcmp(p->samples[h].stack, stack))
+        h = (h + 1) & (p->sample_size - 1);
+
+    if (!p->samples[h].stack)
+    {
+        p->samples[h].stack = strdup(stack);
+        if (!p->samples[h].stack)
+            return;
+        p->sample_used++;
+    }
+    p->samples[h].count += count;
+}
+
+static void _sample_take(profile_state_t *p)
+{
+    uint32_t frames[SAMPLE_MAX_DEPTH + 1];
+    int      depth = 0;
+    uint32_t sp = m68k_get_reg(NULL, M68K_REG_A7);
+    char     stack[SAMPLE_MAX_STACK];
+    int      len;
+
+    frames[depth++] = m68k_get_reg(NULL, M68K_REG_PC);
+
+    for (int i = 0; i < SAMPLE_STACK_SCAN && depth <= SAMPLE_MAX_DEPTH; i++, sp += 4)
+    {
+        if (!lxa_mem_is_ram(sp, 4))
+            break;
+        uint32_t v = m68k_read_memory_32(sp);
+        if (_sample_is_code(v) && _sample_after_call(v))
+            frames[depth++] = v;
+    }
+
+    len = _sample_append_task(stack, 0);
+    while (depth > 0)
+        len = _sample_append_addr(stack, len, frames[--depth]);
+
+    _sample_count(p, stack, 1);
+}
+
+void _profile_sample_tick(void)
+{
+    profile_state_t *p = s_prof;
+
+    if (!p || !p->sample_interval || g_profile_cycles < p->sample_next)
+        return;
+
+    _sample_take(p);
+    p->sample_next = g_profile_cycles + p->sample_interval;
+}
+
+int _profile_execute(int cycles)
+{
+    int run = 0;
+
+    while (run < cycles)
+    {
+        int slice = _profile_sample_slice(cycles - run);
+        int used  = m68k_execute(slice);
+
+        g_profile_cycles += used;
+        run += used;
+        _profile_sample_tick();
+        if (used < slice)
+            break;                  /* timeslice ended early */
+    }
+    return run;
+}
+
+bool lxa_profile_write_folded(const char *path)
+{
+    profile_state_t *p = s_prof;
+
+    if (!path) return false;
+
+    FILE *f = fopen(path, "w");
+    if (!f) return false;
+
+    for (uint32_t i = 0; p && i < p->sample_size; i++)
+    {
+        if (p->samples[i].stack)
+            fprintf(f, "%s %" PRIu64 "\n", p->samples[i].stack, p->samples[i].count);
+    }
+    fclose(f);
+    return true;
+}
+
+static int _profile_lvo_cmp_by_ns(const void *a, const void *b)
+{
+    const lxa_profile_lvo_entry_t *ea = (const lxa_profile_lvo_entry_t *)a;
+    const lxa_profile_lvo_entry_t *eb = (const lxa_profile_lvo_entry_t *)b;
+    if (eb->total_ns > ea->total_ns) return  1;
+    if (eb->total_ns < ea->total_ns) return -1;
+    return 0;
+}
+
 bool lxa_profile_write_json(const char *path)
 {
     if (!path) return false;
 
     lxa_profile_entry_t entries[LXA_PROFILE_MAX_EMUCALL];
+    lxa_profile_lvo_entry_t *lvos = malloc(LXA_PROFILE_MAX_LVO * sizeof(*lvos));
+    if (!lvos) return false;
     int count = lxa_profile_get(entries, LXA_PROFILE_MAX_EMUCALL);
-    if (count == 0)
+    int lvo_count = lxa_profile_get_lvo(lvos, LXA_PROFILE_MAX_LVO);
+    if (count == 0 && lvo_count == 0)
     {
+        free(lvos);
         FILE *f = fopen(path, "w");
         if (!f) return false;
         fprintf(f, "[]\n");
@@ -278,9 +809,14 @@ bool lxa_profile_write_json(const char *path)
     }
 
     qsort(entries, (size_t)count, sizeof(entries[0]), _profile_cmp_by_ns);
+    qsort(lvos, (size_t)lvo_count, sizeof(lvos[0]), _profile_lvo_cmp_by_ns);
 
     FILE *f = fopen(path, "w");
-    if (!f) return false;
+    if (!f)
+    {
+        free(lvos);
+        return false;
+    }
 
     fprintf(f, "[\n");
     char name[64];
@@ -292,9 +828,22 @@ bool lxa_profile_write_json(const char *path)
                 name,
                 entries[i].call_count,
                 entries[i].total_ns,
-                (i < count - 1) ? "," : "");
+                (i < count - 1 || lvo_count > 0) ? "," : "");
+    }
+    for (int i = 0; i < lvo_count; i++)
+    {
+        fprintf(f, "  {\"kind\": \"lvo\", \"name\": \"%s\", \"calls\": %" PRIu64 ", \"total_ns\": %" PRIu64
+                   ", \"self_ns\": %" PRIu64 ", \"cycles\": %" PRIu64 ", \"self_cycles\": %" PRIu64 "}%s\n",
+                lvos[i].name,
+                lvos[i].call_count,
+                lvos[i].total_ns,
+                lvos[i].self_ns,
+                lvos[i].total_cycles,
+                lvos[i].self_cycles,
+                (i < lvo_count - 1) ? "," : "");
     }
     fprintf(f, "]\n");
     fclose(f);
+    free(lvos);
     return true;
 }
@@ -0,0 +1,348 @@
+/*
+ * lxa_snapshot.c — Emulator snapshots (lxa_snapshot_save() & co.).
+ *
+ * Test drivers boot the ROM and start the application under
+ * test for every test case.  A snapshot taken once the application is up
+ * lets the following cases skip all of that: lxa_init(), set up drives and
+ * assigns, lxa_snapshot_restore().
+ *
+ * A snapshot is a header followed by tagged sections:
+ *
+ *   CPU   m68k context (registers, flags, MMU/FPU state)
+ *   RAM   guest RAM, all-zero 4 KB pages left out
+ *   CUST  copper pointers (the other custom registers are in HOST)
+ *   DISP  displays, rootless windows, pixel buffers, input queue
+ *   HOST  lxa.c state: program name, args, console input, DMACON, ...
+ *   API   lxa_api.c state: captured output, VBlank cadence
+ *   EVNT  Intuition event log
+ *   DOS   locks, record locks, notify and timer requests, open files
+ *
+ * The ROM is not saved; the header carries a hash of it and the RAM sizes,
+ * and restoring into a machine with a different ROM or memory layout
+ * fails.  Host configuration (drives, assigns, headless/rootless mode) is
+ * not part of a snapshot either: it belongs to the process doing the
+ * restore, which sets it up before calling lxa_snapshot_restore().
+ *
+ * Sections are restored in the order above, so RAM is in place when the
+ * free list indexes are rebuilt and displays exist when HOST resolves the
+ * last input event.  A failed restore leaves the machine in an undefined
+ * state; call lxa_shutdown().
+ */
+
+#include "lxa_api.h"
+#include "lxa_internal.h"
+#include "lxa_memory.h"
+#include "lxa_copper.h"
+#include "lxa_snapshot.h"
+#include "m68kcache.h"
+
+#define SNAPSHOT_MAGIC      0x4c584153u     /* 'LXAS' */
+#define SNAPSHOT_VERSION    1
+#define SNAPSHOT_PAGE_SIZE  4096
+
+struct lxa_snapshot
+{
+    lxa_snap_buf_t buf;
+};
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t cpu_context_size;
+    uint32_t ram_size;
+    uint64_t rom_hash;
+} snapshot_header_t;
+
+/* FNV-1a */
+static uint64_t _rom_hash(void)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+
+    for (uint32_t i = 0; i < ROM_SIZE; i++)
+        h = (h ^ g_rom[i]) * 0x100000001b3ull;
+    return h;
+}
+
+/* =========================================================
+ * CPU, RAM and copper sections
+ * ========================================================= */
+
+static void _save_cpu(lxa_snap_buf_t *buf)
+{
+    unsigned int size = m68k_context_size();
+    void        *ctx  = malloc(size);
+
+    if (!ctx)
+    {
+        buf->error = true;
+        return;
+    }
+    m68k_get_context(ctx);
+    lxa_snap_put(buf, ctx, size);
+    free(ctx);
+}
+
+static bool _load_cpu(lxa_snap_buf_t *buf)
+{
+    unsigned int size = m68k_context_size();
+    void        *ctx  = malloc(size);
+    bool         ok;
+
+    if (!ctx)
+        return false;
+    ok = lxa_snap_get(buf, ctx, size);
+    if (ok)
+        m68k_set_context_state(ctx);
+    free(ctx);
+    return ok;
+}
+
+static void _save_ram(lxa_snap_buf_t *buf, const uint8_t *ram, uint32_t size)
+{
+    static const uint8_t zero[SNAPSHOT_PAGE_SIZE];
+    uint32_t             pages = 0;
+
+    for (uint32_t off = 0; off < size; off += SNAPSHOT_PAGE_SIZE)
+        pages += memcmp(ram + off, zero, SNAPSHOT_PAGE_SIZE) != 0;
+
+    lxa_snap_put_u32(buf, pages);
+    for (uint32_t off = 0; off < size; off += SNAPSHOT_PAGE_SIZE)
+    {
+        if (!memcmp(ram + off, zero, SNAPSHOT_PAGE_SIZE))
+            continue;
+        lxa_snap_put_u32(buf, off);
+        lxa_snap_put(buf, ram + off, SNAPSHOT_PAGE_SIZE);
+    }
+}
+
+static bool _load_ram(lxa_snap_buf_t *buf, uint8_t *ram, uint32_t size)
+{
+    uint32_t pages = lxa_snap_get_u32(buf);
+
+    for (uint32_t n = 0; n < pages && !buf->error; n++)
+    {
+        uint32_t off = lxa_snap_get_u32(buf);
+
+        if (off >= size || off % SNAPSHOT_PAGE_SIZE)
+            return false;
+        lxa_snap_get(buf, ram + off, SNAPSHOT_PAGE_SIZE);
+    }
+    return !buf->error;
+}
+
+static void _save_custom(lxa_snap_buf_t *buf)
+{
+    lxa_snap_put_u32(buf, copper_get_cop1lc());
+    lxa_snap_put_u32(buf, copper_get_cop2lc());
+    lxa_snap_put_u32(buf, copper_get_copcon());
+}
+
+static bool _load_custom(lxa_snap_buf_t *buf)
+{
+    copper_reset();
+    copper_set_cop1lc(lxa_snap_get_u32(buf));
+    copper_set_cop2lc(lxa_snap_get_u32(buf));
+    copper_set_copcon((uint16_t)lxa_snap_get_u32(buf));
+    return !buf->error;
+}
+
+static void _save_memory(lxa_snap_buf_t *buf)
+{
+    _save_ram(buf, g_ram, g_ram_size);
+}
+
+static bool _load_memory(lxa_snap_buf_t *buf)
+{
+    lxa_mem_clear_ram();
+    if (!_load_ram(buf, g_ram, g_ram_size))
+        return false;
+
+    m68k_cache_flush();
+    return true;
+}
+
+static void _save_api(lxa_snap_buf_t *buf)
+{
+    if (!lxa_api_save_state(buf))
+        buf->error = true;
+}
+
+/* =========================================================
+ * Section table
+ * ========================================================= */
+
+#define SECTION(a, b, c, d) (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+
+static const struct
+{
+    uint32_t tag;
+    void   (*save)(lxa_snap_buf_t *buf);
+    bool   (*load)(lxa_snap_buf_t *buf);
+} s_sections[] = {
+    { SECTION('C', 'P', 'U', ' '), _save_cpu,             _load_cpu },
+    { SECTION('R', 'A', 'M', ' '), _save_memory,          _load_memory },
+    { SECTION('C', 'U', 'S', 'T'), _save_custom,          _load_custom },
+    { SECTION('D', 'I', 'S', 'P'), display_save_state,    display_load_state },
+    { SECTION('H', 'O', 'S', 'T'), lxa_save_host_state,   lxa_load_host_state },
+    { SECTION('A', 'P', 'I', ' '), _save_api,             lxa_api_load_state },
+    { SECTION('E', 'V', 'N', 'T'), lxa_events_save_state, lxa_events_load_state },
+    { SECTION('D', 'O', 'S', ' '), _dos_host_save_state,  _dos_host_load_state },
+};
+
+#define NUM_SECTIONS ((int)(sizeof(s_sections) / sizeof(s_sections[0])))
+
+static void _save_section(lxa_snap_buf_t *buf, int i)
+{
+    size_t   len_pos;
+    uint32_t len;
+
+    lxa_snap_put_u32(buf, s_sections[i].tag);
+    len_pos = buf->size;
+    lxa_snap_put_u32(buf, 0);
+
+    s_sections[i].save(buf);
+
+    len = (uint32_t)(buf->size - len_pos - sizeof(len));
+    if (!buf->error)
+        memcpy(buf->data + len_pos, &len, sizeof(len));
+}
+
+/* A section must be present, load without error and consume exactly its length */
+static bool _load_section(lxa_snap_buf_t *buf, int i)
+{
+    uint32_t tag = lxa_snap_get_u32(buf);
+    uint32_t len = lxa_snap_get_u32(buf);
+    size_t   end = buf->pos + len;
+
+    if (!buf->error && tag == s_sections[i].tag && len <= buf->size - buf->pos &&
+        s_sections[i].load(buf) && !buf->error && buf->pos == end)
+        return true;
+
+    tag = s_sections[i].tag;
+    LPRINTF(LOG_ERROR, "lxa: snapshot: cannot restore section %c%c%c%c\n",
+            tag >> 24, (tag >> 16) & 0xff, (tag >> 8) & 0xff, tag & 0xff);
+    return false;
+}
+
+/* =========================================================
+ * Public interface
+ * ========================================================= */
+
+lxa_snapshot_t *lxa_snapshot_save(void)
+{
+    lxa_snapshot_t   *snap;
+    snapshot_header_t hdr;
+
+    if (!g_ram || !(snap = calloc(1, sizeof(*snap))))
+        return NULL;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic            = SNAPSHOT_MAGIC;
+    hdr.version          = SNAPSHOT_VERSION;
+    hdr.cpu_context_size = m68k_context_size();
+    hdr.ram_size         = g_ram_size;
+    hdr.rom_hash         = _rom_hash();
+    lxa_snap_put(&snap->buf, &hdr, sizeof(hdr));
+
+    for (int i = 0; i < NUM_SECTIONS; i++)
+        _save_section(&snap->buf, i);
+
+    if (snap->buf.error)
+    {
+        lxa_snapshot_free(snap);
+        return NULL;
+    }
+    return snap;
+}
+
+bool lxa_snapshot_restore(const lxa_snapshot_t *snapshot)
+{
+    lxa_snap_buf_t    buf;
+    snapshot_header_t hdr;
+
+    if (!snapshot)
+        return false;
+
+    buf       = snapshot->buf;
+    buf.pos   = 0;
+    buf.error = false;
+
+    if (!lxa_snap_get(&buf, &hdr, sizeof(hdr)) || hdr.magic != SNAPSHOT_MAGIC ||
+        hdr.version != SNAPSHOT_VERSION || hdr.cpu_context_size != m68k_context_size())
+    {
+        LPRINTF(LOG_ERROR, "lxa: snapshot: not a snapshot of this lxa version\n");
+        return false;
+    }
+    if (!g_ram || hdr.ram_size != g_ram_size || hdr.rom_hash != _rom_hash())
+    {
+        LPRINTF(LOG_ERROR, "lxa: snapshot: ROM or RAM configuration differs\n");
+        return false;
+    }
+
+    for (int i = 0; i < NUM_SECTIONS; i++)
+    {
+        if (!_load_section(&buf, i))
+            return false;
+    }
+    return true;
+}
+
+void lxa_snapshot_free(lxa_snapshot_t *snapshot)
+{
+    if (!snapshot)
+        return;
+    free(snapshot->buf.data);
+    free(snapshot);
+}
+
+size_t lxa_snapshot_size(const lxa_snapshot_t *snapshot)
+{
+    return snapshot ? snapshot->buf.size : 0;
+}
+
+bool lxa_snapshot_write(const lxa_snapshot_t *snapshot, const char *path)
+{
+    FILE *f;
+    bool  ok;
+
+    if (!snapshot || !path)
+        return false;
+
+    f = fopen(path, "wb");
+    if (!f)
+        return false;
+    ok = fwrite(snapshot->buf.data, 1, snapshot->buf.size, f) == snapshot->buf.size;
+    return (fclose(f) == 0) && ok;
+}
+
+lxa_snapshot_t *lxa_snapshot_read(const char *path)
+{
+    lxa_snapshot_t *snap;
+    FILE           *f;
+    long            size;
+
+    if (!path || !(f = fopen(path, "rb")))
+        return NULL;
+
+    snap = calloc(1, sizeof(*snap));
+    if (!snap || fseek(f, 0, SEEK_END) || (size = ftell(f)) < (long)sizeof(snapshot_header_t) ||
+        fseek(f, 0, SEEK_SET))
+    {
+        free(snap);
+        fclose(f);
+        return NULL;
+    }
+
+    snap->buf.data = malloc(size);
+    snap->buf.size = snap->buf.cap = (size_t)size;
+    if (!snap->buf.data || fread(snap->buf.data, 1, size, f) != (size_t)size)
+    {
+        lxa_snapshot_free(snap);
+        fclose(f);
+        return NULL;
+    }
+
+    fclose(f);
+    return snap;
+}
@@ -0,0 +1,93 @@
+/*
+ * lxa_snapshot.h — Internal interface for emulator snapshots.
+ *
+ * lxa_snapshot_save()/lxa_snapshot_restore() (lxa_api.h)
+ * serialize the whole machine into one byte buffer.  The buffer is made of
+ * tagged sections; each module that owns host-side state writes its own
+ * section with the helpers below and reads it back on restore.  See
+ * lxa_snapshot.c for the section list and what is (not) captured.
+ */
+
+#ifndef LXA_SNAPSHOT_H
+#define LXA_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct lxa_snap_buf_s
+{
+    uint8_t *data;
+    size_t   size;      /* bytes written */
+    size_t   cap;
+    size_t   pos;       /* read position */
+    bool     error;     /* out of memory, or read past the end */
+} lxa_snap_buf_t;
+
+static inline void lxa_snap_put(lxa_snap_buf_t *buf, const void *data, size_t size)
+{
+    if (buf->error || !size)
+        return;
+
+    if (buf->size + size > buf->cap)
+    {
+        size_t   cap  = buf->cap ? buf->cap : 65536;
+        uint8_t *grow;
+
+        while (cap < buf->size + size)
+            cap *= 2;
+        grow = realloc(buf->data, cap);
+        if (!grow)
+        {
+            buf->error = true;
+            return;
+        }
+        buf->data = grow;
+        buf->cap  = cap;
+    }
+
+    memcpy(buf->data + buf->size, data, size);
+    buf->size += size;
+}
+
+static inline bool lxa_snap_get(lxa_snap_buf_t *buf, void *data, size_t size)
+{
+    if (buf->error || size > buf->size - buf->pos)
+    {
+        buf->error = true;
+        memset(data, 0, size);
+        return false;
+    }
+
+    memcpy(data, buf->data + buf->pos, size);
+    buf->pos += size;
+    return true;
+}
+
+static inline void lxa_snap_put_u32(lxa_snap_buf_t *buf, uint32_t value)
+{
+    lxa_snap_put(buf, &value, sizeof(value));
+}
+
+static inline uint32_t lxa_snap_get_u32(lxa_snap_buf_t *buf)
+{
+    uint32_t value = 0;
+    lxa_snap_get(buf, &value, sizeof(value));
+    return value;
+}
+
+/* Per-module sections (defined next to the state they cover) */
+void lxa_save_host_state(lxa_snap_buf_t *buf);              /* lxa.c */
+bool lxa_load_host_state(lxa_snap_buf_t *buf);
+bool lxa_api_save_state(lxa_snap_buf_t *buf);               /* lxa_api.c */
+bool lxa_api_load_state(lxa_snap_buf_t *buf);
+void lxa_events_save_state(lxa_snap_buf_t *buf);            /* lxa_events.c */
+bool lxa_events_load_state(lxa_snap_buf_t *buf);
+void _dos_host_save_state(lxa_snap_buf_t *buf);             /* lxa_dos_host.c */
+bool _dos_host_load_state(lxa_snap_buf_t *buf);
+void display_save_state(lxa_snap_buf_t *buf);               /* display.c */
+bool display_load_state(lxa_snap_buf_t *buf);
+
+#endif /* LXA_SNAPSHOT_H */
@@ -0,0 +1,384 @@
+/*
+ * lxa_watch.c — Data watchpoints on guest RAM (lxa_watch_add() & co.).
+ *
+ * See lxa_watch.h.  The signal handlers only touch the state of
+ * the faulting thread's instance (initial-exec TLS, see lxa_instance.h)
+ * and queue hits; reporting is left to the caller of lxa_watch_poll().
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                 /* REG_EFL */
+#endif
+
+#include "lxa_internal.h"
+#include "lxa_memory.h"
+#include "lxa_watch.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define WATCH_SINGLE_STEP   1
+#define WATCH_EFLAGS_TF     0x100   /* trap after the next instruction */
+#else
+#define WATCH_SINGLE_STEP   0
+#endif
+
+#define WATCH_MAX_STEP_PAGES 4      /* an unaligned store can fault twice */
+
+typedef struct
+{
+    uint32_t address;
+    uint32_t size;
+    bool     brk;
+    bool     reported;              /* last change already queued as a hit */
+    uint8_t *shadow;                /* watched bytes as of the last check */
+} watch_t;
+
+LXA_INSTANCE_LOCAL int g_watch_count;
+
+static LXA_INSTANCE_LOCAL watch_t         s_watch[LXA_WATCH_MAX];
+static LXA_INSTANCE_LOCAL lxa_watch_hit_t s_hits[LXA_WATCH_MAX_HITS];
+static LXA_INSTANCE_LOCAL uint32_t        s_hit_head;
+static LXA_INSTANCE_LOCAL uint32_t        s_hit_count;
+static LXA_INSTANCE_LOCAL uint32_t        s_lost_hits;
+static LXA_INSTANCE_LOCAL bool            s_lifted;     /* pages writable until the next poll */
+static LXA_INSTANCE_LOCAL uint8_t        *s_step_page[WATCH_MAX_STEP_PAGES];
+static LXA_INSTANCE_LOCAL int             s_num_step_pages;
+
+/* Signal handlers are per process */
+static uintptr_t        s_page_size;
+static struct sigaction s_old_segv;
+static struct sigaction s_old_trap;
+static pthread_once_t   s_install_once = PTHREAD_ONCE_INIT;
+
+/* =========================================================
+ * Guest <-> host addresses, page protection
+ * ========================================================= */
+
+/* Only for addresses lxa_mem_is_ram() accepts */
+static uint8_t *_host(uint32_t address)
+{
+    return g_ram + address;
+}
+
+static bool _guest(const uint8_t *p, uint32_t *address)
+{
+    if (g_ram && p >= g_ram && p < g_ram + g_ram_size)
+    {
+        *address = (uint32_t)(p - g_ram);
+        return true;
+    }
+    return false;
+}
+
+/* Host pages holding the bytes of w */
+static void _span(const watch_t *w, uint8_t **first, uint8_t **end)
+{
+    uintptr_t start = (uintptr_t)_host(w->address);
+
+    *first = (uint8_t *)(start & ~(s_page_size - 1));
+    *end   = (uint8_t *)((start + w->size + s_page_size - 1) & ~(s_page_size - 1));
+}
+
+static bool _on_watched_page(const uint8_t *lo, const uint8_t *hi)
+{
+    for (int i = 0; i < g_watch_count; i++)
+    {
+        uint8_t *first, *end;
+
+        _span(&s_watch[i], &first, &end);
+        if (lo < end && hi > first)
+            return true;
+    }
+    return false;
+}
+
+static void _protect(int prot)
+{
+    for (int i = 0; i < g_watch_count; i++)
+    {
+        uint8_t *first, *end;
+
+        _span(&s_watch[i], &first, &end);
+        mprotect(first, end - first, prot);
+    }
+}
+
+static void _arm(void)
+{
+    _protect(PROT_READ);
+    s_lifted = false;
+}
+
+/* =========================================================
+ * Hits
+ * ========================================================= */
+
+static void _queue(watch_t *w, uint32_t address, bool host)
+{
+    lxa_watch_hit_t *hit;
+
+    w->reported = true;
+    if (w->brk)
+        m68k_end_timeslice_used();
+
+    if (s_hit_count == LXA_WATCH_MAX_HITS)
+    {
+        s_lost_hits++;
+        return;
+    }
+
+    hit = &s_hits[(s_hit_head + s_hit_count++) % LXA_WATCH_MAX_HITS];
+    hit->address = address;
+    hit->pc      = m68k_get_reg(NULL, M68K_REG_PPC);
+    hit->watch   = w->address;
+    hit->host    = host;
+    hit->brk     = w->brk;
+}
+
+/*
+ * Queue changes of watched bytes no hit was queued for (wide host stores
+ * that start below the watched range, writes while a page was lifted) and
+ * update the copies.  page: only watchpoints on this host page, or all.
+ */
+static void _compare(const uint8_t *page)
+{
+    for (int i = 0; i < g_watch_count; i++)
+    {
+        watch_t       *w    = &s_watch[i];
+        const uint8_t *live = _host(w->address);
+        uint8_t       *first, *end;
+
+        _span(w, &first, &end);
+        if (page && (page < first || page >= end))
+            continue;
+
+        if (memcmp(live, w->shadow, w->size))
+        {
+            uint32_t off = 0;
+
+            while (live[off] == w->shadow[off])
+                off++;
+            if (!w->reported)
+                _queue(w, w->address + off, false);
+            memcpy(w->shadow, live, w->size);
+        }
+        w->reported = false;
+    }
+}
+
+/* =========================================================
+ * Signal handlers
+ * ========================================================= */
+
+/* Not ours: hand over to whatever was installed before */
+static void _chain(const struct sigaction *old, int sig, siginfo_t *info, void *context)
+{
+    if (old->sa_flags & SA_SIGINFO)
+    {
+        old->sa_sigaction(sig, info, context);
+        return;
+    }
+    if (old->sa_handler != SIG_DFL && old->sa_handler != SIG_IGN)
+    {
+        old->sa_handler(sig);
+        return;
+    }
+
+    /* Default action: a fault repeats on return, a trap has to be raised */
+    sigaction(sig, old, NULL);
+    if (sig == SIGTRAP)
+        raise(sig);
+}
+
+static void _segv_handler(int sig, siginfo_t *info, void *context)
+{
+    uint8_t *p = info->si_addr;
+    uint8_t *page;
+    uint32_t address;
+
+    if (!g_watch_count || !_guest(p, &address) || !_on_watched_page(p, p + 1))
+    {
+        _chain(&s_old_segv, sig, info, context);
+        return;
+    }
+
+    for (int i = 0; i < g_watch_count; i++)
+    {
+        if (address - s_watch[i].address < s_watch[i].size)
+            _queue(&s_watch[i], address, false);
+    }
+
+    page = (uint8_t *)((uintptr_t)p & ~(s_page_size - 1));
+    mprotect(page, s_page_size, PROT_READ | PROT_WRITE);
+
+#if WATCH_SINGLE_STEP
+    if (s_num_step_pages < WATCH_MAX_STEP_PAGES)
+    {
+        s_step_page[s_num_step_pages++] = page;
+        ((ucontext_t *)context)->uc_mcontext.gregs[REG_EFL] |= WATCH_EFLAGS_TF;
+        return;
+    }
+#endif
+
+    s_lifted = true;
+    m68k_end_timeslice_used();      /* get to the next poll soon */
+}
+
+#if WATCH_SINGLE_STEP
+/* The store went through: protect its pages again */
+static void _trap_handler(int sig, siginfo_t *info, void *context)
+{
+    if (!s_num_step_pages)
+    {
+        _chain(&s_old_trap, sig, info, context);
+        return;
+    }
+
+    ((ucontext_t *)context)->uc_mcontext.gregs[REG_EFL] &= ~WATCH_EFLAGS_TF;
+
+    for (int i = 0; i < s_num_step_pages; i++)
+    {
+        _compare(s_step_page[i]);
+        if (!s_lifted)
+            mprotect(s_step_page[i], s_page_size, PROT_READ);
+    }
+    s_num_step_pages = 0;
+}
+#endif
+
+static void _install(void)
+{
+    struct sigaction sa;
+
+    s_page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = _segv_handler;
+    sa.sa_flags     = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGSEGV, &sa, &s_old_segv);
+
+#if WATCH_SINGLE_STEP
+    sa.sa_sigaction = _trap_handler;
+    sigaction(SIGTRAP, &sa, &s_old_trap);
+#endif
+}
+
+/* =========================================================
+ * Public interface
+ * ========================================================= */
+
+bool lxa_watch_add(uint32_t address, uint32_t size, bool brk)
+{
+    watch_t *w;
+
+    if (!size || !lxa_mem_is_ram(address, size) || g_watch_count == LXA_WATCH_MAX)
+        return false;
+    for (int i = 0; i < g_watch_count; i++)
+    {
+        if (s_watch[i].address == address)
+            return false;
+    }
+
+    pthread_once(&s_install_once, _install);
+
+    w = &s_watch[g_watch_count];
+    w->shadow = malloc(size);
+    if (!w->shadow)
+        return false;
+    memcpy(w->shadow, _host(address), size);
+    w->address  = address;
+    w->size     = size;
+    w->brk      = brk;
+    w->reported = false;
+    g_watch_count++;
+
+    _arm();
+    return true;
+}
+
+bool lxa_watch_remove(uint32_t address)
+{
+    for (int i = 0; i < g_watch_count; i++)
+    {
+        if (s_watch[i].address != address)
+            continue;
+
+        /* lift everything, then protect what the others still cover */
+        _protect(PROT_READ | PROT_WRITE);
+        free(s_watch[i].shadow);
+        memmove(&s_watch[i], &s_watch[i + 1], (g_watch_count - i - 1) * sizeof(watch_t));
+        g_watch_count--;
+        _arm();
+        return true;
+    }
+    return false;
+}
+
+void lxa_watch_clear(void)
+{
+    _protect(PROT_READ | PROT_WRITE);
+    for (int i = 0; i < g_watch_count; i++)
+        free(s_watch[i].shadow);
+
+    g_watch_count    = 0;
+    s_hit_head       = 0;
+    s_hit_count      = 0;
+    s_lost_hits      = 0;
+    s_lifted         = false;
+    s_num_step_pages = 0;
+}
+
+void lxa_watch_host_write(uint32_t address, uint32_t size)
+{
+    uint8_t *lo;
+
+    if (!size || !lxa_mem_is_ram(address, size))
+        return;
+
+    for (int i = 0; i < g_watch_count; i++)
+    {
+        watch_t *w = &s_watch[i];
+
+        if (address < w->address + w->size && w->address < address + size)
+            _queue(w, address > w->address ? address : w->address, true);
+    }
+
+    /* the kernel would fail the write (EFAULT) rather than fault */
+    lo = _host(address);
+    if (!s_lifted && _on_watched_page(lo, lo + size))
+    {
+        _protect(PROT_READ | PROT_WRITE);
+        s_lifted = true;
+    }
+}
+
+bool lxa_watch_poll(lxa_watch_hit_t *hit)
+{
+    if (s_lifted)
+    {
+        _compare(NULL);
+        _arm();
+    }
+
+    if (!s_hit_count)
+        return false;
+
+    *hit       = s_hits[s_hit_head];
+    s_hit_head = (s_hit_head + 1) % LXA_WATCH_MAX_HITS;
+    s_hit_count--;
+    return true;
+}
+
+uint32_t lxa_watch_lost_hits(void)
+{
+    uint32_t lost = s_lost_hits;
+
+    s_lost_hits = 0;
+    return lost;
+}
@@ -0,0 +1,71 @@
+/*
+ * lxa_watch.h — Data watchpoints on guest RAM.
+ *
+ * A watchpoint write-protects the host pages holding the
+ * watched guest bytes (mprotect()), so the mwrite*() fast paths and every
+ * other store stay exactly as fast as before; only stores to a protected
+ * page take a SIGSEGV.  The handler records the write and the guest PC,
+ * lifts the protection, single-steps the host store (x86-64: trap flag)
+ * and protects the page again.  Stores to the rest of a protected page
+ * are let through the same way without a report.
+ *
+ * Host code that writes guest RAM through the kernel (read() in DOS
+ * Read()) would get EFAULT instead of a signal; those writes are reported
+ * up front through lxa_mem_host_write(), which lifts the protection until
+ * the next lxa_watch_poll().
+ *
+ * Without single-stepping (other hosts) a page stays writable until the
+ * next lxa_watch_poll(); writes in between are found by comparing the
+ * watched bytes with a copy and report the PC at poll time.
+ */
+
+#ifndef LXA_WATCH_H
+#define LXA_WATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lxa_instance.h"
+
+#define LXA_WATCH_MAX       16      /* watchpoints per instance */
+#define LXA_WATCH_MAX_HITS  64      /* hits queued between two polls */
+
+typedef struct lxa_watch_hit_s
+{
+    uint32_t address;       /* first written (or changed) byte */
+    uint32_t pc;            /* start of the guest instruction doing the write */
+    uint32_t watch;         /* start address of the watchpoint */
+    bool     host;          /* host-side write (EMU call), not a CPU store */
+    bool     brk;           /* watchpoint asks to stop in the debugger */
+} lxa_watch_hit_t;
+
+/* Number of watchpoints; lets callers skip lxa_watch_poll() altogether. */
+extern LXA_INSTANCE_LOCAL int g_watch_count;
+
+/*
+ * Watch [address, address + size) for writes.  The range must be in guest
+ * RAM.  brk: a hit ends the current CPU slice and asks the caller to
+ * stop (see lxa_watch_hit_t.brk).  False if the range is invalid, already
+ * watched or all LXA_WATCH_MAX watchpoints are in use.
+ */
+bool lxa_watch_add(uint32_t address, uint32_t size, bool brk);
+
+/* Remove the watchpoint starting at address; false if there is none. */
+bool lxa_watch_remove(uint32_t address);
+
+/* Remove all watchpoints and forget queued hits. */
+void lxa_watch_clear(void);
+
+/* Host-side write to guest RAM coming up (lxa_mem_host_write()). */
+void lxa_watch_host_write(uint32_t address, uint32_t size);
+
+/*
+ * Next queued hit, oldest first.  Re-protects pages lifted since the last
+ * call.  Call after every CPU slice while g_watch_count is non-zero.
+ */
+bool lxa_watch_poll(lxa_watch_hit_t *hit);
+
+/* Hits dropped because the queue was full, since the last call. */
+uint32_t lxa_watch_lost_hits(void);
+
+#endif /* LXA_WATCH_H */
@@ -293,6 +293,34 @@ void m68k_set_fc_callback(void  (*callback)(unsigned int new_fc));
  */
 void m68k_set_instr_hook_callback(void  (*callback)(unsigned int pc));
 
+/* Set the callback that maps program space onto host memory.
+ * You must enable M68K_DIRECT_FETCH in m68kconf.h.
+ * The CPU calls this callback when the PC leaves the current fetch window.
+ * It returns a pointer to the host bytes backing [*base, *base + *size)
+ * (the window containing address, stored big-endian like the 68k sees it),
+ * or NULL if the address is not plain memory.  Fetches inside the window
+ * bypass m68k_read_memory_16/32().
+ * Default behavior: return NULL (every fetch uses the memory callbacks).
+ */
+void m68k_set_fetch_callback(const unsigned char *(*callback)(unsigned int address, unsigned int *base, unsigned int *size));
+
+/* Drop the current fetch window.  Call this whenever the host remaps memory
+ * that a previously returned window may cover.
+ */
+void m68k_invalidate_fetch(void);
+
+/* Set the callback that maps data space onto host memory for bulk access.
+ * The fast execute loop calls it when it runs a recognised copy, fill or
+ * string-scan loop in one go (see m68kidiom.h).  It returns a pointer to
+ * the host bytes backing address (stored big-endian like the 68k sees
+ * them) and lowers *size to the number of contiguous bytes available from
+ * there - writable ones if write is set - or NULL if address is not plain
+ * memory.  Accesses through the returned pointer bypass the memory
+ * callbacks.
+ * Default behavior: return NULL (such loops are interpreted).
+ */
+void m68k_set_host_memory_callback(unsigned char *(*callback)(unsigned int address, unsigned int *size, int write));
+
 
 
 /* ======================================================================== */
@@ -305,6 +333,21 @@ void m68k_set_instr_hook_callback(void  (*callback)(unsigned int pc));
  */
 void m68k_set_cpu_type(unsigned int cpu_type);
 
+/* Select how FPU arithmetic is carried out.
+ * M68K_FPU_EXACT: 80-bit extended precision in software (softfloat).
+ * M68K_FPU_HOST:  FADD/FSUB/FMUL/FDIV/FSQRT/FCMP run on the host FPU
+ *                 (long double where it is 80-bit, double otherwise),
+ *                 honouring the FPCR rounding mode and precision and
+ *                 reporting exceptions in the FPSR.  Transcendental
+ *                 instructions (FSIN, FETOX, ...) use the host math
+ *                 library; softfloat has none, so exact mode stops on them.
+ * Default: M68K_FPU_EXACT.
+ */
+#define M68K_FPU_EXACT 0
+#define M68K_FPU_HOST  1
+
+void m68k_set_fpu_mode(int mode);
+
 /* Do whatever initialisations the core requires.  Should be called
  * at least once at init time.
  */
@@ -331,6 +374,14 @@ int m68k_cycles_remaining(void);        /* Number of cycles left */
 void m68k_modify_timeslice(int cycles); /* Modify cycles left */
 void m68k_end_timeslice(void);          /* End timeslice now */
 
+/* lxa: end the timeslice now, like m68k_end_timeslice(), but keep the cycle
+ * count: m68k_execute() and m68k_cycles_run() then report the cycles run
+ * so far, whereas after m68k_end_timeslice() they report the cycles that
+ * were left.  lxa ends its timeslices with this one (lxa_run_cycles(),
+ * the profiler and the idle/spin sleeps rely on the count).
+ */
+void m68k_end_timeslice_used(void);
+
 /* Set the IPL0-IPL2 pins on the CPU (IRQ).
  * A transition from < 7 to 7 will cause a non-maskable interrupt (NMI).
  * Setting IRQ to 0 will clear an interrupt request.
@@ -363,6 +414,13 @@ unsigned int m68k_get_context(void* dst);
 /* set the current cpu context */
 void m68k_set_context(void* dst);
 
+/* Set the registers, flags and MMU/FPU state of the current cpu
+ * from a context saved with m68k_get_context(), keeping this process'
+ * callbacks, cycle tables and fetch window.  The saved context may come
+ * from another run of the same binary (emulator snapshots).
+ */
+void m68k_set_context_state(const void* src);
+
 /* Register the CPU state information */
 void m68k_state_register(const char *type, int index);
 
@@ -0,0 +1,406 @@
+/*
+ * m68kcache.c - Predecoded block cache for the Musashi execute loop.
+ *
+ * See m68kcache.h for the overview.
+ *
+ * A block is a run of up to M68KCACHE_MAX_INSNS instructions that starts
+ * at a given PC and stays within one 4 KB page. It is recorded the first
+ * time the interpreter reaches that PC: each instruction is executed the
+ * normal way while its PC, opcode word, handler and base cycle cost are
+ * appended to the block. Recording stops after a control-flow opcode
+ * (branches, jumps, returns, traps, line-A/F, ILLEGAL - which is how
+ * EMU_CALLs enter the host), when the PC leaves the page or when the
+ * block is full.
+ *
+ * Replay checks REG_PC against the recorded PC before every entry, so a
+ * branch that goes the other way, an exception or an interrupt simply
+ * ends the block and control returns to the execute loop. Code that
+ * patches the instruction right behind itself is caught the same way:
+ * invalidating the page of the block being replayed poisons the PCs of
+ * its remaining entries.
+ *
+ * The loop comes in two variants selected by m68k_cache_set_fast_mode():
+ * the debug one calls the instruction hook and snapshots the data/address
+ * registers (for bus error rollback) before every instruction, exactly
+ * like the stock Musashi loop; the fast one calls the hook once per block
+ * dispatch and skips the snapshot. Only the fast one runs recognised
+ * copy/fill loops in bulk (m68kidiom.h) before replaying them, and only
+ * the fast one watches polling loops for busy-waits.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "m68kcpu.h"
+#include "m68kcache.h"
+#include "m68kidiom.h"
+
+extern void (*m68ki_instruction_jump_table[0x10000])(void);
+
+typedef struct
+{
+    uint32_t          pc;       /* start PC, M68KCACHE_NO_PC when empty */
+    uint              gen;      /* page generation at record time */
+    int               count;
+    m68k_cache_insn_t insn[M68KCACHE_MAX_INSNS];
+    int               idiom;    /* M68K_IDIOM_*, bulk-run in the fast loop */
+} m68k_cache_block_t;
+
+#define M68KCACHE_NO_PC         0xffffffff
+#define M68KCACHE_HASH(pc)      (((pc) >> 1) & (M68KCACHE_NUM_BLOCKS - 1))
+
+LXA_INSTANCE_LOCAL uint8_t m68k_cache_page_flags[M68KCACHE_NUM_PAGES];
+
+static LXA_INSTANCE_LOCAL uint32_t            s_page_gen[M68KCACHE_NUM_PAGES];
+static LXA_INSTANCE_LOCAL m68k_cache_block_t *s_blocks;        /* M68KCACHE_NUM_BLOCKS, allocated on first run */
+static LXA_INSTANCE_LOCAL m68k_cache_block_t *s_running;       /* block being replayed, if any */
+static LXA_INSTANCE_LOCAL int                 s_fast_mode = 0;
+static LXA_INSTANCE_LOCAL int                 s_spin_detect = 0;
+static LXA_INSTANCE_LOCAL int                 s_spin_detected = 0;
+static uint8_t                                s_ends_block[0x10000 / 8];    /* shared by all instances */
+static pthread_once_t                         s_ends_block_once = PTHREAD_ONCE_INIT;
+
+static void _init_ends_block(void)
+{
+    void (*illegal)(void) = m68ki_instruction_jump_table[0x4afc];
+    uint op;
+
+    memset(s_ends_block, 0, sizeof(s_ends_block));
+
+    for (op = 0; op < 0x10000; op++)
+    {
+        int ends = 0;
+
+        if (m68ki_instruction_jump_table[op] == illegal)
+            ends = 1;                           /* ILLEGAL / EMU_CALL / unimplemented */
+        else if ((op & 0xf000) == 0x6000)
+            ends = 1;                           /* Bcc, BRA, BSR */
+        else if ((op & 0xf0f8) == 0x50c8)
+            ends = 1;                           /* DBcc */
+        else if ((op & 0xf0f8) == 0x50f8)
+            ends = 1;                           /* TRAPcc */
+        else if ((op & 0xff80) == 0x4e80)
+            ends = 1;                           /* JSR, JMP */
+        else if ((op & 0xfff0) == 0x4e40)
+            ends = 1;                           /* TRAP */
+        else if ((op & 0xfff8) == 0x4e70 && op != 0x4e71)
+            ends = 1;                           /* RESET, STOP, RTE, RTD, RTS, TRAPV, RTR */
+        else if ((op & 0xfffe) == 0x4e7a)
+            ends = 1;                           /* MOVEC */
+        else if ((op & 0xffc0) == 0x46c0)
+            ends = 1;                           /* MOVE to SR */
+        else if (op == 0x007c || op == 0x027c || op == 0x0a7c)
+            ends = 1;                           /* ORI/ANDI/EORI to SR */
+        else if ((op & 0xf000) == 0xa000 || (op & 0xf000) == 0xf000)
+            ends = 1;                           /* line A, line F (FPU, PMMU) */
+        else if ((op & 0xfff8) == 0x4848)
+            ends = 1;                           /* BKPT */
+
+        if (ends)
+            s_ends_block[op >> 3] |= 1 << (op & 7);
+    }
+}
+
+static inline int _ends_block(uint ir)
+{
+    return s_ends_block[ir >> 3] & (1 << (ir & 7));
+}
+
+void m68k_cache_flush(void)
+{
+    int i;
+
+    for (i = 0; s_blocks && i < M68KCACHE_NUM_BLOCKS; i++)
+        s_blocks[i].pc = M68KCACHE_NO_PC;
+
+    for (i = 0; i < M68KCACHE_NUM_PAGES; i++)
+        m68k_cache_page_flags[i] &= ~M68KCACHE_PAGE_CODE;
+}
+
+void m68k_cache_set_cacheable(uint32_t start, uint32_t end)
+{
+    uint32_t page;
+
+    if (start > 0xffffff)
+        return;
+    if (end > 0xffffff)
+        end = 0xffffff;
+
+    for (page = start >> M68KCACHE_PAGE_SHIFT; page <= (end >> M68KCACHE_PAGE_SHIFT); page++)
+        m68k_cache_page_flags[page] |= M68KCACHE_PAGE_CACHEABLE;
+}
+
+void m68k_cache_invalidate_range(uint32_t address, uint32_t size)
+{
+    uint32_t first, last, page;
+
+    if (size == 0)
+        return;
+
+    first = (address & 0xffffff) >> M68KCACHE_PAGE_SHIFT;
+    last  = ((address + size - 1) & 0xffffff) >> M68KCACHE_PAGE_SHIFT;
+
+    for (page = first; ; page = (page + 1) & (M68KCACHE_NUM_PAGES - 1))
+    {
+        if (m68k_cache_page_flags[page] & M68KCACHE_PAGE_CODE)
+        {
+            m68k_cache_page_flags[page] &= ~M68KCACHE_PAGE_CODE;
+            s_page_gen[page]++;
+
+            /* A store into the block being replayed: poison its remaining
+             * entries so the per-entry PC check ends the replay. */
+            if (s_running && (s_running->pc >> M68KCACHE_PAGE_SHIFT) == page)
+            {
+                int i;
+                for (i = 0; i < s_running->count; i++)
+                    s_running->insn[i].pc = M68KCACHE_NO_PC;
+                s_running->pc = M68KCACHE_NO_PC;
+                s_running = NULL;
+            }
+        }
+        if (page == last)
+            break;
+    }
+}
+
+void m68k_cache_set_fast_mode(int enable)
+{
+    s_fast_mode = enable != 0;
+}
+
+void m68k_cache_set_spin_detect(int enable)
+{
+    s_spin_detect   = enable != 0;
+    s_spin_detected = 0;
+}
+
+int m68k_cache_spin_detected(void)
+{
+    int detected = s_spin_detected;
+
+    s_spin_detected = 0;
+    return detected;
+}
+
+/*
+ * Common per-instruction prologue, identical to the m68k_execute() loop in
+ * the debug variant. The functions below take `debug` as a compile-time
+ * constant so each variant is compiled without the other's tests.
+ */
+static inline __attribute__((always_inline)) void _insn_prologue(int debug)
+{
+    m68ki_trace_t1(); /* auto-disable (see m68kcpu.h) */
+    m68ki_use_data_space(); /* auto-disable (see m68kcpu.h) */
+    if (debug)
+        m68ki_instr_hook(REG_PC); /* auto-disable (see m68kcpu.h) */
+
+    REG_PPC = REG_PC;
+    if (debug)
+        memcpy(REG_DA_SAVE, REG_DA, sizeof(REG_DA_SAVE));
+}
+
+/* Plain interpreter step for PCs the cache cannot handle. */
+static inline __attribute__((always_inline)) void _step_uncached(int debug)
+{
+    _insn_prologue(debug);
+    REG_IR = m68ki_read_imm_16();
+    m68ki_instruction_jump_table[REG_IR]();
+    USE_CYCLES(CYC_INSTRUCTION[REG_IR]);
+    m68ki_exception_if_trace(); /* auto-disable (see m68kcpu.h) */
+}
+
+static inline __attribute__((always_inline)) void _record_block(m68k_cache_block_t *blk, uint pc, uint page, int debug)
+{
+    uint gen = s_page_gen[page];
+    int  count = 0;
+
+    /* Flag the page first so stores made while recording retire it. */
+    blk->pc = M68KCACHE_NO_PC;
+    m68k_cache_page_flags[page] |= M68KCACHE_PAGE_CODE;
+
+    for (;;)
+    {
+        m68k_cache_insn_t *in = &blk->insn[count];
+
+        _insn_prologue(debug);
+
+        in->pc      = REG_PC;
+        REG_IR      = m68ki_read_imm_16();
+        in->ir      = REG_IR;
+        in->handler = m68ki_instruction_jump_table[REG_IR];
+        in->cycles  = CYC_INSTRUCTION[REG_IR];
+        count++;
+
+        in->handler();
+        USE_CYCLES(in->cycles);
+        m68ki_exception_if_trace(); /* auto-disable (see m68kcpu.h) */
+
+        if (_ends_block(in->ir) || count == M68KCACHE_MAX_INSNS ||
+            s_page_gen[page] != gen || (REG_PC >> M68KCACHE_PAGE_SHIFT) != page ||
+            PMMU_ENABLED || GET_CYCLES() <= 0)
+            break;
+    }
+
+    if (s_page_gen[page] == gen)
+    {
+        blk->gen    = gen;
+        blk->count  = count;
+        blk->idiom  = m68k_idiom_classify(blk->insn, count);
+        blk->pc     = pc;
+    }
+}
+
+/* Replay a recorded block; returns at the first divergence. */
+static inline __attribute__((always_inline)) void _replay_block(m68k_cache_block_t *blk, int debug)
+{
+    int i;
+
+    s_running = blk;
+
+    for (i = 0; i < blk->count; i++)
+    {
+        const m68k_cache_insn_t *in = &blk->insn[i];
+
+        if (REG_PC != in->pc)
+            break;
+
+        _insn_prologue(debug);
+
+        if (debug && __builtin_expect(REG_PC != in->pc, 0))
+        {
+            /* The instruction hook (debugger) moved the PC or patched
+             * the code: fall back to a plain fetch for this entry. */
+            s_running = NULL;
+            REG_IR = m68ki_read_imm_16();
+            m68ki_instruction_jump_table[REG_IR]();
+            USE_CYCLES(CYC_INSTRUCTION[REG_IR]);
+            m68ki_exception_if_trace(); /* auto-disable (see m68kcpu.h) */
+            return;
+        }
+
+        REG_IR = in->ir;
+        REG_PC += 2;
+        in->handler();
+        USE_CYCLES(in->cycles);
+        m68ki_exception_if_trace(); /* auto-disable (see m68kcpu.h) */
+
+        if (GET_CYCLES() <= 0)
+            break;
+    }
+
+    s_running = NULL;
+}
+
+/*
+ * Replay a polling loop (M68K_IDIOM_SPIN). If one pass brought the PC back
+ * to the loop head with every register and flag unchanged, the next pass
+ * will do the same until an interrupt or the host changes something:
+ * give up the rest of the timeslice and tell the host.
+ */
+static void _replay_spin(m68k_cache_block_t *blk)
+{
+    uint pc = REG_PC;
+    uint sr = m68ki_get_sr();
+    uint da[16];
+
+    memcpy(da, REG_DA, sizeof(da));
+    _replay_block(blk, 0);
+
+    if (REG_PC == pc && m68ki_get_sr() == sr && memcmp(da, REG_DA, sizeof(da)) == 0)
+    {
+        s_spin_detected = 1;
+        m68k_end_timeslice_used();
+    }
+}
+
+static inline __attribute__((always_inline)) void _run(int debug)
+{
+    do
+    {
+        uint                pc = REG_PC;
+        uint                page = (pc >> M68KCACHE_PAGE_SHIFT) & (M68KCACHE_NUM_PAGES - 1);
+        m68k_cache_block_t *blk;
+
+        if (!debug)
+        {
+            m68ki_instr_hook(pc); /* auto-disable (see m68kcpu.h) */
+
+            /* The hook entered the debugger and turned on stepping or a
+             * breakpoint: run this instruction without a second hook call
+             * and let the debug loop take over. */
+            if (__builtin_expect(!s_fast_mode || REG_PC != pc, 0))
+            {
+                _step_uncached(0);
+                break;
+            }
+        }
+
+        if (pc > 0xffffff || PMMU_ENABLED ||
+            !(m68k_cache_page_flags[page] & M68KCACHE_PAGE_CACHEABLE))
+        {
+            _step_uncached(debug);
+            continue;
+        }
+
+        blk = &s_blocks[M68KCACHE_HASH(pc)];
+        if (blk->pc != pc || blk->gen != s_page_gen[page])
+        {
+            _record_block(blk, pc, page, debug);
+            continue;
+        }
+
+        if (!debug && blk->idiom == M68K_IDIOM_SPIN && s_spin_detect)
+        {
+            _replay_spin(blk);
+            continue;
+        }
+
+        if (!debug && blk->idiom != M68K_IDIOM_NONE)
+            m68k_idiom_run(blk->idiom, blk->insn, blk->count);
+
+        _replay_block(blk, debug);
+    } while (GET_CYCLES() > 0 && s_fast_mode == !debug);
+}
+
+static void _run_fast(void)
+{
+    _run(0);
+}
+
+static void _run_debug(void)
+{
+    _run(1);
+}
+
+void m68k_cache_release(void)
+{
+    free(s_blocks);
+    s_blocks  = NULL;
+    s_running = NULL;
+}
+
+void m68k_cache_run(void)
+{
+    pthread_once(&s_ends_block_once, _init_ends_block);
+
+    if (!s_blocks)
+    {
+        s_blocks = malloc(M68KCACHE_NUM_BLOCKS * sizeof(m68k_cache_block_t));
+        if (!s_blocks)
+        {
+            while (GET_CYCLES() > 0)        /* out of memory: plain interpreter */
+                _step_uncached(1);
+            return;
+        }
+        m68k_cache_flush();
+    }
+
+    do
+    {
+        if (s_fast_mode)
+            _run_fast();
+        else
+            _run_debug();
+    } while (GET_CYCLES() > 0);
+}
@@ -0,0 +1,104 @@
+#ifndef M68KCACHE__HEADER
+#define M68KCACHE__HEADER
+
+/*
+ * m68kcache.h - Predecoded block cache for the Musashi execute loop.
+ *
+ * CPU throughput without swapping the core.
+ *
+ * m68k_execute() normally re-fetches every opcode word, looks it up in the
+ * 64K handler table and fetches its cycle cost on every pass through a hot
+ * loop. The block cache records straight-line runs of instructions keyed
+ * by their start PC (opcode word, handler pointer and cycle cost per
+ * entry) and replays them on later visits, skipping the fetch/decode step.
+ * Extension words and effective addresses are still evaluated by the
+ * Musashi handlers, so replay is bit-exact with the interpreter.
+ *
+ * Invalidation is per 4 KB page of the 24-bit address space: every page
+ * that holds a recorded block is flagged as a code page, and any write to
+ * a flagged page (m68k_write_memory_*, or host writes reported through
+ * m68k_cache_invalidate_range()) bumps the page generation, which retires
+ * every block recorded on it.
+ */
+
+#include <stdint.h>
+
+#include "lxa_instance.h"
+
+#define M68KCACHE_PAGE_SHIFT    12
+#define M68KCACHE_NUM_PAGES     (1 << (24 - M68KCACHE_PAGE_SHIFT))
+#define M68KCACHE_NUM_BLOCKS    4096        /* direct-mapped, power of two */
+#define M68KCACHE_MAX_INSNS     24          /* entries per block */
+
+/* m68k_cache_page_flags[] bits */
+#define M68KCACHE_PAGE_CACHEABLE 0x01       /* plain RAM/ROM, safe to record */
+#define M68KCACHE_PAGE_CODE      0x02       /* at least one block recorded */
+
+extern LXA_INSTANCE_LOCAL uint8_t m68k_cache_page_flags[M68KCACHE_NUM_PAGES];
+
+/* One predecoded instruction of a block (shared with m68kidiom.c) */
+typedef struct
+{
+    uint32_t pc;                /* address of the opcode word */
+    uint32_t ir;                /* opcode word */
+    void   (*handler)(void);    /* m68ki_instruction_jump_table[ir] */
+    int      cycles;            /* CYC_INSTRUCTION[ir] at record time */
+} m68k_cache_insn_t;
+
+/* Forget every recorded block (reset, CPU type change). */
+void m68k_cache_flush(void);
+
+/* Free the block table of this instance (lxa_shutdown()). */
+void m68k_cache_release(void);
+
+/* Mark [start, end] as plain memory whose code may be cached. */
+void m68k_cache_set_cacheable(uint32_t start, uint32_t end);
+
+/* Retire all blocks on pages overlapping [address, address + size). */
+void m68k_cache_invalidate_range(uint32_t address, uint32_t size);
+
+/*
+ * Write barrier for the memory handlers: cheap flag test, only calls out
+ * when the write hits a page that holds recorded code. Only the first and
+ * last page are tested, so this is for CPU-sized (1 to 4 byte) stores;
+ * longer host writes must use m68k_cache_invalidate_range().
+ */
+static inline void m68k_cache_note_write(uint32_t address, uint32_t size)
+{
+    uint32_t first = (address & 0xffffff) >> M68KCACHE_PAGE_SHIFT;
+    uint32_t last  = ((address + size - 1) & 0xffffff) >> M68KCACHE_PAGE_SHIFT;
+
+    if (__builtin_expect((m68k_cache_page_flags[first] | m68k_cache_page_flags[last]) & M68KCACHE_PAGE_CODE, 0))
+        m68k_cache_invalidate_range(address, size);
+}
+
+/*
+ * Select the execute loop variant. The default (debug) loop calls the
+ * instruction hook and saves the registers for bus error rollback before
+ * every instruction. The fast loop calls the hook only when it dispatches
+ * a block (the first instruction of every run, so every branch target)
+ * and keeps no rollback copy, so it must not be combined with
+ * m68k_pulse_bus_error(). Takes effect at the next block dispatch.
+ */
+void m68k_cache_set_fast_mode(int enable);
+
+/*
+ * Busy-wait detection for the fast loop. When enabled, a short loop that
+ * only reads memory (m68kidiom.h, M68K_IDIOM_SPIN) and completes a pass
+ * without changing any register or flag ends the timeslice early: nothing
+ * the CPU can do will change the outcome before the next interrupt.
+ * m68k_cache_spin_detected() reports (and clears) whether that happened
+ * since the last call, so the host can sleep until its next event instead
+ * of feeding the loop more cycles.
+ */
+void m68k_cache_set_spin_detect(int enable);
+int  m68k_cache_spin_detected(void);
+
+/*
+ * Body of the m68k_execute() loop: run blocks (recording them on a miss)
+ * until the cycle budget is used up. PCs outside cacheable memory and
+ * code running with the PMMU enabled take the plain fetch/decode path.
+ */
+void m68k_cache_run(void);
+
+#endif /* M68KCACHE__HEADER */
@@ -171,6 +171,14 @@ void cpu_instr_callback(int pc);
 #define M68K_EMULATE_PREFETCH       OPT_OFF
 
 
+/* If ON, opcode and extension word fetches are served straight from a host
+ * memory window supplied by the fetch callback (see m68k_set_fetch_callback())
+ * instead of going through m68k_read_memory_16/32().  Ignored while the
+ * PMMU is enabled or M68K_EMULATE_PREFETCH is on.
+ */
+#define M68K_DIRECT_FETCH           OPT_ON
+
+
 /* If ON, the CPU will generate address error exceptions if it tries to
  * access a word or longword at an odd address.
  * NOTE: This is only emulated properly for 68000 mode.
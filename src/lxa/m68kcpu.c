@@ -38,6 +38,8 @@
 /* ================================ INCLUDES ============================== */
 /* ======================================================================== */
 
+#include <pthread.h>
+
 extern void m68040_fpu_op0(void);
 extern void m68040_fpu_op1(void);
 extern void m68881_mmu_ops();
@@ -47,6 +49,7 @@ extern void m68ki_build_opcode_table(void);
 
 #include "m68kops.h"
 #include "m68kcpu.h"
+#include "m68kcache.h"
 
 #include "m68kfpu.c"
 #include "m68kmmu.h" // uses some functions from m68kfpu.c which are static !
@@ -55,10 +58,10 @@ extern void m68ki_build_opcode_table(void);
 /* ================================= DATA ================================= */
 /* ======================================================================== */
 
-int  m68ki_initial_cycles;
-int  m68ki_remaining_cycles = 0;                     /* Number of clocks remaining */
-uint m68ki_tracing = 0;
-uint m68ki_address_space;
+LXA_INSTANCE_LOCAL int  m68ki_initial_cycles;
+LXA_INSTANCE_LOCAL int  m68ki_remaining_cycles = 0;  /* Number of clocks remaining */
+LXA_INSTANCE_LOCAL uint m68ki_tracing = 0;
+LXA_INSTANCE_LOCAL uint m68ki_address_space;
 
 #ifdef M68K_LOG_ENABLE
 const char *const m68ki_cpu_names[] =
@@ -76,21 +79,21 @@ const char *const m68ki_cpu_names[] =
 #endif /* M68K_LOG_ENABLE */
 
 /* The CPU core */
-m68ki_cpu_core m68ki_cpu = {0};
+LXA_INSTANCE_LOCAL m68ki_cpu_core m68ki_cpu = {0};
 
 #if M68K_EMULATE_ADDRESS_ERROR
 #ifdef _BSD_SETJMP_H
-sigjmp_buf m68ki_aerr_trap;
+LXA_INSTANCE_LOCAL sigjmp_buf m68ki_aerr_trap;
 #else
-jmp_buf m68ki_aerr_trap;
+LXA_INSTANCE_LOCAL jmp_buf m68ki_aerr_trap;
 #endif
 #endif /* M68K_EMULATE_ADDRESS_ERROR */
 
-uint    m68ki_aerr_address;
-uint    m68ki_aerr_write_mode;
-uint    m68ki_aerr_fc;
+LXA_INSTANCE_LOCAL uint    m68ki_aerr_address;
+LXA_INSTANCE_LOCAL uint    m68ki_aerr_write_mode;
+LXA_INSTANCE_LOCAL uint    m68ki_aerr_fc;
 
-jmp_buf m68ki_bus_error_jmp_buf;
+LXA_INSTANCE_LOCAL jmp_buf m68ki_bus_error_jmp_buf;
 
 /* Used by shift & rotate instructions */
 const uint8 m68ki_shift_8_table[65] =
@@ -597,6 +600,24 @@ static void default_instr_hook_callback(unsigned int pc)
 	(void)pc;
 }
 
+/* Called when a recognised copy/fill loop wants bulk access to memory */
+static unsigned char *default_host_memory_callback(unsigned int address, unsigned int *size, int write)
+{
+	(void)address;
+	(void)write;
+	*size = 0;
+	return NULL;
+}
+
+/* Called when the PC leaves the direct fetch window */
+static const unsigned char *default_fetch_page_callback(unsigned int address, unsigned int *base, unsigned int *size)
+{
+	(void)address;
+	*base = 0;
+	*size = 0;
+	return NULL;
+}
+
 
 #if M68K_EMULATE_ADDRESS_ERROR
 	#include <setjmp.h>
@@ -774,9 +795,50 @@ void m68k_set_instr_hook_callback(void  (*callback)(unsigned int pc))
 	CALLBACK_INSTR_HOOK = callback ? callback : default_instr_hook_callback;
 }
 
+void m68k_set_fetch_callback(const unsigned char *(*callback)(unsigned int address, unsigned int *base, unsigned int *size))
+{
+	CALLBACK_FETCH_PAGE = callback ? callback : default_fetch_page_callback;
+	m68k_invalidate_fetch();
+}
+
+void m68k_set_host_memory_callback(unsigned char *(*callback)(unsigned int address, unsigned int *size, int write))
+{
+	CALLBACK_HOST_MEMORY = callback ? callback : default_host_memory_callback;
+}
+
+void m68k_invalidate_fetch(void)
+{
+	CPU_FETCH_HOST = NULL;
+	CPU_FETCH_BASE = 0;
+	CPU_FETCH_SIZE = 0;
+}
+
+#if M68K_DIRECT_FETCH && !M68K_EMULATE_PREFETCH
+/* The PC left the fetch window, ask the host for the new one */
+void m68ki_fetch_refill(void)
+{
+	uint base, size;
+	const unsigned char *host = CALLBACK_FETCH_PAGE(ADDRESS_68K(REG_PC), &base, &size);
+
+	if (host == NULL)
+	{
+		m68k_invalidate_fetch();
+		return;
+	}
+
+	CPU_FETCH_HOST = host;
+	CPU_FETCH_BASE = base;
+	CPU_FETCH_SIZE = size;
+}
+#endif /* M68K_DIRECT_FETCH && !M68K_EMULATE_PREFETCH */
+
 /* Set the CPU type. */
 void m68k_set_cpu_type(unsigned int cpu_type)
 {
+	/* Cached cycle costs and the address mask depend on the CPU type */
+	m68k_cache_flush();
+	m68k_invalidate_fetch();
+
 	switch(cpu_type)
 	{
 		case M68K_CPU_TYPE_68000:
@@ -968,34 +1030,10 @@ int m68k_execute(int num_cycles)
 		m68ki_check_bus_error_trap();
 
 		/* Main loop.  Keep going until we run out of clock cycles */
-		do
-		{
-			int i;
-			/* Set tracing accodring to T1. (T0 is done inside instruction) */
-			m68ki_trace_t1(); /* auto-disable (see m68kcpu.h) */
-
-			/* Set the address space for reads */
-			m68ki_use_data_space(); /* auto-disable (see m68kcpu.h) */
-
-			/* Call external hook to peek at CPU */
-			m68ki_instr_hook(REG_PC); /* auto-disable (see m68kcpu.h) */
-
-			/* Record previous program counter */
-			REG_PPC = REG_PC;
-
-			/* Record previous D/A register state (in case of bus error) */
-			for (i = 15; i >= 0; i--){
-				REG_DA_SAVE[i] = REG_DA[i];
-			}
-
-			/* Read an instruction and call its handler */
-			REG_IR = m68ki_read_imm_16();
-			m68ki_instruction_jump_table[REG_IR]();
-			USE_CYCLES(CYC_INSTRUCTION[REG_IR]);
-
-			/* Trace m68k_exception, if necessary */
-			m68ki_exception_if_trace(); /* auto-disable (see m68kcpu.h) */
-		} while(GET_CYCLES() > 0);
+		/* Instructions are dispatched through the predecoded
+		 * block cache (m68kcache.c), which falls back to a plain
+		 * fetch/decode step for PCs it cannot cache. */
+		m68k_cache_run();
 
 		/* set previous PC to current PC for the next entry into the loop */
 		REG_PPC = REG_PC;
@@ -1032,6 +1070,13 @@ void m68k_end_timeslice(void)
 	SET_CYCLES(0);
 }
 
+/* lxa: end the timeslice, m68k_execute() returns the cycles actually run */
+void m68k_end_timeslice_used(void)
+{
+	m68ki_initial_cycles -= GET_CYCLES();
+	SET_CYCLES(0);
+}
+
 
 /* ASG: rewrote so that the int_level is a mask of the IPL0/IPL1/IPL2 bits */
 /* KS: Modified so that IPL* bits match with mask positions in the SR
@@ -1072,14 +1117,10 @@ unsigned int m68k_get_virq(unsigned int level)
 
 void m68k_init(void)
 {
-	static uint emulation_initialized = 0;
+	/* The opcode handler jump table is shared by all instances: build it once */
+	static pthread_once_t opcode_table_once = PTHREAD_ONCE_INIT;
 
-	/* The first call to this function initializes the opcode handler jump table */
-	if(!emulation_initialized)
-		{
-		m68ki_build_opcode_table();
-		emulation_initialized = 1;
-	}
+	pthread_once(&opcode_table_once, m68ki_build_opcode_table);
 
 	m68k_set_int_ack_callback(NULL);
 	m68k_set_bkpt_ack_callback(NULL);
@@ -1091,6 +1132,8 @@ void m68k_init(void)
 	m68k_set_pc_changed_callback(NULL);
 	m68k_set_fc_callback(NULL);
 	m68k_set_instr_hook_callback(NULL);
+	m68k_set_fetch_callback(NULL);
+	m68k_set_host_memory_callback(NULL);
 }
 
 /* Trigger a Bus Error exception */
@@ -1105,6 +1148,10 @@ void m68k_pulse_reset(void)
 	/* Disable the PMMU on reset */
 	m68ki_cpu.pmmu_enabled = 0;
 
+	/* Drop predecoded blocks and the fetch window */
+	m68k_cache_flush();
+	m68k_invalidate_fetch();
+
 	/* Clear all stop levels and eat up all remaining cycles */
 	CPU_STOPPED = 0;
 	SET_CYCLES(0);
@@ -1165,6 +1212,33 @@ void m68k_set_context(void* src)
 	if(src) m68ki_cpu = *(m68ki_cpu_core*)src;
 }
 
+void m68k_set_context_state(const void* src)
+{
+	m68ki_cpu_core cpu = m68ki_cpu;
+
+	if(!src)
+		return;
+
+	m68ki_cpu = *(const m68ki_cpu_core*)src;
+
+	m68ki_cpu.cyc_instruction = cpu.cyc_instruction;
+	m68ki_cpu.cyc_exception = cpu.cyc_exception;
+	m68ki_cpu.int_ack_callback = cpu.int_ack_callback;
+	m68ki_cpu.bkpt_ack_callback = cpu.bkpt_ack_callback;
+	m68ki_cpu.reset_instr_callback = cpu.reset_instr_callback;
+	m68ki_cpu.cmpild_instr_callback = cpu.cmpild_instr_callback;
+	m68ki_cpu.rte_instr_callback = cpu.rte_instr_callback;
+	m68ki_cpu.tas_instr_callback = cpu.tas_instr_callback;
+	m68ki_cpu.illg_instr_callback = cpu.illg_instr_callback;
+	m68ki_cpu.pc_changed_callback = cpu.pc_changed_callback;
+	m68ki_cpu.set_fc_callback = cpu.set_fc_callback;
+	m68ki_cpu.instr_hook_callback = cpu.instr_hook_callback;
+	m68ki_cpu.fetch_page_callback = cpu.fetch_page_callback;
+	m68ki_cpu.host_memory_callback = cpu.host_memory_callback;
+
+	m68k_invalidate_fetch();
+}
+
 /* ======================================================================== */
 /* ============================== MAME STUFF ============================== */
 /* ======================================================================== */
@@ -38,6 +38,7 @@ extern "C" {
 #endif
 
 #include "m68k.h"
+#include "lxa_instance.h"
 
 #include <limits.h>
 
@@ -364,6 +365,9 @@ typedef uint32 uint64;
 #define CPU_STOPPED      m68ki_cpu.stopped
 #define CPU_PREF_ADDR    m68ki_cpu.pref_addr
 #define CPU_PREF_DATA    m68ki_cpu.pref_data
+#define CPU_FETCH_HOST   m68ki_cpu.fetch_host
+#define CPU_FETCH_BASE   m68ki_cpu.fetch_base
+#define CPU_FETCH_SIZE   m68ki_cpu.fetch_size
 #define CPU_ADDRESS_MASK m68ki_cpu.address_mask
 #define CPU_SR_MASK      m68ki_cpu.sr_mask
 #define CPU_INSTR_MODE   m68ki_cpu.instr_mode
@@ -395,6 +399,8 @@ typedef uint32 uint64;
 #define CALLBACK_PC_CHANGED  m68ki_cpu.pc_changed_callback
 #define CALLBACK_SET_FC      m68ki_cpu.set_fc_callback
 #define CALLBACK_INSTR_HOOK  m68ki_cpu.instr_hook_callback
+#define CALLBACK_FETCH_PAGE  m68ki_cpu.fetch_page_callback
+#define CALLBACK_HOST_MEMORY m68ki_cpu.host_memory_callback
 
 
 
@@ -604,7 +610,7 @@ typedef uint32 uint64;
 
 /* sigjmp() on Mac OS X and *BSD in general saves signal contexts and is super-slow, use sigsetjmp() to tell it not to */
 #ifdef _BSD_SETJMP_H
-extern sigjmp_buf m68ki_aerr_trap;
+extern LXA_INSTANCE_LOCAL sigjmp_buf m68ki_aerr_trap;
 #define m68ki_set_address_error_trap(m68k) \
 	if(sigsetjmp(m68ki_aerr_trap, 0) != 0) \
 	{ \
@@ -626,7 +632,7 @@ extern sigjmp_buf m68ki_aerr_trap;
 		siglongjmp(m68ki_aerr_trap, 1); \
 	}
 #else
-extern jmp_buf m68ki_aerr_trap;
+extern LXA_INSTANCE_LOCAL jmp_buf m68ki_aerr_trap;
 	#define m68ki_set_address_error_trap() \
 		if(setjmp(m68ki_aerr_trap) != 0) \
 		{ \
@@ -955,6 +961,9 @@ typedef struct
 	uint stopped;      /* Stopped state */
 	uint pref_addr;    /* Last prefetch address */
 	uint pref_data;    /* Data in the prefetch queue */
+	const uint8* fetch_host; /* Host bytes of the direct fetch window */
+	uint fetch_base;   /* Address of the first byte of the fetch window */
+	uint fetch_size;   /* Size of the fetch window, 0 if none */
 	uint address_mask; /* Available address pins */
 	uint sr_mask;      /* Implemented status register bits */
 	uint instr_mode;   /* Stores whether we are in instruction mode or group 0/1 exception mode */
@@ -1009,23 +1018,25 @@ typedef struct
 	void (*pc_changed_callback)(unsigned int new_pc); /* Called when the PC changes by a large amount */
 	void (*set_fc_callback)(unsigned int new_fc);     /* Called when the CPU function code changes */
 	void (*instr_hook_callback)(unsigned int pc);     /* Called every instruction cycle prior to execution */
+	const unsigned char *(*fetch_page_callback)(unsigned int address, unsigned int *base, unsigned int *size); /* Maps program space for direct fetch */
+	unsigned char *(*host_memory_callback)(unsigned int address, unsigned int *size, int write); /* Maps data space for bulk loop idioms */
 
 } m68ki_cpu_core;
 
 
-extern m68ki_cpu_core m68ki_cpu;
-extern sint           m68ki_remaining_cycles;
-extern uint           m68ki_tracing;
+extern LXA_INSTANCE_LOCAL m68ki_cpu_core m68ki_cpu;
+extern LXA_INSTANCE_LOCAL sint           m68ki_remaining_cycles;
+extern LXA_INSTANCE_LOCAL uint           m68ki_tracing;
 extern const uint8    m68ki_shift_8_table[];
 extern const uint16   m68ki_shift_16_table[];
 extern const uint     m68ki_shift_32_table[];
 extern const uint8    m68ki_exception_cycle_table[][256];
-extern uint           m68ki_address_space;
+extern LXA_INSTANCE_LOCAL uint           m68ki_address_space;
 extern const uint8    m68ki_ea_idx_cycle_table[];
 
-extern uint           m68ki_aerr_address;
-extern uint           m68ki_aerr_write_mode;
-extern uint           m68ki_aerr_fc;
+extern LXA_INSTANCE_LOCAL uint           m68ki_aerr_address;
+extern LXA_INSTANCE_LOCAL uint           m68ki_aerr_write_mode;
+extern LXA_INSTANCE_LOCAL uint           m68ki_aerr_fc;
 
 /* Forward declarations to keep some of the macros happy */
 static inline uint m68ki_read_16_fc (uint address, uint fc);
@@ -1046,6 +1057,37 @@ char* m68ki_disassemble_quick(unsigned int pc, unsigned int cpu_type);
 
 extern uint pmmu_translate_addr(uint addr_in);
 
+#if M68K_DIRECT_FETCH && !M68K_EMULATE_PREFETCH
+/* Direct instruction fetch.
+ * Opcode and extension words are read straight from the host bytes of the
+ * current fetch window (normally the 64 KB RAM/ROM page the PC is in).
+ * m68ki_fetch_refill() asks the host for a new window when the PC leaves
+ * it; stores are seen immediately since the window aliases guest memory.
+ */
+extern void m68ki_fetch_refill(void);
+
+/* Returns the host pointer for a size-byte fetch at REG_PC, or NULL */
+static inline const uint8* m68ki_fetch_ptr(uint size)
+{
+	uint offset;
+
+#if M68K_EMULATE_PMMU
+	if (PMMU_ENABLED)
+		return NULL;
+#endif
+
+	offset = ADDRESS_68K(REG_PC) - CPU_FETCH_BASE;
+	if (offset >= CPU_FETCH_SIZE || CPU_FETCH_SIZE - offset < size)
+	{
+		m68ki_fetch_refill();
+		offset = ADDRESS_68K(REG_PC) - CPU_FETCH_BASE;
+		if (offset >= CPU_FETCH_SIZE || CPU_FETCH_SIZE - offset < size)
+			return NULL;
+	}
+	return CPU_FETCH_HOST + offset;
+}
+#endif /* M68K_DIRECT_FETCH && !M68K_EMULATE_PREFETCH */
+
 /* Handles all immediate reads, does address error check, function code setting,
  * and prefetching if they are enabled in m68kconf.h
  */
@@ -1076,6 +1118,16 @@ static inline uint m68ki_read_imm_16(void)
 	return result;
 }
 #else
+#if M68K_DIRECT_FETCH
+	{
+		const uint8* p = m68ki_fetch_ptr(2);
+		if (p)
+		{
+			REG_PC += 2;
+			return (p[0] << 8) | p[1];
+		}
+	}
+#endif /* M68K_DIRECT_FETCH */
 	REG_PC += 2;
 	return m68k_read_immediate_16(ADDRESS_68K(REG_PC-2));
 #endif /* M68K_EMULATE_PREFETCH */
@@ -1121,6 +1173,16 @@ static inline uint m68ki_read_imm_32(void)
 #else
 	m68ki_set_fc(FLAG_S | FUNCTION_CODE_USER_PROGRAM); /* auto-disable (see m68kcpu.h) */
 	m68ki_check_address_error(REG_PC, MODE_READ, FLAG_S | FUNCTION_CODE_USER_PROGRAM); /* auto-disable (see m68kcpu.h) */
+#if M68K_DIRECT_FETCH
+	{
+		const uint8* p = m68ki_fetch_ptr(4);
+		if (p)
+		{
+			REG_PC += 4;
+			return ((uint)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+		}
+	}
+#endif /* M68K_DIRECT_FETCH */
 	REG_PC += 4;
 	return m68k_read_immediate_32(ADDRESS_68K(REG_PC-4));
 #endif /* M68K_EMULATE_PREFETCH */
@@ -1916,7 +1978,7 @@ static inline void m68ki_exception_privilege_violation(void)
 	USE_CYCLES(CYC_EXCEPTION[EXCEPTION_PRIVILEGE_VIOLATION] - CYC_INSTRUCTION[REG_IR]);
 }
 
-extern jmp_buf m68ki_bus_error_jmp_buf;
+extern LXA_INSTANCE_LOCAL jmp_buf m68ki_bus_error_jmp_buf;
 
 #define m68ki_check_bus_error_trap() setjmp(m68ki_bus_error_jmp_buf)
 
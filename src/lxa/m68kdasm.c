@@ -36,7 +36,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 #include "m68k.h"
+#include "lxa_instance.h"
 
 #ifndef uint32
 #define uint32 uint
@@ -208,20 +210,20 @@ typedef struct
 
 /* Opcode handler jump table */
 static void (*g_instruction_table[0x10000])(void);
-/* Flag if disassembler initialized */
-static int  g_initialized = 0;
+/* Built once, shared by all emulator instances */
+static pthread_once_t g_initialized = PTHREAD_ONCE_INIT;
 
 /* Address mask to simulate address lines */
-static unsigned int g_address_mask = 0xffffffff;
+static LXA_INSTANCE_LOCAL unsigned int g_address_mask = 0xffffffff;
 
-static char g_dasm_str[100]; /* string to hold disassembly */
-static char g_helper_str[100]; /* string to hold helpful info */
-static uint g_cpu_pc;        /* program counter */
-static uint g_cpu_ir;        /* instruction register */
-static uint g_cpu_type;
-static uint g_opcode_type;
-static const unsigned char* g_rawop;
-static uint g_rawbasepc;
+static LXA_INSTANCE_LOCAL char g_dasm_str[100]; /* string to hold disassembly */
+static LXA_INSTANCE_LOCAL char g_helper_str[100]; /* string to hold helpful info */
+static LXA_INSTANCE_LOCAL uint g_cpu_pc;        /* program counter */
+static LXA_INSTANCE_LOCAL uint g_cpu_ir;        /* instruction register */
+static LXA_INSTANCE_LOCAL uint g_cpu_type;
+static LXA_INSTANCE_LOCAL uint g_opcode_type;
+static LXA_INSTANCE_LOCAL const unsigned char* g_rawop;
+static LXA_INSTANCE_LOCAL uint g_rawbasepc;
 
 /* used by ops like asr, ror, addq, etc */
 static const uint g_3bit_qdata_table[8] = {8, 1, 2, 3, 4, 5, 6, 7};
@@ -354,7 +356,7 @@ static int make_int_32(int value)
 /* Get string representation of hex values */
 static char* make_signed_hex_str_8(uint val)
 {
-	static char str[20];
+	static LXA_INSTANCE_LOCAL char str[20];
 
 	val &= 0xff;
 
@@ -370,7 +372,7 @@ static char* make_signed_hex_str_8(uint val)
 
 static char* make_signed_hex_str_16(uint val)
 {
-	static char str[20];
+	static LXA_INSTANCE_LOCAL char str[20];
 
 	val &= 0xffff;
 
@@ -386,7 +388,7 @@ static char* make_signed_hex_str_16(uint val)
 
 static char* make_signed_hex_str_32(uint val)
 {
-	static char str[20];
+	static LXA_INSTANCE_LOCAL char str[20];
 
 	val &= 0xffffffff;
 
@@ -404,7 +406,7 @@ static char* make_signed_hex_str_32(uint val)
 /* make string of immediate value */
 static char* get_imm_str_s(uint size)
 {
-	static char str[15];
+	static LXA_INSTANCE_LOCAL char str[15];
 	if(size == 0)
 		sprintf(str, "#%s", make_signed_hex_str_8(read_imm_8()));
 	else if(size == 1)
@@ -416,7 +418,7 @@ static char* get_imm_str_s(uint size)
 
 static char* get_imm_str_u(uint size)
 {
-	static char str[15];
+	static LXA_INSTANCE_LOCAL char str[15];
 	if(size == 0)
 		sprintf(str, "#$%x", read_imm_8() & 0xff);
 	else if(size == 1)
@@ -429,9 +431,9 @@ static char* get_imm_str_u(uint size)
 /* Make string of effective address mode */
 static char* get_ea_mode_str(uint instruction, uint size)
 {
-	static char b1[64];
-	static char b2[64];
-	static char* mode = b2;
+	static LXA_INSTANCE_LOCAL char b1[64];
+	static LXA_INSTANCE_LOCAL char b2[64];
+	static LXA_INSTANCE_LOCAL char* mode;
 	uint extension;
 	uint base;
 	uint outer;
@@ -3724,11 +3726,7 @@ static void build_opcode_table(void)
 /* Disasemble one instruction at pc and store in str_buff */
 unsigned int m68k_disassemble(char* str_buff, unsigned int pc, unsigned int cpu_type)
 {
-	if(!g_initialized)
-	{
-		build_opcode_table();
-		g_initialized = 1;
-	}
+	pthread_once(&g_initialized, build_opcode_table);
 	switch(cpu_type)
 	{
 		case M68K_CPU_TYPE_68000:
@@ -3773,7 +3771,7 @@ unsigned int m68k_disassemble(char* str_buff, unsigned int pc, unsigned int cpu_
 
 char* m68ki_disassemble_quick(unsigned int pc, unsigned int cpu_type)
 {
-	static char buff[100];
+	static LXA_INSTANCE_LOCAL char buff[100];
 	buff[0] = 0;
 	m68k_disassemble(buff, pc, cpu_type);
 	return buff;
@@ -3794,11 +3792,7 @@ unsigned int m68k_disassemble_raw(char* str_buff, unsigned int pc, const unsigne
 /* Check if the instruction is a valid one */
 unsigned int m68k_is_valid_instruction(unsigned int instruction, unsigned int cpu_type)
 {
-	if(!g_initialized)
-	{
-		build_opcode_table();
-		g_initialized = 1;
-	}
+	pthread_once(&g_initialized, build_opcode_table);
 
 	instruction &= 0xffff;
 	if(g_instruction_table[instruction] == d68000_illegal)
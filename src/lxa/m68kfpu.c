@@ -1,6 +1,9 @@
 #include <math.h>
+#include <fenv.h>
+#include <float.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 
 extern void exit(int);
 
@@ -60,6 +63,169 @@ static inline floatx80 double_to_fx80(double in)
 	return float64_to_floatx80(*d);
 }
 
+/*
+ * Host FPU mode (m68k_set_fpu_mode()).
+ *
+ * Where long double is the x87 80-bit format it holds a floatx80 bit for
+ * bit, so arithmetic matches the 68881's extended precision; elsewhere the
+ * host works in IEEE double.
+ */
+#define FPSR_EXC_MASK	0x0000ff00
+#define FPSR_EXC_OPERR	0x00002000
+#define FPSR_EXC_OVFL	0x00001000
+#define FPSR_EXC_UNFL	0x00000800
+#define FPSR_EXC_DZ		0x00000400
+#define FPSR_EXC_INEX2	0x00000200
+#define FPSR_AEXC_IOP	0x00000080
+#define FPSR_AEXC_OVFL	0x00000040
+#define FPSR_AEXC_UNFL	0x00000020
+#define FPSR_AEXC_DZ	0x00000010
+#define FPSR_AEXC_INEX	0x00000008
+
+static LXA_INSTANCE_LOCAL int s_fpu_mode = M68K_FPU_EXACT;
+
+void m68k_set_fpu_mode(int mode)
+{
+	s_fpu_mode = mode;
+}
+
+#if LDBL_MANT_DIG == 64 && LDBL_MAX_EXP == 16384
+#define FPU_HOST_X87 1
+#define FPU_HOST_FN(f) f##l
+typedef long double fpu_host_t;
+#else
+#define FPU_HOST_FN(f) f
+typedef double fpu_host_t;
+#endif
+
+static inline fpu_host_t fx80_to_host(floatx80 fx)
+{
+#ifdef FPU_HOST_X87
+	long double r = 0.0L;
+	memcpy(&r, &fx.low, 8);
+	memcpy((uint8 *)&r + 8, &fx.high, 2);
+	return r;
+#else
+	return fx80_to_double(fx);
+#endif
+}
+
+static inline floatx80 host_to_fx80(fpu_host_t in)
+{
+#ifdef FPU_HOST_X87
+	floatx80 fx;
+	memcpy(&fx.low, &in, 8);
+	memcpy(&fx.high, (uint8 *)&in + 8, 2);
+	return fx;
+#else
+	return double_to_fx80(in);
+#endif
+}
+
+// host rounding modes in FPCR RND order: RN, RZ, RM, RP
+static const int fpu_host_rounding[4] = { FE_TONEAREST, FE_TOWARDZERO, FE_DOWNWARD, FE_UPWARD };
+
+// FPCR PREC (or single for FSDIV/FSMUL) as the narrowing the host has to do: 0 none, 1 float, 2 double
+static inline int fpu_host_prec(int single)
+{
+	int prec = single ? 1 : (REG_FPCR >> 6) & 3;
+
+#ifndef FPU_HOST_X87
+	if (prec == 2)
+	{
+		prec = 0;	// the host already works in double
+	}
+#endif
+	return prec == 3 ? 0 : prec;
+}
+
+// odd: the operation is narrowed afterwards and has to be computed rounding to odd (fpu_host_round)
+static inline void fpu_host_begin(int odd)
+{
+	feclearexcept(FE_ALL_EXCEPT);
+	if (odd)
+	{
+		fesetround(FE_TOWARDZERO);
+	}
+	else if (REG_FPCR & 0x30)
+	{
+		fesetround(fpu_host_rounding[(REG_FPCR >> 4) & 3]);
+	}
+}
+
+/*
+ * Narrow res to float or double with the FPCR rounding mode.  With odd,
+ * res was computed since fpu_host_begin(1) and is rounded to odd first
+ * (round toward zero, then set the lowest mantissa bit if that was
+ * inexact): the host format has at least two more bits than the target,
+ * so the result is the exact operation rounded once, not twice.  libm
+ * results are not correctly rounded to begin with and are just narrowed.
+ */
+static fpu_host_t fpu_host_round(fpu_host_t res, int prec, int odd_first)
+{
+	volatile fpu_host_t r = res;
+	fpu_host_t odd = res;
+	uint64 mant;
+
+	if (odd_first && fetestexcept(FE_INEXACT))
+	{
+		memcpy(&mant, &odd, 8);		// x87: low half of the 80-bit value
+		mant |= 1;
+		memcpy(&odd, &mant, 8);
+		r = odd;
+	}
+
+	fesetround(fpu_host_rounding[(REG_FPCR >> 4) & 3]);
+	if (prec == 1)
+	{
+		volatile float f = r;
+		r = f;
+	}
+	else
+	{
+		volatile double d = r;
+		r = d;
+	}
+	return r;
+}
+
+// restore the rounding mode, fold host exceptions into the FPSR
+static void fpu_host_end(void)
+{
+	int exc = fetestexcept(FE_ALL_EXCEPT);
+
+	if (REG_FPCR & 0x30)
+	{
+		fesetround(FE_TONEAREST);
+	}
+
+	REG_FPSR &= ~FPSR_EXC_MASK;
+	if (exc & FE_INVALID)
+	{
+		REG_FPSR |= FPSR_EXC_OPERR | FPSR_AEXC_IOP;
+	}
+	if (exc & FE_OVERFLOW)
+	{
+		REG_FPSR |= FPSR_EXC_OVFL | FPSR_AEXC_OVFL | FPSR_AEXC_INEX;
+	}
+	if (exc & FE_UNDERFLOW)
+	{
+		REG_FPSR |= FPSR_EXC_UNFL;
+		if (exc & FE_INEXACT)
+		{
+			REG_FPSR |= FPSR_AEXC_UNFL;
+		}
+	}
+	if (exc & FE_DIVBYZERO)
+	{
+		REG_FPSR |= FPSR_EXC_DZ | FPSR_AEXC_DZ;
+	}
+	if (exc & FE_INEXACT)
+	{
+		REG_FPSR |= FPSR_EXC_INEX2 | FPSR_AEXC_INEX;
+	}
+}
+
 static inline floatx80 load_extended_float80(uint32 ea)
 {
 	uint32 d1,d2;
@@ -1045,6 +1211,124 @@ static void WRITE_EA_PACK(int ea, int k, floatx80 fpr)
 }
 
 
+/*
+ * Arithmetic on the host FPU in M68K_FPU_HOST mode: the common
+ * arithmetic instructions and the transcendental ones (host libm), which
+ * softfloat does not provide.  Returns 0 if the instruction is left to the
+ * softfloat path, always in M68K_FPU_EXACT mode.
+ */
+static int fpgen_host(int opmode, int dst, int cos_reg, floatx80 source)
+{
+	volatile fpu_host_t a, b;
+	volatile fpu_host_t res;
+	int cycles, prec, arith;
+
+	if (s_fpu_mode != M68K_FPU_HOST)
+	{
+		return 0;
+	}
+
+	switch (opmode)
+	{
+		case 0x04: case 0x20: case 0x22: case 0x23:
+		case 0x28: case 0x38: case 0x60: case 0x63:
+			arith = 1;
+			break;
+		case 0x02: case 0x06: case 0x08: case 0x09: case 0x0a:
+		case 0x0c: case 0x0d: case 0x0e: case 0x0f: case 0x10:
+		case 0x11: case 0x12: case 0x14: case 0x15: case 0x16:
+		case 0x19: case 0x1c: case 0x1d:
+		case 0x30: case 0x31: case 0x32: case 0x33:
+		case 0x34: case 0x35: case 0x36: case 0x37:
+			arith = 0;
+			break;
+		default:
+			return 0;
+	}
+
+	a = fx80_to_host(REG_FP[dst]);
+	b = fx80_to_host(source);
+
+	if (opmode == 0x38)		// FCMP: ordered compare, quiet NaNs raise nothing
+	{
+		floatx80 cc;
+
+		if (isunordered(a, b))
+		{
+			cc.high = 0x7fff;
+			cc.low = U64(0xffffffffffffffff);
+		}
+		else if (a == b)
+		{
+			cc.high = signbit(a) ? 0x8000 : 0;	// equal: Z, plus N for -0/-inf
+			cc.low = 0;
+		}
+		else
+		{
+			cc = host_to_fx80(isless(a, b) ? -1.0 : 1.0);
+		}
+		REG_FPSR &= ~FPSR_EXC_MASK;
+		SET_CONDITION_CODES(cc);
+		USE_CYCLES(7);
+		return 1;
+	}
+
+	prec = fpu_host_prec(opmode == 0x60 || opmode == 0x63);
+	fpu_host_begin(prec && arith);
+
+	switch (opmode)
+	{
+		case 0x60:	// FSDIVS
+		case 0x20:	res = a / b;			cycles = 43;  break;	// FDIV
+		case 0x22:	res = a + b;			cycles = 9;   break;	// FADD
+		case 0x63:	// FSMULS
+		case 0x23:	res = a * b;			cycles = 11;  break;	// FMUL
+		case 0x28:	res = a - b;			cycles = 9;   break;	// FSUB
+		case 0x04:	res = FPU_HOST_FN(sqrt)(b);	cycles = 109; break;	// FSQRT
+		case 0x02:	res = FPU_HOST_FN(sinh)(b);	cycles = 687; break;	// FSINH
+		case 0x06:	res = FPU_HOST_FN(log1p)(b);	cycles = 571; break;	// FLOGNP1
+		case 0x08:	res = FPU_HOST_FN(expm1)(b);	cycles = 591; break;	// FETOXM1
+		case 0x09:	res = FPU_HOST_FN(tanh)(b);	cycles = 661; break;	// FTANH
+		case 0x0a:	res = FPU_HOST_FN(atan)(b);	cycles = 403; break;	// FATAN
+		case 0x0c:	res = FPU_HOST_FN(asin)(b);	cycles = 581; break;	// FASIN
+		case 0x0d:	res = FPU_HOST_FN(atanh)(b);	cycles = 693; break;	// FATANH
+		case 0x0e:	res = FPU_HOST_FN(sin)(b);	cycles = 391; break;	// FSIN
+		case 0x0f:	res = FPU_HOST_FN(tan)(b);	cycles = 473; break;	// FTAN
+		case 0x10:	res = FPU_HOST_FN(exp)(b);	cycles = 497; break;	// FETOX
+		case 0x11:	res = FPU_HOST_FN(exp2)(b);	cycles = 567; break;	// FTWOTOX
+		case 0x12:	res = FPU_HOST_FN(pow)(10, b);	cycles = 567; break;	// FTENTOX
+		case 0x14:	res = FPU_HOST_FN(log)(b);	cycles = 525; break;	// FLOGN
+		case 0x15:	res = FPU_HOST_FN(log10)(b);	cycles = 581; break;	// FLOG10
+		case 0x16:	res = FPU_HOST_FN(log2)(b);	cycles = 581; break;	// FLOG2
+		case 0x19:	res = FPU_HOST_FN(cosh)(b);	cycles = 607; break;	// FCOSH
+		case 0x1c:	res = FPU_HOST_FN(acos)(b);	cycles = 581; break;	// FACOS
+		case 0x1d:	res = FPU_HOST_FN(cos)(b);	cycles = 391; break;	// FCOS
+		default:	// FSINCOS: cosine to FPc, sine to FPs, both at the FPCR precision
+		{
+			volatile fpu_host_t c = FPU_HOST_FN(cos)(b);
+			if (prec)
+			{
+				c = fpu_host_round(c, prec, 0);
+			}
+			REG_FP[cos_reg] = host_to_fx80(c);
+			res = FPU_HOST_FN(sin)(b);
+			cycles = 451;
+			break;
+		}
+	}
+
+	if (prec)
+	{
+		res = fpu_host_round(res, prec, arith);
+	}
+	fpu_host_end();
+
+	REG_FP[dst] = host_to_fx80(res);
+	SET_CONDITION_CODES(REG_FP[dst]);
+	USE_CYCLES(cycles);
+	return 1;
+}
+
 static void fpgen_rm_reg(uint16 w2)
 {
 	int ea = REG_IR & 0x3f;
@@ -1178,7 +1462,10 @@ static void fpgen_rm_reg(uint16 w2)
 		source = REG_FP[src];
 	}
 
-
+	if (fpgen_host(opmode, dst, w2 & 7, source))
+	{
+		return;
+	}
 
 	switch (opmode)
 	{
@@ -0,0 +1,368 @@
+/*
+ * m68kidiom.c - Bulk execution of copy, fill and string-scan loops.
+ *
+ * See m68kidiom.h for the overview.
+ *
+ * Every idiom is a loop whose iterations all cost the same number of
+ * cycles except the last one. m68k_idiom_run() therefore only performs
+ * "continuing" iterations - those after which the loop branch is taken
+ * and more than zero cycles remain - and charges exactly their cost. The
+ * state it leaves behind is the state the interpreter reaches at the same
+ * loop head, so the replay that follows takes over seamlessly.
+ */
+
+#include <string.h>
+
+#include "m68kcpu.h"
+#include "m68kidiom.h"
+
+/* Operand shapes */
+#define IS_MOVE_PI_PI(ir)   (((ir) & 0xc1f8) == 0x00d8 && ((ir) >> 12) != 0)
+#define IS_MOVE_D_PI(ir)    (((ir) & 0xc1f8) == 0x00c0 && ((ir) >> 12) != 0)
+#define IS_CLR_PI(ir)       (((ir) & 0xff38) == 0x4218 && ((ir) & 0x00c0) != 0x00c0)
+#define IS_TST_B_PI(ir)     (((ir) & 0xfff8) == 0x4a18)
+#define IS_DBF(ir)          (((ir) & 0xfff8) == 0x51c8)
+#define IS_SUBQ_L_1_D(ir)   (((ir) & 0xfff8) == 0x5380)
+#define IS_BNE(ir)          (((ir) & 0xff00) == 0x6600 && ((ir) & 0xff) != 0xff)
+
+/* MOVE size field (bits 13-12) and CLR size field (bits 7-6) in bytes */
+static const int s_move_size[4] = { 0, 1, 4, 2 };
+static const int s_clr_size[4]  = { 1, 2, 4, 0 };
+
+/* Loop branch target of a DBcc / Bcc */
+static uint32_t _branch_target(const m68k_cache_insn_t *in)
+{
+	if (IS_DBF(in->ir) || (in->ir & 0xff) == 0)
+		return in->pc + 2 + (int16_t)m68k_read_memory_16(in->pc + 2);
+	return in->pc + 2 + (int8_t)(in->ir & 0xff);
+}
+
+static inline uint32_t _min(uint32_t a, uint32_t b)
+{
+	return a < b ? a : b;
+}
+
+static int _is_fill(uint ir)
+{
+	return IS_MOVE_D_PI(ir) || IS_CLR_PI(ir);
+}
+
+/*
+ * Instructions that only read memory: everything they change lives in
+ * registers and flags, so a pass that leaves those unchanged is a fixed
+ * point until something outside the CPU writes.
+ */
+static int _reads_only(uint ir)
+{
+	uint opmode = (ir >> 6) & 7;
+
+	switch (ir >> 12)
+	{
+		case 0x0:
+			if ((ir & 0xff00) == 0x0c00 && (ir & 0xc0) != 0xc0)
+				return 1;                                   /* CMPI */
+			if ((ir & 0xffc0) == 0x0800)
+				return 1;                                   /* BTST #n,<ea> */
+			return (ir & 0xf1c0) == 0x0100 && (ir & 0x38) != 0x08;  /* BTST Dn,<ea> */
+		case 0x1:
+		case 0x2:
+		case 0x3:
+			return opmode <= 1;                             /* MOVE/MOVEA to a register */
+		case 0x4:
+			return ir == 0x4e71 ||                          /* NOP */
+				   ((ir & 0xff00) == 0x4a00 && (ir & 0xc0) != 0xc0);  /* TST */
+		case 0x6:
+			return (ir & 0xff00) != 0x6100;                 /* Bcc/BRA, not BSR */
+		case 0x7:
+			return !(ir & 0x100);                           /* MOVEQ */
+		case 0x8:
+		case 0xc:
+			return opmode <= 2;                             /* OR/AND <ea>,Dn */
+		case 0x9:
+		case 0xb:
+		case 0xd:
+			return opmode <= 3 || opmode == 7;              /* SUB/CMP/ADD(A) <ea>,Rn */
+	}
+	return 0;
+}
+
+int m68k_idiom_classify(const m68k_cache_insn_t *insn, int count)
+{
+	const m68k_cache_insn_t *last = &insn[count - 1];
+	uint first = insn[0].ir;
+	int  i, spin;
+
+	for (i = 0; i < count && _reads_only(insn[i].ir); i++)
+		;
+	spin = i == count && count <= M68K_IDIOM_SPIN_MAX && (last->ir >> 12) == 0x6;
+
+	if ((!spin && (count < 2 || count > 3)) || _branch_target(last) != insn[0].pc)
+		return M68K_IDIOM_NONE;
+	if (count < 2 || count > 3)
+		return M68K_IDIOM_SPIN;
+
+	/* A7 steps by 2 for byte accesses: leave it to the interpreter */
+	if (IS_MOVE_PI_PI(first) && ((first & 7) == 7 || ((first >> 9) & 7) == 7 ||
+	                             (first & 7) == ((first >> 9) & 7)))
+		return M68K_IDIOM_NONE;
+	if ((IS_MOVE_D_PI(first) && ((first >> 9) & 7) == 7) ||
+	    ((IS_CLR_PI(first) || IS_TST_B_PI(first)) && (first & 7) == 7))
+		return M68K_IDIOM_NONE;
+
+	if (count == 2 && IS_DBF(last->ir))
+	{
+		/* MOVE Dn,(Ax)+ with the loop counter as data changes every pass */
+		if (IS_MOVE_D_PI(first) && (first & 7) == (last->ir & 7))
+			return M68K_IDIOM_NONE;
+		if (IS_MOVE_PI_PI(first))
+			return M68K_IDIOM_COPY_DBF;
+		if (_is_fill(first))
+			return M68K_IDIOM_FILL_DBF;
+	}
+	else if (count == 2 && IS_BNE(last->ir))
+	{
+		if (IS_TST_B_PI(first))
+			return M68K_IDIOM_STRLEN;
+		if (IS_MOVE_PI_PI(first) && (first >> 12) == 1)
+			return M68K_IDIOM_STRCPY;
+	}
+	else if (count == 3 && IS_SUBQ_L_1_D(insn[1].ir) && IS_BNE(last->ir))
+	{
+		if (IS_MOVE_D_PI(first) && (first & 7) == (insn[1].ir & 7))
+			return M68K_IDIOM_NONE;
+		if (IS_MOVE_PI_PI(first))
+			return M68K_IDIOM_COPY_SUBQ;
+		if (_is_fill(first))
+			return M68K_IDIOM_FILL_SUBQ;
+	}
+
+	return spin ? M68K_IDIOM_SPIN : M68K_IDIOM_NONE;
+}
+
+/*
+ * Host pointer for [address, address + *bytes), shrinking *bytes to what
+ * is contiguous plain memory. Returns NULL if nothing is.
+ */
+static uint8 *_host_range(uint32_t address, uint32_t *bytes, int write)
+{
+	uint8 *host;
+
+	if (*bytes == 0 || ADDRESS_68K(address) != address)
+		return NULL;
+	if (ADDRESS_68K(address + *bytes - 1) != address + *bytes - 1 || address + *bytes < address)
+		*bytes = ADDRESS_68K(0xffffffff) - address + 1;
+
+	host = CALLBACK_HOST_MEMORY(address, bytes, write);
+	return *bytes ? host : NULL;
+}
+
+static uint _load(const uint8 *p, int size)
+{
+	uint v = 0;
+	int  i;
+
+	for (i = 0; i < size; i++)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+/* Element-wise forward copy, as the loop itself would do it */
+static void _copy_forward(uint8 *dst, const uint8 *src, uint32_t bytes, int size)
+{
+	uint32_t i;
+
+	if (dst <= src || dst >= src + bytes)
+	{
+		memmove(dst, src, bytes);
+		return;
+	}
+
+	for (i = 0; i < bytes; i += size)
+	{
+		uint8 tmp[4];
+		memcpy(tmp, src + i, size);
+		memcpy(dst + i, tmp, size);
+	}
+}
+
+static void _fill(uint8 *dst, uint value, uint32_t bytes, int size)
+{
+	uint8    pattern[4];
+	uint32_t i;
+	int      k;
+
+	for (k = 0; k < size; k++)
+		pattern[k] = value >> (8 * (size - 1 - k));
+
+	if (size == 1 || value == 0)
+	{
+		memset(dst, pattern[0], bytes);
+		return;
+	}
+
+	for (i = 0; i < bytes; i += size)
+		memcpy(dst + i, pattern, size);
+}
+
+static inline void _set_move_flags(uint res, int size)
+{
+	FLAG_N = size == 1 ? NFLAG_8(res) : size == 2 ? NFLAG_16(res) : NFLAG_32(res);
+	FLAG_Z = res;
+	FLAG_V = VFLAG_CLEAR;
+	FLAG_C = CFLAG_CLEAR;
+}
+
+void m68k_idiom_run(int idiom, const m68k_cache_insn_t *insn, int count)
+{
+	uint     first = insn[0].ir;
+	uint     counter = insn[count - 1].ir & 7;
+	int      size, i;
+	sint     cost = 0;
+	uint32_t n, bytes, src_bytes;
+	uint32_t code_start = insn[0].pc, code_end = insn[count - 1].pc + 4;
+	uint    *ax;
+	uint    *ay = NULL;
+	uint8   *dst = NULL, *src = NULL;
+
+	if (idiom == M68K_IDIOM_SPIN || PMMU_ENABLED)
+		return;
+
+	for (i = 0; i < count; i++)
+		cost += insn[i].cycles;
+	if (IS_DBF(insn[count - 1].ir))
+		cost += CYC_DBCC_F_NOEXP;
+	if (cost <= 0 || GET_CYCLES() <= cost)
+		return;
+
+	/* continuing iterations the budget allows */
+	n = (GET_CYCLES() - 1) / cost;
+
+	if (IS_CLR_PI(first) || IS_TST_B_PI(first))
+	{
+		size = IS_CLR_PI(first) ? s_clr_size[(first >> 6) & 3] : 1;
+		ax = &REG_A[first & 7];
+	}
+	else
+	{
+		size = s_move_size[(first >> 12) & 3];
+		ax = &REG_A[(first >> 9) & 7];
+		if (IS_MOVE_PI_PI(first))
+			ay = &REG_A[first & 7];
+	}
+
+	switch (idiom)
+	{
+		case M68K_IDIOM_COPY_DBF:
+		case M68K_IDIOM_FILL_DBF:
+			n = _min(n, MASK_OUT_ABOVE_16(REG_D[counter]));
+			break;
+		case M68K_IDIOM_COPY_SUBQ:
+		case M68K_IDIOM_FILL_SUBQ:
+			counter = insn[1].ir & 7;
+			n = _min(n, (uint32_t)(REG_D[counter] - 1));
+			break;
+		default:
+			break;
+	}
+
+	/* Odd word/long pointers would raise address errors on a 68000 */
+	if (size > 1 && ((*ax & 1) || (ay && (*ay & 1))))
+		return;
+
+	n = _min(n, 0x40000000u / size);
+	if (n == 0)
+		return;
+
+	if (idiom == M68K_IDIOM_STRLEN || idiom == M68K_IDIOM_STRCPY)
+	{
+		const uint8 *zero;
+		uint32_t     scan = n;
+
+		src = _host_range(idiom == M68K_IDIOM_STRLEN ? *ax : *ay, &scan, 0);
+		if (src == NULL)
+			return;
+		zero = memchr(src, 0, scan);
+		n = zero ? (uint32_t)(zero - src) : scan;
+		if (n == 0)
+			return;
+	}
+	else if (ay != NULL)
+	{
+		src_bytes = n * size;
+		src = _host_range(*ay, &src_bytes, 0);
+		if (src == NULL || src_bytes < (uint32_t)size)
+			return;
+		n = src_bytes / size;
+	}
+
+	if (idiom != M68K_IDIOM_STRLEN)
+	{
+		bytes = n * size;
+
+		/* never store over the loop's own code */
+		if (*ax < code_end && *ax + bytes > code_start)
+			return;
+
+		/* a string copied onto its own tail would never see the NUL */
+		if (idiom == M68K_IDIOM_STRCPY && *ax > *ay && *ax <= *ay + n)
+			return;
+
+		/* last check: a writable range is reported to watchpoints */
+		dst = _host_range(*ax, &bytes, 1);
+		if (dst == NULL || bytes < (uint32_t)size)
+			return;
+		n = bytes / size;
+	}
+
+	bytes = n * size;
+
+	switch (idiom)
+	{
+		case M68K_IDIOM_COPY_DBF:
+		case M68K_IDIOM_COPY_SUBQ:
+		case M68K_IDIOM_STRCPY:
+			_copy_forward(dst, src, bytes, size);
+			_set_move_flags(_load(dst + bytes - size, size), size);
+			break;
+		case M68K_IDIOM_FILL_DBF:
+		case M68K_IDIOM_FILL_SUBQ:
+		{
+			uint value = IS_CLR_PI(first) ? 0 : REG_D[first & 7] & (0xffffffffu >> (32 - 8 * size));
+			_fill(dst, value, bytes, size);
+			_set_move_flags(value, size);
+			if (IS_CLR_PI(first))
+				FLAG_Z = ZFLAG_SET;
+			break;
+		}
+		case M68K_IDIOM_STRLEN:
+			_set_move_flags(src[bytes - 1], 1);
+			break;
+	}
+
+	/* the range can span pages between its first and last one */
+	if (dst != NULL)
+		m68k_cache_invalidate_range(*ax, bytes);
+
+	*ax += bytes;
+	if (ay != NULL)
+		*ay += bytes;
+
+	if (idiom == M68K_IDIOM_COPY_DBF || idiom == M68K_IDIOM_FILL_DBF)
+	{
+		REG_D[counter] = MASK_OUT_BELOW_16(REG_D[counter]) | MASK_OUT_ABOVE_16(REG_D[counter] - n);
+	}
+	else if (idiom == M68K_IDIOM_COPY_SUBQ || idiom == M68K_IDIOM_FILL_SUBQ)
+	{
+		/* flags of the last SUBQ.L #1,Dn performed */
+		uint d = REG_D[counter] - (n - 1);
+		uint res = d - 1;
+
+		REG_D[counter] = res;
+		FLAG_N = NFLAG_32(res);
+		FLAG_Z = MASK_OUT_ABOVE_32(res);
+		FLAG_X = FLAG_C = CFLAG_SUB_32(1, d, res);
+		FLAG_V = VFLAG_SUB_32(1, d, res);
+	}
+
+	USE_CYCLES(cost * n);
+}
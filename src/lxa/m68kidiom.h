@@ -0,0 +1,58 @@
+#ifndef M68KIDIOM__HEADER
+#define M68KIDIOM__HEADER
+
+/*
+ * m68kidiom.h - Bulk execution of copy, fill and string-scan loops.
+ *
+ * Idiom recognition on top of the block cache.
+ *
+ * When the block cache records a block that is a complete loop of one of
+ * these shapes (the loop branch targets the block's own start):
+ *
+ *   MOVE.s (Ay)+,(Ax)+ ; DBF Dn,loop                  copy
+ *   MOVE.s Dm,(Ax)+ / CLR.s (Ax)+ ; DBF Dn,loop       fill
+ *   MOVE.s (Ay)+,(Ax)+ ; SUBQ.L #1,Dn ; BNE loop      copy
+ *   MOVE.s Dm,(Ax)+ / CLR.s (Ax)+ ; SUBQ.L #1,Dn ; BNE loop
+ *   TST.B (Ax)+ ; BNE loop                            strlen
+ *   MOVE.B (Ay)+,(Ax)+ ; BNE loop                     strcpy
+ *
+ * the fast execute loop runs all but the last iteration as one host
+ * memmove()/memset()/memchr() and leaves registers, flags and cycle count
+ * exactly where the interpreter would have. The final iteration (and any
+ * iteration that would cross the end of the timeslice) is replayed
+ * normally, so the loop exit is never emulated here.
+ *
+ * Bulk access needs host memory from m68k_set_host_memory_callback(); as
+ * soon as a pointer leaves plain RAM (custom chips, unmapped space, ROM
+ * for stores) the loop is interpreted instruction by instruction.
+ *
+ * A short loop built only from instructions that read memory (TST, CMP,
+ * BTST, MOVE to a register, ...) is classified M68K_IDIOM_SPIN: a polling
+ * loop on a custom register or on a flag an interrupt handler sets. It is
+ * not run in bulk; the block cache watches it for a busy-wait instead
+ * (m68k_cache_set_spin_detect()).
+ */
+
+#include "m68kcache.h"
+
+#define M68K_IDIOM_NONE         0
+#define M68K_IDIOM_COPY_DBF     1
+#define M68K_IDIOM_FILL_DBF     2
+#define M68K_IDIOM_COPY_SUBQ    3
+#define M68K_IDIOM_FILL_SUBQ    4
+#define M68K_IDIOM_STRLEN       5
+#define M68K_IDIOM_STRCPY       6
+#define M68K_IDIOM_SPIN         7
+
+#define M68K_IDIOM_SPIN_MAX     8       /* longest polling loop, in instructions */
+
+/* Classify a freshly recorded block; returns M68K_IDIOM_NONE for anything else. */
+int m68k_idiom_classify(const m68k_cache_insn_t *insn, int count);
+
+/*
+ * Run the leading iterations of an idiom block in bulk. Called with REG_PC
+ * at the block's start; the caller replays the block afterwards.
+ */
+void m68k_idiom_run(int idiom, const m68k_cache_insn_t *insn, int count);
+
+#endif /* M68KIDIOM__HEADER */
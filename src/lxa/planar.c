@@ -0,0 +1,403 @@
+/*
+ * planar.c - Planar-to-chunky row conversion
+ *
+ * Every kernel converts whole groups of 8 pixels, one byte per plane; the
+ * columns before the first and after the last whole group go through the
+ * bit loop.  A group's 8 plane bytes form an 8x8 bit matrix whose
+ * transpose is its 8 pixels; the kernels differ only in how many groups
+ * they transpose at once.
+ */
+
+#include "planar.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define PLANAR_X86 1
+#else
+#define PLANAR_X86 0
+#endif
+
+typedef void (*planar_block_fn)(uint8_t *dst, const uint8_t **rows, int groups, int depth);
+
+static pthread_once_t  s_select_once = PTHREAD_ONCE_INIT;
+static planar_kernel_t s_kernel      = PLANAR_KERNEL_SCALAR;
+
+/* =========================================================
+ * Scalar
+ * ========================================================= */
+
+static inline uint8_t _pixel(const uint8_t **planes, int src_row_offset, int col, int depth)
+{
+    int     byte_idx = src_row_offset + col / 8;
+    int     bit_idx  = 7 - (col % 8);   /* Amiga: MSB is leftmost pixel */
+    uint8_t pixel    = 0;
+
+    for (int p = 0; p < depth; p++)
+    {
+        if (planes[p] && (planes[p][byte_idx] & (1 << bit_idx)))
+            pixel |= (1 << p);
+    }
+    return pixel;
+}
+
+/*
+ * Byte p of x holds plane p of 8 pixels.  Transposed, byte c holds the
+ * pixel of bit c, so the leftmost pixel is the most significant byte.
+ */
+static inline uint64_t _transpose8(uint64_t x)
+{
+    uint64_t t;
+
+    t = (x ^ (x >> 7))  & 0x00AA00AA00AA00AAull;  x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCull;  x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ull;  x ^= t ^ (t << 28);
+    return x;
+}
+
+static void _block_scalar(uint8_t *dst, const uint8_t **rows, int groups, int depth)
+{
+    for (int g = 0; g < groups; g++, dst += 8)
+    {
+        uint64_t x = 0;
+
+        for (int p = 0; p < depth; p++)
+        {
+            if (rows[p])
+                x |= (uint64_t)rows[p][g] << (8 * p);
+        }
+        x = _transpose8(x);
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        x = __builtin_bswap64(x);
+#endif
+        memcpy(dst, &x, 8);
+    }
+}
+
+/* =========================================================
+ * x86: the same transpose on 64-bit lanes, 8 groups per step
+ * ========================================================= */
+
+#if PLANAR_X86
+
+/*
+ * Plane bytes of groups g..g+7 as q[i] = groups 2i, 2i+1, one qword per
+ * group with plane p in byte p (three rounds of unpacking).
+ */
+__attribute__((target("sse2")))
+static inline void _gather8(const uint8_t **rows, int g, int depth, __m128i q[4])
+{
+    __m128i p[8];
+
+    for (int i = 0; i < 8; i++)
+        p[i] = i < depth && rows[i] ? _mm_loadl_epi64((const __m128i *)(rows[i] + g))
+                                    : _mm_setzero_si128();
+
+    __m128i a01 = _mm_unpacklo_epi8(p[0], p[1]);
+    __m128i a23 = _mm_unpacklo_epi8(p[2], p[3]);
+    __m128i a45 = _mm_unpacklo_epi8(p[4], p[5]);
+    __m128i a67 = _mm_unpacklo_epi8(p[6], p[7]);
+    __m128i b0  = _mm_unpacklo_epi16(a01, a23);
+    __m128i b1  = _mm_unpackhi_epi16(a01, a23);
+    __m128i c0  = _mm_unpacklo_epi16(a45, a67);
+    __m128i c1  = _mm_unpackhi_epi16(a45, a67);
+
+    q[0] = _mm_unpacklo_epi32(b0, c0);
+    q[1] = _mm_unpackhi_epi32(b0, c0);
+    q[2] = _mm_unpacklo_epi32(b1, c1);
+    q[3] = _mm_unpackhi_epi32(b1, c1);
+}
+
+#define PLANAR_SWAP128(x, s, m)                                             \
+    do {                                                                    \
+        __m128i t_ = _mm_and_si128(_mm_xor_si128(x, _mm_srli_epi64(x, s)), \
+                                   _mm_set1_epi64x(m));                     \
+        x = _mm_xor_si128(x, _mm_xor_si128(t_, _mm_slli_epi64(t_, s)));    \
+    } while (0)
+
+#define PLANAR_SWAP256(x, s, m)                                                      \
+    do {                                                                             \
+        __m256i t_ = _mm256_and_si256(_mm256_xor_si256(x, _mm256_srli_epi64(x, s)),  \
+                                      _mm256_set1_epi64x(m));                        \
+        x = _mm256_xor_si256(x, _mm256_xor_si256(t_, _mm256_slli_epi64(t_, s)));     \
+    } while (0)
+
+__attribute__((target("sse2")))
+static void _block_sse2(uint8_t *dst, const uint8_t **rows, int groups, int depth)
+{
+    int g = 0;
+
+    for (; g + 8 <= groups; g += 8, dst += 64)
+    {
+        __m128i q[4];
+
+        _gather8(rows, g, depth, q);
+        for (int i = 0; i < 4; i++)
+        {
+            __m128i x = q[i];
+
+            PLANAR_SWAP128(x, 7,  0x00AA00AA00AA00AAll);
+            PLANAR_SWAP128(x, 14, 0x0000CCCC0000CCCCll);
+            PLANAR_SWAP128(x, 28, 0x00000000F0F0F0F0ll);
+
+            /* byte c -> byte 7 - c */
+            x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+            x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+            x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+            _mm_storeu_si128((__m128i *)(dst + 16 * i), x);
+        }
+    }
+
+    if (g < groups)
+    {
+        const uint8_t *rest[8];
+
+        for (int p = 0; p < depth; p++)
+            rest[p] = rows[p] ? rows[p] + g : NULL;
+        _block_scalar(dst, rest, groups - g, depth);
+    }
+}
+
+__attribute__((target("avx2")))
+static void _block_avx2(uint8_t *dst, const uint8_t **rows, int groups, int depth)
+{
+    const __m256i reverse = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                             7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    int           g       = 0;
+
+    for (; g + 8 <= groups; g += 8, dst += 64)
+    {
+        __m128i q[4];
+
+        _gather8(rows, g, depth, q);
+        for (int i = 0; i < 2; i++)
+        {
+            __m256i x = _mm256_set_m128i(q[2 * i + 1], q[2 * i]);
+
+            PLANAR_SWAP256(x, 7,  0x00AA00AA00AA00AAll);
+            PLANAR_SWAP256(x, 14, 0x0000CCCC0000CCCCll);
+            PLANAR_SWAP256(x, 28, 0x00000000F0F0F0F0ll);
+            x = _mm256_shuffle_epi8(x, reverse);
+            _mm256_storeu_si256((__m256i *)(dst + 32 * i), x);
+        }
+    }
+
+    if (g < groups)
+    {
+        const uint8_t *rest[8];
+
+        for (int p = 0; p < depth; p++)
+            rest[p] = rows[p] ? rows[p] + g : NULL;
+        _block_scalar(dst, rest, groups - g, depth);
+    }
+}
+
+/*
+ * 8 groups per step.  VPERMB turns the 8 plane qwords into one qword per
+ * group with plane p in byte 7 - p; GF2P8AFFINEQB with the data as matrix
+ * and 0x80 >> j as byte j of the vector transposes each qword, giving
+ * byte j bit p = plane p bit 7 - j, which is pixel j.
+ */
+__attribute__((target("avx512f,avx512bw,avx512vbmi,gfni")))
+static void _block_avx512(uint8_t *dst, const uint8_t **rows, int groups, int depth)
+{
+    static const uint8_t perm_idx[64] = {
+        56, 48, 40, 32, 24, 16,  8,  0,   57, 49, 41, 33, 25, 17,  9,  1,
+        58, 50, 42, 34, 26, 18, 10,  2,   59, 51, 43, 35, 27, 19, 11,  3,
+        60, 52, 44, 36, 28, 20, 12,  4,   61, 53, 45, 37, 29, 21, 13,  5,
+        62, 54, 46, 38, 30, 22, 14,  6,   63, 55, 47, 39, 31, 23, 15,  7,
+    };
+    const __m512i perm = _mm512_loadu_si512(perm_idx);
+    const __m512i bits = _mm512_set1_epi64(0x0102040810204080ll);
+    int           g    = 0;
+
+    for (; g + 8 <= groups; g += 8, dst += 64)
+    {
+        uint64_t q[8] = {0};
+        __m512i  v;
+
+        for (int p = 0; p < depth; p++)
+        {
+            if (rows[p])
+                memcpy(&q[p], rows[p] + g, 8);
+        }
+        v = _mm512_loadu_si512(q);
+        v = _mm512_permutexvar_epi8(perm, v);
+        v = _mm512_gf2p8affine_epi64_epi8(bits, v, 0);
+        _mm512_storeu_si512(dst, v);
+    }
+
+    if (g < groups)
+    {
+        const uint8_t *rest[8];
+
+        for (int p = 0; p < depth; p++)
+            rest[p] = rows[p] ? rows[p] + g : NULL;
+        _block_scalar(dst, rest, groups - g, depth);
+    }
+}
+
+/* =========================================================
+ * x86: colour index -> ARGB
+ * ========================================================= */
+
+__attribute__((target("avx2")))
+static int _argb_avx2(uint32_t *dst, const uint8_t *src, int n, const uint32_t *lut)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_i32gather_epi32((const int *)lut, idx, 4));
+    }
+    return i;
+}
+
+__attribute__((target("avx512f")))
+static int _argb_avx512(uint32_t *dst, const uint8_t *src, int n, const uint32_t *lut)
+{
+    int i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m512i idx = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+
+        _mm512_storeu_si512(dst + i, _mm512_i32gather_epi32(idx, lut, 4));
+    }
+    return i;
+}
+
+#endif /* PLANAR_X86 */
+
+/* =========================================================
+ * Kernel selection
+ * ========================================================= */
+
+static const planar_block_fn s_blocks[PLANAR_NUM_KERNELS] = {
+    _block_scalar,
+#if PLANAR_X86
+    _block_sse2,
+    _block_avx2,
+    _block_avx512,
+#endif
+};
+
+static bool _supported(planar_kernel_t k)
+{
+#if PLANAR_X86
+    __builtin_cpu_init();
+    switch (k)
+    {
+        case PLANAR_KERNEL_SCALAR:
+            return true;
+        case PLANAR_KERNEL_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case PLANAR_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+        case PLANAR_KERNEL_AVX512:
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+                   __builtin_cpu_supports("avx512vbmi") && __builtin_cpu_supports("gfni");
+        default:
+            return false;
+    }
+#else
+    return k == PLANAR_KERNEL_SCALAR;
+#endif
+}
+
+static void _select(void)
+{
+    for (int k = PLANAR_NUM_KERNELS - 1; k > PLANAR_KERNEL_SCALAR; k--)
+    {
+        if (_supported((planar_kernel_t)k))
+        {
+            s_kernel = (planar_kernel_t)k;
+            return;
+        }
+    }
+}
+
+planar_kernel_t planar_get_kernel(void)
+{
+    pthread_once(&s_select_once, _select);
+    return s_kernel;
+}
+
+bool planar_set_kernel(planar_kernel_t k)
+{
+    pthread_once(&s_select_once, _select);
+    if ((unsigned)k >= PLANAR_NUM_KERNELS || !_supported(k))
+        return false;
+    s_kernel = k;
+    return true;
+}
+
+const char *planar_kernel_name(planar_kernel_t k)
+{
+    static const char *const names[PLANAR_NUM_KERNELS] = { "scalar", "sse2", "avx2", "avx512" };
+
+    return (unsigned)k < PLANAR_NUM_KERNELS ? names[k] : "?";
+}
+
+/* =========================================================
+ * Rows
+ * ========================================================= */
+
+void planar_to_chunky_row(uint8_t *dst, const uint8_t **planes, int src_row_offset,
+                          int col_start, int col_end, int depth)
+{
+    int col   = col_start;
+    int first = (col_start + 7) & ~7;
+    int groups;
+
+    if (depth > 8)
+        depth = 8;
+    if (first > col_end)
+        first = col_end;
+
+    for (; col < first; col++)
+        *dst++ = _pixel(planes, src_row_offset, col, depth);
+
+    groups = (col_end - col) / 8;
+    if (groups > 0)
+    {
+        const uint8_t *rows[8];
+
+        for (int p = 0; p < depth; p++)
+            rows[p] = planes[p] ? planes[p] + src_row_offset + col / 8 : NULL;
+
+        s_blocks[planar_get_kernel()](dst, rows, groups, depth);
+        dst += groups * 8;
+        col += groups * 8;
+    }
+
+    for (; col < col_end; col++)
+        *dst++ = _pixel(planes, src_row_offset, col, depth);
+}
+
+void chunky_to_argb_row(uint32_t *dst, const uint8_t *src, int n, const uint32_t lut[256])
+{
+    int i = 0;
+
+#if PLANAR_X86
+    switch (planar_get_kernel())
+    {
+        case PLANAR_KERNEL_AVX512:
+            i = _argb_avx512(dst, src, n, lut);
+            break;
+        case PLANAR_KERNEL_AVX2:
+            i = _argb_avx2(dst, src, n, lut);
+            break;
+        default:
+            break;
+    }
+#endif
+
+    for (; i < n; i++)
+        dst[i] = lut[src[i]];
+}
@@ -0,0 +1,54 @@
+#ifndef HAVE_PLANAR_H
+#define HAVE_PLANAR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Planar-to-chunky row conversion.
+ *
+ * Converts Amiga bitplane rows (up to 8 planes) into one 8-bit colour index
+ * per pixel.  The kernel is picked once per process from what the host CPU
+ * supports (cpuid); every kernel produces exactly the same bytes as the
+ * plain bit loop.
+ *
+ *   scalar   8x8 bit-matrix transpose in a 64-bit word, 8 pixels per step
+ *   sse2     64 pixels per step, the same transpose on 2 groups per register
+ *   avx2     64 pixels per step, 4 groups per register
+ *   avx512   64 pixels per step, byte transpose (VBMI) + GF2P8AFFINE bit
+ *            transpose (GFNI)
+ */
+
+typedef enum
+{
+    PLANAR_KERNEL_SCALAR,
+    PLANAR_KERNEL_SSE2,
+    PLANAR_KERNEL_AVX2,
+    PLANAR_KERNEL_AVX512,
+    PLANAR_NUM_KERNELS
+} planar_kernel_t;
+
+/*
+ * Convert columns col_start..col_end-1 of one row.  planes[p] points to the
+ * row's first byte in plane p, NULL planes read as 0.  dst receives
+ * col_end - col_start bytes.  depth: number of planes, 1..8.
+ */
+void planar_to_chunky_row(uint8_t *dst, const uint8_t **planes, int src_row_offset,
+                          int col_start, int col_end, int depth);
+
+/*
+ * dst[i] = lut[src[i]] for n pixels: colour indices to ARGB for the texture
+ * upload.  Uses the same kernel choice (8/16-lane gathers with AVX2 and
+ * AVX-512, a plain loop otherwise).
+ */
+void chunky_to_argb_row(uint32_t *dst, const uint8_t *src, int n, const uint32_t lut[256]);
+
+/* Kernel in use (the best one the host supports unless overridden). */
+planar_kernel_t planar_get_kernel(void);
+
+/* Use kernel k from now on; false if this host or build cannot run it. */
+bool planar_set_kernel(planar_kernel_t k);
+
+const char *planar_kernel_name(planar_kernel_t k);
+
+#endif
@@ -36,12 +36,12 @@ these four paragraphs for those parts of this code that are retained.
 | Floating-point rounding mode, extended double-precision rounding precision,
 | and exception flags.
 *----------------------------------------------------------------------------*/
-int8 float_exception_flags = 0;
+LXA_INSTANCE_LOCAL int8 float_exception_flags = 0;
 #ifdef FLOATX80
-int8 floatx80_rounding_precision = 80;
+LXA_INSTANCE_LOCAL int8 floatx80_rounding_precision = 80;
 #endif
 
-int8 float_rounding_mode = float_round_nearest_even;
+LXA_INSTANCE_LOCAL int8 float_rounding_mode = float_round_nearest_even;
 
 /*----------------------------------------------------------------------------
 | Functions and definitions to determine:  (1) whether tininess for underflow
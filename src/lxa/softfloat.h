@@ -76,7 +76,7 @@ enum {
 /*----------------------------------------------------------------------------
 | Software IEC/IEEE floating-point rounding mode.
 *----------------------------------------------------------------------------*/
-extern int8 float_rounding_mode;
+extern LXA_INSTANCE_LOCAL int8 float_rounding_mode;
 enum {
 	float_round_nearest_even = 0,
 	float_round_to_zero      = 1,
@@ -87,7 +87,7 @@ enum {
 /*----------------------------------------------------------------------------
 | Software IEC/IEEE floating-point exception flags.
 *----------------------------------------------------------------------------*/
-extern int8 float_exception_flags;
+extern LXA_INSTANCE_LOCAL int8 float_exception_flags;
 enum {
 	float_flag_invalid = 0x01, float_flag_denormal = 0x02, float_flag_divbyzero = 0x04, float_flag_overflow = 0x08,
 	float_flag_underflow = 0x10, float_flag_inexact = 0x20
@@ -220,7 +220,7 @@ static inline floatx80 packFloatx80( flag zSign, int32 zExp, bits64 zSig )
 | Software IEC/IEEE extended double-precision rounding precision.  Valid
 | values are 32, 64, and 80.
 *----------------------------------------------------------------------------*/
-extern int8 floatx80_rounding_precision;
+extern LXA_INSTANCE_LOCAL int8 floatx80_rounding_precision;
 
 /*----------------------------------------------------------------------------
 | Software IEC/IEEE extended double-precision operations.
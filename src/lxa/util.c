@@ -13,6 +13,7 @@ bool     g_debug                         = false;
 static pthread_mutex_t g_log_mutex;
 static pthread_once_t g_log_mutex_once = PTHREAD_ONCE_INIT;
 static __thread bool g_log_line_locked = false;
+static int g_log_users = 0;
 
 static void init_log_mutex(void)
 {
@@ -96,20 +97,35 @@ void lprintf (int level, const char *format, ...)
     va_end(ap);
 }
 
+/* The log file is shared by all emulator instances of the process */
 void util_init(void)
 {
+    lock_log_output();
+
     // logging
-    g_logf = fopen (LXA_LOG_FILENAME, "w");
-    assert (g_logf);
+    if (g_log_users++ == 0)
+    {
+        g_logf = fopen (LXA_LOG_FILENAME, "w");
+        assert (g_logf);
+    }
+
+    unlock_log_output();
 }
 
 void util_shutdown(void)
 {
-    if (g_logf)
+    lock_log_output();
+
+    if (g_log_users > 0 && --g_log_users == 0)
     {
-        fclose(g_logf);
-        g_logf = NULL;
+        if (g_logf)
+        {
+            fclose(g_logf);
+            g_logf = NULL;
+        }
+
+        g_debug = false;
     }
 
-    g_debug = false;
+    unlock_log_output();
 }
@@ -9,6 +9,7 @@
 #include <pwd.h>
 #include "vfs.h"
 #include "util.h"
+#include "lxa_instance.h"
 
 typedef struct drive_map_s drive_map_t;
 struct drive_map_s {
@@ -17,9 +18,9 @@ struct drive_map_s {
     char *linux_path;
 };
 
-static drive_map_t *g_drive_maps = NULL;
-static char g_lxa_home[PATH_MAX] = "";
-static char g_progdir[PATH_MAX] = "";  /* Program directory for PROGDIR: */
+static LXA_INSTANCE_LOCAL drive_map_t *g_drive_maps = NULL;
+static LXA_INSTANCE_LOCAL char g_lxa_home[PATH_MAX] = "";
+static LXA_INSTANCE_LOCAL char g_progdir[PATH_MAX] = "";  /* Program directory for PROGDIR: */
 
 /*
  * Phase 7: Assignment System
@@ -43,7 +44,7 @@ struct assign_entry_s {
     assign_path_t *paths;    /* List of paths (first is primary) */
 };
 
-static assign_entry_t *g_assigns = NULL;
+static LXA_INSTANCE_LOCAL assign_entry_t *g_assigns = NULL;
 
 /* Forward declaration for find_assign (used by vfs_resolve_path) */
 static assign_entry_t *find_assign(const char *name);
@@ -94,7 +95,7 @@ static bool normalize_host_path(const char *input_path, char *normalized_path, s
 }
 
 /* Static buffer for data directory path */
-static char g_data_dir[PATH_MAX] = "";
+static LXA_INSTANCE_LOCAL char g_data_dir[PATH_MAX] = "";
 
 void vfs_reset(void)
 {
@@ -8,12 +8,17 @@
  * - lxa_read_pixel()
  * - lxa_read_pixel_rgb()
  *
+ * Snapshot round trip and fork server.
+ *
  * Phase 107: Uses SetUpTestSuite() to load SimpleGad once for all tests,
  * avoiding redundant emulator init + program load per test case.
  */
 
 #include "lxa_test.h"
 
+#include <pthread.h>
+#include <sys/wait.h>
+
 using namespace lxa::testing;
 
 class LxaAPITest : public ::testing::Test {
@@ -365,6 +370,168 @@ TEST_F(LxaAPITest, MemoryFastPathRead32AtMultipleOffsets) {
     }
 }
 
+/* A snapshot survives a file round trip and rewinds the machine */
+#define SNAPSHOT_MARKER 0xF0    /* vector 60, unassigned: free to scribble on */
+
+TEST_F(LxaAPITest, SnapshotRestoreRoundTrip) {
+    ASSERT_TRUE(s_setup_ok) << "Emulator not initialized";
+
+    lxa_snapshot_t *snap = lxa_snapshot_save();
+    ASSERT_NE(snap, nullptr);
+    EXPECT_GT(lxa_snapshot_size(snap), (size_t)0);
+
+    char path[] = "/tmp/lxa_test_snapshot_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    ASSERT_TRUE(lxa_snapshot_write(snap, path));
+    lxa_snapshot_free(snap);
+    snap = lxa_snapshot_read(path);
+    unlink(path);
+    ASSERT_NE(snap, nullptr);
+
+    uint32_t exec_base = lxa_peek32(4);
+    uint32_t marker     = lxa_peek32(SNAPSHOT_MARKER);
+    int      pen_before = -1;
+    EXPECT_TRUE(lxa_read_pixel(window_info.x + 10, window_info.y + 10, &pen_before));
+
+    /* change the machine after the save: RAM, window position, time */
+    lxa_poke32(SNAPSHOT_MARKER, ~marker);
+    ASSERT_EQ(lxa_peek32(SNAPSHOT_MARKER), ~marker);
+    int drag_x = window_info.x + window_info.width / 2;
+    int drag_y = window_info.y + 4;
+    EXPECT_TRUE(lxa_inject_drag(drag_x, drag_y, drag_x + 40, drag_y + 30, LXA_MOUSE_LEFT, 5));
+    RunCyclesWithVBlank(10);
+
+    ASSERT_TRUE(lxa_snapshot_restore(snap));
+    lxa_snapshot_free(snap);
+
+    EXPECT_EQ(lxa_peek32(4), exec_base);
+    EXPECT_EQ(lxa_peek32(SNAPSHOT_MARKER), marker);
+    EXPECT_EQ(lxa_get_window_count(), 1);
+
+    lxa_window_info_t info;
+    ASSERT_TRUE(lxa_get_window_info(0, &info));
+    EXPECT_EQ(info.x, window_info.x);
+    EXPECT_EQ(info.y, window_info.y);
+    EXPECT_EQ(info.width, window_info.width);
+    EXPECT_EQ(info.height, window_info.height);
+
+    int pen_after = -1;
+    EXPECT_TRUE(lxa_read_pixel(window_info.x + 10, window_info.y + 10, &pen_after));
+    EXPECT_EQ(pen_after, pen_before);
+
+    /* the restored machine keeps running */
+    RunCyclesWithVBlank(10);
+    EXPECT_TRUE(lxa_is_running());
+}
+
+/* Fork server children all start from the suite's checkpoint */
+static int ForkHandler(const char *request, int out_fd, void *) {
+    char line[128];
+    int n = snprintf(line, sizeof(line), "%s windows=%d\n", request, lxa_get_window_count());
+    if (write(out_fd, line, n) != n)
+        return 1;
+    for (int i = 0; i < 10; i++) {
+        lxa_trigger_vblank();
+        lxa_run_cycles(50000);
+    }
+    return lxa_is_running() ? 3 : 2;
+}
+
+TEST_F(LxaAPITest, ForkServerServesRequests) {
+    ASSERT_TRUE(s_setup_ok) << "Emulator not initialized";
+
+    std::string sock = s_t_dir + "/fork.sock";
+    fflush(nullptr);
+    pid_t server = fork();
+    ASSERT_GE(server, 0);
+    if (server == 0)
+        _exit(lxa_fork_server(sock.c_str(), 2, ForkHandler, nullptr));
+
+    char out[256];
+    int  rv = -1;
+    for (int tries = 0; tries < 500 && rv < 0; tries++) {
+        rv = lxa_fork_request(sock.c_str(), "first", out, sizeof(out));
+        if (rv < 0) usleep(10000);
+    }
+    EXPECT_EQ(rv, 3);
+    EXPECT_STREQ(out, "first windows=1\n");
+
+    EXPECT_EQ(lxa_fork_request(sock.c_str(), "second", out, sizeof(out)), 3);
+    EXPECT_STREQ(out, "second windows=1\n");
+
+    EXPECT_EQ(lxa_fork_request(sock.c_str(), "quit", nullptr, 0), -1);
+    int status = 0;
+    ASSERT_EQ(waitpid(server, &status, 0), server);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 2);
+
+    /* the checkpoint itself is untouched */
+    EXPECT_EQ(lxa_get_window_count(), 1);
+}
+
+/* One emulator instance per thread */
+struct ThreadInstanceParams {
+    const char* rom;
+    const char* samples;
+    const char* sysbase;
+    const char* libs;
+    int         windows;
+    uint32_t    reset_sp;
+};
+
+static void* ThreadInstance(void* arg) {
+    ThreadInstanceParams* p = (ThreadInstanceParams*)arg;
+
+    lxa_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.headless = true;
+    config.rootless = true;
+    config.rom_path = p->rom;
+    if (lxa_init(&config) != 0)
+        return nullptr;
+
+    if (p->samples) lxa_add_assign("SYS", p->samples);
+    if (p->sysbase) lxa_add_assign_path("SYS", p->sysbase);
+    if (p->libs)    lxa_add_assign_path("LIBS", p->libs);
+
+    if (lxa_load_program("SYS:SimpleGad", "") == 0 && lxa_wait_windows(1, 5000))
+        p->windows = lxa_get_window_count();
+    p->reset_sp = lxa_peek32(0);
+
+    lxa_shutdown();
+    return nullptr;
+}
+
+TEST_F(LxaAPITest, InstancesRunOnOtherThreads) {
+    ASSERT_TRUE(s_setup_ok) << "Emulator not initialized";
+
+    ThreadInstanceParams params[2];
+    pthread_t            threads[2];
+    for (int i = 0; i < 2; i++) {
+        params[i] = { FindRomPath(), FindSamplesPath(), FindSystemBasePath(),
+                      FindSystemLibsPath(), -1, 0 };
+        ASSERT_EQ(pthread_create(&threads[i], nullptr, ThreadInstance, &params[i]), 0);
+    }
+
+    /* this thread's machine keeps running alongside */
+    uint32_t sp = lxa_peek32(0);
+    for (int i = 0; i < 20; i++) {
+        lxa_trigger_vblank();
+        lxa_run_cycles(50000);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        pthread_join(threads[i], nullptr);
+        EXPECT_EQ(params[i].windows, 1) << "instance " << i;
+        EXPECT_EQ(params[i].reset_sp, sp) << "instance " << i;
+    }
+
+    EXPECT_TRUE(lxa_is_running());
+    EXPECT_EQ(lxa_get_window_count(), 1);
+}
+
 
 
 
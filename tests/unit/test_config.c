@@ -177,6 +177,26 @@ void test_config_display_rootless_mode_false(void)
     TEST_ASSERT_FALSE(config_get_rootless_mode());
 }
 
+void test_config_cpu_fpu_mode(void)
+{
+    config_reset();
+    TEST_ASSERT_FALSE(config_get_fpu_host());
+
+    write_config(
+        "[cpu]\n"
+        "fpu = host\n"
+    );
+    TEST_ASSERT_TRUE(config_load(g_config_path));
+    TEST_ASSERT_TRUE(config_get_fpu_host());
+
+    write_config(
+        "[cpu]\n"
+        "fpu = exact\n"
+    );
+    TEST_ASSERT_TRUE(config_load(g_config_path));
+    TEST_ASSERT_FALSE(config_get_fpu_host());
+}
+
 /*-------------------------------------------------------
  * Drive Configuration Tests
  *-------------------------------------------------------*/
@@ -426,6 +446,7 @@ int main(void)
     RUN_TEST(test_config_default_ram_size);
     RUN_TEST(test_config_rootless_mode_defaults_true);
     RUN_TEST(test_config_display_rootless_mode_false);
+    RUN_TEST(test_config_cpu_fpu_mode);
 
     /* Drive configuration */
     RUN_TEST(test_config_drives_section);
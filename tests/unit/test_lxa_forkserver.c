@@ -0,0 +1,273 @@
+/*
+ * Unit Tests for the copy-on-write fork server
+ *
+ * Runs the real lxa_forkserver.c in a forked server process, with the
+ * real lxa_dos_host.c behind it and a handler standing in for a test case,
+ * and talks to it with lxa_fork_request().  Checks that:
+ * - a child's output reaches the client, followed by its exit status
+ * - a child killed by a signal reports 128 + the signal number
+ * - "quit" stops the server, which returns the number of children served
+ * - every child re-arms the VBlank timer in its own process
+ * - a guest file opened before the fork keeps its offset in the server
+ *   and in later children when a child seeks it (_dos_host_unshare_fds())
+ * - the server refuses to run without headless mode
+ */
+
+#include "unity.h"
+
+#include "lxa_api.h"
+#include "lxa_internal.h"
+#include "m68kcache.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define TEST_RAM_SIZE   (64 * 1024)
+#define TEST_FH         0x1000
+#define TEST_PATH       0x1100
+
+/* === Globals normally provided by lxa_memory.c, lxa.c and m68kcpu.c === */
+
+uint8_t  *g_ram;
+uint32_t  g_ram_size;
+uint8_t  *g_rom;
+char     *g_sysroot;
+int       g_watch_count;
+uint8_t   m68k_cache_page_flags[M68KCACHE_NUM_PAGES];
+void    (*g_console_output_hook)(const char *data, int len);
+
+unsigned int m68k_read_memory_8(unsigned int address)
+{
+    return g_ram[address % TEST_RAM_SIZE];
+}
+
+unsigned int m68k_read_memory_32(unsigned int address)
+{
+    return (m68k_read_memory_8(address) << 24) | (m68k_read_memory_8(address + 1) << 16) |
+           (m68k_read_memory_8(address + 2) << 8) | m68k_read_memory_8(address + 3);
+}
+
+void m68k_write_memory_8(unsigned int address, unsigned int value)
+{
+    g_ram[address % TEST_RAM_SIZE] = value;
+}
+
+void m68k_write_memory_16(unsigned int address, unsigned int value)
+{
+    m68k_write_memory_8(address, value >> 8);
+    m68k_write_memory_8(address + 1, value);
+}
+
+void m68k_write_memory_32(unsigned int address, unsigned int value)
+{
+    m68k_write_memory_16(address, value >> 16);
+    m68k_write_memory_16(address + 2, value);
+}
+
+void m68k_cache_invalidate_range(uint32_t address, uint32_t size)
+{
+    (void)address;
+    (void)size;
+}
+
+void lxa_mem_mark_dirty_range(uint32_t address, uint32_t size)
+{
+    (void)address;
+    (void)size;
+}
+
+void lxa_watch_host_write(uint32_t address, uint32_t size)
+{
+    (void)address;
+    (void)size;
+}
+
+bool lxa_host_console_input_empty(void)
+{
+    return true;
+}
+
+int lxa_host_console_input_pop(void)
+{
+    return -1;
+}
+
+/* === display.c and lxa.c === */
+
+static bool  g_headless = true;
+static int   g_timer_starts;
+static pid_t g_timer_pid;
+
+bool display_get_headless(void)
+{
+    return g_headless;
+}
+
+bool lxa_start_timer(void)
+{
+    g_timer_starts++;
+    g_timer_pid = getpid();
+    return true;
+}
+
+/* === Test case handler and server === */
+
+static char  g_socket[64];
+static char  g_file[64];
+static int   g_fd;
+static pid_t g_server;
+
+/*
+ * "echo <text>"  write text, exit 0
+ * "exit <n>"     exit n
+ * "kill"         die from SIGKILL
+ * "file"         report timer and file offset, then seek the file to 20
+ */
+static int handler(const char *request, int out_fd, void *userdata)
+{
+    char reply[128];
+
+    (void)userdata;
+
+    if (!strncmp(request, "echo ", 5))
+    {
+        dprintf(out_fd, "%s", request + 5);
+        return 0;
+    }
+    if (!strncmp(request, "exit ", 5))
+        return atoi(request + 5);
+    if (!strcmp(request, "kill"))
+        raise(SIGKILL);
+    if (!strcmp(request, "file"))
+    {
+        snprintf(reply, sizeof(reply), "timer=%d own=%d offset=%ld", g_timer_starts,
+                 g_timer_pid == getpid(), (long)lseek(g_fd, 0, SEEK_CUR));
+        lseek(g_fd, 20, SEEK_SET);
+        dprintf(out_fd, "%s", reply);
+        return 0;
+    }
+    return 99;
+}
+
+static void start_server(void)
+{
+    char out[16];
+
+    fflush(NULL);                       /* or the server prints our output again */
+    g_server = fork();
+    TEST_ASSERT_TRUE(g_server >= 0);
+    if (g_server == 0)
+        _exit(lxa_fork_server(g_socket, 4, handler, NULL));
+
+    /* wait until it listens */
+    for (int i = 0; i < 200; i++)
+    {
+        if (lxa_fork_request(g_socket, "echo up", out, sizeof(out)) == 0)
+            return;
+        usleep(10000);
+    }
+    TEST_FAIL_MESSAGE("fork server did not come up");
+}
+
+/* Stop the server; returns the number of children it served */
+static int stop_server(void)
+{
+    int status;
+
+    lxa_fork_request(g_socket, "quit", NULL, 0);
+    TEST_ASSERT_EQUAL_INT(g_server, waitpid(g_server, &status, 0));
+    TEST_ASSERT_TRUE(WIFEXITED(status));
+    return WEXITSTATUS(status);
+}
+
+void setUp(void)
+{
+    int fd;
+
+    g_ram_size = TEST_RAM_SIZE;
+    g_ram      = calloc(1, TEST_RAM_SIZE);
+    g_locks    = calloc(MAX_LOCKS, sizeof(lock_entry_t));
+    g_notify_requests = calloc(MAX_NOTIFY_REQUESTS, sizeof(notify_entry_t));
+    TEST_ASSERT_TRUE(g_ram && g_locks && g_notify_requests);
+
+    snprintf(g_socket, sizeof(g_socket), "/tmp/lxa_fork_%d.sock", (int)getpid());
+    strcpy(g_file, "/tmp/lxa_fork_XXXXXX");
+    fd = mkstemp(g_file);
+    TEST_ASSERT_TRUE(fd >= 0);
+    TEST_ASSERT_EQUAL_INT(32, write(fd, "0123456789abcdefghijklmnopqrstuv", 32));
+    close(fd);
+
+    /* a file the guest has open at offset 5 when the server starts */
+    strcpy((char *)&g_ram[TEST_PATH], g_file);
+    TEST_ASSERT_EQUAL_INT(0, _dos_open(TEST_PATH, MODE_OLDFILE, TEST_FH));
+    g_fd = (int)m68k_read_memory_32(TEST_FH + 36);
+    TEST_ASSERT_EQUAL_INT(5, lseek(g_fd, 5, SEEK_SET));
+
+    g_headless     = true;
+    g_timer_starts = 0;
+    g_timer_pid    = 0;
+}
+
+void tearDown(void)
+{
+    _dos_close(TEST_FH);
+    unlink(g_file);
+    free(g_ram);
+    free(g_locks);
+    free(g_notify_requests);
+}
+
+/* === Tests === */
+
+void test_lxa_forkserver_reports_output_and_status(void)
+{
+    char out[64];
+
+    start_server();
+
+    TEST_ASSERT_EQUAL_INT(0, lxa_fork_request(g_socket, "echo hello", out, sizeof(out)));
+    TEST_ASSERT_EQUAL_STRING("hello", out);
+    TEST_ASSERT_EQUAL_INT(42, lxa_fork_request(g_socket, "exit 42", out, sizeof(out)));
+    TEST_ASSERT_EQUAL_STRING("", out);
+    TEST_ASSERT_EQUAL_INT(128 + SIGKILL, lxa_fork_request(g_socket, "kill", out, sizeof(out)));
+
+    /* "echo up" from start_server() and the three above */
+    TEST_ASSERT_EQUAL_INT(4, stop_server());
+    TEST_ASSERT_EQUAL_INT(-1, lxa_fork_request(g_socket, "echo gone", out, sizeof(out)));
+}
+
+void test_lxa_forkserver_children_rearm_timer_and_unshare_files(void)
+{
+    char out[64];
+
+    start_server();
+
+    TEST_ASSERT_EQUAL_INT(0, lxa_fork_request(g_socket, "file", out, sizeof(out)));
+    TEST_ASSERT_EQUAL_STRING("timer=1 own=1 offset=5", out);
+
+    /* the first child's seek moved neither the server's offset nor ours */
+    TEST_ASSERT_EQUAL_INT(0, lxa_fork_request(g_socket, "file", out, sizeof(out)));
+    TEST_ASSERT_EQUAL_STRING("timer=1 own=1 offset=5", out);
+    TEST_ASSERT_EQUAL_INT(5, lseek(g_fd, 0, SEEK_CUR));
+
+    stop_server();
+    TEST_ASSERT_EQUAL_INT(0, g_timer_starts);
+}
+
+void test_lxa_forkserver_requires_headless(void)
+{
+    g_headless = false;
+    TEST_ASSERT_EQUAL_INT(-1, lxa_fork_server(g_socket, 4, handler, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, lxa_fork_server(g_socket, 4, NULL, NULL));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_lxa_forkserver_reports_output_and_status);
+    RUN_TEST(test_lxa_forkserver_children_rearm_timer_and_unshare_files);
+    RUN_TEST(test_lxa_forkserver_requires_headless);
+    return UNITY_END();
+}
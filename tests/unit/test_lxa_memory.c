@@ -0,0 +1,396 @@
+/*
+ * Unit Tests for the guest memory page table
+ *
+ * Links the real lxa_memory.c and checks that the 64 KB page table
+ * reproduces the documented memory map:
+ * - RAM and ROM are served from host memory, big-endian
+ * - probe areas (overflow, Zorro, extended ROM) read their fixed values
+ * - custom chip word/long stores reach _handle_custom_write()
+ * - accesses that straddle a page boundary are split correctly
+ * - additional host regions can be registered at runtime
+ * - stores into code pages notify the CPU block cache
+ * - host writes retire code pages anywhere in their range
+ * - the CPU fetch window covers host pages only
+ * - bulk ranges for loop idioms stay within contiguous host memory
+ * - guest RAM is committed lazily and reset without touching every page
+ * - RAM stores, host writes and bulk ranges mark the dirty map
+ * - host stores into RAM are reported to watchpoints first
+ */
+
+#include "unity.h"
+
+#include "lxa_internal.h"
+#include "lxa_memory.h"
+
+#include <sys/mman.h>
+
+/* === Globals normally provided by lxa.c / lxa_custom.c === */
+
+static uint8_t s_rom[ROM_SIZE];
+uint8_t *g_rom = s_rom;
+uint16_t g_color_regs[32];
+uint16_t g_intena;
+uint16_t g_intreq;
+uint16_t g_dmacon;
+
+static int      g_custom_writes;
+static uint16_t g_custom_reg[4];
+static uint16_t g_custom_val[4];
+
+void _handle_custom_write(uint16_t reg, uint16_t value)
+{
+    if (g_custom_writes < 4)
+    {
+        g_custom_reg[g_custom_writes] = reg;
+        g_custom_val[g_custom_writes] = value;
+    }
+    g_custom_writes++;
+}
+
+void _debug(uint32_t pc)
+{
+    (void)pc;
+}
+
+unsigned int m68k_get_reg(void *context, m68k_register_t reg)
+{
+    (void)context;
+    (void)reg;
+    return 0;
+}
+
+static int g_fetch_invalidations;
+
+void m68k_invalidate_fetch(void)
+{
+    g_fetch_invalidations++;
+}
+
+/* === Block cache stubs === */
+
+uint8_t m68k_cache_page_flags[M68KCACHE_NUM_PAGES];
+static int      g_cache_invalidations;
+static uint32_t g_cache_inval_start;
+static uint32_t g_cache_inval_end;
+
+void m68k_cache_invalidate_range(uint32_t address, uint32_t size)
+{
+    g_cache_inval_start = address;
+    g_cache_inval_end   = address + size;
+    g_cache_invalidations++;
+}
+
+/* === Watchpoint stubs === */
+
+int g_watch_count;
+
+static int      g_watch_writes;
+static uint32_t g_watch_start;
+static uint32_t g_watch_size;
+
+void lxa_watch_host_write(uint32_t address, uint32_t size)
+{
+    g_watch_start = address;
+    g_watch_size  = size;
+    g_watch_writes++;
+}
+
+/* Bytes of [p, p + size) that are resident in host memory */
+static size_t resident_bytes(const uint8_t *p, size_t size)
+{
+    long          host_page = sysconf(_SC_PAGESIZE);
+    size_t        n = (size + host_page - 1) / host_page;
+    unsigned char vec[4096];
+    size_t        count = 0;
+
+    TEST_ASSERT_TRUE(n <= sizeof(vec));
+    TEST_ASSERT_EQUAL_INT(0, mincore((void *)p, size, vec));
+    for (size_t i = 0; i < n; i++)
+        count += vec[i] & 1;
+    return count * host_page;
+}
+
+void setUp(void)
+{
+    TEST_ASSERT_TRUE(lxa_mem_alloc_ram());
+    memset(g_rom, 0, ROM_SIZE);
+    memset(m68k_cache_page_flags, 0, sizeof(m68k_cache_page_flags));
+    g_custom_writes = 0;
+    g_cache_invalidations = 0;
+    g_watch_count = 0;
+    g_watch_writes = 0;
+    lxa_mem_init();
+    g_fetch_invalidations = 0;
+}
+
+void tearDown(void)
+{
+    lxa_mem_free_ram();
+}
+
+void test_lxa_memory_ram_is_big_endian(void)
+{
+    mwrite32(0x1000, 0x12345678);
+
+    TEST_ASSERT_EQUAL_HEX8(0x12, g_ram[0x1000]);
+    TEST_ASSERT_EQUAL_HEX8(0x78, g_ram[0x1003]);
+    TEST_ASSERT_EQUAL_HEX16(0x1234, mread16(0x1000));
+    TEST_ASSERT_EQUAL_HEX32(0x12345678, mread32(0x1000));
+
+    mwrite16(0x2001, 0xbeef);
+    TEST_ASSERT_EQUAL_HEX8(0xbe, mread8(0x2001));
+    TEST_ASSERT_EQUAL_HEX8(0xef, mread8(0x2002));
+}
+
+void test_lxa_memory_rom_is_read_only(void)
+{
+    g_rom[0x10] = 0xab;
+    g_rom[0x11] = 0xcd;
+
+    TEST_ASSERT_EQUAL_HEX16(0xabcd, mread16(ROM_START + 0x10));
+
+    mwrite16(ROM_START + 0x10, 0x0000);
+    mwrite8(ROM_START + 0x11, 0x00);
+    TEST_ASSERT_EQUAL_HEX16(0xabcd, mread16(ROM_START + 0x10));
+}
+
+void test_lxa_memory_probe_areas_return_fixed_values(void)
+{
+    TEST_ASSERT_EQUAL_HEX8(0x00, mread8(0x00A00000));       /* RAM overflow */
+    TEST_ASSERT_EQUAL_HEX8(0x00, mread8(0x00BFE001));       /* CIA: inside overflow area */
+    TEST_ASSERT_EQUAL_HEX8(0x00, mread8(0x00DFEFFF));       /* overflow tail of custom page */
+    TEST_ASSERT_EQUAL_HEX8(0x00, mread8(0x00E00000));       /* Ranger */
+    TEST_ASSERT_EQUAL_HEX8(0x00, mread8(0x00E80000));       /* Zorro-II autoconfig */
+    TEST_ASSERT_EQUAL_HEX8(0x00, mread8(0x00F00000));       /* extended ROM */
+    TEST_ASSERT_EQUAL_HEX32(0xffffffff, mread32(0x01000000)); /* Zorro-III */
+
+    /* stores to probe areas are ignored */
+    mwrite32(0x00A00000, 0xffffffff);
+    mwrite32(0x08000000, 0x12345678);
+    TEST_ASSERT_EQUAL_HEX32(0x00000000, mread32(0x00A00000));
+    TEST_ASSERT_EQUAL_HEX32(0xffffffff, mread32(0x08000000));
+}
+
+void test_lxa_memory_custom_stores_reach_register_handler(void)
+{
+    mwrite16(CUSTOM_START + CUSTOM_REG_INTENA, 0xc020);
+    TEST_ASSERT_EQUAL_INT(1, g_custom_writes);
+    TEST_ASSERT_EQUAL_HEX16(CUSTOM_REG_INTENA, g_custom_reg[0]);
+    TEST_ASSERT_EQUAL_HEX16(0xc020, g_custom_val[0]);
+
+    /* long stores are split high word first */
+    mwrite32(CUSTOM_START + 0x050, 0x00012340);
+    TEST_ASSERT_EQUAL_INT(3, g_custom_writes);
+    TEST_ASSERT_EQUAL_HEX16(0x050, g_custom_reg[1]);
+    TEST_ASSERT_EQUAL_HEX16(0x0001, g_custom_val[1]);
+    TEST_ASSERT_EQUAL_HEX16(0x052, g_custom_reg[2]);
+    TEST_ASSERT_EQUAL_HEX16(0x2340, g_custom_val[2]);
+
+    /* byte stores and overflow-area stores on the same page do not */
+    mwrite8(CUSTOM_START + CUSTOM_REG_INTENA, 0x80);
+    mwrite32(0x00DFEFFC, 0x11223344);
+    TEST_ASSERT_EQUAL_INT(3, g_custom_writes);
+}
+
+void test_lxa_memory_custom_reads_return_shadows(void)
+{
+    g_intena = 0x4020;
+    g_color_regs[1] = 0x0fa5;
+
+    TEST_ASSERT_EQUAL_HEX16(0x4020, mread16(CUSTOM_START + CUSTOM_REG_INTENAR));
+    TEST_ASSERT_EQUAL_HEX16(0x0fa5, mread16(CUSTOM_START + CUSTOM_REG_COLOR00 + 2));
+}
+
+void test_lxa_memory_page_crossing_accesses_are_split(void)
+{
+    /* last long of RAM straddles into the overflow area */
+    g_ram[RAM_SIZE - 2] = 0xaa;
+    g_ram[RAM_SIZE - 1] = 0xbb;
+    TEST_ASSERT_EQUAL_HEX32(0xaabb0000, mread32(RAM_SIZE - 2));
+
+    /* RAM-to-RAM page boundary */
+    mwrite32(0x0000fffe, 0xdeadbeef);
+    TEST_ASSERT_EQUAL_HEX8(0xde, g_ram[0xfffe]);
+    TEST_ASSERT_EQUAL_HEX8(0xef, g_ram[0x10001]);
+    TEST_ASSERT_EQUAL_HEX32(0xdeadbeef, mread32(0x0000fffe));
+}
+
+void test_lxa_memory_registered_host_region(void)
+{
+    static uint8_t fast[2 * LXA_MEM_PAGE_SIZE];
+
+    lxa_mem_map_host(0x02000000, sizeof(fast), fast, true);
+
+    mwrite32(0x0200fffe, 0xcafef00d);
+    TEST_ASSERT_EQUAL_HEX32(0xcafef00d, mread32(0x0200fffe));
+    TEST_ASSERT_EQUAL_HEX8(0xca, fast[0xfffe]);
+
+    /* neighbouring Zorro-III space is unaffected */
+    TEST_ASSERT_EQUAL_HEX8(0xff, mread8(0x02020000));
+}
+
+void test_lxa_memory_code_page_store_notifies_block_cache(void)
+{
+    mwrite32(0x3000, 1);
+    TEST_ASSERT_EQUAL_INT(0, g_cache_invalidations);
+
+    m68k_cache_page_flags[0x3000 >> M68KCACHE_PAGE_SHIFT] = M68KCACHE_PAGE_CODE;
+    mwrite16(0x3002, 2);
+    mwrite8(0x3004, 3);
+    TEST_ASSERT_EQUAL_INT(2, g_cache_invalidations);
+}
+
+void test_lxa_memory_host_write_retires_middle_code_page(void)
+{
+    uint32_t code = 0x41000;
+
+    /* a DOS Read() buffer spanning three pages, code only in the middle */
+    m68k_cache_page_flags[code >> M68KCACHE_PAGE_SHIFT] = M68KCACHE_PAGE_CODE;
+    lxa_mem_host_write(code - 0x800, 0x2000);
+
+    TEST_ASSERT_EQUAL_INT(1, g_cache_invalidations);
+    TEST_ASSERT_TRUE(g_cache_inval_start <= code);
+    TEST_ASSERT_TRUE(g_cache_inval_end >= code + (1 << M68KCACHE_PAGE_SHIFT));
+}
+
+void test_lxa_memory_fetch_window_covers_host_pages(void)
+{
+    static uint8_t fast[LXA_MEM_PAGE_SIZE];
+    unsigned int base, size;
+
+    TEST_ASSERT_TRUE(lxa_mem_fetch_page(0x0003abcd, &base, &size) == g_ram + 0x30000);
+    TEST_ASSERT_EQUAL_HEX32(0x00030000, base);
+    TEST_ASSERT_EQUAL_HEX32(LXA_MEM_PAGE_SIZE, size);
+
+    TEST_ASSERT_TRUE(lxa_mem_fetch_page(ROM_START + 0x10002, &base, &size) == g_rom + 0x10000);
+    TEST_ASSERT_TRUE(lxa_mem_fetch_page(CUSTOM_START, &base, &size) == NULL);
+    TEST_ASSERT_TRUE(lxa_mem_fetch_page(0x00E80000, &base, &size) == NULL);
+
+    /* remapping drops the CPU's current window */
+    lxa_mem_map_host(0x02000000, sizeof(fast), fast, true);
+    TEST_ASSERT_EQUAL_INT(1, g_fetch_invalidations);
+    TEST_ASSERT_TRUE(lxa_mem_fetch_page(0x02000000, &base, &size) == fast);
+}
+
+void test_lxa_memory_host_range_is_contiguous_plain_memory(void)
+{
+    unsigned int size;
+
+    /* RAM pages are one host block: ranges may cross page boundaries */
+    size = 0x30000;
+    TEST_ASSERT_TRUE(lxa_mem_host_range(0x0000fff0, &size, 1) == g_ram + 0xfff0);
+    TEST_ASSERT_EQUAL_HEX32(0x30000, size);
+
+    /* ... but stop at the end of RAM */
+    size = 0x100000;
+    TEST_ASSERT_TRUE(lxa_mem_host_range(RAM_SIZE - 0x10, &size, 0) == g_ram + RAM_SIZE - 0x10);
+    TEST_ASSERT_EQUAL_HEX32(0x10, size);
+
+    /* ROM is readable in bulk, never writable */
+    size = 4;
+    TEST_ASSERT_TRUE(lxa_mem_host_range(ROM_START, &size, 0) == g_rom);
+    TEST_ASSERT_TRUE(lxa_mem_host_range(ROM_START, &size, 1) == NULL);
+    TEST_ASSERT_EQUAL_HEX32(0, size);
+
+    /* custom chips are never plain memory */
+    size = 2;
+    TEST_ASSERT_TRUE(lxa_mem_host_range(CUSTOM_START + CUSTOM_REG_INTENA, &size, 0) == NULL);
+}
+
+void test_lxa_memory_ram_is_committed_lazily(void)
+{
+    /* a fresh guest costs no host memory ... */
+    TEST_ASSERT_EQUAL_INT(0, resident_bytes(g_ram, g_ram_size));
+
+    /* ... until it writes (at most one transparent huge page) */
+    mwrite32(0x4000, 0x11223344);
+    TEST_ASSERT_TRUE(resident_bytes(g_ram, g_ram_size) > 0);
+    TEST_ASSERT_TRUE(resident_bytes(g_ram, g_ram_size) <= 2 * 1024 * 1024);
+
+    /* reset zeroes RAM and returns the pages to the host */
+    lxa_mem_clear_ram();
+    TEST_ASSERT_EQUAL_INT(0, resident_bytes(g_ram, g_ram_size));
+    TEST_ASSERT_EQUAL_HEX32(0, mread32(0x4000));
+}
+
+void test_lxa_memory_stores_mark_dirty_lines(void)
+{
+    unsigned int size;
+
+    /* fresh RAM is all dirty */
+    TEST_ASSERT_TRUE(lxa_mem_is_dirty(0x8000, 1));
+    lxa_mem_clear_dirty(0, 0x1000000);
+    TEST_ASSERT_FALSE(lxa_mem_is_dirty(0, RAM_SIZE));
+
+    /* CPU stores mark their line; neighbours stay clean */
+    mwrite8(0x8010, 1);
+    TEST_ASSERT_TRUE(lxa_mem_is_dirty(0x8000, 0x100));
+    TEST_ASSERT_FALSE(lxa_mem_is_dirty(0x7f00, 0x100));
+    TEST_ASSERT_FALSE(lxa_mem_is_dirty(0x8100, 0x100));
+
+    /* a long store straddling two lines marks both */
+    mwrite32(0x90fe, 0x12345678);
+    TEST_ASSERT_TRUE(lxa_mem_is_dirty(0x9000, 1));
+    TEST_ASSERT_TRUE(lxa_mem_is_dirty(0x9100, 1));
+
+    lxa_mem_clear_dirty(0x8000, 0x2000);
+    TEST_ASSERT_FALSE(lxa_mem_is_dirty(0x8000, 0x2000));
+
+    /* host writes (DOS Read(), blitter) and bulk ranges for loop idioms */
+    lxa_mem_host_write(0x20000, 0x1000);
+    TEST_ASSERT_TRUE(lxa_mem_is_dirty(0x20f00, 0x10));
+    TEST_ASSERT_FALSE(lxa_mem_is_dirty(0x21000, 0x10));
+
+    size = 0x300;
+    TEST_ASSERT_NOT_NULL(lxa_mem_host_range(0x30000, &size, 1));
+    TEST_ASSERT_TRUE(lxa_mem_is_dirty(0x30200, 1));
+    size = 0x300;
+    TEST_ASSERT_NOT_NULL(lxa_mem_host_range(0x40000, &size, 0));
+    TEST_ASSERT_FALSE(lxa_mem_is_dirty(0x40000, 0x300));
+
+    /* stores that miss RAM do not */
+    mwrite32(CUSTOM_START + CUSTOM_REG_INTENA, 0);
+    TEST_ASSERT_FALSE(lxa_mem_is_dirty(CUSTOM_START, 0x100));
+}
+
+void test_lxa_memory_host_stores_are_reported_to_watchpoints(void)
+{
+    unsigned int size;
+
+    /* nothing to report without watchpoints */
+    size = 0x100;
+    TEST_ASSERT_NOT_NULL(lxa_mem_host_range(0x6000, &size, 1));
+    TEST_ASSERT_EQUAL_INT(0, g_watch_writes);
+
+    g_watch_count = 1;
+
+    /* loop idioms: only ranges asked for writing */
+    size = 0x100;
+    TEST_ASSERT_NOT_NULL(lxa_mem_host_range(0x6000, &size, 0));
+    TEST_ASSERT_EQUAL_INT(0, g_watch_writes);
+    size = 0x100;
+    TEST_ASSERT_NOT_NULL(lxa_mem_host_range(0x6000, &size, 1));
+    TEST_ASSERT_EQUAL_INT(1, g_watch_writes);
+    TEST_ASSERT_EQUAL_HEX32(0x6000, g_watch_start);
+    TEST_ASSERT_EQUAL_HEX32(0x100, g_watch_size);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_lxa_memory_ram_is_big_endian);
+    RUN_TEST(test_lxa_memory_rom_is_read_only);
+    RUN_TEST(test_lxa_memory_probe_areas_return_fixed_values);
+    RUN_TEST(test_lxa_memory_custom_stores_reach_register_handler);
+    RUN_TEST(test_lxa_memory_custom_reads_return_shadows);
+    RUN_TEST(test_lxa_memory_page_crossing_accesses_are_split);
+    RUN_TEST(test_lxa_memory_registered_host_region);
+    RUN_TEST(test_lxa_memory_code_page_store_notifies_block_cache);
+    RUN_TEST(test_lxa_memory_host_write_retires_middle_code_page);
+    RUN_TEST(test_lxa_memory_fetch_window_covers_host_pages);
+    RUN_TEST(test_lxa_memory_host_range_is_contiguous_plain_memory);
+    RUN_TEST(test_lxa_memory_ram_is_committed_lazily);
+    RUN_TEST(test_lxa_memory_stores_mark_dirty_lines);
+    RUN_TEST(test_lxa_memory_host_stores_are_reported_to_watchpoints);
+    return UNITY_END();
+}
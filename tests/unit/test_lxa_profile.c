@@ -0,0 +1,423 @@
+/*
+ * Unit Tests for the per-LVO profiler
+ *
+ * Links the real lxa_profile.c against a tiny fake CPU (flat memory, A7,
+ * ExecBase->ThisTask) and feeds dispatched PCs to _profile_lvo_hook() the
+ * way cpu_instr_callback() does. Checks that:
+ * - a call through a jump-table slot is closed at its return address
+ * - nested library calls split inclusive and exclusive cycles
+ * - another task returning to the same address does not close the call
+ * - the JSON output carries the per-LVO records
+ * - the sampler stops at sample points and folds PC + return addresses
+ * - _profile_execute() (lxa_run_cycles(), main loop) accounts the cycles
+ *   run, also when a timeslice is ended early
+ * - instances on two threads keep their own counters and samples
+ *
+ * Built with LXA_LIBRARY_BUILD, so the profiler and the fake CPU are
+ * instance-local the way they are in liblxa; configure with -DTSAN=ON to
+ * run it under ThreadSanitizer.
+ */
+
+#include "unity.h"
+
+#include "lxa_api.h"
+#include "lxa_internal.h"
+
+#include <pthread.h>
+
+#define TEST_MEM_SIZE   0x10000
+#define TEST_EXECBASE   0x0100
+#define TEST_TASK_A     0x2000
+#define TEST_TASK_B     0x2100
+#define TEST_SLOT_TEXT  0x5000
+#define TEST_SLOT_MOVE  0x5006
+#define FUNC_TEXT       0xf80100
+#define FUNC_MOVE       0xf80200
+
+static LXA_INSTANCE_LOCAL uint8_t  g_mem[TEST_MEM_SIZE];
+static LXA_INSTANCE_LOCAL uint32_t g_a7;
+
+LXA_INSTANCE_LOCAL uint32_t g_ram_size = TEST_MEM_SIZE;
+static LXA_INSTANCE_LOCAL uint32_t g_pc;
+
+/* === Fake CPU used by lxa_profile.c === */
+
+unsigned int m68k_read_memory_8(unsigned int address)
+{
+    return g_mem[address & (TEST_MEM_SIZE - 1)];
+}
+
+unsigned int m68k_read_memory_16(unsigned int address)
+{
+    return (m68k_read_memory_8(address) << 8) | m68k_read_memory_8(address + 1);
+}
+
+unsigned int m68k_read_memory_32(unsigned int address)
+{
+    return (m68k_read_memory_16(address) << 16) | m68k_read_memory_16(address + 2);
+}
+
+unsigned int m68k_get_reg(void *context, m68k_register_t regnum)
+{
+    (void)context;
+    return regnum == M68K_REG_A7 ? g_a7 : regnum == M68K_REG_PC ? g_pc : 0;
+}
+
+/* Symbols of a fake hunk: _main at 0x3000, _inner at 0x4000 */
+const char *_symtab_lookup(uint32_t addr)
+{
+    if (addr >= 0x3000 && addr < 0x3400)
+        return "_main";
+    if (addr >= 0x4000 && addr < 0x4400)
+        return "_inner";
+    return NULL;
+}
+
+int m68k_cycles_run(void)
+{
+    return 0;
+}
+
+/* Timeslices asked for; the slice running past g_end_at ends there, as
+ * m68k_end_timeslice_used() would */
+static LXA_INSTANCE_LOCAL int      g_slices[16];
+static LXA_INSTANCE_LOCAL int      g_num_slices;
+static LXA_INSTANCE_LOCAL uint64_t g_cpu_cycles;
+static LXA_INSTANCE_LOCAL uint64_t g_end_at;
+
+int m68k_execute(int num_cycles)
+{
+    int used = num_cycles;
+
+    if (g_end_at > g_cpu_cycles && g_end_at < g_cpu_cycles + num_cycles)
+        used = (int)(g_end_at - g_cpu_cycles);
+    if (g_num_slices < 16)
+        g_slices[g_num_slices++] = num_cycles;
+    g_cpu_cycles += used;
+    return used;
+}
+
+static void poke32(uint32_t address, uint32_t value)
+{
+    g_mem[address]     = value >> 24;
+    g_mem[address + 1] = value >> 16;
+    g_mem[address + 2] = value >> 8;
+    g_mem[address + 3] = value;
+}
+
+static void make_slot(uint32_t slot, uint32_t func)
+{
+    g_mem[slot]     = 0x4e;
+    g_mem[slot + 1] = 0xf9;
+    poke32(slot + 2, func);
+}
+
+static void set_task(uint32_t task)
+{
+    poke32(TEST_EXECBASE + EXECBASE_THISTASK, task);
+}
+
+/* JSR to a slot: push the return address and dispatch the slot */
+static void call(uint32_t slot, uint32_t ret)
+{
+    g_a7 -= 4;
+    poke32(g_a7, ret);
+    _profile_lvo_hook(slot);
+}
+
+/* RTS: pop and dispatch the return address */
+static void ret(void)
+{
+    uint32_t pc = m68k_read_memory_32(g_a7);
+
+    g_a7 += 4;
+    _profile_lvo_hook(pc);
+}
+
+static void read_file(const char *path, char *buf, size_t size)
+{
+    FILE  *f = fopen(path, "r");
+    size_t n = f ? fread(buf, 1, size - 1, f) : 0;
+
+    buf[n] = 0;
+    if (f)
+        fclose(f);
+    unlink(path);
+}
+
+static int find(const lxa_profile_lvo_entry_t *e, int n, const char *name)
+{
+    for (int i = 0; i < n; i++)
+    {
+        if (!strcmp(e[i].name, name))
+            return i;
+    }
+    return -1;
+}
+
+void setUp(void)
+{
+    memset(g_mem, 0, sizeof(g_mem));
+    poke32(4, TEST_EXECBASE);
+    set_task(TEST_TASK_A);
+    make_slot(TEST_SLOT_TEXT, FUNC_TEXT);
+    make_slot(TEST_SLOT_MOVE, FUNC_MOVE);
+    _profile_lvo_register(FUNC_TEXT, "graphics/Text");
+    _profile_lvo_register(FUNC_MOVE, "graphics/Move");
+    lxa_profile_reset();
+    g_profile_cycles = 0;
+    g_a7 = 0x8000;
+    g_num_slices = 0;
+    g_cpu_cycles = 0;
+    g_end_at     = 0;
+}
+
+void tearDown(void)
+{
+}
+
+void test_lxa_profile_lvo_nested_calls(void)
+{
+    lxa_profile_lvo_entry_t e[4];
+    int n, text, move;
+
+    g_profile_cycles = 100;
+    call(TEST_SLOT_TEXT, 0x3000);
+    _profile_lvo_hook(FUNC_TEXT);
+
+    g_profile_cycles = 150;
+    call(TEST_SLOT_MOVE, FUNC_TEXT + 0x10);
+    _profile_lvo_hook(FUNC_MOVE);
+
+    g_profile_cycles = 170;
+    ret();
+
+    g_profile_cycles = 200;
+    ret();
+
+    n = lxa_profile_get_lvo(e, 4);
+    TEST_ASSERT_EQUAL_INT(2, n);
+    text = find(e, n, "graphics/Text");
+    move = find(e, n, "graphics/Move");
+    TEST_ASSERT_TRUE(text >= 0 && move >= 0);
+
+    TEST_ASSERT_EQUAL_UINT32(1, (uint32_t)e[text].call_count);
+    TEST_ASSERT_EQUAL_UINT32(100, (uint32_t)e[text].total_cycles);
+    TEST_ASSERT_EQUAL_UINT32(80, (uint32_t)e[text].self_cycles);
+    TEST_ASSERT_EQUAL_UINT32(20, (uint32_t)e[move].total_cycles);
+    TEST_ASSERT_EQUAL_UINT32(20, (uint32_t)e[move].self_cycles);
+    TEST_ASSERT_TRUE(e[text].total_ns >= e[text].self_ns);
+}
+
+void test_lxa_profile_lvo_tasks_keep_their_calls(void)
+{
+    lxa_profile_lvo_entry_t e[4];
+
+    /* task A enters Text and blocks in it */
+    call(TEST_SLOT_TEXT, 0x3000);
+
+    /* task B calls Text from the same code, on its own stack */
+    set_task(TEST_TASK_B);
+    g_a7 = 0x7000;
+    g_profile_cycles = 10;
+    call(TEST_SLOT_TEXT, 0x3000);
+    g_profile_cycles = 40;
+    ret();
+
+    TEST_ASSERT_EQUAL_INT(1, lxa_profile_get_lvo(e, 4));
+    TEST_ASSERT_EQUAL_UINT32(1, (uint32_t)e[0].call_count);
+    TEST_ASSERT_EQUAL_UINT32(30, (uint32_t)e[0].total_cycles);
+
+    /* task A returns */
+    set_task(TEST_TASK_A);
+    g_a7 = 0x8000 - 4;
+    g_profile_cycles = 100;
+    ret();
+
+    TEST_ASSERT_EQUAL_INT(1, lxa_profile_get_lvo(e, 4));
+    TEST_ASSERT_EQUAL_UINT32(2, (uint32_t)e[0].call_count);
+    TEST_ASSERT_EQUAL_UINT32(130, (uint32_t)e[0].total_cycles);
+}
+
+void test_lxa_profile_lvo_json(void)
+{
+    char  path[] = "/tmp/lxa_lvo_profile_XXXXXX";
+    char  buf[512];
+    FILE *f;
+    int   fd = mkstemp(path);
+    size_t n;
+
+    TEST_ASSERT_TRUE(fd >= 0);
+    close(fd);
+
+    call(TEST_SLOT_TEXT, 0x3000);
+    g_profile_cycles = 25;
+    ret();
+
+    TEST_ASSERT_TRUE(lxa_profile_write_json(path));
+    f = fopen(path, "r");
+    TEST_ASSERT_NOT_NULL(f);
+    n = fread(buf, 1, sizeof(buf) - 1, f);
+    buf[n] = 0;
+    fclose(f);
+    unlink(path);
+
+    TEST_ASSERT_NOT_NULL(strstr(buf, "\"kind\": \"lvo\", \"name\": \"graphics/Text\", \"calls\": 1"));
+    TEST_ASSERT_NOT_NULL(strstr(buf, "\"cycles\": 25, \"self_cycles\": 25"));
+}
+
+void test_lxa_profile_sampler_folded_stacks(void)
+{
+    char  path[] = "/tmp/lxa_samples_XXXXXX";
+    char  buf[256];
+    FILE *f;
+    int   fd = mkstemp(path);
+    size_t n;
+
+    TEST_ASSERT_TRUE(fd >= 0);
+    close(fd);
+
+    /* task "my app" running _inner, called by JSR abs.l from _main */
+    poke32(TEST_TASK_A + 10, 0x2200);
+    memcpy(&g_mem[0x2200], "my app", 7);
+    g_mem[0x3010] = 0x4e;
+    g_mem[0x3011] = 0xb9;
+    poke32(0x3012, 0x4000);
+    g_a7 = 0x7ff0;
+    poke32(0x7ff0, 0x3016);     /* return address */
+    poke32(0x7ff4, 0x4002);     /* code pointer, but not behind a call */
+    g_pc = 0x4010;
+
+    TEST_ASSERT_EQUAL_INT(1000, _profile_sample_slice(1000));
+    lxa_profile_sample_start(300);
+    for (int i = 0; i < 3; i++)
+    {
+        int slice = _profile_sample_slice(1000);
+        TEST_ASSERT_EQUAL_INT(300, slice);
+        g_profile_cycles += slice;
+        _profile_sample_tick();
+    }
+    lxa_profile_sample_stop();
+    TEST_ASSERT_EQUAL_INT(1000, _profile_sample_slice(1000));
+
+    TEST_ASSERT_TRUE(lxa_profile_write_folded(path));
+    f = fopen(path, "r");
+    TEST_ASSERT_NOT_NULL(f);
+    n = fread(buf, 1, sizeof(buf) - 1, f);
+    buf[n] = 0;
+    fclose(f);
+    unlink(path);
+
+    TEST_ASSERT_EQUAL_STRING("my_app;main;inner 3\n", buf);
+}
+
+void test_lxa_profile_execute_accounts_cycles(void)
+{
+    /* no sampler: one timeslice */
+    TEST_ASSERT_EQUAL_INT(1000, _profile_execute(1000));
+    TEST_ASSERT_EQUAL_INT(1, g_num_slices);
+    TEST_ASSERT_TRUE(g_profile_cycles == 1000);
+
+    /* sampler: pieces ending at sample points, all cycles accounted */
+    lxa_profile_sample_start(300);
+    g_num_slices = 0;
+    TEST_ASSERT_EQUAL_INT(1000, _profile_execute(1000));
+    TEST_ASSERT_EQUAL_INT(4, g_num_slices);
+    TEST_ASSERT_EQUAL_INT(300, g_slices[0]);
+    TEST_ASSERT_EQUAL_INT(100, g_slices[3]);
+    TEST_ASSERT_TRUE(g_profile_cycles == 2000);
+
+    /* timeslice ended early (emucall, spin, idle): stop, count what ran */
+    g_num_slices = 0;
+    g_end_at     = g_cpu_cycles + 450;
+    TEST_ASSERT_EQUAL_INT(450, _profile_execute(1000));
+    TEST_ASSERT_EQUAL_INT(2, g_num_slices);
+    TEST_ASSERT_TRUE(g_profile_cycles == 2450);
+    lxa_profile_sample_stop();
+}
+
+/* One profiled instance: calls Text n times, then samples 3000 cycles */
+typedef struct
+{
+    int      calls;
+    uint32_t interval;
+    int      lvo_count;
+    uint64_t lvo_calls;
+    uint64_t lvo_cycles;
+    char     folded[128];
+} instance_run_t;
+
+static pthread_barrier_t g_barrier;
+
+static void *run_instance(void *arg)
+{
+    instance_run_t         *r = arg;
+    lxa_profile_lvo_entry_t e[4];
+    char                    path[] = "/tmp/lxa_samples_XXXXXX";
+    int                     fd = mkstemp(path);
+
+    setUp();
+    pthread_barrier_wait(&g_barrier);
+
+    for (int i = 0; i < r->calls; i++)
+    {
+        call(TEST_SLOT_TEXT, 0x3000);
+        g_profile_cycles += 10;
+        ret();
+    }
+    lxa_profile_sample_start(r->interval);
+    _profile_execute(3000);
+    lxa_profile_sample_stop();
+
+    r->lvo_count = lxa_profile_get_lvo(e, 4);
+    if (r->lvo_count > 0)
+    {
+        r->lvo_calls  = e[0].call_count;
+        r->lvo_cycles = e[0].total_cycles;
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+        lxa_profile_write_folded(path);
+        read_file(path, r->folded, sizeof(r->folded));
+    }
+
+    _profile_shutdown();
+    return NULL;
+}
+
+void test_lxa_profile_instances_on_threads(void)
+{
+    instance_run_t runs[2] = { { .calls = 1000, .interval = 300 }, { .calls = 500, .interval = 1000 } };
+    pthread_t      threads[2];
+
+    pthread_barrier_init(&g_barrier, NULL, 2);
+    for (int i = 0; i < 2; i++)
+        TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL, run_instance, &runs[i]));
+    for (int i = 0; i < 2; i++)
+        pthread_join(threads[i], NULL);
+    pthread_barrier_destroy(&g_barrier);
+
+    for (int i = 0; i < 2; i++)
+    {
+        char expect[64];
+
+        TEST_ASSERT_EQUAL_INT(1, runs[i].lvo_count);
+        TEST_ASSERT_TRUE(runs[i].lvo_calls == (uint64_t)runs[i].calls);
+        TEST_ASSERT_TRUE(runs[i].lvo_cycles == 10 * (uint64_t)runs[i].calls);
+        snprintf(expect, sizeof(expect), "task_0x%06x;0x000000 %u\n", TEST_TASK_A, 3000 / runs[i].interval);
+        TEST_ASSERT_EQUAL_STRING(expect, runs[i].folded);
+    }
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_lxa_profile_lvo_nested_calls);
+    RUN_TEST(test_lxa_profile_lvo_tasks_keep_their_calls);
+    RUN_TEST(test_lxa_profile_lvo_json);
+    RUN_TEST(test_lxa_profile_sampler_folded_stacks);
+    RUN_TEST(test_lxa_profile_execute_accounts_cycles);
+    RUN_TEST(test_lxa_profile_instances_on_threads);
+    return UNITY_END();
+}
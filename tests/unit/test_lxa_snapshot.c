@@ -0,0 +1,413 @@
+/*
+ * Unit Tests for emulator snapshots
+ *
+ * Links the real lxa_snapshot.c and lxa_dos_host.c against a fake guest
+ * RAM and ROM, a fake CPU context and stub sections for the modules that
+ * need a booted machine (display, lxa.c, lxa_api.c, events).  Checks that:
+ * - a restore brings back RAM, CPU context, copper pointers and every
+ *   section, and clears RAM written after the save
+ * - all-zero RAM pages are left out of the image
+ * - the DOS section reopens the guest's files at their saved offsets and
+ *   rebases the timer queue on the time of the restore
+ * - a snapshot of another ROM or RAM size, a section that does not consume
+ *   its length and an fd the host took over in the meantime are refused
+ * - images survive lxa_snapshot_write()/lxa_snapshot_read()
+ */
+
+#include "unity.h"
+
+#include "lxa_api.h"
+#include "lxa_internal.h"
+#include "lxa_snapshot.h"
+#include "m68kcache.h"
+
+#include <fcntl.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define TEST_RAM_SIZE   (64 * 1024)
+#define TEST_FH         0x1000
+#define TEST_PATH       0x1100
+#define TEST_CTX_SIZE   16
+
+/* === Globals normally provided by lxa_memory.c, lxa.c and m68kcpu.c === */
+
+uint8_t  *g_ram;
+uint32_t  g_ram_size;
+uint8_t  *g_rom;
+char     *g_sysroot;
+int       g_watch_count;
+uint8_t   m68k_cache_page_flags[M68KCACHE_NUM_PAGES];
+void    (*g_console_output_hook)(const char *data, int len);
+
+static uint8_t g_ctx[TEST_CTX_SIZE];
+static int     g_cache_flushes;
+
+unsigned int m68k_read_memory_8(unsigned int address)
+{
+    return g_ram[address % TEST_RAM_SIZE];
+}
+
+unsigned int m68k_read_memory_32(unsigned int address)
+{
+    return (m68k_read_memory_8(address) << 24) | (m68k_read_memory_8(address + 1) << 16) |
+           (m68k_read_memory_8(address + 2) << 8) | m68k_read_memory_8(address + 3);
+}
+
+void m68k_write_memory_8(unsigned int address, unsigned int value)
+{
+    g_ram[address % TEST_RAM_SIZE] = value;
+}
+
+void m68k_write_memory_16(unsigned int address, unsigned int value)
+{
+    m68k_write_memory_8(address, value >> 8);
+    m68k_write_memory_8(address + 1, value);
+}
+
+void m68k_write_memory_32(unsigned int address, unsigned int value)
+{
+    m68k_write_memory_16(address, value >> 16);
+    m68k_write_memory_16(address + 2, value);
+}
+
+unsigned int m68k_context_size(void)
+{
+    return TEST_CTX_SIZE;
+}
+
+unsigned int m68k_get_context(void *dst)
+{
+    memcpy(dst, g_ctx, TEST_CTX_SIZE);
+    return TEST_CTX_SIZE;
+}
+
+void m68k_set_context_state(const void *src)
+{
+    memcpy(g_ctx, src, TEST_CTX_SIZE);
+}
+
+void m68k_cache_flush(void)
+{
+    g_cache_flushes++;
+}
+
+void m68k_cache_invalidate_range(uint32_t address, uint32_t size)
+{
+    (void)address;
+    (void)size;
+}
+
+void lxa_mem_clear_ram(void)
+{
+    memset(g_ram, 0, g_ram_size);
+}
+
+void lxa_mem_mark_dirty_range(uint32_t address, uint32_t size)
+{
+    (void)address;
+    (void)size;
+}
+
+void lxa_watch_host_write(uint32_t address, uint32_t size)
+{
+    (void)address;
+    (void)size;
+}
+
+bool lxa_host_console_input_empty(void)
+{
+    return true;
+}
+
+int lxa_host_console_input_pop(void)
+{
+    return -1;
+}
+
+/* === Copper and the sections of modules that need a booted machine === */
+
+static uint32_t g_cop1lc, g_cop2lc;
+static uint16_t g_copcon;
+
+void copper_reset(void)                 { g_cop1lc = g_cop2lc = 0; g_copcon = 0; }
+void copper_set_cop1lc(uint32_t addr)   { g_cop1lc = addr; }
+void copper_set_cop2lc(uint32_t addr)   { g_cop2lc = addr; }
+void copper_set_copcon(uint16_t val)    { g_copcon = val; }
+uint32_t copper_get_cop1lc(void)        { return g_cop1lc; }
+uint32_t copper_get_cop2lc(void)        { return g_cop2lc; }
+uint16_t copper_get_copcon(void)        { return g_copcon; }
+
+/* One value per stubbed section; g_short_events makes EVNT read too little */
+static uint32_t g_display_state, g_host_state, g_api_state, g_events_state;
+static bool     g_short_events;
+
+void display_save_state(lxa_snap_buf_t *buf)     { lxa_snap_put_u32(buf, g_display_state); }
+bool display_load_state(lxa_snap_buf_t *buf)     { g_display_state = lxa_snap_get_u32(buf); return true; }
+void lxa_save_host_state(lxa_snap_buf_t *buf)    { lxa_snap_put_u32(buf, g_host_state); }
+bool lxa_load_host_state(lxa_snap_buf_t *buf)    { g_host_state = lxa_snap_get_u32(buf); return true; }
+bool lxa_api_save_state(lxa_snap_buf_t *buf)     { lxa_snap_put_u32(buf, g_api_state); return true; }
+bool lxa_api_load_state(lxa_snap_buf_t *buf)     { g_api_state = lxa_snap_get_u32(buf); return true; }
+
+void lxa_events_save_state(lxa_snap_buf_t *buf)
+{
+    lxa_snap_put_u32(buf, g_events_state);
+    lxa_snap_put_u32(buf, 0);
+}
+
+bool lxa_events_load_state(lxa_snap_buf_t *buf)
+{
+    g_events_state = lxa_snap_get_u32(buf);
+    if (!g_short_events)
+        lxa_snap_get_u32(buf);
+    return true;
+}
+
+/* === Helpers === */
+
+static char g_file[64];
+
+static uint64_t now_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000ULL + (uint64_t)tv.tv_usec;
+}
+
+/* Open g_file through dos.library's Open() path; returns the host fd */
+static int guest_open(void)
+{
+    strcpy((char *)&g_ram[TEST_PATH], g_file);
+    TEST_ASSERT_EQUAL_INT(0, _dos_open(TEST_PATH, MODE_OLDFILE, TEST_FH));
+    return (int)m68k_read_memory_32(TEST_FH + 36);
+}
+
+void setUp(void)
+{
+    int fd;
+
+    g_ram_size = TEST_RAM_SIZE;
+    g_ram      = calloc(1, TEST_RAM_SIZE);
+    g_rom      = calloc(1, ROM_SIZE);
+    g_locks    = calloc(MAX_LOCKS, sizeof(lock_entry_t));
+    g_notify_requests = calloc(MAX_NOTIFY_REQUESTS, sizeof(notify_entry_t));
+    TEST_ASSERT_TRUE(g_ram && g_rom && g_locks && g_notify_requests);
+    memset(g_timer_queue, 0, sizeof(timer_request_t) * MAX_TIMER_REQUESTS);
+    g_rom[0] = 0x11;
+
+    strcpy(g_file, "/tmp/lxa_snapshot_XXXXXX");
+    fd = mkstemp(g_file);
+    TEST_ASSERT_TRUE(fd >= 0);
+    TEST_ASSERT_EQUAL_INT(32, write(fd, "0123456789abcdefghijklmnopqrstuv", 32));
+    close(fd);
+
+    memset(g_ctx, 0, sizeof(g_ctx));
+    copper_reset();
+    g_display_state = g_host_state = g_api_state = g_events_state = 0;
+    g_short_events  = false;
+    g_cache_flushes = 0;
+}
+
+void tearDown(void)
+{
+    if (m68k_read_memory_32(TEST_FH + 32) == FILE_KIND_REGULAR)
+        _dos_close(TEST_FH);
+    unlink(g_file);
+    free(g_ram);
+    free(g_rom);
+    free(g_locks);
+    free(g_notify_requests);
+}
+
+/* === Tests === */
+
+void test_lxa_snapshot_restores_machine(void)
+{
+    lxa_snapshot_t *snap;
+
+    g_ram[0x2000] = 0xaa;
+    g_ram[0x9fff] = 0x55;
+    memset(g_ctx, 0x42, sizeof(g_ctx));
+    copper_set_cop1lc(0x1234);
+    copper_set_cop2lc(0x5678);
+    copper_set_copcon(2);
+    g_display_state = 1;
+    g_host_state    = 2;
+    g_api_state     = 3;
+    g_events_state  = 4;
+
+    snap = lxa_snapshot_save();
+    TEST_ASSERT_NOT_NULL(snap);
+
+    g_ram[0x2000] = 0;
+    g_ram[0x5000] = 0x77;
+    memset(g_ctx, 0, sizeof(g_ctx));
+    copper_reset();
+    g_display_state = g_host_state = g_api_state = g_events_state = 0;
+
+    TEST_ASSERT_TRUE(lxa_snapshot_restore(snap));
+    TEST_ASSERT_EQUAL_HEX8(0xaa, g_ram[0x2000]);
+    TEST_ASSERT_EQUAL_HEX8(0x55, g_ram[0x9fff]);
+    TEST_ASSERT_EQUAL_HEX8(0, g_ram[0x5000]);
+    TEST_ASSERT_EQUAL_HEX8(0x42, g_ctx[TEST_CTX_SIZE - 1]);
+    TEST_ASSERT_EQUAL_HEX32(0x1234, g_cop1lc);
+    TEST_ASSERT_EQUAL_HEX32(0x5678, g_cop2lc);
+    TEST_ASSERT_EQUAL_UINT16(2, g_copcon);
+    TEST_ASSERT_EQUAL_UINT32(1, g_display_state);
+    TEST_ASSERT_EQUAL_UINT32(2, g_host_state);
+    TEST_ASSERT_EQUAL_UINT32(3, g_api_state);
+    TEST_ASSERT_EQUAL_UINT32(4, g_events_state);
+    TEST_ASSERT_EQUAL_INT(1, g_cache_flushes);
+
+    lxa_snapshot_free(snap);
+}
+
+void test_lxa_snapshot_leaves_out_zero_pages(void)
+{
+    lxa_snapshot_t *empty, *two;
+
+    empty = lxa_snapshot_save();
+    g_ram[0x1000] = 1;
+    g_ram[0xf000] = 1;
+    two = lxa_snapshot_save();
+    TEST_ASSERT_TRUE(empty && two);
+
+    TEST_ASSERT_TRUE(lxa_snapshot_size(empty) < 4096);
+    TEST_ASSERT_EQUAL_UINT32(2 * (4096 + 4), lxa_snapshot_size(two) - lxa_snapshot_size(empty));
+
+    lxa_snapshot_free(empty);
+    lxa_snapshot_free(two);
+}
+
+void test_lxa_snapshot_reopens_files_and_rebases_timers(void)
+{
+    lxa_snapshot_t *snap;
+    uint64_t        wake = now_us() + 1000000;
+    int             fd = guest_open();
+    char            c;
+
+    TEST_ASSERT_EQUAL_INT(7, lseek(fd, 7, SEEK_SET));
+    g_timer_queue[5].in_use       = true;
+    g_timer_queue[5].ioreq_ptr    = 0x4000;
+    g_timer_queue[5].wake_time_us = wake;
+
+    snap = lxa_snapshot_save();
+    TEST_ASSERT_NOT_NULL(snap);
+
+    /* the session goes on: the file is read on and closed, the timer fires */
+    TEST_ASSERT_EQUAL_INT(1, read(fd, &c, 1));
+    _dos_close(TEST_FH);
+    memset(g_timer_queue, 0, sizeof(timer_request_t) * MAX_TIMER_REQUESTS);
+    usleep(20000);
+
+    TEST_ASSERT_TRUE(lxa_snapshot_restore(snap));
+
+    /* same fd number, same offset */
+    TEST_ASSERT_TRUE(fcntl(fd, F_GETFD) != -1);
+    TEST_ASSERT_EQUAL_INT(7, lseek(fd, 0, SEEK_CUR));
+    TEST_ASSERT_EQUAL_INT(1, read(fd, &c, 1));
+    TEST_ASSERT_EQUAL_INT('7', c);
+
+    /* the request still has its second to go */
+    TEST_ASSERT_TRUE(g_timer_queue[5].in_use);
+    TEST_ASSERT_EQUAL_HEX32(0x4000, g_timer_queue[5].ioreq_ptr);
+    TEST_ASSERT_TRUE(g_timer_queue[5].wake_time_us >= wake + 20000);
+    TEST_ASSERT_TRUE(g_timer_queue[5].wake_time_us <= now_us() + 1000000);
+
+    lxa_snapshot_free(snap);
+}
+
+void test_lxa_snapshot_refuses_fd_taken_by_host(void)
+{
+    lxa_snapshot_t *snap;
+    int             fd = guest_open();
+    int             host;
+
+    snap = lxa_snapshot_save();
+    TEST_ASSERT_NOT_NULL(snap);
+    _dos_close(TEST_FH);
+
+    host = open("/dev/null", O_RDONLY);
+    TEST_ASSERT_EQUAL_INT(fd, host);
+
+    TEST_ASSERT_FALSE(lxa_snapshot_restore(snap));
+
+    close(host);
+    lxa_snapshot_free(snap);
+}
+
+void test_lxa_snapshot_refuses_other_machine(void)
+{
+    lxa_snapshot_t *snap = lxa_snapshot_save();
+
+    TEST_ASSERT_NOT_NULL(snap);
+
+    g_rom[100] = 1;
+    TEST_ASSERT_FALSE(lxa_snapshot_restore(snap));
+    g_rom[100] = 0;
+
+    g_ram_size = TEST_RAM_SIZE / 2;
+    TEST_ASSERT_FALSE(lxa_snapshot_restore(snap));
+    g_ram_size = TEST_RAM_SIZE;
+
+    TEST_ASSERT_TRUE(lxa_snapshot_restore(snap));
+    TEST_ASSERT_FALSE(lxa_snapshot_restore(NULL));
+    lxa_snapshot_free(snap);
+}
+
+void test_lxa_snapshot_refuses_section_of_wrong_length(void)
+{
+    lxa_snapshot_t *snap = lxa_snapshot_save();
+
+    TEST_ASSERT_NOT_NULL(snap);
+    g_short_events = true;
+    TEST_ASSERT_FALSE(lxa_snapshot_restore(snap));
+    g_short_events = false;
+    TEST_ASSERT_TRUE(lxa_snapshot_restore(snap));
+    lxa_snapshot_free(snap);
+}
+
+void test_lxa_snapshot_file_round_trip(void)
+{
+    char            path[] = "/tmp/lxa_image_XXXXXX";
+    int             fd = mkstemp(path);
+    lxa_snapshot_t *snap, *back;
+
+    TEST_ASSERT_TRUE(fd >= 0);
+    close(fd);
+
+    g_ram[0x3000] = 0x99;
+    g_host_state  = 5;
+    snap = lxa_snapshot_save();
+    TEST_ASSERT_NOT_NULL(snap);
+    TEST_ASSERT_TRUE(lxa_snapshot_write(snap, path));
+
+    back = lxa_snapshot_read(path);
+    unlink(path);
+    TEST_ASSERT_NOT_NULL(back);
+    TEST_ASSERT_EQUAL_UINT32(lxa_snapshot_size(snap), lxa_snapshot_size(back));
+
+    g_ram[0x3000] = 0;
+    g_host_state  = 0;
+    TEST_ASSERT_TRUE(lxa_snapshot_restore(back));
+    TEST_ASSERT_EQUAL_HEX8(0x99, g_ram[0x3000]);
+    TEST_ASSERT_EQUAL_UINT32(5, g_host_state);
+
+    TEST_ASSERT_TRUE(lxa_snapshot_read("/nonexistent/lxa_image") == NULL);
+    lxa_snapshot_free(snap);
+    lxa_snapshot_free(back);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_lxa_snapshot_restores_machine);
+    RUN_TEST(test_lxa_snapshot_leaves_out_zero_pages);
+    RUN_TEST(test_lxa_snapshot_reopens_files_and_rebases_timers);
+    RUN_TEST(test_lxa_snapshot_refuses_fd_taken_by_host);
+    RUN_TEST(test_lxa_snapshot_refuses_other_machine);
+    RUN_TEST(test_lxa_snapshot_refuses_section_of_wrong_length);
+    RUN_TEST(test_lxa_snapshot_file_round_trip);
+    return UNITY_END();
+}
@@ -0,0 +1,200 @@
+/*
+ * Unit Tests for the data watchpoints
+ *
+ * Links the real lxa_watch.c against a fake, page-aligned guest RAM:
+ * - CPU stores into a watched range are reported with the guest PC and
+ *   still land, every time
+ * - stores to the rest of a watched page are let through without a report
+ * - wide host stores starting below the range are found by comparison
+ * - kernel writes announced as host writes succeed and are reported
+ * - removed watchpoints stop reporting, invalid ranges are refused
+ * - break watchpoints end the CPU slice
+ */
+
+#include "unity.h"
+
+#include "lxa_internal.h"
+#include "lxa_watch.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define TEST_RAM_SIZE   (256 * 1024)
+#define TEST_PC         0x00f81234
+
+/* === Globals normally provided by lxa_memory.c / m68kcpu.c === */
+
+uint8_t  *g_ram;
+uint32_t  g_ram_size;
+
+static int g_end_timeslices;
+
+unsigned int m68k_get_reg(void *context, m68k_register_t reg)
+{
+    (void)context;
+    return reg == M68K_REG_PPC ? TEST_PC : 0;
+}
+
+void m68k_end_timeslice_used(void)
+{
+    g_end_timeslices++;
+}
+
+/* A store the compiler cannot drop or move */
+static void poke(uint32_t address, uint8_t value)
+{
+    *(volatile uint8_t *)(g_ram + address) = value;
+}
+
+static int drain(lxa_watch_hit_t *first)
+{
+    lxa_watch_hit_t hit;
+    int             n = 0;
+
+    while (lxa_watch_poll(&hit))
+    {
+        if (!n++ && first)
+            *first = hit;
+    }
+    return n;
+}
+
+void setUp(void)
+{
+    if (!g_ram)
+    {
+        g_ram = mmap(NULL, TEST_RAM_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        TEST_ASSERT_TRUE(g_ram != MAP_FAILED);
+        g_ram_size = TEST_RAM_SIZE;
+    }
+    memset(g_ram, 0, TEST_RAM_SIZE);
+    g_end_timeslices = 0;
+}
+
+void tearDown(void)
+{
+    lxa_watch_clear();
+}
+
+void test_lxa_watch_cpu_store_is_reported_and_lands(void)
+{
+    lxa_watch_hit_t hit;
+
+    TEST_ASSERT_TRUE(lxa_watch_add(0x10000, 4, false));
+    TEST_ASSERT_EQUAL_INT(1, g_watch_count);
+
+    poke(0x10002, 0x55);
+    TEST_ASSERT_EQUAL_HEX8(0x55, g_ram[0x10002]);
+    TEST_ASSERT_EQUAL_INT(1, drain(&hit));
+    TEST_ASSERT_EQUAL_HEX32(0x10002, hit.address);
+    TEST_ASSERT_EQUAL_HEX32(0x10000, hit.watch);
+    TEST_ASSERT_EQUAL_HEX32(TEST_PC, hit.pc);
+    TEST_ASSERT_FALSE(hit.host);
+    TEST_ASSERT_FALSE(hit.brk);
+    TEST_ASSERT_EQUAL_INT(0, g_end_timeslices);
+
+    /* the page is protected again */
+    poke(0x10000, 0x66);
+    TEST_ASSERT_EQUAL_HEX8(0x66, g_ram[0x10000]);
+    TEST_ASSERT_EQUAL_INT(1, drain(&hit));
+    TEST_ASSERT_EQUAL_HEX32(0x10000, hit.address);
+}
+
+void test_lxa_watch_rest_of_page_is_not_reported(void)
+{
+    lxa_watch_hit_t hit;
+
+    TEST_ASSERT_TRUE(lxa_watch_add(0x10000, 4, false));
+
+    poke(0x10100, 0x11);
+    poke(0x10004, 0x22);
+    TEST_ASSERT_EQUAL_HEX8(0x11, g_ram[0x10100]);
+    TEST_ASSERT_EQUAL_HEX8(0x22, g_ram[0x10004]);
+    TEST_ASSERT_EQUAL_INT(0, drain(NULL));
+
+    poke(0x10003, 0x33);
+    TEST_ASSERT_EQUAL_INT(1, drain(&hit));
+    TEST_ASSERT_EQUAL_HEX32(0x10003, hit.address);
+}
+
+void test_lxa_watch_wide_store_from_below_is_found(void)
+{
+    lxa_watch_hit_t hit;
+
+    TEST_ASSERT_TRUE(lxa_watch_add(0x10010, 8, false));
+
+    memset(g_ram + 0x10000, 0xaa, 0x40);
+    TEST_ASSERT_EQUAL_HEX8(0xaa, g_ram[0x1003f]);
+    TEST_ASSERT_TRUE(drain(&hit) >= 1);
+    TEST_ASSERT_EQUAL_HEX32(0x10010, hit.watch);
+    TEST_ASSERT_TRUE(hit.address >= 0x10010 && hit.address < 0x10018);
+}
+
+void test_lxa_watch_host_write_lets_kernel_write(void)
+{
+    lxa_watch_hit_t hit;
+    int             fds[2];
+
+    TEST_ASSERT_TRUE(lxa_watch_add(0x10000, 4, false));
+    TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+    TEST_ASSERT_EQUAL_INT(4, write(fds[1], "\x01\x02\x03\x04", 4));
+
+    lxa_watch_host_write(0x0fffe, 4);
+    TEST_ASSERT_EQUAL_INT(4, read(fds[0], g_ram + 0x0fffe, 4));
+    close(fds[0]);
+    close(fds[1]);
+
+    TEST_ASSERT_EQUAL_HEX8(0x04, g_ram[0x10001]);
+    TEST_ASSERT_EQUAL_INT(1, drain(&hit));
+    TEST_ASSERT_EQUAL_HEX32(0x10000, hit.address);
+    TEST_ASSERT_TRUE(hit.host);
+
+    /* the poll protected the page again */
+    poke(0x10001, 0x77);
+    TEST_ASSERT_EQUAL_INT(1, drain(&hit));
+    TEST_ASSERT_FALSE(hit.host);
+}
+
+void test_lxa_watch_remove_and_invalid_ranges(void)
+{
+    TEST_ASSERT_TRUE(lxa_watch_add(0x10000, 4, false));
+    TEST_ASSERT_TRUE(lxa_watch_add(0x20000, 2, false));
+    TEST_ASSERT_FALSE(lxa_watch_add(0x10000, 4, false));
+    TEST_ASSERT_FALSE(lxa_watch_add(0x10008, 0, false));
+    TEST_ASSERT_FALSE(lxa_watch_add(TEST_RAM_SIZE - 2, 4, false));
+    TEST_ASSERT_FALSE(lxa_watch_add(0x00bfe001, 1, false));
+
+    TEST_ASSERT_TRUE(lxa_watch_remove(0x10000));
+    TEST_ASSERT_FALSE(lxa_watch_remove(0x10000));
+    TEST_ASSERT_EQUAL_INT(1, g_watch_count);
+
+    poke(0x10000, 0x12);
+    TEST_ASSERT_EQUAL_INT(0, drain(NULL));
+    poke(0x20001, 0x34);
+    TEST_ASSERT_EQUAL_INT(1, drain(NULL));
+}
+
+void test_lxa_watch_break_ends_timeslice(void)
+{
+    lxa_watch_hit_t hit;
+
+    TEST_ASSERT_TRUE(lxa_watch_add(0x30000, 1, true));
+
+    poke(0x30000, 0x99);
+    TEST_ASSERT_TRUE(g_end_timeslices > 0);
+    TEST_ASSERT_EQUAL_INT(1, drain(&hit));
+    TEST_ASSERT_TRUE(hit.brk);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_lxa_watch_cpu_store_is_reported_and_lands);
+    RUN_TEST(test_lxa_watch_rest_of_page_is_not_reported);
+    RUN_TEST(test_lxa_watch_wide_store_from_below_is_found);
+    RUN_TEST(test_lxa_watch_host_write_lets_kernel_write);
+    RUN_TEST(test_lxa_watch_remove_and_invalid_ranges);
+    RUN_TEST(test_lxa_watch_break_ends_timeslice);
+    return UNITY_END();
+}
@@ -0,0 +1,487 @@
+/*
+ * Unit Tests for the m68k predecoded block cache
+ *
+ * Runs small hand-assembled 68k programs through the real Musashi core
+ * with a flat 64 KB test memory and checks that:
+ * - cached execution produces the same results as the interpreter
+ * - stores into a cached code page (self-modifying code) are honoured
+ * - host writes reported via m68k_cache_invalidate_range() are honoured
+ * - the cycle budget of m68k_execute() is respected exactly
+ * - direct instruction fetch bypasses the memory callbacks and sees stores
+ * - fast mode calls the instruction hook once per block dispatch
+ * - copy/fill/string loops run in bulk leave the interpreter's state
+ *   and retire code pages anywhere in their destination
+ * - polling loops that cannot make progress end the timeslice early
+ * - m68k_execute() reports the cycles run up to m68k_end_timeslice_used()
+ */
+
+#include "unity.h"
+#include <stdint.h>
+#include <string.h>
+
+#include "m68k.h"
+#include "m68kcache.h"
+
+#define TEST_MEM_SIZE     0x10000
+#define TEST_CACHED_END   0x7fff        /* code below here may be cached */
+#define TEST_CODE         0x1000
+#define TEST_CODE_UNCACHED 0x9000
+
+static uint8_t g_mem[TEST_MEM_SIZE];
+static int     g_emu_stops;
+static int     g_mem_reads;
+
+unsigned int m68k_read_memory_8(unsigned int address)
+{
+    g_mem_reads++;
+    return g_mem[address & (TEST_MEM_SIZE - 1)];
+}
+
+unsigned int m68k_read_memory_16(unsigned int address)
+{
+    return (m68k_read_memory_8(address) << 8) | m68k_read_memory_8(address + 1);
+}
+
+unsigned int m68k_read_memory_32(unsigned int address)
+{
+    return (m68k_read_memory_16(address) << 16) | m68k_read_memory_16(address + 2);
+}
+
+unsigned int m68k_read_disassembler_16(unsigned int address)
+{
+    return m68k_read_memory_16(address);
+}
+
+unsigned int m68k_read_disassembler_32(unsigned int address)
+{
+    return m68k_read_memory_32(address);
+}
+
+void m68k_write_memory_8(unsigned int address, unsigned int value)
+{
+    m68k_cache_note_write(address & (TEST_MEM_SIZE - 1), 1);
+    g_mem[address & (TEST_MEM_SIZE - 1)] = (uint8_t)value;
+}
+
+void m68k_write_memory_16(unsigned int address, unsigned int value)
+{
+    m68k_write_memory_8(address, value >> 8);
+    m68k_write_memory_8(address + 1, value);
+}
+
+void m68k_write_memory_32(unsigned int address, unsigned int value)
+{
+    m68k_write_memory_16(address, value >> 16);
+    m68k_write_memory_16(address + 2, value);
+}
+
+static int g_stop_upstream;             /* stop with m68k_end_timeslice() */
+
+/* ILLEGAL acts as "stop" for the test programs, like an EMU_CALL */
+int op_illg(int level)
+{
+    (void)level;
+    g_emu_stops++;
+    if (g_stop_upstream)
+        m68k_end_timeslice();
+    else
+        m68k_end_timeslice_used();
+    return 1;
+}
+
+static int g_hook_calls;
+static int g_hook_loop_head;
+
+void cpu_instr_callback(int pc)
+{
+    g_hook_calls++;
+    if (pc == TEST_CODE + 4)
+        g_hook_loop_head++;
+}
+
+/* Fetch window over the first half of test memory */
+static const unsigned char *fetch_page(unsigned int address, unsigned int *base, unsigned int *size)
+{
+    *base = 0;
+    *size = TEST_CACHED_END + 1;
+    return address <= TEST_CACHED_END ? g_mem : NULL;
+}
+
+/* Bulk access window for loop idioms: the same first half, writable */
+static unsigned char *host_memory(unsigned int address, unsigned int *size, int write)
+{
+    (void)write;
+    if (address > TEST_CACHED_END)
+        return NULL;
+    if (*size > TEST_CACHED_END + 1 - address)
+        *size = TEST_CACHED_END + 1 - address;
+    return g_mem + address;
+}
+
+static void load_program(uint32_t addr, const uint16_t *words, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        g_mem[addr + i * 2]     = words[i] >> 8;
+        g_mem[addr + i * 2 + 1] = words[i] & 0xff;
+    }
+}
+
+static void start_at(uint32_t pc)
+{
+    g_mem[0] = 0x00; g_mem[1] = 0x00; g_mem[2] = 0x80; g_mem[3] = 0x00;   /* SSP */
+    g_mem[4] = 0x00; g_mem[5] = 0x00; g_mem[6] = pc >> 8; g_mem[7] = pc & 0xff;
+    m68k_pulse_reset();
+    g_emu_stops = 0;
+}
+
+static void run_until_stop(void)
+{
+    int guard = 0;
+
+    while (!g_emu_stops && guard++ < 1000)
+        m68k_execute(1000);
+}
+
+void setUp(void)
+{
+    memset(g_mem, 0, sizeof(g_mem));
+    m68k_init();
+    m68k_set_cpu_type(M68K_CPU_TYPE_68030);
+    m68k_cache_set_cacheable(0, TEST_CACHED_END);
+    m68k_cache_set_fast_mode(0);
+    m68k_cache_set_spin_detect(0);
+    g_stop_upstream = 0;
+}
+
+void tearDown(void)
+{
+}
+
+/* moveq #0,d0; moveq #9,d1; loop: addq.l #1,d0; dbf d1,loop; illegal */
+static const uint16_t s_count_loop[] = { 0x7000, 0x7209, 0x5280, 0x51c9, 0xfffc, 0x4afc };
+
+void test_m68kcache_loop_result_matches_interpreter(void)
+{
+    load_program(TEST_CODE, s_count_loop, 6);
+    start_at(TEST_CODE);
+    run_until_stop();
+
+    TEST_ASSERT_EQUAL_INT(1, g_emu_stops);
+    TEST_ASSERT_EQUAL_HEX32(10, m68k_get_reg(NULL, M68K_REG_D0));
+    TEST_ASSERT_EQUAL_HEX32(0xffff, m68k_get_reg(NULL, M68K_REG_D1) & 0xffff);
+    TEST_ASSERT_EQUAL_HEX32(TEST_CODE + 12, m68k_get_reg(NULL, M68K_REG_PC));
+}
+
+void test_m68kcache_self_modifying_code_is_seen(void)
+{
+    /*
+     *        moveq   #0,d0
+     *        moveq   #4,d2
+     * loop:  moveq   #1,d1          ; immediate patched below
+     *        add.l   d1,d0
+     *        addq.b  #1,$1005.w     ; bump the moveq immediate
+     *        dbf     d2,loop
+     *        illegal
+     */
+    static const uint16_t prog[] = {
+        0x7000, 0x7404, 0x7201, 0xd081, 0x5238, 0x1005, 0x51ca, 0xfff6, 0x4afc
+    };
+
+    load_program(TEST_CODE, prog, 9);
+    start_at(TEST_CODE);
+    run_until_stop();
+
+    TEST_ASSERT_EQUAL_INT(1, g_emu_stops);
+    TEST_ASSERT_EQUAL_HEX32(1 + 2 + 3 + 4 + 5, m68k_get_reg(NULL, M68K_REG_D0));
+}
+
+void test_m68kcache_host_write_invalidates_block(void)
+{
+    /* moveq #1,d0; illegal */
+    static const uint16_t prog[] = { 0x7001, 0x4afc };
+
+    load_program(TEST_CODE, prog, 2);
+    start_at(TEST_CODE);
+    run_until_stop();
+    start_at(TEST_CODE);
+    run_until_stop();
+    TEST_ASSERT_EQUAL_HEX32(1, m68k_get_reg(NULL, M68K_REG_D0));
+
+    /* Patch behind the CPU's back and report it, like DOS Read() does */
+    g_mem[TEST_CODE + 1] = 0x05;
+    m68k_cache_invalidate_range(TEST_CODE, 2);
+
+    m68k_set_reg(M68K_REG_PC, TEST_CODE);
+    g_emu_stops = 0;
+    run_until_stop();
+    TEST_ASSERT_EQUAL_HEX32(5, m68k_get_reg(NULL, M68K_REG_D0));
+}
+
+void test_m68kcache_respects_cycle_budget(void)
+{
+    int      cached_pc[64], plain_pc[64];
+    int      cached_used[64], plain_used[64];
+    int      i;
+
+    /* Same position-independent loop, once in cacheable memory and once
+     * outside it (plain interpreter), sliced into tiny timeslices. */
+    load_program(TEST_CODE, s_count_loop, 6);
+    load_program(TEST_CODE_UNCACHED, s_count_loop, 6);
+
+    start_at(TEST_CODE);
+    for (i = 0; i < 64; i++)
+    {
+        cached_used[i] = m68k_execute(7);
+        cached_pc[i]   = (int)(m68k_get_reg(NULL, M68K_REG_PC) - TEST_CODE);
+    }
+
+    start_at(TEST_CODE_UNCACHED);
+    for (i = 0; i < 64; i++)
+    {
+        plain_used[i] = m68k_execute(7);
+        plain_pc[i]   = (int)(m68k_get_reg(NULL, M68K_REG_PC) - TEST_CODE_UNCACHED);
+    }
+
+    TEST_ASSERT_EQUAL_INT_ARRAY(plain_used, cached_used, 64);
+    TEST_ASSERT_EQUAL_INT_ARRAY(plain_pc, cached_pc, 64);
+}
+
+void test_m68kcache_direct_fetch_bypasses_memory_callbacks(void)
+{
+    /* Same self-modifying loop as above, fetched from the host window */
+    static const uint16_t prog[] = {
+        0x7000, 0x7404, 0x7201, 0xd081, 0x5238, 0x1005, 0x51ca, 0xfff6, 0x4afc
+    };
+
+    load_program(TEST_CODE, prog, 9);
+    m68k_set_fetch_callback(fetch_page);
+    start_at(TEST_CODE);
+    g_mem_reads = 0;
+    run_until_stop();
+
+    TEST_ASSERT_EQUAL_INT(1, g_emu_stops);
+    TEST_ASSERT_EQUAL_HEX32(1 + 2 + 3 + 4 + 5, m68k_get_reg(NULL, M68K_REG_D0));
+    /* only the data reads of addq.b, no opcode or extension fetches */
+    TEST_ASSERT_EQUAL_INT(5, g_mem_reads);
+}
+
+void test_m68kcache_fast_mode_hooks_block_dispatch_only(void)
+{
+    load_program(TEST_CODE, s_count_loop, 6);
+
+    /* debug loop: one hook call per instruction (2 + 10 * 2 + 1) */
+    start_at(TEST_CODE);
+    g_hook_calls = g_hook_loop_head = 0;
+    run_until_stop();
+    TEST_ASSERT_EQUAL_INT(23, g_hook_calls);
+    TEST_ASSERT_EQUAL_INT(10, g_hook_loop_head);
+
+    /* fast loop: entry, 9 taken DBF branches, exit to ILLEGAL */
+    m68k_cache_set_fast_mode(1);
+    start_at(TEST_CODE);
+    g_hook_calls = g_hook_loop_head = 0;
+    run_until_stop();
+    TEST_ASSERT_EQUAL_INT(11, g_hook_calls);
+    TEST_ASSERT_EQUAL_INT(9, g_hook_loop_head);
+    TEST_ASSERT_EQUAL_HEX32(10, m68k_get_reg(NULL, M68K_REG_D0));
+    TEST_ASSERT_EQUAL_HEX32(TEST_CODE + 12, m68k_get_reg(NULL, M68K_REG_PC));
+}
+
+#define IDIOM_SRC    0x3000
+#define IDIOM_DST    0x5000
+#define IDIOM_SLICES 256
+
+typedef struct
+{
+    int used, pc, d0, a0, a1, sr;
+} slice_state_t;
+
+/* Run a loop in 97-cycle timeslices from base, recording the state after each */
+static int run_sliced(uint32_t base, const uint16_t *prog, int words, uint32_t d0, slice_state_t *out)
+{
+    int i, n = 0;
+
+    for (i = 0; i < 0x400; i++)
+        g_mem[IDIOM_SRC + i] = (i % 251) + 1;       /* no NUL before the end */
+    g_mem[IDIOM_SRC + 0x3ff] = 0;
+    memset(g_mem + IDIOM_DST, 0xee, 0x400);
+
+    load_program(base, prog, words);
+    start_at(base);
+    m68k_set_reg(M68K_REG_D0, d0);
+    m68k_set_reg(M68K_REG_A0, IDIOM_SRC);
+    m68k_set_reg(M68K_REG_A1, IDIOM_DST);
+
+    while (!g_emu_stops && n < IDIOM_SLICES)
+    {
+        out[n].used = m68k_execute(97);
+        out[n].pc   = (int)(m68k_get_reg(NULL, M68K_REG_PC) - base);
+        out[n].d0   = (int)m68k_get_reg(NULL, M68K_REG_D0);
+        out[n].a0   = (int)m68k_get_reg(NULL, M68K_REG_A0);
+        out[n].a1   = (int)m68k_get_reg(NULL, M68K_REG_A1);
+        out[n].sr   = (int)m68k_get_reg(NULL, M68K_REG_SR);
+        n++;
+    }
+    return n;
+}
+
+void test_m68kcache_idioms_match_interpreter(void)
+{
+    static const uint16_t copy_dbf[]  = { 0x22d8, 0x51c8, 0xfffc, 0x4afc };   /* move.l (a0)+,(a1)+; dbf d0 */
+    static const uint16_t fill_subq[] = { 0x4259, 0x5380, 0x66fa, 0x4afc };   /* clr.w (a1)+; subq.l #1,d0; bne */
+    static const uint16_t strlen_[]   = { 0x4a18, 0x66fc, 0x4afc };           /* tst.b (a0)+; bne */
+    static const uint16_t strcpy_[]   = { 0x12d8, 0x66fc, 0x4afc };           /* move.b (a0)+,(a1)+; bne */
+    static const struct { const uint16_t *prog; int words; uint32_t d0; } loops[] = {
+        { copy_dbf, 4, 199 }, { fill_subq, 4, 300 }, { strlen_, 3, 0 }, { strcpy_, 3, 0 },
+    };
+    static slice_state_t bulk[IDIOM_SLICES], plain[IDIOM_SLICES];
+    static uint8_t       bulk_dst[0x400];
+    int                  i;
+
+    m68k_set_host_memory_callback(host_memory);
+
+    for (i = 0; i < (int)(sizeof(loops) / sizeof(loops[0])); i++)
+    {
+        int nb, np;
+
+        m68k_cache_set_fast_mode(1);
+        g_mem_reads = 0;
+        nb = run_sliced(TEST_CODE, loops[i].prog, loops[i].words, loops[i].d0, bulk);
+        TEST_ASSERT_EQUAL_INT(1, g_emu_stops);
+        TEST_ASSERT_TRUE(g_mem_reads < 400);        /* one pass per slice; 1000+ without */
+        memcpy(bulk_dst, g_mem + IDIOM_DST, sizeof(bulk_dst));
+
+        m68k_cache_set_fast_mode(0);
+        np = run_sliced(TEST_CODE_UNCACHED, loops[i].prog, loops[i].words, loops[i].d0, plain);
+
+        TEST_ASSERT_EQUAL_INT(np, nb);
+        TEST_ASSERT_EQUAL_INT_ARRAY((int *)plain, (int *)bulk, nb * 6);
+        TEST_ASSERT_EQUAL_MEMORY(g_mem + IDIOM_DST, bulk_dst, sizeof(bulk_dst));
+    }
+
+    m68k_set_host_memory_callback(NULL);
+}
+
+void test_m68kcache_bulk_copy_retires_middle_code_page(void)
+{
+    static const uint16_t copy_dbf[] = { 0x22d8, 0x51c8, 0xfffc, 0x4afc };   /* move.l (a0)+,(a1)+; dbf d0 */
+    static const uint16_t old_code[] = { 0x7001, 0x4afc };                   /* moveq #1,d0; illegal */
+    static const uint16_t new_code[] = { 0x7005, 0x4afc };                   /* moveq #5,d0; illegal */
+    int                   guard = 0;
+
+    /* record a block on 0x5000-0x5fff, the middle page of the copy below */
+    load_program(0x5400, old_code, 2);
+    start_at(0x5400);
+    run_until_stop();
+    start_at(0x5400);
+    run_until_stop();
+    TEST_ASSERT_EQUAL_HEX32(1, m68k_get_reg(NULL, M68K_REG_D0));
+
+    /* relocate 8 KB from 0x2000 to 0x4800 in one bulk pass */
+    load_program(0x2000 + 0x5400 - 0x4800, new_code, 2);
+    load_program(TEST_CODE, copy_dbf, 4);
+    m68k_set_host_memory_callback(host_memory);
+    m68k_cache_set_fast_mode(1);
+    m68k_set_reg(M68K_REG_PC, TEST_CODE);          /* no reset: keep the cache */
+    g_emu_stops = 0;
+    m68k_set_reg(M68K_REG_D0, 0x2000 / 4 - 1);
+    m68k_set_reg(M68K_REG_A0, 0x2000);
+    m68k_set_reg(M68K_REG_A1, 0x4800);
+    g_mem_reads = 0;
+    while (!g_emu_stops && guard++ < 100)
+        m68k_execute(100000);
+    m68k_set_host_memory_callback(NULL);
+    TEST_ASSERT_TRUE(g_mem_reads < 100);            /* ran in bulk */
+    TEST_ASSERT_EQUAL_HEX32(0x6800, m68k_get_reg(NULL, M68K_REG_A1));
+
+    m68k_set_reg(M68K_REG_PC, 0x5400);
+    g_emu_stops = 0;
+    run_until_stop();
+    TEST_ASSERT_EQUAL_HEX32(5, m68k_get_reg(NULL, M68K_REG_D0));
+}
+
+void test_m68kcache_busy_wait_ends_timeslice(void)
+{
+    static const uint16_t spin[]   = { 0x4a38, 0x2000, 0x67fa, 0x4afc };                 /* tst.b $2000.w; beq */
+    static const uint16_t scan[]   = { 0x2018, 0x4a80, 0x67fa, 0x4afc };                 /* move.l (a0)+,d0; tst.l d0; beq */
+    static const uint16_t stores[] = { 0x4238, 0x2000, 0x4a38, 0x2000, 0x67f6, 0x4afc }; /* clr.b; tst.b; beq */
+
+    m68k_cache_set_fast_mode(1);
+    m68k_cache_set_spin_detect(1);
+
+    load_program(TEST_CODE, spin, 4);
+    start_at(TEST_CODE);
+    g_mem_reads = 0;
+    m68k_execute(100000);
+    TEST_ASSERT_TRUE(g_mem_reads < 100);            /* a few passes, not the whole slice */
+    TEST_ASSERT_EQUAL_INT(1, m68k_cache_spin_detected());
+    TEST_ASSERT_EQUAL_INT(0, m68k_cache_spin_detected());
+    TEST_ASSERT_EQUAL_HEX32(TEST_CODE, m68k_get_reg(NULL, M68K_REG_PC));
+
+    /* the "interrupt" sets the flag: the loop exits normally */
+    g_mem[0x2000] = 1;
+    run_until_stop();
+    TEST_ASSERT_EQUAL_INT(1, g_emu_stops);
+
+    /* registers change every pass: not a busy-wait */
+    load_program(TEST_CODE, scan, 4);
+    start_at(TEST_CODE);
+    m68k_set_reg(M68K_REG_A0, 0x3000);
+    g_mem_reads = 0;
+    m68k_execute(10000);
+    TEST_ASSERT_TRUE(g_mem_reads > 1000);
+    TEST_ASSERT_EQUAL_INT(0, m68k_cache_spin_detected());
+
+    /* stores inside the loop: never treated as a busy-wait */
+    load_program(TEST_CODE + 0x100, stores, 6);
+    start_at(TEST_CODE + 0x100);
+    g_mem_reads = 0;
+    m68k_execute(10000);
+    TEST_ASSERT_TRUE(g_mem_reads > 1000);
+    TEST_ASSERT_EQUAL_INT(0, m68k_cache_spin_detected());
+}
+
+void test_m68kcache_end_timeslice_used_reports_cycles_run(void)
+{
+    int used_small, used_large, left_small, left_large;
+
+    /* the loop stops itself long before either budget is used up */
+    load_program(TEST_CODE, s_count_loop, 6);
+    start_at(TEST_CODE);
+    used_small = m68k_execute(5000);
+    start_at(TEST_CODE);
+    used_large = m68k_execute(50000);
+
+    TEST_ASSERT_EQUAL_INT(1, g_emu_stops);
+    TEST_ASSERT_TRUE(used_small > 0 && used_small < 5000);
+    TEST_ASSERT_EQUAL_INT(used_small, used_large);
+    TEST_ASSERT_EQUAL_INT(used_small, m68k_cycles_run());
+
+    /* Musashi's own m68k_end_timeslice() reports what was left instead */
+    g_stop_upstream = 1;
+    start_at(TEST_CODE);
+    left_small = m68k_execute(5000);
+    start_at(TEST_CODE);
+    left_large = m68k_execute(50000);
+
+    TEST_ASSERT_EQUAL_INT(45000, left_large - left_small);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_m68kcache_loop_result_matches_interpreter);
+    RUN_TEST(test_m68kcache_self_modifying_code_is_seen);
+    RUN_TEST(test_m68kcache_host_write_invalidates_block);
+    RUN_TEST(test_m68kcache_respects_cycle_budget);
+    RUN_TEST(test_m68kcache_direct_fetch_bypasses_memory_callbacks);
+    RUN_TEST(test_m68kcache_fast_mode_hooks_block_dispatch_only);
+    RUN_TEST(test_m68kcache_idioms_match_interpreter);
+    RUN_TEST(test_m68kcache_bulk_copy_retires_middle_code_page);
+    RUN_TEST(test_m68kcache_busy_wait_ends_timeslice);
+    RUN_TEST(test_m68kcache_end_timeslice_used_reports_cycles_run);
+    return UNITY_END();
+}
@@ -0,0 +1,342 @@
+/*
+ * Unit Tests for the 68881 host FPU mode
+ *
+ * Runs small hand-assembled FPU programs through the real Musashi core
+ * and checks that:
+ * - host mode arithmetic matches the softfloat (exact) results
+ * - host mode reports exceptions in the FPSR
+ * - the FPCR rounding mode is honoured
+ * - results narrowed to single precision are rounded once, not twice
+ * - transcendental instructions are available in host mode, and FSINCOS
+ *   rounds both results to the FPCR precision
+ */
+
+#include "unity.h"
+#include <float.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "m68k.h"
+#include "m68kcache.h"
+
+#define TEST_MEM_SIZE   0x10000
+#define TEST_CODE       0x1000
+#define TEST_RESULT     0x2000
+#define TEST_OPERANDS   0x3000
+
+#define FPSR_EXC_DZ     0x00000400
+#define FPSR_EXC_INEX2  0x00000200
+#define FPSR_AEXC_DZ    0x00000010
+
+static uint8_t g_mem[TEST_MEM_SIZE];
+static int     g_emu_stops;
+
+unsigned int m68k_read_memory_8(unsigned int address)
+{
+    return g_mem[address & (TEST_MEM_SIZE - 1)];
+}
+
+unsigned int m68k_read_memory_16(unsigned int address)
+{
+    return (m68k_read_memory_8(address) << 8) | m68k_read_memory_8(address + 1);
+}
+
+unsigned int m68k_read_memory_32(unsigned int address)
+{
+    return (m68k_read_memory_16(address) << 16) | m68k_read_memory_16(address + 2);
+}
+
+unsigned int m68k_read_disassembler_16(unsigned int address)
+{
+    return m68k_read_memory_16(address);
+}
+
+unsigned int m68k_read_disassembler_32(unsigned int address)
+{
+    return m68k_read_memory_32(address);
+}
+
+void m68k_write_memory_8(unsigned int address, unsigned int value)
+{
+    g_mem[address & (TEST_MEM_SIZE - 1)] = (uint8_t)value;
+}
+
+void m68k_write_memory_16(unsigned int address, unsigned int value)
+{
+    m68k_write_memory_8(address, value >> 8);
+    m68k_write_memory_8(address + 1, value);
+}
+
+void m68k_write_memory_32(unsigned int address, unsigned int value)
+{
+    m68k_write_memory_16(address, value >> 16);
+    m68k_write_memory_16(address + 2, value);
+}
+
+/* ILLEGAL acts as "stop" for the test programs, like an EMU_CALL */
+int op_illg(int level)
+{
+    (void)level;
+    g_emu_stops++;
+    m68k_end_timeslice_used();
+    return 1;
+}
+
+void cpu_instr_callback(int pc)
+{
+    (void)pc;
+}
+
+static void load_program(const uint16_t *prog, int words)
+{
+    int i;
+
+    for (i = 0; i < words; i++)
+    {
+        g_mem[TEST_CODE + i * 2]     = prog[i] >> 8;
+        g_mem[TEST_CODE + i * 2 + 1] = prog[i] & 0xff;
+    }
+
+    g_mem[0] = 0x00; g_mem[1] = 0x00; g_mem[2] = 0x80; g_mem[3] = 0x00;   /* SSP */
+    g_mem[4] = 0x00; g_mem[5] = 0x00; g_mem[6] = TEST_CODE >> 8; g_mem[7] = 0x00;
+    m68k_pulse_reset();
+    m68k_set_reg(M68K_REG_A0, TEST_RESULT);
+    m68k_set_reg(M68K_REG_A1, TEST_OPERANDS);
+    m68k_set_reg(M68K_REG_A2, TEST_OPERANDS + 12);
+    m68k_set_reg(M68K_REG_A3, TEST_RESULT + 12);
+    g_emu_stops = 0;
+}
+
+static void run_program(void)
+{
+    int guard = 0;
+
+    while (!g_emu_stops && guard++ < 100)
+        m68k_execute(1000);
+}
+
+/*
+ * FPCR is loaded from D3 and D0 / D1 into FP0 / FP1, FP0 = FP0 <op> FP1,
+ * then FP0 is stored as extended at (A0) and the FPSR is copied to D2.
+ */
+static void run_fpu_op(uint16_t fpgen, uint32_t d0, uint32_t d1, uint32_t fpcr)
+{
+    const uint16_t prog[] = {
+        0xf203, 0x9000,         /* FMOVE.L  D3,FPCR   */
+        0xf200, 0x4000,         /* FMOVE.L  D0,FP0    */
+        0xf201, 0x4080,         /* FMOVE.L  D1,FP1    */
+        0xf200, fpgen,          /* <op>     FP1,FP0   */
+        0xf210, 0x6800,         /* FMOVE.X  FP0,(A0)  */
+        0xf202, 0xa800,         /* FMOVE.L  FPSR,D2   */
+        0x4afc,                 /* ILLEGAL            */
+    };
+
+    load_program(prog, sizeof(prog) / sizeof(prog[0]));
+    m68k_set_reg(M68K_REG_D0, d0);
+    m68k_set_reg(M68K_REG_D1, d1);
+    m68k_set_reg(M68K_REG_D3, fpcr);
+    run_program();
+}
+
+/* Extended-precision operand n (0: FP0, 1: FP1) for run_fpu_op_x() */
+static void set_operand(int n, uint16_t exp, uint64_t mant)
+{
+    uint8_t *p = g_mem + TEST_OPERANDS + n * 12;
+    int i;
+
+    p[0] = exp >> 8;
+    p[1] = exp & 0xff;
+    p[2] = p[3] = 0;
+    for (i = 0; i < 8; i++)
+        p[4 + i] = (uint8_t)(mant >> (56 - 8 * i));
+}
+
+/*
+ * Like run_fpu_op(), with FP0 / FP1 loaded from the set_operand() values;
+ * FP2 is stored as well, at (A3).
+ */
+static void run_fpu_op_x(uint16_t fpgen, uint32_t fpcr)
+{
+    const uint16_t prog[] = {
+        0xf203, 0x9000,         /* FMOVE.L  D3,FPCR   */
+        0xf211, 0x4800,         /* FMOVE.X  (A1),FP0  */
+        0xf212, 0x4880,         /* FMOVE.X  (A2),FP1  */
+        0xf200, fpgen,          /* <op>     FP1,FP0   */
+        0xf210, 0x6800,         /* FMOVE.X  FP0,(A0)  */
+        0xf213, 0x6900,         /* FMOVE.X  FP2,(A3)  */
+        0xf202, 0xa800,         /* FMOVE.L  FPSR,D2   */
+        0x4afc,                 /* ILLEGAL            */
+    };
+
+    load_program(prog, sizeof(prog) / sizeof(prog[0]));
+    m68k_set_reg(M68K_REG_D3, fpcr);
+    run_program();
+}
+
+static uint16_t result_exp_at(int n)
+{
+    return (g_mem[TEST_RESULT + n * 12] << 8) | g_mem[TEST_RESULT + n * 12 + 1];
+}
+
+static uint64_t result_mant_at(int n)
+{
+    uint64_t m = 0;
+    int i;
+
+    for (i = 0; i < 8; i++)
+        m = (m << 8) | g_mem[TEST_RESULT + n * 12 + 4 + i];
+    return m;
+}
+
+static uint16_t result_exp(void)
+{
+    return result_exp_at(0);
+}
+
+static uint64_t result_mant(void)
+{
+    return result_mant_at(0);
+}
+
+void setUp(void)
+{
+    memset(g_mem, 0, sizeof(g_mem));
+    m68k_init();
+    m68k_set_cpu_type(M68K_CPU_TYPE_68030);
+    m68k_cache_set_fast_mode(0);
+    m68k_set_fpu_mode(M68K_FPU_EXACT);
+}
+
+void tearDown(void)
+{
+    m68k_set_fpu_mode(M68K_FPU_EXACT);
+}
+
+void test_m68kfpu_host_matches_exact(void)
+{
+    static const uint16_t ops[] = { 0x0420, 0x0422, 0x0423, 0x0428, 0x0404 };
+    int i;
+
+    for (i = 0; i < (int)(sizeof(ops) / sizeof(ops[0])); i++)
+    {
+        uint16_t exp;
+        uint64_t mant;
+
+        m68k_set_fpu_mode(M68K_FPU_EXACT);
+        run_fpu_op(ops[i], 1, 3, 0);
+        exp = result_exp();
+        mant = result_mant();
+
+        m68k_set_fpu_mode(M68K_FPU_HOST);
+        run_fpu_op(ops[i], 1, 3, 0);
+        TEST_ASSERT_EQUAL_HEX16(exp, result_exp());
+#if LDBL_MANT_DIG == 64
+        /* 80-bit host: bit-identical to softfloat */
+        TEST_ASSERT_TRUE(mant == result_mant());
+#else
+        /* double host: 53 significant bits */
+        TEST_ASSERT_TRUE((mant >> 11) == (result_mant() >> 11) ||
+                         (mant >> 11) + 1 == (result_mant() >> 11));
+#endif
+    }
+}
+
+void test_m68kfpu_host_reports_exceptions(void)
+{
+    m68k_set_fpu_mode(M68K_FPU_HOST);
+
+    run_fpu_op(0x0420, 1, 3, 0);                    /* 1 / 3 */
+    TEST_ASSERT_TRUE(m68k_get_reg(NULL, M68K_REG_D2) & FPSR_EXC_INEX2);
+    TEST_ASSERT_FALSE(m68k_get_reg(NULL, M68K_REG_D2) & FPSR_EXC_DZ);
+
+    run_fpu_op(0x0420, 1, 0, 0);                    /* 1 / 0 */
+    TEST_ASSERT_TRUE(m68k_get_reg(NULL, M68K_REG_D2) & FPSR_EXC_DZ);
+    TEST_ASSERT_TRUE(m68k_get_reg(NULL, M68K_REG_D2) & FPSR_AEXC_DZ);
+    TEST_ASSERT_EQUAL_HEX16(0x7fff, result_exp());  /* +inf */
+}
+
+void test_m68kfpu_host_honours_rounding_mode(void)
+{
+    uint64_t nearest, down, up;
+
+    m68k_set_fpu_mode(M68K_FPU_HOST);
+
+    run_fpu_op(0x0420, 2, 3, 0x00);                 /* 2 / 3, RN */
+    nearest = result_mant();
+    run_fpu_op(0x0420, 2, 3, 0x20);                 /* 2 / 3, RM */
+    down = result_mant();
+    run_fpu_op(0x0420, 2, 3, 0x30);                 /* 2 / 3, RP */
+    up = result_mant();
+
+    TEST_ASSERT_TRUE(down <= nearest && nearest <= up);
+    TEST_ASSERT_TRUE(down < up);
+
+    /* single precision (PREC = 01) clears the low mantissa bits */
+    run_fpu_op(0x0420, 2, 3, 0x40);
+    TEST_ASSERT_TRUE((result_mant() & 0xffffffffffull) == 0);
+}
+
+void test_m68kfpu_host_single_precision_rounds_once(void)
+{
+#if LDBL_MANT_DIG == 64
+    /*
+     * (1 + 2^-24 - 2^-45) * (1 + 2^-45) = 1 + 2^-24 + 2^-69 - 2^-90: just
+     * above the single-precision tie, so it rounds up to 1 + 2^-23.
+     * Rounded to extended first it becomes the tie itself and would then
+     * round to even, 1.0.
+     */
+    static const uint16_t ops[] = { 0x0463, 0x0423 };   /* FSMUL; FMUL at PREC = single */
+    static const uint32_t fpcr[] = { 0x00, 0x40 };
+    int i;
+
+    m68k_set_fpu_mode(M68K_FPU_HOST);
+    for (i = 0; i < 2; i++)
+    {
+        set_operand(0, 0x3fff, 0x8000000000000000ull + (1ull << 39) - (1ull << 18));
+        set_operand(1, 0x3fff, 0x8000000000000000ull + (1ull << 18));
+        run_fpu_op_x(ops[i], fpcr[i]);
+        TEST_ASSERT_EQUAL_HEX16(0x3fff, result_exp());
+        TEST_ASSERT_TRUE(result_mant() == 0x8000010000000000ull);
+        TEST_ASSERT_TRUE(m68k_get_reg(NULL, M68K_REG_D2) & FPSR_EXC_INEX2);
+    }
+
+    /* exact products stay exact */
+    set_operand(0, 0x3fff, 0xc000000000000000ull);      /* 1.5 */
+    set_operand(1, 0x4000, 0xc000000000000000ull);      /* 3.0 */
+    run_fpu_op_x(0x0463, 0);
+    TEST_ASSERT_EQUAL_HEX16(0x4001, result_exp());
+    TEST_ASSERT_TRUE(result_mant() == 0x9000000000000000ull);
+    TEST_ASSERT_FALSE(m68k_get_reg(NULL, M68K_REG_D2) & FPSR_EXC_INEX2);
+#else
+    TEST_IGNORE_MESSAGE("needs an 80-bit long double host");
+#endif
+}
+
+void test_m68kfpu_transcendentals_in_host_mode(void)
+{
+    m68k_set_fpu_mode(M68K_FPU_HOST);
+    run_fpu_op(0x0010, 0, 0, 0);                    /* FETOX FP0: e^0 */
+    TEST_ASSERT_EQUAL_HEX16(0x3fff, result_exp());
+    TEST_ASSERT_TRUE(result_mant() == 0x8000000000000000ull);
+
+    /* FSINCOS FP1,FP2:FP0 at single precision: both results narrowed */
+    set_operand(0, 0, 0);
+    set_operand(1, 0x3fff, 0x8000000000000000ull);      /* 1.0 */
+    run_fpu_op_x(0x0432, 0x40);
+    TEST_ASSERT_EQUAL_HEX16(0x3ffe, result_exp_at(0)); /* sin(1) = 0.84 */
+    TEST_ASSERT_TRUE((result_mant_at(0) & 0xffffffffffull) == 0);
+    TEST_ASSERT_EQUAL_HEX16(0x3ffe, result_exp_at(1)); /* cos(1) = 0.54 */
+    TEST_ASSERT_TRUE(result_mant_at(1) != 0);
+    TEST_ASSERT_TRUE((result_mant_at(1) & 0xffffffffffull) == 0);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_m68kfpu_host_matches_exact);
+    RUN_TEST(test_m68kfpu_host_reports_exceptions);
+    RUN_TEST(test_m68kfpu_host_honours_rounding_mode);
+    RUN_TEST(test_m68kfpu_host_single_precision_rounds_once);
+    RUN_TEST(test_m68kfpu_transcendentals_in_host_mode);
+    return UNITY_END();
+}
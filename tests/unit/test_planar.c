@@ -0,0 +1,216 @@
+/*
+ * Unit Tests for the planar-to-chunky kernels
+ *
+ * Links the real planar.c and checks every kernel the host CPU can run
+ * against the plain bit loop:
+ * - depths 1-8 on random bitplanes, whole rows
+ * - column ranges that start and end inside a plane byte
+ * - NULL planes read as 0
+ * - the automatic choice is the best supported kernel
+ * - colour index -> ARGB matches a table lookup for every length 0..ROW
+ * and reports the throughput of each kernel on a 640 pixel, 8 plane row.
+ */
+
+#include "unity.h"
+
+#include "planar.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ROW_BYTES   160                 /* 1280 pixels */
+#define ROW_PIXELS  (ROW_BYTES * 8)
+
+static uint8_t         s_plane_data[8][ROW_BYTES];
+static planar_kernel_t s_auto_kernel;
+
+static void reference_row(uint8_t *dst, const uint8_t **planes, int col_start, int col_end, int depth)
+{
+    for (int col = col_start; col < col_end; col++)
+    {
+        uint8_t pixel = 0;
+
+        for (int p = 0; p < depth; p++)
+        {
+            if (planes[p] && (planes[p][col / 8] & (0x80 >> (col % 8))))
+                pixel |= 1 << p;
+        }
+        dst[col - col_start] = pixel;
+    }
+}
+
+/* Convert with kernel k and compare; the byte after the range must stay */
+static void check_row(planar_kernel_t k, const uint8_t **planes, int col_start, int col_end, int depth)
+{
+    uint8_t expected[ROW_PIXELS + 1];
+    uint8_t actual[ROW_PIXELS + 1];
+    int     n = col_end - col_start;
+    char    msg[96];
+
+    snprintf(msg, sizeof(msg), "%s: depth %d, columns %d..%d",
+             planar_kernel_name(k), depth, col_start, col_end);
+
+    memset(actual, 0xa5, sizeof(actual));
+    reference_row(expected, planes, col_start, col_end, depth);
+    expected[n] = 0xa5;
+
+    planar_to_chunky_row(actual, planes, 0, col_start, col_end, depth);
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(expected, actual, n + 1, msg);
+}
+
+void setUp(void)
+{
+    srand(172);
+    for (int p = 0; p < 8; p++)
+        for (int i = 0; i < ROW_BYTES; i++)
+            s_plane_data[p][i] = (uint8_t)rand();
+}
+
+void tearDown(void)
+{
+    planar_set_kernel(s_auto_kernel);
+}
+
+void test_planar_auto_kernel_is_best_supported(void)
+{
+    TEST_ASSERT_TRUE(planar_set_kernel(PLANAR_KERNEL_SCALAR));
+    for (int k = s_auto_kernel + 1; k < PLANAR_NUM_KERNELS; k++)
+        TEST_ASSERT_FALSE(planar_set_kernel((planar_kernel_t)k));
+    TEST_ASSERT_FALSE(planar_set_kernel(PLANAR_NUM_KERNELS));
+}
+
+void test_planar_kernels_match_bit_loop_on_whole_rows(void)
+{
+    const uint8_t *planes[8];
+
+    for (int p = 0; p < 8; p++)
+        planes[p] = s_plane_data[p];
+
+    for (int k = 0; k < PLANAR_NUM_KERNELS; k++)
+    {
+        if (!planar_set_kernel((planar_kernel_t)k))
+            continue;
+        for (int depth = 1; depth <= 8; depth++)
+            check_row((planar_kernel_t)k, planes, 0, ROW_PIXELS, depth);
+    }
+}
+
+void test_planar_kernels_match_bit_loop_on_unaligned_ranges(void)
+{
+    const uint8_t *planes[8];
+
+    for (int p = 0; p < 8; p++)
+        planes[p] = s_plane_data[p];
+
+    for (int k = 0; k < PLANAR_NUM_KERNELS; k++)
+    {
+        if (!planar_set_kernel((planar_kernel_t)k))
+            continue;
+        for (int i = 0; i < 200; i++)
+        {
+            int start = rand() % ROW_PIXELS;
+            int end   = start + rand() % (ROW_PIXELS - start + 1);
+
+            check_row((planar_kernel_t)k, planes, start, end, 1 + rand() % 8);
+        }
+    }
+}
+
+void test_planar_kernels_treat_null_planes_as_zero(void)
+{
+    const uint8_t *planes[8];
+
+    for (int p = 0; p < 8; p++)
+        planes[p] = (p == 0 || p == 3 || p == 7) ? NULL : s_plane_data[p];
+
+    for (int k = 0; k < PLANAR_NUM_KERNELS; k++)
+    {
+        if (!planar_set_kernel((planar_kernel_t)k))
+            continue;
+        check_row((planar_kernel_t)k, planes, 0, ROW_PIXELS, 8);
+        check_row((planar_kernel_t)k, planes, 5, 613, 5);
+    }
+}
+
+void test_planar_argb_matches_table_lookup(void)
+{
+    static uint32_t lut[256];
+    static uint8_t  src[ROW_PIXELS];
+    static uint32_t dst[ROW_PIXELS + 1];
+
+    for (int i = 0; i < 256; i++)
+        lut[i] = 0xff000000u | (uint32_t)rand() << 8 | (uint32_t)i;
+    for (int i = 0; i < ROW_PIXELS; i++)
+        src[i] = (uint8_t)rand();
+
+    for (int k = 0; k < PLANAR_NUM_KERNELS; k++)
+    {
+        if (!planar_set_kernel((planar_kernel_t)k))
+            continue;
+        for (int n = 0; n <= 67; n++)
+        {
+            int off = rand() % (ROW_PIXELS - n + 1);
+
+            dst[n] = 0xdeadbeef;
+            chunky_to_argb_row(dst, src + off, n, lut);
+            for (int i = 0; i < n; i++)
+                TEST_ASSERT_EQUAL_HEX32(lut[src[off + i]], dst[i]);
+            TEST_ASSERT_EQUAL_HEX32(0xdeadbeef, dst[n]);
+        }
+        chunky_to_argb_row(dst, src, ROW_PIXELS, lut);
+        for (int i = 0; i < ROW_PIXELS; i++)
+            TEST_ASSERT_EQUAL_HEX32(lut[src[i]], dst[i]);
+    }
+}
+
+/* Not a pass/fail check: Mpixel/s per kernel for the log */
+void test_planar_kernel_throughput(void)
+{
+    const uint8_t  *planes[8];
+    static uint8_t  dst[640];
+    static uint32_t argb[640];
+    static uint32_t lut[256];
+
+    for (int p = 0; p < 8; p++)
+        planes[p] = s_plane_data[p];
+
+    for (int k = 0; k < PLANAR_NUM_KERNELS; k++)
+    {
+        struct timespec t0, t1, t2;
+        const int       rows = 20000;
+        double          secs, argb_secs;
+
+        if (!planar_set_kernel((planar_kernel_t)k))
+            continue;
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int i = 0; i < rows; i++)
+            planar_to_chunky_row(dst, planes, 0, 0, 640, 8);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        for (int i = 0; i < rows; i++)
+            chunky_to_argb_row(argb, dst, 640, lut);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+
+        secs      = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+        argb_secs = (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) / 1e9;
+        printf("%-6s %8.1f Mpixel/s (640 x 8 planes), ARGB %8.1f Mpixel/s\n",
+               planar_kernel_name((planar_kernel_t)k), rows * 640.0 / secs / 1e6,
+               rows * 640.0 / argb_secs / 1e6);
+    }
+}
+
+int main(void)
+{
+    s_auto_kernel = planar_get_kernel();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_planar_auto_kernel_is_best_supported);
+    RUN_TEST(test_planar_kernels_match_bit_loop_on_whole_rows);
+    RUN_TEST(test_planar_kernels_match_bit_loop_on_unaligned_ranges);
+    RUN_TEST(test_planar_kernels_treat_null_planes_as_zero);
+    RUN_TEST(test_planar_argb_matches_table_lookup);
+    RUN_TEST(test_planar_kernel_throughput);
+    return UNITY_END();
+}
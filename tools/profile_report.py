@@ -5,6 +5,8 @@ profile_report.py - lxa profiling JSON report tool (Phase 126)
 Reads the JSON output of lxa_profile_write_json() and prints:
   - Top-10 EMU_CALLs by cumulative wall-clock nanoseconds
   - Top-10 EMU_CALLs by call count
+  - Top-10 ROM library functions by exclusive and inclusive emulated
+    cycles (per-LVO records, "kind": "lvo")
 
 Usage:
     python tools/profile_report.py <profile.json> [--top N] [--csv]
@@ -45,6 +47,39 @@ def print_table(title: str, rows: list[dict], key: str, label: str) -> None:
         )
 
 
+def print_lvo_table(title: str, rows: list[dict], total_cycles: int) -> None:
+    print(f"\n=== {title} ===")
+    header = (f"{'Rank':>4}  {'Function':<36}  {'Calls':>10}  {'Self cycles':>14}  "
+              f"{'Total cycles':>14}  {'Self %':>6}  {'Self ns':>14}  {'Total ns':>14}")
+    print(header)
+    print("-" * len(header))
+    for rank, row in enumerate(rows, 1):
+        pct = 100.0 * row.get("self_cycles", 0) / max(total_cycles, 1)
+        print(
+            f"{rank:>4}  {row['name']:<36}  {row['calls']:>10,}  {row['self_cycles']:>14,}  "
+            f"{row['cycles']:>14,}  {pct:>5.1f}%  {row['self_ns']:>14,}  {row['total_ns']:>14,}"
+        )
+
+
+def report_lvo(lvos: list[dict], top: int, csv: bool) -> None:
+    by_self  = sorted(lvos, key=lambda x: x.get("self_cycles", 0), reverse=True)[:top]
+    by_total = sorted(lvos, key=lambda x: x.get("cycles", 0), reverse=True)[:top]
+    total_self = sum(r.get("self_cycles", 0) for r in lvos)
+
+    if csv:
+        print()
+        print("rank,function,calls,self_cycles,cycles,self_ns,total_ns")
+        for rank, row in enumerate(by_self, 1):
+            print(f"{rank},{row['name']},{row['calls']},{row['self_cycles']},{row['cycles']},"
+                  f"{row['self_ns']},{row['total_ns']}")
+        return
+
+    print(f"\n  ROM functions    : {len(lvos)}")
+    print(f"  Self cycles      : {total_self:,}")
+    print_lvo_table(f"Top {top} ROM functions by self cycles", by_self, total_self)
+    print_lvo_table(f"Top {top} ROM functions by total cycles", by_total, total_self)
+
+
 def main() -> int:
     parser = argparse.ArgumentParser(description="lxa profiling report")
     parser.add_argument("profile_json", help="Path to profile JSON file")
@@ -62,6 +97,10 @@ def main() -> int:
         print("Profile file is empty (no EMU_CALLs were recorded).")
         return 0
 
+    # Per-LVO records follow the EMU_CALL ones
+    lvos = [r for r in data if r.get("kind") == "lvo"]
+    data = [r for r in data if r.get("kind", "emucall") == "emucall"]
+
     # Sort by total_ns descending for the first table
     by_ns    = sorted(data, key=lambda x: x.get("total_ns", 0), reverse=True)[: args.top]
     # Sort by calls descending for the second table
@@ -75,6 +114,8 @@ def main() -> int:
         for rank, row in enumerate(by_ns, 1):
             pct = 100.0 * row.get("total_ns", 0) / max(total_ns, 1)
             print(f"{rank},{row['name']},{row['calls']},{row['total_ns']},{pct:.2f}")
+        if lvos:
+            report_lvo(lvos, args.top, True)
         return 0
 
     print(f"\nlxa Profile Report")
@@ -105,6 +146,9 @@ def main() -> int:
         "Call count",
     )
 
+    if lvos:
+        report_lvo(lvos, args.top, False)
+
     return 0
 
 